@@ -0,0 +1,125 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Throughput of the engine to HIDL measurement conversion, at the maximum of
+// GNSS_MEASUREMENTS_MAX (128) measurements per epoch. The "FreshArena"
+// variants start every epoch from an empty arena, which is what the
+// conversion cost before the arena was kept across epochs.
+
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+
+#include "MeasurementAPIClient.h"
+
+using namespace android::hardware::gnss;
+using android::hardware::gnss::V2_0::implementation::convertGnssData_1_1;
+using android::hardware::gnss::V2_0::implementation::convertGnssData_2_0;
+
+static void fillEpoch(GnssMeasurementsNotification& n, uint32_t count)
+{
+    memset(&n, 0, sizeof(n));
+    n.size = sizeof(n);
+    n.count = count;
+    for (uint32_t i = 0; i < count; i++) {
+        GnssMeasurementsData& m = n.measurements[i];
+        m.size = sizeof(m);
+        m.svId = 1 + i % 32;
+        // Spread over every constellation and code type, and set the most
+        // common flag, state and ADR bits
+        m.svType = static_cast<GnssSvType>(1 + i % 7);
+        m.codeType = static_cast<GnssMeasurementsCodeType>(i % 15);
+        m.flags = GNSS_MEASUREMENTS_DATA_SIGNAL_TO_NOISE_RATIO_BIT |
+                  GNSS_MEASUREMENTS_DATA_CARRIER_FREQUENCY_BIT |
+                  GNSS_MEASUREMENTS_DATA_AUTOMATIC_GAIN_CONTROL_BIT;
+        m.stateMask = GNSS_MEASUREMENTS_STATE_CODE_LOCK_BIT |
+                      GNSS_MEASUREMENTS_STATE_BIT_SYNC_BIT |
+                      GNSS_MEASUREMENTS_STATE_TOW_DECODED_BIT;
+        m.adrStateMask = GNSS_MEASUREMENTS_ACCUMULATED_DELTA_RANGE_STATE_VALID_BIT;
+        m.receivedSvTimeNs = 1000000LL * i;
+        m.carrierToNoiseDbHz = 30.0 + i % 15;
+        m.carrierFrequencyHz = 1575.42e6f;
+    }
+    n.clock.size = sizeof(n.clock);
+    n.clock.flags = GNSS_MEASUREMENTS_CLOCK_FLAGS_FULL_BIAS_BIT;
+}
+
+template <class GnssData, class Measurement,
+          void (*convert)(GnssMeasurementsNotification&, GnssData&, std::vector<Measurement>&)>
+static void BM_Convert(benchmark::State& state, bool freshArena)
+{
+    static GnssMeasurementsNotification epoch;
+    fillEpoch(epoch, state.range(0));
+    std::vector<Measurement> arena;
+
+    for (auto _ : state) {
+        if (freshArena) {
+            std::vector<Measurement>().swap(arena);
+        }
+        GnssData data;
+        convert(epoch, data, arena);
+        benchmark::DoNotOptimize(data.measurements.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_Convert_1_1(benchmark::State& state)
+{
+    BM_Convert<V1_1::IGnssMeasurementCallback::GnssData,
+               V1_1::IGnssMeasurementCallback::GnssMeasurement,
+               convertGnssData_1_1>(state, false);
+}
+
+static void BM_Convert_1_1_FreshArena(benchmark::State& state)
+{
+    BM_Convert<V1_1::IGnssMeasurementCallback::GnssData,
+               V1_1::IGnssMeasurementCallback::GnssMeasurement,
+               convertGnssData_1_1>(state, true);
+}
+
+static void BM_Convert_2_0(benchmark::State& state)
+{
+    BM_Convert<V2_0::IGnssMeasurementCallback::GnssData,
+               V2_0::IGnssMeasurementCallback::GnssMeasurement,
+               convertGnssData_2_0>(state, false);
+}
+
+static void BM_Convert_2_0_FreshArena(benchmark::State& state)
+{
+    BM_Convert<V2_0::IGnssMeasurementCallback::GnssData,
+               V2_0::IGnssMeasurementCallback::GnssMeasurement,
+               convertGnssData_2_0>(state, true);
+}
+
+BENCHMARK(BM_Convert_1_1)->Arg(GNSS_MEASUREMENTS_MAX);
+BENCHMARK(BM_Convert_1_1_FreshArena)->Arg(GNSS_MEASUREMENTS_MAX);
+BENCHMARK(BM_Convert_2_0)->Arg(GNSS_MEASUREMENTS_MAX);
+BENCHMARK(BM_Convert_2_0_FreshArena)->Arg(GNSS_MEASUREMENTS_MAX);
+
+BENCHMARK_MAIN();
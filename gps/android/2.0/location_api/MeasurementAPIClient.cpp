@@ -47,10 +47,6 @@ using ::android::hardware::gnss::V2_0::IGnssMeasurementCallback;
 
 static void convertGnssData(GnssMeasurementsNotification& in,
         V1_0::IGnssMeasurementCallback::GnssData& out);
-static void convertGnssData_1_1(GnssMeasurementsNotification& in,
-        V1_1::IGnssMeasurementCallback::GnssData& out);
-static void convertGnssData_2_0(GnssMeasurementsNotification& in,
-        V2_0::IGnssMeasurementCallback::GnssData& out);
 static void convertGnssMeasurement(GnssMeasurementsData& in,
         V1_0::IGnssMeasurementCallback::GnssMeasurement& out);
 static void convertGnssClock(GnssMeasurementsClock& in, IGnssMeasurementCallback::GnssClock& out);
@@ -188,7 +184,7 @@ void MeasurementAPIClient::onGnssMeasurementsCb(
 
         if (gnssMeasurementCbIface_2_0 != nullptr) {
             V2_0::IGnssMeasurementCallback::GnssData gnssData;
-            convertGnssData_2_0(gnssMeasurementsNotification, gnssData);
+            convertGnssData_2_0(gnssMeasurementsNotification, gnssData, mMeasurements_2_0);
             auto r = gnssMeasurementCbIface_2_0->gnssMeasurementCb_2_0(gnssData);
             if (!r.isOk()) {
                 LOC_LOGE("%s] Error from gnssMeasurementCb description=%s",
@@ -196,7 +192,7 @@ void MeasurementAPIClient::onGnssMeasurementsCb(
             }
         } else if (gnssMeasurementCbIface_1_1 != nullptr) {
             V1_1::IGnssMeasurementCallback::GnssData gnssData;
-            convertGnssData_1_1(gnssMeasurementsNotification, gnssData);
+            convertGnssData_1_1(gnssMeasurementsNotification, gnssData, mMeasurements_1_1);
             auto r = gnssMeasurementCbIface_1_1->gnssMeasurementCb(gnssData);
             if (!r.isOk()) {
                 LOC_LOGE("%s] Error from gnssMeasurementCb description=%s",
@@ -214,67 +210,117 @@ void MeasurementAPIClient::onGnssMeasurementsCb(
     }
 }
 
+typedef IGnssMeasurementCallback::GnssMeasurementFlags MeasurementFlags;
+typedef IGnssMeasurementCallback::GnssMeasurementState MeasurementState;
+typedef IGnssMeasurementCallback::GnssAccumulatedDeltaRangeState AdrState;
+
+// Engine to HIDL bit translation tables, indexed by the engine bit position
+static const uint32_t sMeasurementFlagsTable[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    static_cast<uint32_t>(MeasurementFlags::HAS_CARRIER_FREQUENCY),
+    static_cast<uint32_t>(MeasurementFlags::HAS_CARRIER_CYCLES),
+    static_cast<uint32_t>(MeasurementFlags::HAS_CARRIER_PHASE),
+    static_cast<uint32_t>(MeasurementFlags::HAS_CARRIER_PHASE_UNCERTAINTY),
+    0,
+    static_cast<uint32_t>(MeasurementFlags::HAS_SNR),
+    static_cast<uint32_t>(MeasurementFlags::HAS_AUTOMATIC_GAIN_CONTROL),
+};
+
+static const uint32_t sMeasurementStateTable[] = {
+    static_cast<uint32_t>(MeasurementState::STATE_CODE_LOCK),
+    static_cast<uint32_t>(MeasurementState::STATE_BIT_SYNC),
+    static_cast<uint32_t>(MeasurementState::STATE_SUBFRAME_SYNC),
+    static_cast<uint32_t>(MeasurementState::STATE_TOW_DECODED),
+    static_cast<uint32_t>(MeasurementState::STATE_MSEC_AMBIGUOUS),
+    static_cast<uint32_t>(MeasurementState::STATE_SYMBOL_SYNC),
+    static_cast<uint32_t>(MeasurementState::STATE_GLO_STRING_SYNC),
+    static_cast<uint32_t>(MeasurementState::STATE_GLO_TOD_DECODED),
+    static_cast<uint32_t>(MeasurementState::STATE_BDS_D2_BIT_SYNC),
+    static_cast<uint32_t>(MeasurementState::STATE_BDS_D2_SUBFRAME_SYNC),
+    static_cast<uint32_t>(MeasurementState::STATE_GAL_E1BC_CODE_LOCK),
+    static_cast<uint32_t>(MeasurementState::STATE_GAL_E1C_2ND_CODE_LOCK),
+    static_cast<uint32_t>(MeasurementState::STATE_GAL_E1B_PAGE_SYNC),
+    static_cast<uint32_t>(MeasurementState::STATE_SBAS_SYNC),
+    static_cast<uint32_t>(MeasurementState::STATE_TOW_KNOWN),
+    static_cast<uint32_t>(MeasurementState::STATE_GLO_TOD_KNOWN),
+    static_cast<uint32_t>(MeasurementState::STATE_2ND_CODE_LOCK),
+};
+// 1.0 measurements only ever carried the states up to STATE_SBAS_SYNC
+#define MEASUREMENT_STATE_MASK_1_0 ((GNSS_MEASUREMENTS_STATE_SBAS_SYNC_BIT << 1) - 1)
+
+static const uint32_t sAdrStateTable[] = {
+    static_cast<uint32_t>(AdrState::ADR_STATE_VALID),
+    static_cast<uint32_t>(AdrState::ADR_STATE_RESET),
+    static_cast<uint32_t>(AdrState::ADR_STATE_CYCLE_SLIP),
+    static_cast<uint32_t>(AdrState::ADR_STATE_HALF_CYCLE_RESOLVED),
+};
+#define ADR_STATE_MASK_1_0 \
+    ((GNSS_MEASUREMENTS_ACCUMULATED_DELTA_RANGE_STATE_CYCLE_SLIP_BIT << 1) - 1)
+
+// indexed by GnssSvType
+static const V1_0::GnssConstellationType sConstellationTable_1_0[] = {
+    V1_0::GnssConstellationType::UNKNOWN,
+    V1_0::GnssConstellationType::GPS,
+    V1_0::GnssConstellationType::SBAS,
+    V1_0::GnssConstellationType::GLONASS,
+    V1_0::GnssConstellationType::QZSS,
+    V1_0::GnssConstellationType::BEIDOU,
+    V1_0::GnssConstellationType::GALILEO,
+    V1_0::GnssConstellationType::UNKNOWN,
+};
+
+static const V2_0::GnssConstellationType sConstellationTable_2_0[] = {
+    V2_0::GnssConstellationType::UNKNOWN,
+    V2_0::GnssConstellationType::GPS,
+    V2_0::GnssConstellationType::SBAS,
+    V2_0::GnssConstellationType::GLONASS,
+    V2_0::GnssConstellationType::QZSS,
+    V2_0::GnssConstellationType::BEIDOU,
+    V2_0::GnssConstellationType::GALILEO,
+    V2_0::GnssConstellationType::IRNSS,
+};
+
+// indexed by GnssMeasurementsCodeType, static storage so hidl_string can point at it
+static const char* const sCodeTypeTable[] = {
+    "A", "B", "C", "I", "L", "M", "P", "Q", "S", "W", "X", "Y", "Z", "N",
+};
+static const char sCodeTypeUnknown[] = "UNKNOWN";
+
+#define TABLE_SIZE(table) (sizeof(table) / sizeof((table)[0]))
+
+static inline uint32_t translateMask(uint32_t in, const uint32_t* table, size_t tableSize)
+{
+    uint32_t out = 0;
+    while (0 != in) {
+        uint32_t bit = __builtin_ctz(in);
+        if (bit >= tableSize) {
+            break;
+        }
+        out |= table[bit];
+        in &= in - 1;
+    }
+    return out;
+}
+
 static void convertGnssMeasurement(GnssMeasurementsData& in,
         V1_0::IGnssMeasurementCallback::GnssMeasurement& out)
 {
     memset(&out, 0, sizeof(out));
-    if (in.flags & GNSS_MEASUREMENTS_DATA_SIGNAL_TO_NOISE_RATIO_BIT)
-        out.flags |= IGnssMeasurementCallback::GnssMeasurementFlags::HAS_SNR;
-    if (in.flags & GNSS_MEASUREMENTS_DATA_CARRIER_FREQUENCY_BIT)
-        out.flags |= IGnssMeasurementCallback::GnssMeasurementFlags::HAS_CARRIER_FREQUENCY;
-    if (in.flags & GNSS_MEASUREMENTS_DATA_CARRIER_CYCLES_BIT)
-        out.flags |= IGnssMeasurementCallback::GnssMeasurementFlags::HAS_CARRIER_CYCLES;
-    if (in.flags & GNSS_MEASUREMENTS_DATA_CARRIER_PHASE_BIT)
-        out.flags |= IGnssMeasurementCallback::GnssMeasurementFlags::HAS_CARRIER_PHASE;
-    if (in.flags & GNSS_MEASUREMENTS_DATA_CARRIER_PHASE_UNCERTAINTY_BIT)
-        out.flags |= IGnssMeasurementCallback::GnssMeasurementFlags::HAS_CARRIER_PHASE_UNCERTAINTY;
-    if (in.flags & GNSS_MEASUREMENTS_DATA_AUTOMATIC_GAIN_CONTROL_BIT)
-        out.flags |= IGnssMeasurementCallback::GnssMeasurementFlags::HAS_AUTOMATIC_GAIN_CONTROL;
+    out.flags = translateMask(in.flags, sMeasurementFlagsTable,
+                              TABLE_SIZE(sMeasurementFlagsTable));
     out.svid = in.svId;
-    convertGnssConstellationType(in.svType, out.constellation);
+    out.constellation = (in.svType < TABLE_SIZE(sConstellationTable_1_0)) ?
+            sConstellationTable_1_0[in.svType] : V1_0::GnssConstellationType::UNKNOWN;
     out.timeOffsetNs = in.timeOffsetNs;
-    if (in.stateMask & GNSS_MEASUREMENTS_STATE_CODE_LOCK_BIT)
-        out.state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_CODE_LOCK;
-    if (in.stateMask & GNSS_MEASUREMENTS_STATE_BIT_SYNC_BIT)
-        out.state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_BIT_SYNC;
-    if (in.stateMask & GNSS_MEASUREMENTS_STATE_SUBFRAME_SYNC_BIT)
-        out.state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_SUBFRAME_SYNC;
-    if (in.stateMask & GNSS_MEASUREMENTS_STATE_TOW_DECODED_BIT)
-        out.state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_TOW_DECODED;
-    if (in.stateMask & GNSS_MEASUREMENTS_STATE_MSEC_AMBIGUOUS_BIT)
-        out.state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_MSEC_AMBIGUOUS;
-    if (in.stateMask & GNSS_MEASUREMENTS_STATE_SYMBOL_SYNC_BIT)
-        out.state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_SYMBOL_SYNC;
-    if (in.stateMask & GNSS_MEASUREMENTS_STATE_GLO_STRING_SYNC_BIT)
-        out.state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_GLO_STRING_SYNC;
-    if (in.stateMask & GNSS_MEASUREMENTS_STATE_GLO_TOD_DECODED_BIT)
-        out.state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_GLO_TOD_DECODED;
-    if (in.stateMask & GNSS_MEASUREMENTS_STATE_BDS_D2_BIT_SYNC_BIT)
-        out.state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_BDS_D2_BIT_SYNC;
-    if (in.stateMask & GNSS_MEASUREMENTS_STATE_BDS_D2_SUBFRAME_SYNC_BIT)
-        out.state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_BDS_D2_SUBFRAME_SYNC;
-    if (in.stateMask & GNSS_MEASUREMENTS_STATE_GAL_E1BC_CODE_LOCK_BIT)
-        out.state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_GAL_E1BC_CODE_LOCK;
-    if (in.stateMask & GNSS_MEASUREMENTS_STATE_GAL_E1C_2ND_CODE_LOCK_BIT)
-        out.state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_GAL_E1C_2ND_CODE_LOCK;
-    if (in.stateMask & GNSS_MEASUREMENTS_STATE_GAL_E1B_PAGE_SYNC_BIT)
-        out.state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_GAL_E1B_PAGE_SYNC;
-    if (in.stateMask &  GNSS_MEASUREMENTS_STATE_SBAS_SYNC_BIT)
-        out.state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_SBAS_SYNC;
+    out.state = translateMask(in.stateMask & MEASUREMENT_STATE_MASK_1_0,
+                              sMeasurementStateTable, TABLE_SIZE(sMeasurementStateTable));
     out.receivedSvTimeInNs = in.receivedSvTimeNs;
     out.receivedSvTimeUncertaintyInNs = in.receivedSvTimeUncertaintyNs;
     out.cN0DbHz = in.carrierToNoiseDbHz;
     out.pseudorangeRateMps = in.pseudorangeRateMps;
     out.pseudorangeRateUncertaintyMps = in.pseudorangeRateUncertaintyMps;
-    if (in.adrStateMask & GNSS_MEASUREMENTS_ACCUMULATED_DELTA_RANGE_STATE_VALID_BIT)
-        out.accumulatedDeltaRangeState |=
-            IGnssMeasurementCallback::GnssAccumulatedDeltaRangeState::ADR_STATE_VALID;
-    if (in.adrStateMask & GNSS_MEASUREMENTS_ACCUMULATED_DELTA_RANGE_STATE_RESET_BIT)
-        out.accumulatedDeltaRangeState |=
-            IGnssMeasurementCallback::GnssAccumulatedDeltaRangeState::ADR_STATE_RESET;
-    if (in.adrStateMask & GNSS_MEASUREMENTS_ACCUMULATED_DELTA_RANGE_STATE_CYCLE_SLIP_BIT)
-        out.accumulatedDeltaRangeState |=
-            IGnssMeasurementCallback::GnssAccumulatedDeltaRangeState::ADR_STATE_CYCLE_SLIP;
+    out.accumulatedDeltaRangeState = translateMask(in.adrStateMask & ADR_STATE_MASK_1_0,
+                                                   sAdrStateTable, TABLE_SIZE(sAdrStateTable));
     out.accumulatedDeltaRangeM = in.adrMeters;
     out.accumulatedDeltaRangeUncertaintyM = in.adrUncertaintyMeters;
     out.carrierFrequencyHz = in.carrierFrequencyHz;
@@ -336,134 +382,50 @@ static void convertGnssData(GnssMeasurementsNotification& in,
     convertGnssClock(in.clock, out.clock);
 }
 
-static void convertGnssData_1_1(GnssMeasurementsNotification& in,
-        V1_1::IGnssMeasurementCallback::GnssData& out)
+void convertGnssData_1_1(GnssMeasurementsNotification& in,
+        V1_1::IGnssMeasurementCallback::GnssData& out,
+        std::vector<V1_1::IGnssMeasurementCallback::GnssMeasurement>& arena)
 {
-    out.measurements.resize(in.count);
+    // the arena keeps its capacity, so after the first epoch this never allocates
+    arena.resize(in.count);
     for (size_t i = 0; i < in.count; i++) {
-        convertGnssMeasurement(in.measurements[i], out.measurements[i].v1_0);
-        if (in.measurements[i].adrStateMask & GNSS_MEASUREMENTS_ACCUMULATED_DELTA_RANGE_STATE_VALID_BIT)
-            out.measurements[i].accumulatedDeltaRangeState |=
-            IGnssMeasurementCallback::GnssAccumulatedDeltaRangeState::ADR_STATE_VALID;
-        if (in.measurements[i].adrStateMask & GNSS_MEASUREMENTS_ACCUMULATED_DELTA_RANGE_STATE_RESET_BIT)
-            out.measurements[i].accumulatedDeltaRangeState |=
-            IGnssMeasurementCallback::GnssAccumulatedDeltaRangeState::ADR_STATE_RESET;
-        if (in.measurements[i].adrStateMask & GNSS_MEASUREMENTS_ACCUMULATED_DELTA_RANGE_STATE_CYCLE_SLIP_BIT)
-            out.measurements[i].accumulatedDeltaRangeState |=
-            IGnssMeasurementCallback::GnssAccumulatedDeltaRangeState::ADR_STATE_CYCLE_SLIP;
-        if (in.measurements[i].adrStateMask & GNSS_MEASUREMENTS_ACCUMULATED_DELTA_RANGE_STATE_HALF_CYCLE_RESOLVED_BIT)
-            out.measurements[i].accumulatedDeltaRangeState |=
-            IGnssMeasurementCallback::GnssAccumulatedDeltaRangeState::ADR_STATE_HALF_CYCLE_RESOLVED;
+        convertGnssMeasurement(in.measurements[i], arena[i].v1_0);
+        arena[i].accumulatedDeltaRangeState = translateMask(in.measurements[i].adrStateMask,
+                sAdrStateTable, TABLE_SIZE(sAdrStateTable));
     }
+    out.measurements.setToExternal(arena.data(), in.count);
     convertGnssClock(in.clock, out.clock);
 }
 
-static void convertGnssData_2_0(GnssMeasurementsNotification& in,
-        V2_0::IGnssMeasurementCallback::GnssData& out)
+void convertGnssData_2_0(GnssMeasurementsNotification& in,
+        V2_0::IGnssMeasurementCallback::GnssData& out,
+        std::vector<V2_0::IGnssMeasurementCallback::GnssMeasurement>& arena)
 {
-    out.measurements.resize(in.count);
+    // the arena keeps its capacity, so after the first epoch this never allocates
+    arena.resize(in.count);
     for (size_t i = 0; i < in.count; i++) {
-        convertGnssMeasurement(in.measurements[i], out.measurements[i].v1_1.v1_0);
-        convertGnssConstellationType(in.measurements[i].svType, out.measurements[i].constellation);
-        convertGnssMeasurementsCodeType(in.measurements[i].codeType, out.measurements[i].codeType);
-        if (in.measurements[i].adrStateMask & GNSS_MEASUREMENTS_ACCUMULATED_DELTA_RANGE_STATE_VALID_BIT)
-            out.measurements[i].v1_1.accumulatedDeltaRangeState |=
-            IGnssMeasurementCallback::GnssAccumulatedDeltaRangeState::ADR_STATE_VALID;
-        if (in.measurements[i].adrStateMask & GNSS_MEASUREMENTS_ACCUMULATED_DELTA_RANGE_STATE_RESET_BIT)
-            out.measurements[i].v1_1.accumulatedDeltaRangeState |=
-            IGnssMeasurementCallback::GnssAccumulatedDeltaRangeState::ADR_STATE_RESET;
-        if (in.measurements[i].adrStateMask & GNSS_MEASUREMENTS_ACCUMULATED_DELTA_RANGE_STATE_CYCLE_SLIP_BIT)
-            out.measurements[i].v1_1.accumulatedDeltaRangeState |=
-            IGnssMeasurementCallback::GnssAccumulatedDeltaRangeState::ADR_STATE_CYCLE_SLIP;
-        if (in.measurements[i].adrStateMask & GNSS_MEASUREMENTS_ACCUMULATED_DELTA_RANGE_STATE_HALF_CYCLE_RESOLVED_BIT)
-            out.measurements[i].v1_1.accumulatedDeltaRangeState |=
-            IGnssMeasurementCallback::GnssAccumulatedDeltaRangeState::ADR_STATE_HALF_CYCLE_RESOLVED;
-        if (in.measurements[i].stateMask & GNSS_MEASUREMENTS_STATE_CODE_LOCK_BIT)
-            out.measurements[i].state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_CODE_LOCK;
-        if (in.measurements[i].stateMask & GNSS_MEASUREMENTS_STATE_BIT_SYNC_BIT)
-            out.measurements[i].state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_BIT_SYNC;
-        if (in.measurements[i].stateMask & GNSS_MEASUREMENTS_STATE_SUBFRAME_SYNC_BIT)
-            out.measurements[i].state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_SUBFRAME_SYNC;
-        if (in.measurements[i].stateMask & GNSS_MEASUREMENTS_STATE_TOW_DECODED_BIT)
-            out.measurements[i].state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_TOW_DECODED;
-        if (in.measurements[i].stateMask & GNSS_MEASUREMENTS_STATE_MSEC_AMBIGUOUS_BIT)
-            out.measurements[i].state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_MSEC_AMBIGUOUS;
-        if (in.measurements[i].stateMask & GNSS_MEASUREMENTS_STATE_SYMBOL_SYNC_BIT)
-            out.measurements[i].state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_SYMBOL_SYNC;
-        if (in.measurements[i].stateMask & GNSS_MEASUREMENTS_STATE_GLO_STRING_SYNC_BIT)
-            out.measurements[i].state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_GLO_STRING_SYNC;
-        if (in.measurements[i].stateMask & GNSS_MEASUREMENTS_STATE_GLO_TOD_DECODED_BIT)
-            out.measurements[i].state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_GLO_TOD_DECODED;
-        if (in.measurements[i].stateMask & GNSS_MEASUREMENTS_STATE_BDS_D2_BIT_SYNC_BIT)
-            out.measurements[i].state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_BDS_D2_BIT_SYNC;
-        if (in.measurements[i].stateMask & GNSS_MEASUREMENTS_STATE_BDS_D2_SUBFRAME_SYNC_BIT)
-            out.measurements[i].state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_BDS_D2_SUBFRAME_SYNC;
-        if (in.measurements[i].stateMask & GNSS_MEASUREMENTS_STATE_GAL_E1BC_CODE_LOCK_BIT)
-            out.measurements[i].state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_GAL_E1BC_CODE_LOCK;
-        if (in.measurements[i].stateMask & GNSS_MEASUREMENTS_STATE_GAL_E1C_2ND_CODE_LOCK_BIT)
-            out.measurements[i].state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_GAL_E1C_2ND_CODE_LOCK;
-        if (in.measurements[i].stateMask & GNSS_MEASUREMENTS_STATE_GAL_E1B_PAGE_SYNC_BIT)
-            out.measurements[i].state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_GAL_E1B_PAGE_SYNC;
-        if (in.measurements[i].stateMask &  GNSS_MEASUREMENTS_STATE_SBAS_SYNC_BIT)
-            out.measurements[i].state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_SBAS_SYNC;
-        if (in.measurements[i].stateMask &  GNSS_MEASUREMENTS_STATE_TOW_KNOWN_BIT)
-            out.measurements[i].state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_TOW_KNOWN;
-        if (in.measurements[i].stateMask &  GNSS_MEASUREMENTS_STATE_GLO_TOD_KNOWN_BIT)
-            out.measurements[i].state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_GLO_TOD_KNOWN;
-        if (in.measurements[i].stateMask &  GNSS_MEASUREMENTS_STATE_2ND_CODE_LOCK_BIT)
-            out.measurements[i].state |= IGnssMeasurementCallback::GnssMeasurementState::STATE_2ND_CODE_LOCK;
+        GnssMeasurementsData& measurement = in.measurements[i];
+        convertGnssMeasurement(measurement, arena[i].v1_1.v1_0);
+        arena[i].constellation = (measurement.svType < TABLE_SIZE(sConstellationTable_2_0)) ?
+                sConstellationTable_2_0[measurement.svType] :
+                V2_0::GnssConstellationType::UNKNOWN;
+        convertGnssMeasurementsCodeType(measurement.codeType, arena[i].codeType);
+        arena[i].v1_1.accumulatedDeltaRangeState = translateMask(measurement.adrStateMask,
+                sAdrStateTable, TABLE_SIZE(sAdrStateTable));
+        arena[i].state = translateMask(measurement.stateMask,
+                sMeasurementStateTable, TABLE_SIZE(sMeasurementStateTable));
     }
+    out.measurements.setToExternal(arena.data(), in.count);
     convertGnssClock(in.clock, out.clock);
 }
 
 static void convertGnssMeasurementsCodeType(GnssMeasurementsCodeType& in,
         ::android::hardware::hidl_string& out)
 {
-    switch(in) {
-        case GNSS_MEASUREMENTS_CODE_TYPE_A:
-            out = "A";
-            break;
-        case GNSS_MEASUREMENTS_CODE_TYPE_B:
-            out = "B";
-            break;
-        case GNSS_MEASUREMENTS_CODE_TYPE_C:
-            out = "C";
-            break;
-        case GNSS_MEASUREMENTS_CODE_TYPE_I:
-            out = "I";
-            break;
-        case GNSS_MEASUREMENTS_CODE_TYPE_L:
-            out = "L";
-            break;
-        case GNSS_MEASUREMENTS_CODE_TYPE_M:
-            out = "M";
-            break;
-        case GNSS_MEASUREMENTS_CODE_TYPE_P:
-            out = "P";
-            break;
-        case GNSS_MEASUREMENTS_CODE_TYPE_Q:
-            out = "Q";
-            break;
-        case GNSS_MEASUREMENTS_CODE_TYPE_S:
-            out = "S";
-            break;
-        case GNSS_MEASUREMENTS_CODE_TYPE_W:
-            out = "W";
-            break;
-        case GNSS_MEASUREMENTS_CODE_TYPE_X:
-            out = "X";
-            break;
-        case GNSS_MEASUREMENTS_CODE_TYPE_Y:
-            out = "Y";
-            break;
-        case GNSS_MEASUREMENTS_CODE_TYPE_Z:
-            out = "Z";
-            break;
-        case GNSS_MEASUREMENTS_CODE_TYPE_N:
-            out = "N";
-            break;
-        default:
-            out = "UNKNOWN";
+    if (in < TABLE_SIZE(sCodeTypeTable)) {
+        out.setToExternal(sCodeTypeTable[in], 1);
+    } else {
+        out.setToExternal(sCodeTypeUnknown, sizeof(sCodeTypeUnknown) - 1);
     }
 }
 
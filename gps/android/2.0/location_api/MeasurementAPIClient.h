@@ -31,6 +31,7 @@
 #define MEASUREMENT_API_CLINET_H
 
 #include <mutex>
+#include <vector>
 #include <android/hardware/gnss/2.0/IGnssMeasurement.h>
 //#include <android/hardware/gnss/1.1/IGnssMeasurementCallback.h>
 #include <LocationAPIClientBase.h>
@@ -78,9 +79,22 @@ private:
     sp<V1_1::IGnssMeasurementCallback> mGnssMeasurementCbIface_1_1;
     sp<V2_0::IGnssMeasurementCallback> mGnssMeasurementCbIface_2_0;
 
+    // conversion arenas, only used on the callback thread and reused across epochs
+    std::vector<V1_1::IGnssMeasurementCallback::GnssMeasurement> mMeasurements_1_1;
+    std::vector<V2_0::IGnssMeasurementCallback::GnssMeasurement> mMeasurements_2_0;
+
     bool mTracking;
 };
 
+// Engine to HIDL conversion of one measurement epoch into a reusable arena,
+// out.measurements points into the arena. Exposed for the conversion benchmark.
+void convertGnssData_1_1(GnssMeasurementsNotification& in,
+        V1_1::IGnssMeasurementCallback::GnssData& out,
+        std::vector<V1_1::IGnssMeasurementCallback::GnssMeasurement>& arena);
+void convertGnssData_2_0(GnssMeasurementsNotification& in,
+        V2_0::IGnssMeasurementCallback::GnssData& out,
+        std::vector<V2_0::IGnssMeasurementCallback::GnssMeasurement>& arena);
+
 }  // namespace implementation
 }  // namespace V2_0
 }  // namespace gnss
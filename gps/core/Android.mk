@@ -54,3 +54,30 @@ LOCAL_EXPORT_C_INCLUDE_DIRS := \
     $(LOCAL_PATH)/data-items/common \
     $(LOCAL_PATH)/observer
 include $(BUILD_HEADER_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := libloc_core-observer-benchmark
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_TAGS := optional
+LOCAL_SRC_FILES := \
+    benchmarks/SystemStatusOsObserverBenchmark.cpp
+
+LOCAL_HEADER_LIBRARIES := \
+    libutils_headers \
+    libgps.utils_headers \
+    libloc_pla_headers \
+    liblocation_api_headers \
+    libloc_core_headers
+
+LOCAL_SHARED_LIBRARIES := \
+    liblog \
+    libutils \
+    libcutils \
+    libgps.utils \
+    libloc_core
+
+LOCAL_CFLAGS += \
+     -fno-short-enums \
+     -D_ANDROID_
+LOCAL_CFLAGS += $(GNSS_CFLAGS)
+include $(BUILD_NATIVE_BENCHMARK)
@@ -32,16 +32,24 @@
 #include <dlfcn.h>
 #include <cutils/sched_policy.h>
 #include <unistd.h>
+#include <string.h>
+#include <inttypes.h>
+#include <mutex>
+#include <vector>
 #include <ContextBase.h>
 #include <msg_q.h>
 #include <loc_target.h>
 #include <loc_pla.h>
 #include <loc_log.h>
+#include <LocDlRegistry.h>
+
+using namespace loc_util;
 
 namespace loc_core {
 
 #define SLL_LOC_API_LIB_NAME "libsynergy_loc_api.so"
 #define LOC_APIV2_0_LIB_NAME "libloc_api_v02.so"
+#define PROCESS_NAME_ENGINE_SERVICE "engine-service"
 #define IS_SS5_HW_ENABLED  1
 
 loc_gps_cfg_s_type ContextBase::mGps_conf {};
@@ -115,9 +123,9 @@ const loc_param_s_type ContextBase::mSap_conf_table[] =
 
 void ContextBase::readConfig()
 {
-    static bool confReadDone = false;
-    if (!confReadDone) {
-        confReadDone = true;
+    // may run on the startup thread while the context is being created
+    static std::once_flag confReadDone;
+    std::call_once(confReadDone, [] {
         /*Defaults for gps.conf*/
         mGps_conf.INTERMEDIATE_POS = 0;
         mGps_conf.ACCURACY_THRES = 0;
@@ -208,7 +216,31 @@ void ContextBase::readConfig()
           default:
              break;
         }
+        recordStartupStage("config read");
+    });
+}
+
+void ContextBase::recordStartupStage(const char* stage)
+{
+    static std::mutex timelineLock;
+    static int64_t firstStageMs = -1;
+    static std::vector<const char*> recordedStages;
+    int64_t nowMs = uptimeMillis();
+
+    std::lock_guard<std::mutex> guard(timelineLock);
+    // the timeline is per process, a stage reached again by another adapter
+    // is not recorded again
+    for (auto each : recordedStages) {
+        if (0 == strcmp(each, stage)) {
+            return;
+        }
+    }
+    recordedStages.push_back(stage);
+    if (firstStageMs < 0) {
+        firstStageMs = nowMs;
     }
+    LOC_LOGI("%s] %s: %" PRId64 " ms after boot, +%" PRId64 " ms",
+             __FUNCTION__, stage, nowMs, nowMs - firstStageMs);
 }
 
 uint32_t ContextBase::getCarrierCapabilities() {
@@ -233,10 +265,11 @@ LBSProxyBase* ContextBase::getLBSProxy(const char* libName)
 {
     LBSProxyBase* proxy = NULL;
     LOC_LOGD("%s:%d]: getLBSProxy libname: %s\n", __func__, __LINE__, libName);
-    void* lib = dlopen(libName, RTLD_NOW);
+    void* lib = LocDlRegistry::getLibHandle(libName);
 
     if ((void*)NULL != lib) {
-        getLBSProxy_t* getter = (getLBSProxy_t*)dlsym(lib, "getLBSProxy");
+        getLBSProxy_t* getter =
+                (getLBSProxy_t*)LocDlRegistry::getSymbol(libName, "getLBSProxy");
         if (NULL != getter) {
             proxy = (*getter)();
         }
@@ -252,10 +285,71 @@ LBSProxyBase* ContextBase::getLBSProxy(const char* libName)
     return proxy;
 }
 
+const char* ContextBase::getLocApiLibName()
+{
+    return (IS_SS5_HW_ENABLED == mGps_conf.GNSS_DEPLOYMENT) ?
+            SLL_LOC_API_LIB_NAME : LOC_APIV2_0_LIB_NAME;
+}
+
+bool ContextBase::isEngineServiceEnabled()
+{
+    static std::once_flag sConfRead;
+    static bool sEnabled = false;
+
+    std::call_once(sConfRead, [] {
+        unsigned int processListLength = 0;
+        loc_process_info_s_type* processInfoList = nullptr;
+
+        if (0 != loc_read_process_conf(LOC_PATH_IZAT_CONF, &processListLength,
+                                       &processInfoList)) {
+            LOC_LOGE("%s]: failed to parse conf file", __func__);
+        } else {
+            // go over the conf table to see whether the plugin daemon is enabled
+            for (unsigned int i = 0; i < processListLength; i++) {
+                if ((strncmp(processInfoList[i].name[0], PROCESS_NAME_ENGINE_SERVICE,
+                             strlen(PROCESS_NAME_ENGINE_SERVICE)) == 0) &&
+                    (processInfoList[i].proc_status == ENABLED)) {
+                    sEnabled = true;
+                    break;
+                }
+            }
+        }
+        if (nullptr != processInfoList) {
+            free(processInfoList);
+        }
+    });
+    return sEnabled;
+}
+
+void ContextBase::prelinkLibs()
+{
+    // libraries the context and the adapters load later on, loaded ahead on a
+    // background thread; the LocApi library comes first as it is needed first
+    static std::once_flag sPrelinked;
+
+    std::call_once(sPrelinked, [] {
+        const char* prelinkLibs[4];
+        size_t count = 0;
+        if (TARGET_NO_GNSS != loc_get_target()) {
+            prelinkLibs[count++] = getLocApiLibName();
+        }
+        prelinkLibs[count++] = "libdataitems.so";
+        prelinkLibs[count++] = "libloc_net_iface.so";
+        // GnssAdapter only loads the engine hub when the plugin daemon is enabled
+        if (isEngineServiceEnabled()) {
+            prelinkLibs[count++] = "libloc_eng_hub.so";
+        }
+        LocDlRegistry::prelink(prelinkLibs, count);
+    });
+}
+
 LocApiBase* ContextBase::createLocApi(LOC_API_ADAPTER_EVENT_MASK_T exMask)
 {
+    // contexts are created under the LocContext lock; the LocApi of an earlier
+    // context may still come from the library
+    static bool sLocApiLibInUse = false;
     LocApiBase* locApi = NULL;
-    const char* libname = LOC_APIV2_0_LIB_NAME;
+    const char* libname = getLocApiLibName();
 
     // Check the target
     if (TARGET_NO_GNSS != loc_get_target()){
@@ -263,17 +357,15 @@ LocApiBase* ContextBase::createLocApi(LOC_API_ADAPTER_EVENT_MASK_T exMask)
         if (NULL == (locApi = mLBSProxy->getLocApi(exMask, this))) {
             void *handle = NULL;
 
-            if (IS_SS5_HW_ENABLED == mGps_conf.GNSS_DEPLOYMENT) {
-                libname = SLL_LOC_API_LIB_NAME;
-            }
-
-            if ((handle = dlopen(libname, RTLD_NOW)) != NULL) {
+            if ((handle = LocDlRegistry::getLibHandle(libname)) != NULL) {
                 LOC_LOGD("%s:%d]: %s is present", __func__, __LINE__, libname);
-                getLocApi_t* getter = (getLocApi_t*) dlsym(handle, "getLocApi");
+                getLocApi_t* getter =
+                        (getLocApi_t*)LocDlRegistry::getSymbol(libname, "getLocApi");
                 if (getter != NULL) {
                     LOC_LOGD("%s:%d]: getter is not NULL of %s", __func__,
                             __LINE__, libname);
                     locApi = (*getter)(exMask, this);
+                    sLocApiLibInUse = true;
                 }
             }
             // only RPC is the option now
@@ -290,6 +382,9 @@ LocApiBase* ContextBase::createLocApi(LOC_API_ADAPTER_EVENT_MASK_T exMask)
                     }
                 }
             }
+        } else if (!sLocApiLibInUse) {
+            // the LBS proxy provided the LocApi, the prelinked library is not needed
+            LocDlRegistry::unload(libname);
         }
     }
 
@@ -305,11 +400,24 @@ LocApiBase* ContextBase::createLocApi(LOC_API_ADAPTER_EVENT_MASK_T exMask)
 ContextBase::ContextBase(const MsgTask* msgTask,
                          LOC_API_ADAPTER_EVENT_MASK_T exMask,
                          const char* libName) :
-    mLBSProxy(getLBSProxy(libName)),
+    mLBSProxy(NULL),
     mMsgTask(msgTask),
-    mLocApi(createLocApi(exMask)),
-    mLocApiProxy(mLocApi->getLocApiProxy())
+    mLocApi(NULL),
+    mLocApiProxy(NULL)
 {
+    recordStartupStage("context bring-up");
+
+    // the config is read before anything that depends on it, the LocApi
+    // library choice included, then the libraries are loaded on the prelink
+    // thread while this thread loads the LBS library
+    readConfig();
+    prelinkLibs();
+    mLBSProxy = getLBSProxy(libName);
+    recordStartupStage("LBS library loaded");
+
+    mLocApi = createLocApi(exMask);
+    mLocApiProxy = mLocApi->getLocApiProxy();
+    recordStartupStage("LocApi created");
 }
 
 void ContextBase::setEngineCapabilities(uint64_t supportedMsgMask,
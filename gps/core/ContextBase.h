@@ -114,6 +114,8 @@ class LocAdapterBase;
 
 class ContextBase {
     static LBSProxyBase* getLBSProxy(const char* libName);
+    static const char* getLocApiLibName();
+    static void prelinkLibs();
     LocApiBase* createLocApi(LOC_API_ADAPTER_EVENT_MASK_T excludedMask);
     static const loc_param_s_type mGps_conf_table[];
     static const loc_param_s_type mSap_conf_table[];
@@ -156,8 +158,14 @@ public:
     static uint8_t sFeaturesSupported[MAX_FEATURE_LENGTH];
     static bool sGnssMeasurementSupported;
 
-    void readConfig();
+    static void readConfig();
     static uint32_t getCarrierCapabilities();
+    /* true if izat.conf enables the engine-service plugin daemon, the engine
+       hub is only loaded then; read once per process */
+    static bool isEngineServiceEnabled();
+    /* records the first time a bring-up stage is reached in the process, logged
+       with its time since boot and since the first stage; stage is a literal */
+    static void recordStartupStage(const char* stage);
     void setEngineCapabilities(uint64_t supportedMsgMask,
             uint8_t *featureList, bool gnssMeasurementSupported);
 
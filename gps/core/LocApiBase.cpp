@@ -31,10 +31,13 @@
 
 #include <dlfcn.h>
 #include <inttypes.h>
+#include <mutex>
 #include <gps_extended_c.h>
 #include <LocApiBase.h>
 #include <LocAdapterBase.h>
 #include <log_util.h>
+#include <LocTrace.h>
+#include <LocDlRegistry.h>
 #include <LocContext.h>
 
 namespace loc_core {
@@ -120,6 +123,9 @@ struct LocOpenMsg : public LocMsg {
     inline virtual void proc() const {
         if (LOC_API_ADAPTER_ERR_SUCCESS == mLocApi->open(mLocApi->getEvtMask()) &&
             nullptr != mAdapter) {
+            ContextBase::recordStartupStage("engine up");
+            static std::once_flag sLibStatsLogged;
+            std::call_once(sLibStatsLogged, [] { loc_util::LocDlRegistry::logStats(); });
             mAdapter->handleEngineUpEvent();
         }
     }
@@ -404,8 +410,8 @@ void LocApiBase::reportSv(GnssSvNotification& svNotify)
     const char* constellationString[] = { "Unknown", "GPS", "SBAS", "GLONASS",
         "QZSS", "BEIDOU", "GALILEO", "NAVIC" };
 
-    // print the SV info before delivering
-    LOC_LOGV("num sv: %u\n"
+    // trace the SV info before delivering
+    LOC_TRACE("num sv: %u\n"
         "      sv: constellation svid         cN0"
         "    elevation    azimuth    flags",
         svNotify.count);
@@ -418,7 +424,7 @@ void LocApiBase::reportSv(GnssSvNotification& svNotify)
         uint16_t displaySvId = GNSS_SV_TYPE_QZSS == svNotify.gnssSvs[i].type ?
                                svNotify.gnssSvs[i].svId + QZSS_SV_PRN_MIN - 1 :
                                svNotify.gnssSvs[i].svId;
-        LOC_LOGV("   %03zu: %*s  %02d    %f    %f    %f    %f    0x%02X",
+        LOC_TRACE("   %03zu: %*s  %02d    %f    %f    %f    %f    0x%02X",
             i,
             13,
             constellationString[svNotify.gnssSvs[i].type],
@@ -1681,6 +1681,27 @@ bool SystemStatus::getReport(SystemStatusReports& report, bool isLatestOnly) con
     return true;
 }
 
+/******************************************************************************
+@brief      API to get the latest items used by the GnssDebug report
+
+@param[In]  reference to report buffer, its vectors are reused
+
+@return     true when successfully done
+******************************************************************************/
+bool SystemStatus::getDebugReportItems(SystemStatusReports& report) const
+{
+    pthread_mutex_lock(&mMutexSystemStatus);
+
+    getIteminReport(report.mTimeAndClock, mCache.mTimeAndClock);
+    getIteminReport(report.mBestPosition, mCache.mBestPosition);
+    getIteminReport(report.mXtra, mCache.mXtra);
+    getIteminReport(report.mSvHealth, mCache.mSvHealth);
+    getIteminReport(report.mNavData, mCache.mNavData);
+
+    pthread_mutex_unlock(&mMutexSystemStatus);
+    return true;
+}
+
 /******************************************************************************
 @brief      API to set default report data
 
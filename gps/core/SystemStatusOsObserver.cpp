@@ -46,17 +46,14 @@ COUT SystemStatusOsObserver::containerTransfer(CINT& inContainer) {
 }
 
 SystemStatusOsObserver::~SystemStatusOsObserver() {
-    // Close data-item library handle
-    DataItemsFactoryProxy::closeDataItemLibraryHandle();
-
-    // Destroy cache
-    for (auto each : mDataItemCache) {
-        if (nullptr != each.second) {
-            delete each.second;
-        }
+    // Destroy cache, before the library of the data items goes away
+    for (auto& each : mDataItemCache) {
+        each.mItem.reset();
     }
 
-    mDataItemCache.clear();
+    DataItemsFactoryProxy::logPoolStats();
+    // Close data-item library handle
+    DataItemsFactoryProxy::closeDataItemLibraryHandle();
 }
 
 void SystemStatusOsObserver::setSubscriptionObj(IDataItemSubscription* subscriptionObj)
@@ -97,15 +94,16 @@ void SystemStatusOsObserver::subscribe(const list<DataItemId>& l, IDataItemObser
                 list<DataItemId>& l, IDataItemObserver* client, bool requestData) :
                 mParent(parent), mClient(client),
                 mDataItemSet(containerTransfer<list<DataItemId>, unordered_set<DataItemId>>(l)),
+                mDataItemIds(toDataItemIdSet(l)),
                 diItemlist(l),
                 mToRequestData(requestData) {}
 
         void proc() const {
             unordered_set<DataItemId> dataItemsToSubscribe(0);
             mParent->mDataItemToClients.add(mDataItemSet, {mClient}, &dataItemsToSubscribe);
-            mParent->mClientToDataItems.add(mClient, mDataItemSet);
+            mParent->mClientToDataItems[mClient] |= mDataItemIds;
 
-            mParent->sendCachedDataItems(mDataItemSet, mClient);
+            mParent->sendCachedDataItems(mDataItemIds, mClient);
 
             // Send subscription set to framework
             if (nullptr != mParent->mContext.mSubscriptionObj) {
@@ -125,6 +123,7 @@ void SystemStatusOsObserver::subscribe(const list<DataItemId>& l, IDataItemObser
         mutable SystemStatusOsObserver* mParent;
         IDataItemObserver* mClient;
         const unordered_set<DataItemId> mDataItemSet;
+        const DataItemIdSet mDataItemIds;
         const list<DataItemId> diItemlist;
         bool mToRequestData;
     };
@@ -144,33 +143,33 @@ void SystemStatusOsObserver::updateSubscription(
         HandleUpdateSubscriptionReq(SystemStatusOsObserver* parent,
                                     list<DataItemId>& l, IDataItemObserver* client) :
                 mParent(parent), mClient(client),
-                mDataItemSet(containerTransfer<list<DataItemId>, unordered_set<DataItemId>>(l)) {}
+                mDataItemIds(toDataItemIdSet(l)) {}
 
         void proc() const {
             unordered_set<DataItemId> dataItemsToSubscribe(0);
             unordered_set<DataItemId> dataItemsToUnsubscribe(0);
             unordered_set<IDataItemObserver*> clients({mClient});
-            // below removes clients from all entries keyed with the return of the
-            // mClientToDataItems.update() call. If leaving an empty set of clients as the
-            // result, the entire entry will be removed. dataItemsToUnsubscribe will be
-            // populated to keep the keys of the removed entries.
-            mParent->mDataItemToClients.trimOrRemove(
-                    // this call updates <IDataItemObserver*, DataItemId> map; removes
-                    // the DataItemId's that are not new to the clietn from mDataItemSet;
-                    // and returns a set of mDataItemSet's that are no longer used by client.
-                    // This unused set of mDataItemSet's is passed to trimOrRemove method of
-                    // <DataItemId, IDataItemObserver*> map to remove the client from the
-                    // corresponding entries, and gets a set of the entries that are
-                    // removed from the <DataItemId, IDataItemObserver*> map as a result.
-                    mParent->mClientToDataItems.update(mClient,
-                                                       (unordered_set<DataItemId>&)mDataItemSet),
-                    clients, &dataItemsToUnsubscribe, nullptr);
-            // below adds mClient to <DataItemId, IDataItemObserver*> map, and populates
-            // new keys added to that map, which are DataItemIds to be subscribed.
-            mParent->mDataItemToClients.add(mDataItemSet, clients, &dataItemsToSubscribe);
+
+            // split the new subscription of the client into the data items it
+            // no longer wants and the ones it did not have before
+            DataItemIdSet& current = mParent->mClientToDataItems[mClient];
+            DataItemIdSet gone = current & ~mDataItemIds;
+            DataItemIdSet added = mDataItemIds & ~current;
+            current = mDataItemIds;
+            if (mDataItemIds.none()) {
+                mParent->mClientToDataItems.erase(mClient);
+            }
+
+            // remove the client from the data items it dropped, the ones left without
+            // any client are unsubscribed; add it to the new ones, the ones without
+            // any client so far are subscribed
+            mParent->mDataItemToClients.trimOrRemove(fromDataItemIdSet(gone), clients,
+                                                     &dataItemsToUnsubscribe, nullptr);
+            mParent->mDataItemToClients.add(fromDataItemIdSet(added), clients,
+                                            &dataItemsToSubscribe);
 
             // Send First Response
-            mParent->sendCachedDataItems(mDataItemSet, mClient);
+            mParent->sendCachedDataItems(added, mClient);
 
             if (nullptr != mParent->mContext.mSubscriptionObj) {
                 // Send subscription set to framework
@@ -198,7 +197,7 @@ void SystemStatusOsObserver::updateSubscription(
         }
         SystemStatusOsObserver* mParent;
         IDataItemObserver* mClient;
-        unordered_set<DataItemId> mDataItemSet;
+        const DataItemIdSet mDataItemIds;
     };
 
     if (l.empty() || nullptr == client) {
@@ -216,16 +215,22 @@ void SystemStatusOsObserver::unsubscribe(
         HandleUnsubscribeReq(SystemStatusOsObserver* parent,
                 list<DataItemId>& l, IDataItemObserver* client) :
                 mParent(parent), mClient(client),
-                mDataItemSet(containerTransfer<list<DataItemId>, unordered_set<DataItemId>>(l)) {}
+                mDataItemIds(toDataItemIdSet(l)) {}
 
         void proc() const {
-            unordered_set<DataItemId> dataItemsUnusedByClient(0);
-            unordered_set<IDataItemObserver*> clientToRemove(0);
-            mParent->mClientToDataItems.trimOrRemove({mClient}, mDataItemSet,  &clientToRemove,
-                                                     &dataItemsUnusedByClient);
+            auto client = mParent->mClientToDataItems.find(mClient);
+            if (mParent->mClientToDataItems.end() == client) {
+                return;
+            }
+            DataItemIdSet dataItemsUnusedByClient = client->second & mDataItemIds;
+            client->second &= ~mDataItemIds;
+            if (client->second.none()) {
+                mParent->mClientToDataItems.erase(client);
+            }
             unordered_set<DataItemId> dataItemsToUnsubscribe(0);
-            mParent->mDataItemToClients.trimOrRemove(dataItemsUnusedByClient, {mClient},
-                                                     &dataItemsToUnsubscribe, nullptr);
+            mParent->mDataItemToClients.trimOrRemove(
+                    fromDataItemIdSet(dataItemsUnusedByClient), {mClient},
+                    &dataItemsToUnsubscribe, nullptr);
 
             if (nullptr != mParent->mContext.mSubscriptionObj && !dataItemsToUnsubscribe.empty()) {
                 LOC_LOGD("Unsubscribe Request sent to framework for the following data items");
@@ -240,7 +245,7 @@ void SystemStatusOsObserver::unsubscribe(
         }
         SystemStatusOsObserver* mParent;
         IDataItemObserver* mClient;
-        unordered_set<DataItemId> mDataItemSet;
+        const DataItemIdSet mDataItemIds;
     };
 
     if (l.empty() || nullptr == client) {
@@ -258,10 +263,11 @@ void SystemStatusOsObserver::unsubscribeAll(IDataItemObserver* client)
                 mParent(parent), mClient(client) {}
 
         void proc() const {
-            unordered_set<DataItemId> diByClient = mParent->mClientToDataItems.getValSet(mClient);
-            if (!diByClient.empty()) {
+            auto client = mParent->mClientToDataItems.find(mClient);
+            if (mParent->mClientToDataItems.end() != client) {
+                unordered_set<DataItemId> diByClient = fromDataItemIdSet(client->second);
                 unordered_set<DataItemId> dataItemsToUnsubscribe;
-                mParent->mClientToDataItems.remove(mClient);
+                mParent->mClientToDataItems.erase(client);
                 mParent->mDataItemToClients.trimOrRemove(diByClient, {mClient},
                                                          &dataItemsToUnsubscribe, nullptr);
 
@@ -296,55 +302,48 @@ void SystemStatusOsObserver::unsubscribeAll(IDataItemObserver* client)
 void SystemStatusOsObserver::notify(const list<IDataItemCore*>& dlist)
 {
     struct HandleNotify : public LocMsg {
-        HandleNotify(SystemStatusOsObserver* parent, vector<IDataItemCore*>& v) :
+        HandleNotify(SystemStatusOsObserver* parent, vector<shared_ptr<IDataItemCore>>& v) :
                 mParent(parent), mDiVec(std::move(v)) {}
 
-        inline virtual ~HandleNotify() {
-            for (auto item : mDiVec) {
-                delete item;
-            }
-        }
-
         void proc() const {
             // Update Cache with received data items and prepare
-            // list of data items to be sent.
-            unordered_set<DataItemId> dataItemIdsToBeSent(0);
-            for (auto item : mDiVec) {
+            // set of data items to be sent.
+            DataItemIdSet dataItemIdsToBeSent;
+            for (auto& item : mDiVec) {
                 if (mParent->updateCache(item)) {
-                    dataItemIdsToBeSent.insert(item->getId());
+                    dataItemIdsToBeSent.set(item->getId());
                 }
             }
+            if (dataItemIdsToBeSent.none()) {
+                return;
+            }
 
             // Send data item to all subscribed clients
             unordered_set<IDataItemObserver*> clientSet(0);
-            for (auto each : dataItemIdsToBeSent) {
-                auto clients = mParent->mDataItemToClients.getValSetPtr(each);
-                if (nullptr != clients) {
-                    clientSet.insert(clients->begin(), clients->end());
+            for (size_t id = 0; id < dataItemIdsToBeSent.size(); id++) {
+                if (dataItemIdsToBeSent.test(id)) {
+                    auto clients = mParent->mDataItemToClients.getValSetPtr((DataItemId)id);
+                    if (nullptr != clients) {
+                        clientSet.insert(clients->begin(), clients->end());
+                    }
                 }
             }
 
             for (auto client : clientSet) {
-                unordered_set<DataItemId> dataItemIdsForThisClient(
-                        mParent->mClientToDataItems.getValSet(client));
-                for (auto itr = dataItemIdsForThisClient.begin();
-                        itr != dataItemIdsForThisClient.end(); ) {
-                    if (dataItemIdsToBeSent.find(*itr) == dataItemIdsToBeSent.end()) {
-                        itr = dataItemIdsForThisClient.erase(itr);
-                    } else {
-                        itr++;
-                    }
+                auto subscribed = mParent->mClientToDataItems.find(client);
+                if (mParent->mClientToDataItems.end() != subscribed) {
+                    mParent->sendCachedDataItems(subscribed->second & dataItemIdsToBeSent,
+                                                 client);
                 }
-
-                mParent->sendCachedDataItems(dataItemIdsForThisClient, client);
             }
         }
         SystemStatusOsObserver* mParent;
-        const vector<IDataItemCore*> mDiVec;
+        const vector<shared_ptr<IDataItemCore>> mDiVec;
     };
 
     if (!dlist.empty()) {
-        vector<IDataItemCore*> dataItemVec(dlist.size());
+        vector<shared_ptr<IDataItemCore>> dataItemVec;
+        dataItemVec.reserve(dlist.size());
 
         for (auto each : dlist) {
             IF_LOC_LOGD {
@@ -353,17 +352,21 @@ void SystemStatusOsObserver::notify(const list<IDataItemCore*>& dlist)
                 LOC_LOGD("notify: DataItem In Value:%s", dv.c_str());
             }
 
-            IDataItemCore* di = DataItemsFactoryProxy::createNewDataItem(each->getId());
+            DataItemId id = each->getId();
+            if (id < 0 || id >= MAX_DATA_ITEM_ID_1_1) {
+                LOC_LOGw("Invalid dataitem:%d", id);
+                continue;
+            }
+            shared_ptr<IDataItemCore> di = DataItemsFactoryProxy::obtainSharedDataItem(id);
             if (nullptr == di) {
-                LOC_LOGw("Unable to create dataitem:%d", each->getId());
+                LOC_LOGw("Unable to create dataitem:%d", id);
                 continue;
             }
 
-            // Copy contents into the newly created data item
+            // Copy contents into the pooled data item, it becomes the
+            // cached value as is if its id is not cached yet
             di->copy(each);
-
-            // add this dataitem if updated from last one
-            dataItemVec.push_back(di);
+            dataItemVec.push_back(move(di));
         }
 
         if (!dataItemVec.empty()) {
@@ -510,23 +513,50 @@ bool SystemStatusOsObserver::disconnectBackhaul()
 /******************************************************************************
  Helpers
 ******************************************************************************/
+DataItemIdSet SystemStatusOsObserver::toDataItemIdSet(const list<DataItemId>& l)
+{
+    DataItemIdSet s;
+    for (auto id : l) {
+        if (id >= 0 && id < MAX_DATA_ITEM_ID_1_1) {
+            s.set(id);
+        }
+    }
+    return s;
+}
+
+unordered_set<DataItemId> SystemStatusOsObserver::fromDataItemIdSet(const DataItemIdSet& s)
+{
+    unordered_set<DataItemId> ids(s.count());
+    for (size_t id = 0; id < s.size(); id++) {
+        if (s.test(id)) {
+            ids.insert((DataItemId)id);
+        }
+    }
+    return ids;
+}
+
 void SystemStatusOsObserver::sendCachedDataItems(
-        const unordered_set<DataItemId>& s, IDataItemObserver* to)
+        const DataItemIdSet& s, IDataItemObserver* to)
 {
     if (nullptr == to) {
         LOC_LOGv("client pointer is NULL.");
     } else {
         string clientName;
-        to->getName(clientName);
+        IF_LOC_LOGI {
+            to->getName(clientName);
+        }
         list<IDataItemCore*> dataItems(0);
 
-        for (auto each : s) {
-            auto citer = mDataItemCache.find(each);
-            if (citer != mDataItemCache.end()) {
-                string dv;
-                citer->second->stringify(dv);
-                LOC_LOGI("DataItem: %s >> %s", dv.c_str(), clientName.c_str());
-                dataItems.push_front(citer->second);
+        for (size_t id = 0; id < s.size(); id++) {
+            const CachedDataItem& cached = mDataItemCache[id];
+            if (s.test(id) && nullptr != cached.mItem) {
+                IF_LOC_LOGI {
+                    string dv;
+                    cached.mItem->stringify(dv);
+                    LOC_LOGI("DataItem: %s v%u >> %s",
+                             dv.c_str(), cached.mVersion, clientName.c_str());
+                }
+                dataItems.push_front(cached.mItem.get());
             }
         }
 
@@ -538,7 +568,7 @@ void SystemStatusOsObserver::sendCachedDataItems(
     }
 }
 
-bool SystemStatusOsObserver::updateCache(IDataItemCore* d)
+bool SystemStatusOsObserver::updateCache(const shared_ptr<IDataItemCore>& d)
 {
     bool dataItemUpdated = false;
 
@@ -546,25 +576,21 @@ bool SystemStatusOsObserver::updateCache(IDataItemCore* d)
     // if the return is false, it means that SystemStatus is not
     // handling it, so SystemStatusOsObserver also doesn't.
     // So it has to be true to proceed.
-    if (nullptr != d && mSystemStatus->eventDataItemNotify(d)) {
-        auto citer = mDataItemCache.find(d->getId());
-        if (citer == mDataItemCache.end()) {
-            // New data item; not found in cache
-            IDataItemCore* dataitem = DataItemsFactoryProxy::createNewDataItem(d->getId());
-            if (nullptr != dataitem) {
-                // Copy the contents of the data item
-                dataitem->copy(d);
-                // Insert in mDataItemCache
-                mDataItemCache.insert(std::make_pair(d->getId(), dataitem));
-                dataItemUpdated = true;
-            }
+    if (nullptr != d && mSystemStatus->eventDataItemNotify(d.get())) {
+        CachedDataItem& cached = mDataItemCache[d->getId()];
+        if (nullptr == cached.mItem) {
+            // New data item; not found in cache, adopt the received copy
+            cached.mItem = d;
+            dataItemUpdated = true;
         } else {
-            // Found in cache; Update cache if necessary
-            citer->second->copy(d, &dataItemUpdated);
+            // Found in cache; update in place if necessary
+            cached.mItem->copy(d.get(), &dataItemUpdated);
         }
 
         if (dataItemUpdated) {
-            LOC_LOGV("DataItem:%d updated:%d", d->getId(), dataItemUpdated);
+            cached.mVersion++;
+            LOC_LOGV("DataItem:%d updated:%d version:%u",
+                     d->getId(), dataItemUpdated, cached.mVersion);
         }
     }
 
@@ -35,6 +35,9 @@
 #include <map>
 #include <new>
 #include <vector>
+#include <array>
+#include <bitset>
+#include <memory>
 
 #include <MsgTask.h>
 #include <DataItemId.h>
@@ -56,11 +59,21 @@ class IDataItemCore;
 class SystemStatus;
 class SystemStatusOsObserver;
 typedef map<IDataItemObserver*, list<DataItemId>> ObserverReqCache;
-typedef LocUnorderedSetMap<IDataItemObserver*, DataItemId> ClientToDataItems;
+typedef bitset<MAX_DATA_ITEM_ID_1_1> DataItemIdSet;
+typedef unordered_map<IDataItemObserver*, DataItemIdSet> ClientToDataItems;
 typedef LocUnorderedSetMap<DataItemId, IDataItemObserver*> DataItemToClients;
-typedef unordered_map<DataItemId, IDataItemCore*> DataItemIdToCore;
 typedef unordered_map<DataItemId, int> DataItemIdToInt;
 
+// Cached value of a data item. The same item is handed to every observer.
+// Observers only see it for the duration of their notify() call on the
+// MsgTask, so an update writes it in place and bumps the version.
+struct CachedDataItem {
+    shared_ptr<IDataItemCore> mItem;
+    uint32_t mVersion;
+    inline CachedDataItem() : mVersion(0) {}
+};
+typedef array<CachedDataItem, MAX_DATA_ITEM_ID_1_1> DataItemIdToCore;
+
 struct ObserverContext {
     IDataItemSubscription* mSubscriptionObj;
     IFrameworkActionReq* mFrameworkActionReqObj;
@@ -159,8 +172,10 @@ private:
     void subscribe(const list<DataItemId>& l, IDataItemObserver* client, bool toRequestData);
 
     // Helpers
-    void sendCachedDataItems(const unordered_set<DataItemId>& s, IDataItemObserver* to);
-    bool updateCache(IDataItemCore* d);
+    static DataItemIdSet toDataItemIdSet(const list<DataItemId>& l);
+    static unordered_set<DataItemId> fromDataItemIdSet(const DataItemIdSet& s);
+    void sendCachedDataItems(const DataItemIdSet& s, IDataItemObserver* to);
+    bool updateCache(const shared_ptr<IDataItemCore>& d);
     inline void logMe(const unordered_set<DataItemId>& l) {
         IF_LOC_LOGD {
             for (auto id : l) {
@@ -0,0 +1,154 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Data item fan-out of SystemStatusOsObserver under high-rate network and
+// cell updates. Every update flips the network state, so each one changes
+// the cached item and is delivered to all subscribed clients.
+// BM_NotifyProducers runs the same load from several producer threads; as
+// all processing happens on the single MsgTask, its items/s staying flat
+// with more threads shows the MsgTask, not a lock, is what bounds it.
+
+#include <benchmark/benchmark.h>
+
+#include <future>
+#include <vector>
+
+#include <MsgTask.h>
+#include <SystemStatus.h>
+#include <IDataItemObserver.h>
+
+using namespace loc_core;
+
+// updates sent between two waits for the MsgTask to catch up
+#define UPDATES_PER_BATCH 64
+
+namespace {
+
+class CountingClient : public IDataItemObserver {
+public:
+    inline CountingClient() : mItems(0) {}
+    inline virtual void getName(string& name) override { name = "CountingClient"; }
+    inline virtual void notify(const list<IDataItemCore*>& dlist) override {
+        mItems += dlist.size();
+    }
+    size_t mItems;
+};
+
+struct Barrier : public LocMsg {
+    inline Barrier(std::promise<void>& done) : mDone(done) {}
+    inline virtual void proc() const { mDone.set_value(); }
+    std::promise<void>& mDone;
+};
+
+MsgTask* msgTask()
+{
+    static MsgTask* task = new MsgTask("SsObsBench", false);
+    return task;
+}
+
+IOsObserver* osObserver()
+{
+    static IOsObserver* observer = SystemStatus::getInstance(msgTask())->getOsObserver();
+    return observer;
+}
+
+void waitForMsgTask()
+{
+    std::promise<void> done;
+    std::future<void> doneFuture = done.get_future();
+    msgTask()->sendMsg(new Barrier(done));
+    doneFuture.wait();
+}
+
+void sendUpdates(uint64_t& seq)
+{
+    for (int i = 0; i < UPDATES_PER_BATCH; i++, seq++) {
+        SystemStatusNetworkInfo network(TYPE_WIFI, "WIFI", "", 0 == (seq & 1), false,
+                                        0x100 + (seq & 1));
+        SystemStatusRilCellInfo cell;
+        list<IDataItemCore*> dlist = {&network, &cell};
+        osObserver()->notify(dlist);
+    }
+}
+
+} // namespace
+
+static void BM_NotifyFanOut(benchmark::State& state)
+{
+    const list<DataItemId> ids = {NETWORKINFO_DATA_ITEM_ID, RILCELLINFO_DATA_ITEM_ID};
+    std::vector<CountingClient> clients(state.range(0));
+    for (auto& client : clients) {
+        osObserver()->subscribe(ids, &client);
+    }
+    waitForMsgTask();
+
+    uint64_t seq = 0;
+    for (auto _ : state) {
+        sendUpdates(seq);
+        waitForMsgTask();
+    }
+
+    size_t delivered = 0;
+    for (auto& client : clients) {
+        osObserver()->unsubscribeAll(&client);
+    }
+    waitForMsgTask();
+    for (auto& client : clients) {
+        delivered += client.mItems;
+    }
+    state.SetItemsProcessed(state.iterations() * UPDATES_PER_BATCH * ids.size());
+    state.counters["delivered"] = benchmark::Counter(delivered, benchmark::Counter::kIsRate);
+}
+
+static void BM_NotifyProducers(benchmark::State& state)
+{
+    // subscribed once for all thread counts, and kept for the process lifetime
+    static CountingClient clients[4];
+    static bool subscribed = [] {
+        const list<DataItemId> ids = {NETWORKINFO_DATA_ITEM_ID, RILCELLINFO_DATA_ITEM_ID};
+        for (auto& client : clients) {
+            osObserver()->subscribe(ids, &client);
+        }
+        waitForMsgTask();
+        return true;
+    }();
+    (void)subscribed;
+
+    uint64_t seq = 0;
+    for (auto _ : state) {
+        sendUpdates(seq);
+        waitForMsgTask();
+    }
+    state.SetItemsProcessed(state.iterations() * UPDATES_PER_BATCH * 2);
+}
+
+BENCHMARK(BM_NotifyFanOut)->Arg(1)->Arg(4)->Arg(16);
+BENCHMARK(BM_NotifyProducers)->Threads(1)->Threads(2)->Threads(4)->Threads(8)->UseRealTime();
+
+BENCHMARK_MAIN();
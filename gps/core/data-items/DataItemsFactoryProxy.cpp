@@ -28,73 +28,147 @@
  */
 #define LOG_TAG "DataItemsFactoryProxy"
 
-#include <dlfcn.h>
 #include <DataItemId.h>
 #include <IDataItemCore.h>
 #include <DataItemsFactoryProxy.h>
 #include <loc_pla.h>
+#include <mutex>
 #include <log_util.h>
+#include <LocDlRegistry.h>
+
+using namespace loc_util;
 
 namespace loc_core
 {
 void* DataItemsFactoryProxy::dataItemLibHandle = NULL;
-get_concrete_data_item_fn* DataItemsFactoryProxy::getConcreteDIFunc = NULL;
+std::atomic<get_concrete_data_item_fn*> DataItemsFactoryProxy::getConcreteDIFunc(NULL);
+
+// Free list of one data item id. Items are obtained on the OS observer threads
+// and released on the MsgTask, hence the lock.
+struct DataItemPool {
+    std::mutex lock;
+    IDataItemCore* freeItems[DATA_ITEM_POOL_SIZE];
+    uint32_t freeCount;
+    DataItemPoolStats stats;
+};
+static DataItemPool sDataItemPools[MAX_DATA_ITEM_ID_1_1];
+
+static inline bool isPooledId(DataItemId id) {
+    return id >= 0 && id < MAX_DATA_ITEM_ID_1_1;
+}
 
 IDataItemCore* DataItemsFactoryProxy::createNewDataItem(DataItemId id)
 {
     IDataItemCore *mydi = nullptr;
 
-    if (NULL != getConcreteDIFunc) {
-        mydi = (*getConcreteDIFunc)(id);
+    // the getter is resolved through LocDlRegistry on first use only, later
+    // calls do not go through the dl lock
+    get_concrete_data_item_fn* getter = getConcreteDIFunc.load(std::memory_order_acquire);
+    if (NULL == getter) {
+        dataItemLibHandle = LocDlRegistry::getLibHandle(DATA_ITEMS_LIB_NAME);
+        getter = (get_concrete_data_item_fn*)
+                LocDlRegistry::getSymbol(DATA_ITEMS_LIB_NAME, DATA_ITEMS_GET_CONCRETE_DI);
+        if (NULL != getter) {
+            LOC_LOGD("Loaded function %s : %p", DATA_ITEMS_GET_CONCRETE_DI, getter);
+            getConcreteDIFunc.store(getter, std::memory_order_release);
+        }
+    }
+
+    if (NULL != getter) {
+        mydi = (*getter)(id);
+    }
+    return mydi;
+}
+
+IDataItemCore* DataItemsFactoryProxy::obtainDataItem(DataItemId id)
+{
+    if (!isPooledId(id)) {
+        return createNewDataItem(id);
     }
-    else {
-        // first call to this function, symbol not yet loaded
-        if (NULL == dataItemLibHandle) {
-            LOC_LOGD("Loaded library %s",DATA_ITEMS_LIB_NAME);
-            dataItemLibHandle = dlopen(DATA_ITEMS_LIB_NAME, RTLD_NOW);
-            if (NULL == dataItemLibHandle) {
-                // dlopen failed.
-                const char * err = dlerror();
-                if (NULL == err)
-                {
-                    err = "Unknown";
-                }
-                LOC_LOGE("%s:%d]: failed to load library %s; error=%s",
-                     __func__, __LINE__, DATA_ITEMS_LIB_NAME, err);
-            }
+
+    DataItemPool& pool = sDataItemPools[id];
+    {
+        std::lock_guard<std::mutex> guard(pool.lock);
+        if (pool.freeCount > 0) {
+            pool.stats.reused++;
+            return pool.freeItems[--pool.freeCount];
         }
+    }
+
+    IDataItemCore* dataItem = createNewDataItem(id);
+    if (nullptr != dataItem) {
+        std::lock_guard<std::mutex> guard(pool.lock);
+        pool.stats.created++;
+    }
+    return dataItem;
+}
+
+void DataItemsFactoryProxy::recycleDataItem(IDataItemCore* dataItem)
+{
+    if (nullptr == dataItem) {
+        return;
+    }
 
-        // load sym - if dlopen handle is obtained and symbol is not yet obtained
-        if (NULL != dataItemLibHandle) {
-            getConcreteDIFunc = (get_concrete_data_item_fn * )
-                                    dlsym(dataItemLibHandle, DATA_ITEMS_GET_CONCRETE_DI);
-            if (NULL != getConcreteDIFunc) {
-                LOC_LOGD("Loaded function %s : %p",DATA_ITEMS_GET_CONCRETE_DI,getConcreteDIFunc);
-                mydi = (*getConcreteDIFunc)(id);
-            }
-            else {
-                // dlysm failed.
-                const char * err = dlerror();
-                if (NULL == err)
-                {
-                    err = "Unknown";
-                }
-                LOC_LOGE("%s:%d]: failed to find symbol %s; error=%s",
-                         __func__, __LINE__, DATA_ITEMS_GET_CONCRETE_DI, err);
-            }
+    DataItemId id = dataItem->getId();
+    if (isPooledId(id)) {
+        DataItemPool& pool = sDataItemPools[id];
+        std::lock_guard<std::mutex> guard(pool.lock);
+        if (pool.freeCount < DATA_ITEM_POOL_SIZE) {
+            pool.freeItems[pool.freeCount++] = dataItem;
+            pool.stats.recycled++;
+            return;
+        }
+        pool.stats.discarded++;
+    }
+    delete dataItem;
+}
+
+shared_ptr<IDataItemCore> DataItemsFactoryProxy::obtainSharedDataItem(DataItemId id)
+{
+    IDataItemCore* dataItem = obtainDataItem(id);
+    if (nullptr == dataItem) {
+        return nullptr;
+    }
+    return shared_ptr<IDataItemCore>(dataItem, recycleDataItem);
+}
+
+DataItemPoolStats DataItemsFactoryProxy::getPoolStats(DataItemId id)
+{
+    DataItemPoolStats stats = {};
+    if (isPooledId(id)) {
+        DataItemPool& pool = sDataItemPools[id];
+        std::lock_guard<std::mutex> guard(pool.lock);
+        stats = pool.stats;
+    }
+    return stats;
+}
+
+void DataItemsFactoryProxy::logPoolStats()
+{
+    for (int id = 0; id < MAX_DATA_ITEM_ID_1_1; id++) {
+        DataItemPoolStats stats = getPoolStats((DataItemId)id);
+        if (stats.created > 0) {
+            LOC_LOGD("DataItem:%d created:%u reused:%u recycled:%u discarded:%u",
+                     id, stats.created, stats.reused, stats.recycled, stats.discarded);
         }
     }
-    return mydi;
 }
 
 void DataItemsFactoryProxy::closeDataItemLibraryHandle()
 {
+    // pooled items have their code in the library, delete them first
+    for (DataItemPool& pool : sDataItemPools) {
+        std::lock_guard<std::mutex> guard(pool.lock);
+        while (pool.freeCount > 0) {
+            delete pool.freeItems[--pool.freeCount];
+        }
+    }
+
     if (NULL != dataItemLibHandle) {
-        dlclose(dataItemLibHandle);
+        getConcreteDIFunc.store(NULL, std::memory_order_release);
+        LocDlRegistry::unload(DATA_ITEMS_LIB_NAME);
         dataItemLibHandle = NULL;
     }
 }
 
 } // namespace loc_core
-
-
@@ -30,6 +30,8 @@
 #ifndef __DATAITEMFACTORYBASE__
 #define __DATAITEMFACTORYBASE__
 
+#include <atomic>
+#include <memory>
 #include <DataItemId.h>
 #include <IDataItemCore.h>
 
@@ -39,14 +41,35 @@ namespace loc_core
 #define DATA_ITEMS_LIB_NAME "libdataitems.so"
 #define DATA_ITEMS_GET_CONCRETE_DI "getConcreteDataItem"
 
+// number of released data items kept for reuse, per data item id
+#define DATA_ITEM_POOL_SIZE 4
+
 typedef IDataItemCore * (get_concrete_data_item_fn)(DataItemId);
 
+struct DataItemPoolStats {
+    uint32_t created;   // obtained from the data items library
+    uint32_t reused;    // obtained from the pool
+    uint32_t recycled;  // returned to the pool
+    uint32_t discarded; // deleted as the pool was full
+};
+
 class DataItemsFactoryProxy {
 public:
     static IDataItemCore* createNewDataItem(DataItemId id);
+    // Data items are pooled per id: a released item is kept, up to
+    // DATA_ITEM_POOL_SIZE per id, and handed out again by obtainDataItem().
+    // An obtained item still holds its previous value, callers copy() into it,
+    // which assigns every field and reuses the storage of its strings.
+    static IDataItemCore* obtainDataItem(DataItemId id);
+    static void recycleDataItem(IDataItemCore* dataItem);
+    // obtainDataItem() in a shared_ptr which recycles the item once released
+    static shared_ptr<IDataItemCore> obtainSharedDataItem(DataItemId id);
+    static DataItemPoolStats getPoolStats(DataItemId id);
+    static void logPoolStats();
+    // deletes the pooled data items and unloads the data items library
     static void closeDataItemLibraryHandle();
     static void *dataItemLibHandle;
-    static get_concrete_data_item_fn *getConcreteDIFunc;
+    static std::atomic<get_concrete_data_item_fn*> getConcreteDIFunc;
 };
 
 } // namespace loc_core
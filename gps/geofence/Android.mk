@@ -28,3 +28,35 @@ LOCAL_HEADER_LIBRARIES := \
 
 LOCAL_CFLAGS += $(GNSS_CFLAGS)
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := libgeofencing-batch-test
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_SHARED_LIBRARIES := \
+    libutils \
+    libcutils \
+    liblog \
+    libloc_core \
+    libgps.utils
+
+LOCAL_SRC_FILES := \
+    tests/GeofenceBatchTest.cpp \
+    GeofenceAdapter.cpp
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)
+
+LOCAL_CFLAGS += \
+     -fno-short-enums \
+
+LOCAL_HEADER_LIBRARIES := \
+    libgps.utils_headers \
+    libloc_core_headers \
+    libloc_pla_headers \
+    liblocation_api_headers
+
+LOCAL_CFLAGS += $(GNSS_CFLAGS)
+
+include $(BUILD_NATIVE_TEST)
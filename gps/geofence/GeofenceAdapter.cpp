@@ -31,6 +31,7 @@
 #include <GeofenceAdapter.h>
 #include "loc_log.h"
 #include <log_util.h>
+#include <LocTrace.h>
 #include <string>
 
 using namespace loc_core;
@@ -47,6 +48,12 @@ GeofenceAdapter::GeofenceAdapter() :
     LOC_LOGD("%s]: Constructor", __func__);
 }
 
+GeofenceAdapter::GeofenceAdapter(ContextBase* context) :
+    LocAdapterBase(0, context, true /*isMaster*/)
+{
+    LOC_LOGD("%s]: Constructor", __func__);
+}
+
 void
 GeofenceAdapter::stopClientSessions(LocationAPI* client)
 {
@@ -641,6 +648,170 @@ GeofenceAdapter::modifyGeofencesCommand(LocationAPI* client, size_t count, uint3
     sendMsg(new MsgModifyGeofences(*this, *mLocApi, client, count, idsCopy, optionsCopy));
 }
 
+uint32_t*
+GeofenceAdapter::geofenceBatchCommand(LocationAPI* client, size_t count,
+        GeofenceBatchRequest* requests)
+{
+    LOC_LOGD("%s]: client %p count %zu", __func__, client, count);
+
+    struct MsgGeofenceBatch : public LocMsg {
+        GeofenceAdapter& mAdapter;
+        std::shared_ptr<GeofenceBatch> mBatch;
+        inline MsgGeofenceBatch(GeofenceAdapter& adapter,
+                                const std::shared_ptr<GeofenceBatch>& batch) :
+            LocMsg(),
+            mAdapter(adapter),
+            mBatch(batch) {}
+        inline virtual void proc() const {
+            mAdapter.submitGeofenceBatch(mBatch);
+        }
+    };
+
+    if (0 == count || NULL == requests) {
+        return NULL;
+    }
+    uint32_t* ids = new uint32_t[count];
+    if (nullptr == ids) {
+        LOC_LOGE("%s]: new failed to allocate ids", __func__);
+        return NULL;
+    }
+    for (size_t i=0; i < count; ++i) {
+        ids[i] = (GEOFENCE_BATCH_OP_ADD == requests[i].op) ?
+                generateSessionId() : requests[i].id;
+    }
+
+    sendMsg(new MsgGeofenceBatch(*this,
+            std::make_shared<GeofenceBatch>(client, count, requests, ids)));
+    return ids;
+}
+
+void
+GeofenceAdapter::submitGeofenceBatch(const std::shared_ptr<GeofenceBatch>& batch)
+{
+    size_t count = batch->requests.size();
+    while (batch->next < count && batch->inFlight < GEOFENCE_BATCH_MAX_IN_FLIGHT) {
+        size_t i = batch->next;
+        uint32_t clientId = batch->ids[i];
+
+        // keep requests on the same geofence in order, the earlier one must be answered first
+        if (batch->busyIds.find(clientId) != batch->busyIds.end()) {
+            break;
+        }
+        batch->next++;
+        batch->inFlight++;
+        batch->busyIds.insert(clientId);
+
+        // queued behind the geofence commands already sent to LocApi, so that the
+        // request sees the geofences as they are once those are answered
+        mLocApi->addToCallQueue(new LocApiResponse(*getContext(),
+                [this, batch, i] (LocationError /*err*/) {
+            sendGeofenceBatchItem(batch, i);
+        }));
+    }
+
+    // Send aggregated response once every request is answered and cleanup
+    if (batch->completed == count && nullptr != batch->ids) {
+        size_t failed = 0;
+        for (size_t i=0; i < count; ++i) {
+            if (LOCATION_ERROR_SUCCESS != batch->errs[i]) {
+                failed++;
+            }
+        }
+        LOC_LOGD("%s]: client %p count %zu failed %zu", __func__, batch->client, count, failed);
+
+        auto it = mClientData.find(batch->client);
+        if (it != mClientData.end() && it->second.collectiveResponseCb != nullptr) {
+            it->second.collectiveResponseCb(count, batch->errs.data(), batch->ids);
+        } else {
+            LOC_LOGE("%s]: client %p response not found in info", __func__, batch->client);
+        }
+        delete[] batch->ids;
+        batch->ids = nullptr;
+    }
+}
+
+void
+GeofenceAdapter::sendGeofenceBatchItem(const std::shared_ptr<GeofenceBatch>& batch, size_t index)
+{
+    const GeofenceBatchRequest& request = batch->requests[index];
+    uint32_t clientId = batch->ids[index];
+    uint32_t hwId = 0;
+    LocationError err = LOCATION_ERROR_SUCCESS;
+    if (GEOFENCE_BATCH_OP_ADD != request.op) {
+        err = getHwIdFromClient(batch->client, clientId, hwId);
+    }
+    if (LOCATION_ERROR_SUCCESS != err) {
+        completeGeofenceBatchItem(batch, index, err);
+        return;
+    }
+
+    switch (request.op) {
+    case GEOFENCE_BATCH_OP_ADD:
+        mLocApi->addGeofence(clientId, request.options, request.info,
+                new LocApiResponseData<LocApiGeofenceData>(*getContext(),
+                [this, batch, index] (LocationError err, LocApiGeofenceData data) {
+            if (LOCATION_ERROR_SUCCESS == err) {
+                const GeofenceBatchRequest& request = batch->requests[index];
+                saveGeofenceItem(batch->client, batch->ids[index], data.hwId,
+                                 request.options, request.info);
+            }
+            completeGeofenceBatchItem(batch, index, err);
+        }));
+        break;
+    case GEOFENCE_BATCH_OP_REMOVE:
+        mLocApi->removeGeofence(hwId, clientId, new LocApiResponse(*getContext(),
+                [this, batch, index, hwId] (LocationError err) {
+            if (LOCATION_ERROR_SUCCESS == err) {
+                removeGeofenceItem(hwId);
+            }
+            completeGeofenceBatchItem(batch, index, err);
+        }));
+        break;
+    case GEOFENCE_BATCH_OP_MODIFY:
+        mLocApi->modifyGeofence(hwId, clientId, request.options,
+                new LocApiResponse(*getContext(),
+                [this, batch, index, hwId] (LocationError err) {
+            if (LOCATION_ERROR_SUCCESS == err) {
+                modifyGeofenceItem(hwId, batch->requests[index].options);
+            }
+            completeGeofenceBatchItem(batch, index, err);
+        }));
+        break;
+    case GEOFENCE_BATCH_OP_PAUSE:
+        mLocApi->pauseGeofence(hwId, clientId, new LocApiResponse(*getContext(),
+                [this, batch, index, hwId] (LocationError err) {
+            if (LOCATION_ERROR_SUCCESS == err) {
+                pauseGeofenceItem(hwId);
+            }
+            completeGeofenceBatchItem(batch, index, err);
+        }));
+        break;
+    case GEOFENCE_BATCH_OP_RESUME:
+        mLocApi->resumeGeofence(hwId, clientId, new LocApiResponse(*getContext(),
+                [this, batch, index, hwId] (LocationError err) {
+            if (LOCATION_ERROR_SUCCESS == err) {
+                resumeGeofenceItem(hwId);
+            }
+            completeGeofenceBatchItem(batch, index, err);
+        }));
+        break;
+    default:
+        completeGeofenceBatchItem(batch, index, LOCATION_ERROR_INVALID_PARAMETER);
+        break;
+    }
+}
+
+void
+GeofenceAdapter::completeGeofenceBatchItem(const std::shared_ptr<GeofenceBatch>& batch,
+        size_t index, LocationError err)
+{
+    batch->errs[index] = err;
+    batch->inFlight--;
+    batch->completed++;
+    batch->busyIds.erase(batch->ids[index]);
+    submitGeofenceBatch(batch);
+}
+
 void
 GeofenceAdapter::saveGeofenceItem(LocationAPI* client, uint32_t clientId, uint32_t hwId,
         const GeofenceOption& options, const GeofenceInfo& info)
@@ -729,16 +900,14 @@ GeofenceAdapter::geofenceBreachEvent(size_t count, uint32_t* hwIds, Location& lo
         GeofenceBreachType breachType, uint64_t timestamp)
 {
 
-    IF_LOC_LOGD {
-        std::string idsString = "[";
-        if (NULL != hwIds) {
-            for (size_t i=0; i < count; ++i) {
-                idsString += std::to_string(hwIds[i]) + " ";
-            }
-        }
-        idsString += "]";
-        LOC_LOGD("%s]: breachType %u count %zu ids %s",
-                 __func__, breachType, count, idsString.c_str());
+    LOC_TRACE("%s]: breachType %u count %zu", __func__, breachType, count);
+    // eight ids per record, so that a large breach does not flood the trace ring
+    for (size_t i=0; NULL != hwIds && i < count; i += 8) {
+        uint32_t ids[8] = {};
+        size_t n = (count - i < 8) ? count - i : 8;
+        memcpy(ids, hwIds + i, n * sizeof(uint32_t));
+        LOC_TRACE("ids %zu-%zu: %u %u %u %u %u %u %u %u", i, i + n - 1,
+                  ids[0], ids[1], ids[2], ids[3], ids[4], ids[5], ids[6], ids[7]);
     }
 
     if (0 == count || NULL == hwIds)
@@ -33,6 +33,9 @@
 #include <LocContext.h>
 #include <LocationAPI.h>
 #include <map>
+#include <set>
+#include <vector>
+#include <memory>
 
 using namespace loc_core;
 
@@ -74,6 +77,25 @@ typedef struct {
 typedef std::map<uint32_t, GeofenceObject> GeofencesMap; //map of hwId to GeofenceObject
 typedef std::map<GeofenceKey, uint32_t> GeofenceIdMap; //map of GeofenceKey to hwId
 
+/* max number of requests of one geofence batch outstanding in LocApi at any time */
+#define GEOFENCE_BATCH_MAX_IN_FLIGHT (16)
+
+typedef struct GeofenceBatch {
+    LocationAPI* client;
+    std::vector<GeofenceBatchRequest> requests;
+    std::vector<LocationError> errs;
+    uint32_t* ids;              // returned to the client, freed after the response
+    size_t next;                // index of the next request to submit
+    size_t inFlight;            // requests submitted to LocApi and not yet answered
+    size_t completed;           // requests answered by LocApi or rejected locally
+    std::set<uint32_t> busyIds; // client ids with a request in flight
+    inline GeofenceBatch(LocationAPI* _client, size_t count,
+                         const GeofenceBatchRequest* _requests, uint32_t* _ids) :
+        client(_client), requests(_requests, _requests + count),
+        errs(count, LOCATION_ERROR_SUCCESS), ids(_ids),
+        next(0), inFlight(0), completed(0) {}
+} GeofenceBatch;
+
 class GeofenceAdapter : public LocAdapterBase {
 
     /* ==== GEOFENCES ====================================================================== */
@@ -86,6 +108,10 @@ protected:
     virtual void updateClientsEventMask();
     virtual void stopClientSessions(LocationAPI* client);
 
+    /* ==== TEST =========================================================================== */
+    /* runs on the given context instead of the location HAL's */
+    explicit GeofenceAdapter(ContextBase* context);
+
 public:
 
     GeofenceAdapter();
@@ -106,9 +132,15 @@ public:
     void resumeGeofencesCommand(LocationAPI* client, size_t count, uint32_t* ids);
     void modifyGeofencesCommand(LocationAPI* client, size_t count, uint32_t* ids,
                                 GeofenceOption* options);
+    uint32_t* geofenceBatchCommand(LocationAPI* client, size_t count,
+                                   GeofenceBatchRequest* requests);
     /* ======== RESPONSES ================================================================== */
     void reportResponse(LocationAPI* client, size_t count, LocationError* errs, uint32_t* ids);
     /* ======== UTILITIES ================================================================== */
+    void submitGeofenceBatch(const std::shared_ptr<GeofenceBatch>& batch);
+    void sendGeofenceBatchItem(const std::shared_ptr<GeofenceBatch>& batch, size_t index);
+    void completeGeofenceBatchItem(const std::shared_ptr<GeofenceBatch>& batch, size_t index,
+                                   LocationError err);
     void saveGeofenceItem(LocationAPI* client,
                           uint32_t clientId,
                           uint32_t hwId,
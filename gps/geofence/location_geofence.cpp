@@ -44,6 +44,8 @@ static void modifyGeofences(LocationAPI* client, size_t count, uint32_t* ids,
                                GeofenceOption* options);
 static void pauseGeofences(LocationAPI* client, size_t count, uint32_t* ids);
 static void resumeGeofences(LocationAPI* client, size_t count, uint32_t* ids);
+static uint32_t* geofenceBatch(LocationAPI* client, size_t count,
+                               GeofenceBatchRequest* requests);
 
 static const GeofenceInterface gGeofenceInterface = {
     sizeof(GeofenceInterface),
@@ -56,7 +58,8 @@ static const GeofenceInterface gGeofenceInterface = {
     removeGeofences,
     modifyGeofences,
     pauseGeofences,
-    resumeGeofences
+    resumeGeofences,
+    geofenceBatch
 };
 
 #ifndef DEBUG_X86
@@ -143,3 +146,12 @@ static void resumeGeofences(LocationAPI* client, size_t count, uint32_t* ids)
     }
 }
 
+static uint32_t* geofenceBatch(LocationAPI* client, size_t count,
+                               GeofenceBatchRequest* requests)
+{
+    if (NULL != gGeofenceAdapter) {
+        return gGeofenceAdapter->geofenceBatchCommand(client, count, requests);
+    } else {
+        return NULL;
+    }
+}
@@ -0,0 +1,333 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Sends geofence batches through GeofenceAdapter to a fake LocApi, which
+// lets the calls queued with addToCallQueue go ahead and answers the
+// geofence requests one at a time, as the test tells it to. Checks that no
+// more than GEOFENCE_BATCH_MAX_IN_FLIGHT requests of a batch are out at a
+// time, that requests on the same geofence reach LocApi in order, and that
+// a batch waits behind the geofence commands queued before it.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <vector>
+
+#include <GeofenceAdapter.h>
+#include <MsgTask.h>
+
+#define BATCH_ADDS      ((size_t)40)
+
+using namespace loc_core;
+
+namespace {
+
+typedef enum {
+    CALL_ADD = 0,
+    CALL_REMOVE,
+    CALL_MODIFY,
+    CALL_PAUSE,
+    CALL_RESUME,
+} CallType;
+
+typedef struct {
+    CallType type;
+    uint32_t clientId;
+    LocApiResponse* response;                             // all but CALL_ADD
+    LocApiResponseData<LocApiGeofenceData>* responseData; // CALL_ADD
+} GeofenceCall;
+
+// The fake is called on the context thread and looked at by the test once
+// sync() has returned, so nothing in here needs a lock.
+class FakeLocApi : public LocApiBase {
+public:
+    FakeLocApi(ContextBase* context) : LocApiBase(0, context), mNextHwId(100) {}
+
+    virtual void addToCallQueue(LocApiResponse* adapterResponse) override {
+        mCallQueue.push_back(adapterResponse);
+    }
+    virtual void addGeofence(uint32_t clientId, const GeofenceOption& /*options*/,
+            const GeofenceInfo& /*info*/,
+            LocApiResponseData<LocApiGeofenceData>* adapterResponseData) override {
+        mCalls.push_back({CALL_ADD, clientId, nullptr, adapterResponseData});
+    }
+    virtual void removeGeofence(uint32_t /*hwId*/, uint32_t clientId,
+            LocApiResponse* adapterResponse) override {
+        mCalls.push_back({CALL_REMOVE, clientId, adapterResponse, nullptr});
+    }
+    virtual void pauseGeofence(uint32_t /*hwId*/, uint32_t clientId,
+            LocApiResponse* adapterResponse) override {
+        mCalls.push_back({CALL_PAUSE, clientId, adapterResponse, nullptr});
+    }
+    virtual void resumeGeofence(uint32_t /*hwId*/, uint32_t clientId,
+            LocApiResponse* adapterResponse) override {
+        mCalls.push_back({CALL_RESUME, clientId, adapterResponse, nullptr});
+    }
+    virtual void modifyGeofence(uint32_t /*hwId*/, uint32_t clientId,
+            const GeofenceOption& /*options*/, LocApiResponse* adapterResponse) override {
+        mCalls.push_back({CALL_MODIFY, clientId, adapterResponse, nullptr});
+    }
+
+    // lets the oldest queued call go ahead, false if there is none
+    bool runQueuedCall() {
+        if (mCallQueue.empty()) {
+            return false;
+        }
+        LocApiResponse* response = mCallQueue.front();
+        mCallQueue.pop_front();
+        response->returnToSender(LOCATION_ERROR_SUCCESS);
+        return true;
+    }
+
+    // answers the oldest geofence call
+    GeofenceCall answerCall(LocationError err) {
+        GeofenceCall call = mCalls.front();
+        mCalls.pop_front();
+        if (CALL_ADD == call.type) {
+            LocApiGeofenceData data = {mNextHwId++};
+            call.responseData->returnToSender(err, data);
+        } else {
+            call.response->returnToSender(err);
+        }
+        return call;
+    }
+
+    std::deque<LocApiResponse*> mCallQueue;
+    std::deque<GeofenceCall> mCalls;
+    uint32_t mNextHwId;
+};
+
+// A context on its own thread, with the fake in place of the LocApi it
+// created, and no LBS library.
+class TestContext : public ContextBase {
+public:
+    TestContext() : ContextBase(new MsgTask("GeofenceBatchTest", false), 0, "libgeofence_test_no_lbs.so") {
+        mLocApi->destroy();
+        mLocApi = mFakeLocApi = new FakeLocApi(this);
+    }
+    FakeLocApi* mFakeLocApi;
+};
+
+class TestGeofenceAdapter : public GeofenceAdapter {
+public:
+    TestGeofenceAdapter(ContextBase* context) : GeofenceAdapter(context) {}
+    void addClient(LocationAPI* client, const LocationCallbacks& callbacks) {
+        saveClient(client, callbacks);
+    }
+};
+
+typedef struct {
+    std::vector<LocationError> errs;
+    std::vector<uint32_t> ids;
+} CollectiveResponse;
+
+class GeofenceBatchTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        mContext = new TestContext();
+        mApi = mContext->mFakeLocApi;
+        mAdapter = new TestGeofenceAdapter(mContext);
+
+        LocationCallbacks callbacks = {};
+        callbacks.size = sizeof(LocationCallbacks);
+        callbacks.collectiveResponseCb = [this] (uint32_t count, LocationError* errs,
+                                                 uint32_t* ids) {
+            mResponses.push_back({std::vector<LocationError>(errs, errs + count),
+                                  std::vector<uint32_t>(ids, ids + count)});
+        };
+        mAdapter->addClient(client(), callbacks);
+    }
+
+    void TearDown() override {
+        sync();
+        delete mAdapter;
+        delete mContext;
+    }
+
+    LocationAPI* client() {
+        return reinterpret_cast<LocationAPI*>(this);
+    }
+
+    // waits until the context thread has handled everything sent to it so far
+    void sync() {
+        struct SyncMsg : public LocMsg {
+            std::promise<void>& mDone;
+            inline SyncMsg(std::promise<void>& done) : LocMsg(), mDone(done) {}
+            inline virtual void proc() const {
+                mDone.set_value();
+            }
+        };
+        std::promise<void> done;
+        mContext->sendMsg(new SyncMsg(done));
+        done.get_future().wait();
+    }
+
+    void runQueuedCalls() {
+        while (mApi->runQueuedCall()) {
+            sync();
+        }
+    }
+
+    GeofenceCall answerCall(LocationError err = LOCATION_ERROR_SUCCESS) {
+        GeofenceCall call = mApi->answerCall(err);
+        sync();
+        return call;
+    }
+
+    GeofenceBatchRequest request(GeofenceBatchOp op, uint32_t id = 0) {
+        GeofenceBatchRequest request = {};
+        request.size = sizeof(GeofenceBatchRequest);
+        request.op = op;
+        request.id = id;
+        request.options.size = sizeof(GeofenceOption);
+        request.options.breachTypeMask = GEOFENCE_BREACH_ENTER_BIT;
+        request.options.responsiveness = 1000;
+        request.info.size = sizeof(GeofenceInfo);
+        request.info.latitude = 37.4;
+        request.info.longitude = -122.1;
+        request.info.radius = 100;
+        return request;
+    }
+
+    // adds one geofence and answers it, returns its id
+    uint32_t addGeofence() {
+        GeofenceBatchRequest add = request(GEOFENCE_BATCH_OP_ADD);
+        uint32_t* ids = mAdapter->geofenceBatchCommand(client(), 1, &add);
+        uint32_t id = ids[0];
+        sync();
+        runQueuedCalls();
+        answerCall();
+        mResponses.clear();
+        return id;
+    }
+
+    TestContext* mContext;
+    FakeLocApi* mApi;
+    TestGeofenceAdapter* mAdapter;
+    std::vector<CollectiveResponse> mResponses;
+};
+
+} // namespace
+
+TEST_F(GeofenceBatchTest, KeepsAtMostMaxInFlight)
+{
+    std::vector<GeofenceBatchRequest> requests(BATCH_ADDS, request(GEOFENCE_BATCH_OP_ADD));
+    std::vector<uint32_t> ids;
+    uint32_t* batchIds = mAdapter->geofenceBatchCommand(client(), BATCH_ADDS, requests.data());
+    ids.assign(batchIds, batchIds + BATCH_ADDS);
+    sync();
+
+    // the requests wait in the LocApi call queue, not in LocApi itself
+    EXPECT_EQ((size_t)GEOFENCE_BATCH_MAX_IN_FLIGHT, mApi->mCallQueue.size());
+    EXPECT_TRUE(mApi->mCalls.empty());
+
+    size_t answered = 0;
+    while (answered < BATCH_ADDS) {
+        runQueuedCalls();
+        ASSERT_FALSE(mApi->mCalls.empty());
+        EXPECT_LE(mApi->mCalls.size(), (size_t)GEOFENCE_BATCH_MAX_IN_FLIGHT);
+        GeofenceCall call = answerCall();
+        EXPECT_EQ(CALL_ADD, call.type);
+        EXPECT_EQ(ids[answered], call.clientId);
+        answered++;
+        // each answer lets one more request of the batch in
+        EXPECT_EQ(std::min((size_t)GEOFENCE_BATCH_MAX_IN_FLIGHT, BATCH_ADDS - answered),
+                  mApi->mCalls.size() + mApi->mCallQueue.size());
+    }
+
+    ASSERT_EQ(1u, mResponses.size());
+    EXPECT_EQ(ids, mResponses[0].ids);
+    for (LocationError err : mResponses[0].errs) {
+        EXPECT_EQ(LOCATION_ERROR_SUCCESS, err);
+    }
+}
+
+TEST_F(GeofenceBatchTest, KeepsRequestsOnOneGeofenceInOrder)
+{
+    uint32_t id = addGeofence();
+    uint32_t other = addGeofence();
+
+    std::vector<GeofenceBatchRequest> requests = {
+        request(GEOFENCE_BATCH_OP_MODIFY, id),
+        request(GEOFENCE_BATCH_OP_PAUSE, id),
+        request(GEOFENCE_BATCH_OP_PAUSE, other),
+        request(GEOFENCE_BATCH_OP_RESUME, id),
+        request(GEOFENCE_BATCH_OP_REMOVE, id),
+    };
+    mAdapter->geofenceBatchCommand(client(), requests.size(), requests.data());
+    sync();
+
+    // the second request on id waits for the first to be answered, and
+    // holds back the requests after it
+    ASSERT_EQ(1u, mApi->mCallQueue.size());
+    const CallType expected[] = {CALL_MODIFY, CALL_PAUSE, CALL_PAUSE, CALL_RESUME, CALL_REMOVE};
+    const uint32_t expectedIds[] = {id, id, other, id, id};
+    for (size_t i = 0; i < requests.size(); i++) {
+        runQueuedCalls();
+        ASSERT_FALSE(mApi->mCalls.empty());
+        GeofenceCall call = answerCall();
+        EXPECT_EQ(expected[i], call.type);
+        EXPECT_EQ(expectedIds[i], call.clientId);
+    }
+    runQueuedCalls();
+    EXPECT_TRUE(mApi->mCalls.empty());
+
+    ASSERT_EQ(1u, mResponses.size());
+    for (LocationError err : mResponses[0].errs) {
+        EXPECT_EQ(LOCATION_ERROR_SUCCESS, err);
+    }
+}
+
+TEST_F(GeofenceBatchTest, WaitsForEarlierCommands)
+{
+    uint32_t id = addGeofence();
+
+    uint32_t removeIds[] = {id};
+    mAdapter->removeGeofencesCommand(client(), 1, removeIds);
+    GeofenceBatchRequest modify = request(GEOFENCE_BATCH_OP_MODIFY, id);
+    mAdapter->geofenceBatchCommand(client(), 1, &modify);
+    sync();
+    ASSERT_EQ(2u, mApi->mCallQueue.size());
+
+    // the remove goes first, and the batch then finds the geofence gone
+    mApi->runQueuedCall();
+    sync();
+    GeofenceCall call = answerCall();
+    EXPECT_EQ(CALL_REMOVE, call.type);
+    ASSERT_EQ(1u, mResponses.size());
+    EXPECT_EQ(LOCATION_ERROR_SUCCESS, mResponses[0].errs[0]);
+
+    runQueuedCalls();
+    EXPECT_TRUE(mApi->mCalls.empty());
+    ASSERT_EQ(2u, mResponses.size());
+    EXPECT_EQ(id, mResponses[1].ids[0]);
+    EXPECT_EQ(LOCATION_ERROR_ID_UNKNOWN, mResponses[1].errs[0]);
+}
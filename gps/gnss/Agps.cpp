@@ -38,248 +38,202 @@
 /* --------------------------------------------------------------------
  *   AGPS State Machine Methods
  * -------------------------------------------------------------------*/
+/* Handler for each (state, event) pair. Rows are AgpsState, columns AgpsEvent:
+ * INVALID, SUBSCRIBE, UNSUBSCRIBE, GRANTED, RELEASED, DENIED */
+const AgpsStateMachine::EventHandler
+AgpsStateMachine::sTransitionTable[AGPS_STATE_MAX][AGPS_EVENT_MAX] = {
+    /* AGPS_STATE_INVALID */
+    { &AgpsStateMachine::onInvalidEvent,
+      &AgpsStateMachine::onInvalidEvent,
+      &AgpsStateMachine::onInvalidEvent,
+      &AgpsStateMachine::onInvalidEvent,
+      &AgpsStateMachine::onInvalidEvent,
+      &AgpsStateMachine::onInvalidEvent },
+    /* AGPS_STATE_RELEASED */
+    { &AgpsStateMachine::onInvalidEvent,
+      &AgpsStateMachine::onSubscribeWhenReleased,
+      &AgpsStateMachine::onUnsubscribeWhenReleased,
+      &AgpsStateMachine::onInvalidEvent,
+      &AgpsStateMachine::onReleasedWhenReleased,
+      &AgpsStateMachine::onInvalidEvent },
+    /* AGPS_STATE_PENDING */
+    { &AgpsStateMachine::onInvalidEvent,
+      &AgpsStateMachine::onSubscribeWhenWaiting,
+      &AgpsStateMachine::onUnsubscribeWhenConnected,
+      &AgpsStateMachine::onGrantedWhenPending,
+      &AgpsStateMachine::onIgnoredEvent,
+      &AgpsStateMachine::onDeniedWhenPending },
+    /* AGPS_STATE_ACQUIRED */
+    { &AgpsStateMachine::onInvalidEvent,
+      &AgpsStateMachine::onSubscribeWhenAcquired,
+      &AgpsStateMachine::onUnsubscribeWhenConnected,
+      &AgpsStateMachine::onInvalidEvent,
+      &AgpsStateMachine::onReleasedWhenAcquired,
+      &AgpsStateMachine::onIgnoredEvent },
+    /* AGPS_STATE_RELEASING */
+    { &AgpsStateMachine::onInvalidEvent,
+      &AgpsStateMachine::onSubscribeWhenWaiting,
+      &AgpsStateMachine::onUnsubscribeWhenReleasing,
+      &AgpsStateMachine::onInvalidEvent,
+      &AgpsStateMachine::onClosedWhenReleasing,
+      &AgpsStateMachine::onClosedWhenReleasing }
+};
+
 void AgpsStateMachine::processAgpsEvent(AgpsEvent event){
 
     LOC_LOGD("processAgpsEvent(): SM %p, Event %d, State %d",
                this, event, mState);
 
-    switch (event) {
-
-        case AGPS_EVENT_SUBSCRIBE:
-            processAgpsEventSubscribe();
-            break;
-
-        case AGPS_EVENT_UNSUBSCRIBE:
-            processAgpsEventUnsubscribe();
-            break;
-
-        case AGPS_EVENT_GRANTED:
-            processAgpsEventGranted();
-            break;
+    if (event <= AGPS_EVENT_INVALID || event >= AGPS_EVENT_MAX ||
+            mState <= AGPS_STATE_INVALID || mState >= AGPS_STATE_MAX) {
+        LOC_LOGE("Invalid Loc Agps Event %d in state %d", event, mState);
+        return;
+    }
 
-        case AGPS_EVENT_RELEASED:
-            processAgpsEventReleased();
-            break;
+    (this->*sTransitionTable[mState][event])();
+}
 
-        case AGPS_EVENT_DENIED:
-            processAgpsEventDenied();
-            break;
+void AgpsStateMachine::onInvalidEvent(){
 
-        default:
-            LOC_LOGE("Invalid Loc Agps Event");
-    }
+    LOC_LOGE("Unexpected event in state %d", mState);
 }
 
-void AgpsStateMachine::processAgpsEventSubscribe(){
-
-    switch (mState) {
+void AgpsStateMachine::onIgnoredEvent(){
 
-        case AGPS_STATE_RELEASED:
-            /* Add subscriber to list
-             * No notifications until we get RSRC_GRANTED */
-            addSubscriber(mCurrentSubscriber);
-            requestOrReleaseDataConn(true);
-            transitionState(AGPS_STATE_PENDING);
-            break;
+    /* NOOP */
+}
 
-        case AGPS_STATE_PENDING:
-            /* Already requested for data connection,
-             * do nothing until we get RSRC_GRANTED event;
-             * Just add this subscriber to the list, for notifications */
-            addSubscriber(mCurrentSubscriber);
-            break;
+void AgpsStateMachine::onSubscribeWhenReleased(){
 
-        case AGPS_STATE_ACQUIRED:
-            /* We already have the data connection setup,
-             * Notify current subscriber with GRANTED event,
-             * And add it to the subscriber list for further notifications. */
-            notifyEventToSubscriber(AGPS_EVENT_GRANTED, mCurrentSubscriber, false);
-            addSubscriber(mCurrentSubscriber);
-            break;
+    /* Add subscriber to list
+     * No notifications until we get RSRC_GRANTED */
+    addSubscriber(mCurrentSubscriber);
+    requestOrReleaseDataConn(true);
+    transitionState(AGPS_STATE_PENDING);
+}
 
-        case AGPS_STATE_RELEASING:
-            addSubscriber(mCurrentSubscriber);
-            break;
+void AgpsStateMachine::onSubscribeWhenWaiting(){
 
-        default:
-            LOC_LOGE("Invalid state: %d", mState);
-    }
+    /* Already requested for data connection or its release,
+     * do nothing until the next framework event;
+     * Just add this subscriber to the list, for notifications */
+    addSubscriber(mCurrentSubscriber);
 }
 
-void AgpsStateMachine::processAgpsEventUnsubscribe(){
-
-    switch (mState) {
+void AgpsStateMachine::onSubscribeWhenAcquired(){
 
-        case AGPS_STATE_RELEASED:
-            notifyEventToSubscriber(
-                    AGPS_EVENT_UNSUBSCRIBE, mCurrentSubscriber, false);
-            break;
+    /* We already have the data connection setup,
+     * Notify current subscriber with GRANTED event,
+     * And add it to the subscriber list for further notifications. */
+    notifyEventToSubscriber(AGPS_EVENT_GRANTED, mCurrentSubscriber, false);
+    addSubscriber(mCurrentSubscriber);
+}
 
-        case AGPS_STATE_PENDING:
-        case AGPS_STATE_ACQUIRED:
-            /* If the subscriber wishes to wait for connection close,
-             * before being removed from list, move to inactive state
-             * and notify */
-            if (mCurrentSubscriber->mWaitForCloseComplete) {
-                mCurrentSubscriber->mIsInactive = true;
-            }
-            else {
-                /* Notify only current subscriber and then delete it from
-                 * subscriberList */
-                notifyEventToSubscriber(
-                        AGPS_EVENT_UNSUBSCRIBE, mCurrentSubscriber, true);
-            }
+void AgpsStateMachine::onUnsubscribeWhenReleased(){
 
-            /* If no subscribers in list, release data connection */
-            if (mSubscriberList.empty()) {
-                transitionState(AGPS_STATE_RELEASED);
-                requestOrReleaseDataConn(false);
-            }
-            /* Some subscribers in list, but all inactive;
-             * Release data connection */
-            else if(!anyActiveSubscribers()) {
-                transitionState(AGPS_STATE_RELEASING);
-                requestOrReleaseDataConn(false);
-            }
-            break;
+    notifyEventToSubscriber(
+            AGPS_EVENT_UNSUBSCRIBE, mCurrentSubscriber, false);
+}
 
-        case AGPS_STATE_RELEASING:
-            /* If the subscriber wishes to wait for connection close,
-             * before being removed from list, move to inactive state
-             * and notify */
-            if (mCurrentSubscriber->mWaitForCloseComplete) {
-                mCurrentSubscriber->mIsInactive = true;
-            }
-            else {
-                /* Notify only current subscriber and then delete it from
-                 * subscriberList */
-                notifyEventToSubscriber(
-                        AGPS_EVENT_UNSUBSCRIBE, mCurrentSubscriber, true);
-            }
+void AgpsStateMachine::onUnsubscribeWhenConnected(){
 
-            /* If no subscribers in list, just move the state.
-             * Request for releasing data connection should already have been
-             * sent */
-            if (mSubscriberList.empty()) {
-                transitionState(AGPS_STATE_RELEASED);
-            }
-            break;
+    unsubscribeCurrent();
 
-        default:
-            LOC_LOGE("Invalid state: %d", mState);
+    /* If no subscribers in list, release data connection */
+    if (mSubscribers.empty()) {
+        transitionState(AGPS_STATE_RELEASED);
+        requestOrReleaseDataConn(false);
+    }
+    /* Some subscribers in list, but all inactive;
+     * Release data connection */
+    else if(!anyActiveSubscribers()) {
+        transitionState(AGPS_STATE_RELEASING);
+        requestOrReleaseDataConn(false);
     }
 }
 
-void AgpsStateMachine::processAgpsEventGranted(){
-
-    switch (mState) {
+void AgpsStateMachine::onUnsubscribeWhenReleasing(){
 
-        case AGPS_STATE_RELEASED:
-        case AGPS_STATE_ACQUIRED:
-        case AGPS_STATE_RELEASING:
-            LOC_LOGE("Unexpected event GRANTED in state %d", mState);
-            break;
-
-        case AGPS_STATE_PENDING:
-            // Move to acquired state
-            transitionState(AGPS_STATE_ACQUIRED);
-            notifyAllSubscribers(
-                    AGPS_EVENT_GRANTED, false,
-                    AGPS_NOTIFICATION_TYPE_FOR_ACTIVE_SUBSCRIBERS);
-            break;
+    unsubscribeCurrent();
 
-        default:
-            LOC_LOGE("Invalid state: %d", mState);
+    /* If no subscribers in list, just move the state.
+     * Request for releasing data connection should already have been
+     * sent */
+    if (mSubscribers.empty()) {
+        transitionState(AGPS_STATE_RELEASED);
     }
 }
 
-void AgpsStateMachine::processAgpsEventReleased(){
+void AgpsStateMachine::unsubscribeCurrent(){
 
-    switch (mState) {
+    /* If the subscriber wishes to wait for connection close,
+     * before being removed from list, move to inactive state
+     * and notify */
+    if (mCurrentSubscriber->mWaitForCloseComplete) {
+        setSubscriberInactive(mCurrentSubscriber);
+    }
+    else {
+        /* Notify only current subscriber and then delete it from
+         * subscriberList */
+        notifyEventToSubscriber(
+                AGPS_EVENT_UNSUBSCRIBE, mCurrentSubscriber, true);
+        mCurrentSubscriber = NULL;
+    }
+}
 
-        case AGPS_STATE_RELEASED:
-            /* Subscriber list should be empty if we are in released state */
-            if (!mSubscriberList.empty()) {
-                LOC_LOGE("Unexpected event RELEASED in RELEASED state");
-            }
-            break;
+void AgpsStateMachine::onGrantedWhenPending(){
 
-        case AGPS_STATE_ACQUIRED:
-            /* Force release received */
-            LOC_LOGW("Force RELEASED event in ACQUIRED state");
-            transitionState(AGPS_STATE_RELEASED);
-            notifyAllSubscribers(
-                    AGPS_EVENT_RELEASED, true,
-                    AGPS_NOTIFICATION_TYPE_FOR_ALL_SUBSCRIBERS);
-            break;
+    // Move to acquired state
+    transitionState(AGPS_STATE_ACQUIRED);
+    notifyAllSubscribers(
+            AGPS_EVENT_GRANTED, false,
+            AGPS_NOTIFICATION_TYPE_FOR_ACTIVE_SUBSCRIBERS);
+}
 
-        case AGPS_STATE_RELEASING:
-            /* Notify all inactive subscribers about the event */
-            notifyAllSubscribers(
-                    AGPS_EVENT_RELEASED, true,
-                    AGPS_NOTIFICATION_TYPE_FOR_INACTIVE_SUBSCRIBERS);
-
-            /* If we have active subscribers now, they must be waiting for
-             * data conn setup */
-            if (anyActiveSubscribers()) {
-                transitionState(AGPS_STATE_PENDING);
-                requestOrReleaseDataConn(true);
-            }
-            /* No active subscribers, move to released state */
-            else {
-                transitionState(AGPS_STATE_RELEASED);
-            }
-            break;
+void AgpsStateMachine::onReleasedWhenReleased(){
 
-        case AGPS_STATE_PENDING:
-            /* NOOP */
-            break;
-
-        default:
-            LOC_LOGE("Invalid state: %d", mState);
+    /* Subscriber list should be empty if we are in released state */
+    if (!mSubscribers.empty()) {
+        LOC_LOGE("Unexpected event RELEASED in RELEASED state");
     }
 }
 
-void AgpsStateMachine::processAgpsEventDenied(){
+void AgpsStateMachine::onReleasedWhenAcquired(){
 
-    switch (mState) {
+    /* Force release received */
+    LOC_LOGW("Force RELEASED event in ACQUIRED state");
+    transitionState(AGPS_STATE_RELEASED);
+    notifyAllSubscribers(
+            AGPS_EVENT_RELEASED, true,
+            AGPS_NOTIFICATION_TYPE_FOR_ALL_SUBSCRIBERS);
+}
 
-        case AGPS_STATE_RELEASED:
-            LOC_LOGE("Unexpected event DENIED in state %d", mState);
-            break;
+/* RELEASED or DENIED while releasing: the data call is closed either way */
+void AgpsStateMachine::onClosedWhenReleasing(){
 
-        case AGPS_STATE_ACQUIRED:
-            /* NOOP */
-            break;
+    /* Notify all inactive subscribers about the event */
+    notifyAllSubscribers(
+            AGPS_EVENT_RELEASED, true,
+            AGPS_NOTIFICATION_TYPE_FOR_INACTIVE_SUBSCRIBERS);
 
-        case AGPS_STATE_RELEASING:
-            /* Notify all inactive subscribers about the event */
-            notifyAllSubscribers(
-                    AGPS_EVENT_RELEASED, true,
-                    AGPS_NOTIFICATION_TYPE_FOR_INACTIVE_SUBSCRIBERS);
-
-            /* If we have active subscribers now, they must be waiting for
-             * data conn setup */
-            if (anyActiveSubscribers()) {
-                transitionState(AGPS_STATE_PENDING);
-                requestOrReleaseDataConn(true);
-            }
-            /* No active subscribers, move to released state */
-            else {
-                transitionState(AGPS_STATE_RELEASED);
-            }
-            break;
+    /* If we have active subscribers now, they must be waiting for
+     * data conn setup */
+    if (anyActiveSubscribers()) {
+        transitionState(AGPS_STATE_PENDING);
+        requestOrReleaseDataConn(true);
+    }
+    /* No active subscribers, move to released state */
+    else {
+        transitionState(AGPS_STATE_RELEASED);
+    }
+}
 
-        case AGPS_STATE_PENDING:
-            transitionState(AGPS_STATE_RELEASED);
-            notifyAllSubscribers(
-                    AGPS_EVENT_DENIED, true,
-                    AGPS_NOTIFICATION_TYPE_FOR_ALL_SUBSCRIBERS);
-            break;
+void AgpsStateMachine::onDeniedWhenPending(){
 
-        default:
-            LOC_LOGE("Invalid state: %d", mState);
-    }
+    transitionState(AGPS_STATE_RELEASED);
+    notifyAllSubscribers(
+            AGPS_EVENT_DENIED, true,
+            AGPS_NOTIFICATION_TYPE_FOR_ALL_SUBSCRIBERS);
 }
 
 /* Request or Release data connection
@@ -315,29 +269,22 @@ void AgpsStateMachine::notifyAllSubscribers(
             "SM %p, Event %d Delete %d Notification Type %d",
             this, event, deleteSubscriberPostNotify, notificationType);
 
-    std::list<AgpsSubscriber*>::const_iterator it = mSubscriberList.begin();
-    while ( it != mSubscriberList.end() ) {
-
-        AgpsSubscriber* subscriber = *it;
-
+    /* Snapshot the handles first, deleting swaps slab slots around */
+    mNotifyHandles.clear();
+    for (const AgpsSubscriber& subscriber : mSubscribers) {
         if (notificationType == AGPS_NOTIFICATION_TYPE_FOR_ALL_SUBSCRIBERS ||
                 (notificationType == AGPS_NOTIFICATION_TYPE_FOR_INACTIVE_SUBSCRIBERS &&
-                        subscriber->mIsInactive) ||
+                        subscriber.mIsInactive) ||
                 (notificationType == AGPS_NOTIFICATION_TYPE_FOR_ACTIVE_SUBSCRIBERS &&
-                        !subscriber->mIsInactive)) {
-
-            /* Deleting via this call would require another traversal
-             * through subscriber list, inefficient; hence pass in false*/
-            notifyEventToSubscriber(event, subscriber, false);
+                        !subscriber.mIsInactive)) {
+            mNotifyHandles.push_back(subscriber.mConnHandle);
+        }
+    }
 
-            if (deleteSubscriberPostNotify) {
-                it = mSubscriberList.erase(it);
-                delete subscriber;
-            } else {
-                it++;
-            }
-        } else {
-            it++;
+    for (int connHandle : mNotifyHandles) {
+        AgpsSubscriber* subscriber = getSubscriber(connHandle);
+        if (NULL != subscriber) {
+            notifyEventToSubscriber(event, subscriber, deleteSubscriberPostNotify);
         }
     }
 }
@@ -396,18 +343,18 @@ void AgpsStateMachine::addSubscriber(AgpsSubscriber* subscriberToAdd){
 
     // Check if subscriber is already present in the current list
     // If not, then add
-    std::list<AgpsSubscriber*>::const_iterator it = mSubscriberList.begin();
-    for (; it != mSubscriberList.end(); it++) {
-        AgpsSubscriber* subscriber = *it;
-        if (subscriber->equals(subscriberToAdd)) {
-            LOC_LOGE("Subscriber already in list");
-            return;
-        }
+    auto result = mSubscriberIndex.emplace(
+            subscriberToAdd->mConnHandle, mSubscribers.size());
+    if (!result.second) {
+        LOC_LOGE("Subscriber already in list");
+        return;
     }
 
-    AgpsSubscriber* cloned = subscriberToAdd->clone();
-    LOC_LOGD("addSubscriber(): cloned subscriber: %p", cloned);
-    mSubscriberList.push_back(cloned);
+    mSubscribers.push_back(*subscriberToAdd);
+    if (!subscriberToAdd->mIsInactive) {
+        mActiveSubscriberCount++;
+    }
+    LOC_LOGD("addSubscriber(): slot %zu", mSubscribers.size() - 1);
 }
 
 void AgpsStateMachine::deleteSubscriber(AgpsSubscriber* subscriberToDelete){
@@ -415,30 +362,39 @@ void AgpsStateMachine::deleteSubscriber(AgpsSubscriber* subscriberToDelete){
     LOC_LOGD("deleteSubscriber(): SM %p, Subscriber %p",
                this, subscriberToDelete);
 
-    std::list<AgpsSubscriber*>::const_iterator it = mSubscriberList.begin();
-    while ( it != mSubscriberList.end() ) {
+    auto it = mSubscriberIndex.find(subscriberToDelete->mConnHandle);
+    if (it == mSubscriberIndex.end()) {
+        return;
+    }
 
-        AgpsSubscriber* subscriber = *it;
-        if (subscriber && subscriber->equals(subscriberToDelete)) {
+    size_t slot = it->second;
+    mSubscriberIndex.erase(it);
+    if (!mSubscribers[slot].mIsInactive) {
+        mActiveSubscriberCount--;
+    }
 
-            it = mSubscriberList.erase(it);
-            delete subscriber;
-        } else {
-            it++;
-        }
+    /* Move the last subscriber into the freed slot */
+    size_t last = mSubscribers.size() - 1;
+    if (slot != last) {
+        mSubscribers[slot] = mSubscribers[last];
+        mSubscriberIndex[mSubscribers[slot].mConnHandle] = slot;
     }
+    mSubscribers.pop_back();
 }
 
-bool AgpsStateMachine::anyActiveSubscribers(){
+void AgpsStateMachine::setSubscriberInactive(AgpsSubscriber* subscriber){
 
-    std::list<AgpsSubscriber*>::const_iterator it = mSubscriberList.begin();
-    for (; it != mSubscriberList.end(); it++) {
-        AgpsSubscriber* subscriber = *it;
-        if (!subscriber->mIsInactive) {
-            return true;
+    if (!subscriber->mIsInactive) {
+        subscriber->mIsInactive = true;
+        if (mSubscriberIndex.find(subscriber->mConnHandle) != mSubscriberIndex.end()) {
+            mActiveSubscriberCount--;
         }
     }
-    return false;
+}
+
+bool AgpsStateMachine::anyActiveSubscribers(){
+
+    return mActiveSubscriberCount > 0;
 }
 
 void AgpsStateMachine::setAPN(char* apn, unsigned int len){
@@ -464,13 +420,9 @@ void AgpsStateMachine::setAPN(char* apn, unsigned int len){
 
 AgpsSubscriber* AgpsStateMachine::getSubscriber(int connHandle){
 
-    /* Go over the subscriber list */
-    std::list<AgpsSubscriber*>::const_iterator it = mSubscriberList.begin();
-    for (; it != mSubscriberList.end(); it++) {
-        AgpsSubscriber* subscriber = *it;
-        if (subscriber->mConnHandle == connHandle) {
-            return subscriber;
-        }
+    auto it = mSubscriberIndex.find(connHandle);
+    if (it != mSubscriberIndex.end()) {
+        return &mSubscribers[it->second];
     }
 
     /* Not found, return NULL */
@@ -479,12 +431,10 @@ AgpsSubscriber* AgpsStateMachine::getSubscriber(int connHandle){
 
 AgpsSubscriber* AgpsStateMachine::getFirstSubscriber(bool isInactive){
 
-    /* Go over the subscriber list */
-    std::list<AgpsSubscriber*>::const_iterator it = mSubscriberList.begin();
-    for (; it != mSubscriberList.end(); it++) {
-        AgpsSubscriber* subscriber = *it;
-        if(subscriber->mIsInactive == isInactive) {
-            return subscriber;
+    /* Go over the subscriber slab */
+    for (AgpsSubscriber& subscriber : mSubscribers) {
+        if(subscriber.mIsInactive == isInactive) {
+            return &subscriber;
         }
     }
 
@@ -496,13 +446,9 @@ void AgpsStateMachine::dropAllSubscribers(){
 
     LOC_LOGD("dropAllSubscribers(): SM %p", this);
 
-    /* Go over the subscriber list */
-    std::list<AgpsSubscriber*>::const_iterator it = mSubscriberList.begin();
-    while ( it != mSubscriberList.end() ) {
-        AgpsSubscriber* subscriber = *it;
-        it = mSubscriberList.erase(it);
-        delete subscriber;
-    }
+    mSubscribers.clear();
+    mSubscriberIndex.clear();
+    mActiveSubscriberCount = 0;
 }
 
 /* --------------------------------------------------------------------
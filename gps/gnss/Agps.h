@@ -31,7 +31,8 @@
 #define AGPS_H
 
 #include <functional>
-#include <list>
+#include <unordered_map>
+#include <vector>
 #include <MsgTask.h>
 #include <gps_extended_c.h>
 #include <loc_pla.h>
@@ -55,7 +56,8 @@ typedef enum {
     AGPS_STATE_RELEASED,
     AGPS_STATE_PENDING,
     AGPS_STATE_ACQUIRED,
-    AGPS_STATE_RELEASING
+    AGPS_STATE_RELEASING,
+    AGPS_STATE_MAX
 } AgpsState;
 
 typedef enum {
@@ -64,9 +66,14 @@ typedef enum {
     AGPS_EVENT_UNSUBSCRIBE,
     AGPS_EVENT_GRANTED,
     AGPS_EVENT_RELEASED,
-    AGPS_EVENT_DENIED
+    AGPS_EVENT_DENIED,
+    AGPS_EVENT_MAX
 } AgpsEvent;
 
+/* Subscriber slots reserved up front per state machine; the slab only grows
+ * beyond this when more ATL handles are open at once */
+#define AGPS_SUBSCRIBER_SLAB_SIZE 8
+
 /* Notification Types sent to subscribers */
 typedef enum {
     AGPS_NOTIFICATION_TYPE_INVALID = 0,
@@ -125,10 +132,16 @@ protected:
     /* AGPS Manager instance, from where this state machine is created */
     AgpsManager* mAgpsManager;
 
-    /* List of all subscribers for this State Machine.
+    /* Slab of all subscribers for this State Machine, indexed by
+     * mSubscriberIndex on conn handle. Removal swaps the last slot in.
      * Once a subscriber is notified for ATL open/close status,
      * it is deleted */
-    std::list<AgpsSubscriber*> mSubscriberList;
+    std::vector<AgpsSubscriber> mSubscribers;
+    std::unordered_map<int, size_t> mSubscriberIndex;
+    size_t mActiveSubscriberCount;
+
+    /* Conn handles to notify, reused across notifications */
+    std::vector<int> mNotifyHandles;
 
     /* Current subscriber, whose request this State Machine is
      * currently processing */
@@ -155,11 +168,16 @@ private:
 public:
     /* CONSTRUCTOR */
     AgpsStateMachine(AgpsManager* agpsManager, AGpsExtType agpsType):
-        mFrameworkStatusV4Cb(NULL),
-        mAgpsManager(agpsManager), mSubscriberList(),
+        mAgpsManager(agpsManager), mSubscribers(), mSubscriberIndex(),
+        mActiveSubscriberCount(0), mNotifyHandles(),
         mCurrentSubscriber(NULL), mState(AGPS_STATE_RELEASED),
+        mFrameworkStatusV4Cb(NULL),
         mAgpsType(agpsType), mAPN(NULL), mAPNLen(0),
-        mBearer(AGPS_APN_BEARER_INVALID) {};
+        mBearer(AGPS_APN_BEARER_INVALID) {
+        mSubscribers.reserve(AGPS_SUBSCRIBER_SLAB_SIZE);
+        mSubscriberIndex.reserve(AGPS_SUBSCRIBER_SLAB_SIZE);
+        mNotifyHandles.reserve(AGPS_SUBSCRIBER_SLAB_SIZE);
+    };
 
     virtual ~AgpsStateMachine() { if(NULL != mAPN) delete[] mAPN; };
 
@@ -184,6 +202,9 @@ public:
     /* Fetch subscriber with specified handle */
     AgpsSubscriber* getSubscriber(int connHandle);
 
+    /* Number of subscribers currently held */
+    inline size_t getSubscriberCount() const { return mSubscribers.size(); }
+
     /* Fetch first active or inactive subscriber in list
      * isInactive = true : fetch first inactive subscriber
      * isInactive = false : fetch first active subscriber */
@@ -207,12 +228,30 @@ private:
      * sendRsrcRequest(LOC_GPS_RELEASE_AGPS_DATA_CONN) */
     void requestOrReleaseDataConn(bool request);
 
-    /* Individual event processing methods */
-    void processAgpsEventSubscribe();
-    void processAgpsEventUnsubscribe();
-    void processAgpsEventGranted();
-    void processAgpsEventReleased();
-    void processAgpsEventDenied();
+    /* Event handlers, dispatched through sTransitionTable by state and event */
+    typedef void (AgpsStateMachine::*EventHandler)();
+    static const EventHandler sTransitionTable[AGPS_STATE_MAX][AGPS_EVENT_MAX];
+
+    void onInvalidEvent();
+    void onIgnoredEvent();
+    void onSubscribeWhenReleased();
+    void onSubscribeWhenWaiting();
+    void onSubscribeWhenAcquired();
+    void onUnsubscribeWhenReleased();
+    void onUnsubscribeWhenConnected();
+    void onUnsubscribeWhenReleasing();
+    void onGrantedWhenPending();
+    void onReleasedWhenReleased();
+    void onReleasedWhenAcquired();
+    void onClosedWhenReleasing();
+    void onDeniedWhenPending();
+
+    /* Unsubscribe the current subscriber, either deactivating it until the
+     * data call is closed or notifying and deleting it right away */
+    void unsubscribeCurrent();
+
+    /* Mark subscriber inactive, keeping the active count in step */
+    void setSubscriberInactive(AgpsSubscriber* subscriber);
 
     /* Clone the passed in subscriber and add to the subscriber list
      * if not already present */
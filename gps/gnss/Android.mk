@@ -21,7 +21,12 @@ LOCAL_SRC_FILES += \
     location_gnss.cpp \
     GnssAdapter.cpp \
     Agps.cpp \
-    XtraSystemStatusObserver.cpp
+    XtraSystemStatusObserver.cpp \
+    GnssMeasurementStream.cpp \
+    GnssSvStatusFilter.cpp \
+    OdcpiCache.cpp \
+    GnssDebugSnapshot.cpp \
+    GnssPowerPolicy.cpp
 
 LOCAL_CFLAGS += \
      -fno-short-enums \
@@ -39,3 +44,97 @@ LOCAL_HEADER_LIBRARIES := \
 LOCAL_CFLAGS += $(GNSS_CFLAGS)
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := libgnss-agps-test
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_SHARED_LIBRARIES := \
+    libutils \
+    libcutils \
+    liblog \
+    libloc_core \
+    libgps.utils
+
+LOCAL_SRC_FILES := \
+    tests/AgpsStateMachineTest.cpp \
+    Agps.cpp
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)
+
+LOCAL_CFLAGS += \
+     -fno-short-enums \
+
+LOCAL_HEADER_LIBRARIES := \
+    libgps.utils_headers \
+    libloc_core_headers \
+    libloc_pla_headers \
+    liblocation_api_headers
+
+LOCAL_CFLAGS += $(GNSS_CFLAGS)
+
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := libgnss-measurement-stream-test
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_SHARED_LIBRARIES := \
+    libutils \
+    libcutils \
+    liblog \
+    libgps.utils
+
+LOCAL_SRC_FILES := \
+    tests/GnssMeasurementStreamTest.cpp \
+    GnssMeasurementStream.cpp
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)
+
+LOCAL_CFLAGS += \
+     -fno-short-enums \
+
+LOCAL_HEADER_LIBRARIES := \
+    libgps.utils_headers \
+    libloc_pla_headers \
+    liblocation_api_headers
+
+LOCAL_CFLAGS += $(GNSS_CFLAGS)
+
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := libgnss-power-policy-test
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_SHARED_LIBRARIES := \
+    libutils \
+    libcutils \
+    liblog \
+    libloc_core \
+    libgps.utils
+
+LOCAL_SRC_FILES := \
+    tests/GnssPowerPolicyTest.cpp \
+    GnssPowerPolicy.cpp
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)
+
+LOCAL_CFLAGS += \
+     -fno-short-enums \
+
+LOCAL_HEADER_LIBRARIES := \
+    libgps.utils_headers \
+    libloc_core_headers \
+    libloc_pla_headers \
+    liblocation_api_headers
+
+LOCAL_CFLAGS += $(GNSS_CFLAGS)
+
+include $(BUILD_NATIVE_TEST)
@@ -45,14 +45,14 @@
 #include <loc_nmea.h>
 #include <Agps.h>
 #include <SystemStatus.h>
+#include <LocDlRegistry.h>
 
 #include <vector>
 
-#define RAD2DEG    (180.0 / M_PI)
-#define PROCESS_NAME_ENGINE_SERVICE "engine-service"
 #define MIN_TRACKING_INTERVAL (100) // 100 msec
 
 using namespace loc_core;
+using namespace loc_util;
 
 /* Method to fetch status cb from loc_net_iface library */
 typedef AgpsCbInfo& (*LocAgpsGetAgpsCbInfo)(LocAgpsOpenResultCb openResultCb,
@@ -84,7 +84,16 @@ GnssAdapter::GnssAdapter() :
     mOdcpiRequestActive(false),
     mOdcpiTimer(this),
     mOdcpiRequest(),
+    mOdcpiCache(),
     mSystemStatus(SystemStatus::getInstance(mMsgTask)),
+    mDebugSnapshot(),
+    mPowerPolicy(mSystemStatus->getOsObserver(), mMsgTask,
+                 [this]() { applyPowerPolicy(); },
+                 [this]() {
+                     if (!mTimeBasedTrackingSessions.empty()) {
+                         mLocApi->getGnssEnergyConsumed();
+                     }
+                 }),
     mServerUrl(":"),
     mXtraObserver(mSystemStatus->getOsObserver(), mMsgTask),
     mLocSystemInfo{},
@@ -650,6 +659,7 @@ GnssAdapter::readConfigCommand()
                 UTIL_READ_CONF(LOC_PATH_FLP_CONF, flp_conf_param_table);
                 LOC_LOGd("allowFlpNetworkFixes %u", allowFlpNetworkFixes);
                 mAdapter->setAllowFlpNetworkFixes(allowFlpNetworkFixes);
+                mAdapter->mPowerPolicy.init();
             }
         }
     };
@@ -1633,6 +1643,76 @@ GnssAdapter::gnssUpdateSvTypeConfigCommand(GnssSvTypeConfig config)
     sendMsg(new MsgGnssUpdateSvTypeConfig(this, mLocApi, config));
 }
 
+void
+GnssAdapter::gnssUpdateMeasurementStreamConfigCommand(LocationAPI* client,
+        const GnssMeasurementStreamConfig& config)
+{
+    struct MsgGnssUpdateMeasurementStreamConfig : public LocMsg {
+        GnssAdapter& mAdapter;
+        LocationAPI* mClient;
+        GnssMeasurementStreamConfig mConfig;
+        inline MsgGnssUpdateMeasurementStreamConfig(GnssAdapter& adapter,
+                LocationAPI* client,
+                const GnssMeasurementStreamConfig& config) :
+            LocMsg(),
+            mAdapter(adapter),
+            mClient(client),
+            mConfig(config) {}
+        inline virtual void proc() const {
+            if (mAdapter.mClientData.end() == mAdapter.mClientData.find(mClient)) {
+                LOC_LOGE("%s]: client %p not found", __func__, mClient);
+            } else if (GnssMeasurementStream::isPassThrough(mConfig)) {
+                mAdapter.mMeasurementStreams.erase(mClient);
+            } else if ((mConfig.flags & GNSS_MEASUREMENT_STREAM_DELTA_ENCODED_BIT) &&
+                       nullptr == mConfig.deltaCb) {
+                LOC_LOGE("%s]: delta encoding requested without deltaCb", __func__);
+            } else {
+                LOC_LOGD("%s]: client %p flags 0x%x interval %u svTypes 0x%x codeTypes 0x%x",
+                         __func__, mClient, mConfig.flags, mConfig.minIntervalMs,
+                         mConfig.svTypeMask, mConfig.codeTypeMask);
+                // a new stream starts over with a key frame
+                mAdapter.mMeasurementStreams[mClient].reset(
+                        new GnssMeasurementStream(mConfig));
+            }
+        }
+    };
+
+    sendMsg(new MsgGnssUpdateMeasurementStreamConfig(*this, client, config));
+}
+
+void
+GnssAdapter::gnssUpdateSvStatusConfigCommand(LocationAPI* client,
+        const GnssSvStatusConfig& config)
+{
+    struct MsgGnssUpdateSvStatusConfig : public LocMsg {
+        GnssAdapter& mAdapter;
+        LocationAPI* mClient;
+        GnssSvStatusConfig mConfig;
+        inline MsgGnssUpdateSvStatusConfig(GnssAdapter& adapter,
+                LocationAPI* client,
+                const GnssSvStatusConfig& config) :
+            LocMsg(),
+            mAdapter(adapter),
+            mClient(client),
+            mConfig(config) {}
+        inline virtual void proc() const {
+            if (mAdapter.mClientData.end() == mAdapter.mClientData.find(mClient)) {
+                LOC_LOGE("%s]: client %p not found", __func__, mClient);
+            } else if (GnssSvStatusFilter::isPassThrough(mConfig)) {
+                mAdapter.mSvStatusFilters.erase(mClient);
+            } else {
+                LOC_LOGD("%s]: client %p flags 0x%x interval %u cn0 %.1f angle %.1f",
+                         __func__, mClient, mConfig.flags, mConfig.minIntervalMs,
+                         mConfig.cN0ThresholdDbhz, mConfig.angleThresholdDeg);
+                // a new filter starts over with the full SV list
+                mAdapter.mSvStatusFilters[mClient].reset(new GnssSvStatusFilter(mConfig));
+            }
+        }
+    };
+
+    sendMsg(new MsgGnssUpdateSvStatusConfig(*this, client, config));
+}
+
 void
 GnssAdapter::gnssSvTypeConfigUpdate(const GnssSvTypeConfig& config)
 {
@@ -2023,6 +2103,9 @@ GnssAdapter::stopClientSessions(LocationAPI* client)
 {
     LOC_LOGD("%s]: client %p", __func__, client);
 
+    mMeasurementStreams.erase(client);
+    mSvStatusFilters.erase(client);
+
     /* Time-based Tracking */
     std::vector<LocationSessionKey> vTimeBasedTrackingClient;
     for (auto it : mTimeBasedTrackingSessions) {
@@ -2150,6 +2233,35 @@ GnssAdapter::restartSessions()
     // odcpi session is no longer active after restart
     mOdcpiRequestActive = false;
 
+    restartTimeBasedTracking();
+
+    for (auto it = mDistanceBasedTrackingSessions.begin();
+              it != mDistanceBasedTrackingSessions.end(); ++it) {
+        mLocApi->startDistanceBasedTracking(it->first.id, it->second,
+                                            new LocApiResponse(*getContext(),
+                                            [] (LocationError /*err*/) {}));
+    }
+}
+
+void
+GnssAdapter::adaptTrackingOptions(TrackingOptions& options)
+{
+    // emergency sessions always run at the requested rate
+    if (!getE911State()) {
+        mPowerPolicy.adaptTrackingOptions(options);
+    }
+}
+
+void
+GnssAdapter::applyPowerPolicy()
+{
+    LOC_LOGD("%s]: ", __func__);
+    restartTimeBasedTracking();
+}
+
+void
+GnssAdapter::restartTimeBasedTracking()
+{
     if (!mTimeBasedTrackingSessions.empty()) {
         // get the LocationOptions that has the smallest interval, which should be the active one
         TrackingOptions smallestIntervalOptions; // size is zero until set for the first time
@@ -2172,15 +2284,9 @@ GnssAdapter::restartSessions()
         }
 
         highestPowerTrackingOptions.setLocationOptions(smallestIntervalOptions);
+        adaptTrackingOptions(highestPowerTrackingOptions);
         mLocApi->startTimeBasedTracking(highestPowerTrackingOptions, nullptr);
     }
-
-    for (auto it = mDistanceBasedTrackingSessions.begin();
-              it != mDistanceBasedTrackingSessions.end(); ++it) {
-        mLocApi->startDistanceBasedTracking(it->first.id, it->second,
-                                            new LocApiResponse(*getContext(),
-                                            [] (LocationError /*err*/) {}));
-    }
 }
 
 void
@@ -2506,11 +2612,14 @@ GnssAdapter::startTimeBasedTrackingMultiplex(LocationAPI* client, uint32_t sessi
 
 void
 GnssAdapter::startTimeBasedTracking(LocationAPI* client, uint32_t sessionId,
-        const TrackingOptions& trackingOptions)
+        const TrackingOptions& requestedOptions)
 {
     LOC_LOGd("minInterval %u minDistance %u mode %u powermode %u tbm %u",
-            trackingOptions.minInterval, trackingOptions.minDistance,
-            trackingOptions.mode, trackingOptions.powerMode, trackingOptions.tbm);
+            requestedOptions.minInterval, requestedOptions.minDistance,
+            requestedOptions.mode, requestedOptions.powerMode, requestedOptions.tbm);
+
+    TrackingOptions trackingOptions = requestedOptions;
+    adaptTrackingOptions(trackingOptions);
 
     LocPosMode locPosMode = {};
     convertOptions(locPosMode, trackingOptions);
@@ -2518,11 +2627,15 @@ GnssAdapter::startTimeBasedTracking(LocationAPI* client, uint32_t sessionId,
     // inform engine hub that GNSS session is about to start
     mEngHubProxy->gnssSetFixMode(locPosMode);
     mEngHubProxy->gnssStartFix();
+    mPowerPolicy.onTrackingStateChanged(true);
 
     mLocApi->startTimeBasedTracking(trackingOptions, new LocApiResponse(*getContext(),
                       [this, client, sessionId] (LocationError err) {
             if (LOCATION_ERROR_SUCCESS != err) {
                 eraseTrackingSession(client, sessionId);
+                if (mTimeBasedTrackingSessions.empty()) {
+                    mPowerPolicy.onTrackingStateChanged(false);
+                }
             }
 
             reportResponse(client, err, sessionId);
@@ -2532,14 +2645,18 @@ GnssAdapter::startTimeBasedTracking(LocationAPI* client, uint32_t sessionId,
 
 void
 GnssAdapter::updateTracking(LocationAPI* client, uint32_t sessionId,
-        const TrackingOptions& updatedOptions, const TrackingOptions& oldOptions)
+        const TrackingOptions& requestedOptions, const TrackingOptions& oldOptions)
 {
+    TrackingOptions updatedOptions = requestedOptions;
+    adaptTrackingOptions(updatedOptions);
+
     LocPosMode locPosMode = {};
     convertOptions(locPosMode, updatedOptions);
 
     // inform engine hub that GNSS session is about to start
     mEngHubProxy->gnssSetFixMode(locPosMode);
     mEngHubProxy->gnssStartFix();
+    mPowerPolicy.onTrackingStateChanged(true);
 
     mLocApi->startTimeBasedTracking(updatedOptions, new LocApiResponse(*getContext(),
                       [this, client, sessionId, oldOptions] (LocationError err) {
@@ -2846,6 +2963,7 @@ GnssAdapter::stopTracking(LocationAPI* client, uint32_t id)
 {
     // inform engine hub that GNSS session has stopped
     mEngHubProxy->gnssStopFix();
+    mPowerPolicy.onTrackingStateChanged(false);
 
     mLocApi->stopFix(new LocApiResponse(*getContext(),
                      [this, client, id] (LocationError err) {
@@ -3123,6 +3241,7 @@ GnssAdapter::reportPositionEvent(const UlpLocation& ulpLocation,
             if ((nullptr != s) &&
                     ((LOC_SESS_SUCCESS == mStatus) || (LOC_SESS_INTERMEDIATE == mStatus))){
                 s->eventPosition(mUlpLocation, mLocationExtended);
+                mAdapter.mDebugSnapshot.updateLocation(mUlpLocation, mLocationExtended);
             }
             mAdapter.reportPosition(mUlpLocation, mLocationExtended, mStatus, mTechMask);
             if (true == mbIsDataValid) {
@@ -3216,6 +3335,10 @@ GnssAdapter::reportPosition(const UlpLocation& ulpLocation,
     bool reportToGnssClient = needReportForGnssClient(ulpLocation, status, techMask);
     bool reportToFlpClient = needReportForFlpClient(status, techMask);
 
+    if (reportToGnssClient && LOC_SESS_SUCCESS == status) {
+        mPowerPolicy.onFixReported(uptimeMillis());
+    }
+
     if (reportToGnssClient || reportToFlpClient) {
         GnssLocationInfoNotification locationInfo = {};
         convertLocationInfo(locationInfo, locationExtended);
@@ -3265,7 +3388,7 @@ GnssAdapter::reportPosition(const UlpLocation& ulpLocation,
     }
 
     if (NMEA_PROVIDER_AP == ContextBase::mGps_conf.NMEA_PROVIDER &&
-        !mTimeBasedTrackingSessions.empty()) {
+        !mTimeBasedTrackingSessions.empty() && mPowerPolicy.current().nmeaEnabled) {
         /*Only BlankNMEA sentence needs to be processed and sent, if both lat, long is 0 &
           horReliability is not set. */
         bool blank_fix = ((0 == ulpLocation.gpsLocation.latitude) &&
@@ -3490,14 +3613,20 @@ GnssAdapter::reportSv(GnssSvNotification& svNotify)
         }
     }
 
+    int64_t nowMs = mSvStatusFilters.empty() ? 0 : uptimeMillis();
     for (auto it=mClientData.begin(); it != mClientData.end(); ++it) {
         if (nullptr != it->second.gnssSvCb) {
-            it->second.gnssSvCb(svNotify);
+            auto filter = mSvStatusFilters.find(it->first);
+            if (mSvStatusFilters.end() != filter) {
+                filter->second->report(svNotify, nowMs, it->second.gnssSvCb);
+            } else {
+                it->second.gnssSvCb(svNotify);
+            }
         }
     }
 
     if (NMEA_PROVIDER_AP == ContextBase::mGps_conf.NMEA_PROVIDER &&
-        !mTimeBasedTrackingSessions.empty()) {
+        !mTimeBasedTrackingSessions.empty() && mPowerPolicy.current().nmeaEnabled) {
         std::vector<std::string> nmeaArraystr;
         loc_nmea_generate_sv(svNotify, nmeaArraystr);
         stringstream ss;
@@ -3546,6 +3675,9 @@ GnssAdapter::reportNmeaEvent(const char* nmea, size_t length)
             SystemStatus* s = mAdapter.getSystemStatus();
             if (nullptr != s) {
                 ret = s->setNmeaString(mNmea, mLength);
+                if (ret) {
+                    mAdapter.mDebugSnapshot.updateFromNmea(mNmea, *s);
+                }
             }
             if (false == ret) {
                 // forward NMEA message to upper layer
@@ -3560,6 +3692,10 @@ GnssAdapter::reportNmeaEvent(const char* nmea, size_t length)
 void
 GnssAdapter::reportNmea(const char* nmea, size_t length)
 {
+    if (!mPowerPolicy.current().nmeaEnabled) {
+        return;
+    }
+
     GnssNmeaNotification nmeaNotification = {};
     nmeaNotification.size = sizeof(GnssNmeaNotification);
 
@@ -3925,9 +4061,18 @@ GnssAdapter::reportGnssMeasurementsEvent(const GnssMeasurements& gnssMeasurement
 void
 GnssAdapter::reportGnssMeasurementData(const GnssMeasurementsNotification& measurements)
 {
+    if (!mPowerPolicy.allowMeasurementReport(uptimeMillis())) {
+        return;
+    }
+
     for (auto it=mClientData.begin(); it != mClientData.end(); ++it) {
         if (nullptr != it->second.gnssMeasurementsCb) {
-            it->second.gnssMeasurementsCb(measurements);
+            auto stream = mMeasurementStreams.find(it->first);
+            if (mMeasurementStreams.end() != stream) {
+                stream->second->report(measurements, it->second.gnssMeasurementsCb);
+            } else {
+                it->second.gnssMeasurementsCb(measurements);
+            }
         }
     }
 }
@@ -3977,8 +4122,17 @@ void GnssAdapter::requestOdcpi(const OdcpiRequestInfo& request)
         // so the mOdcpiTimer helps avoid spamming the framework as well as
         // extending the odcpi session past 30 seconds if needed
         if (ODCPI_REQUEST_TYPE_START == request.type) {
-            if (false == mOdcpiRequestActive && false == mOdcpiTimer.isActive()) {
+            mOdcpiCache.stats().requests++;
+            // a fresh enough cached fix answers the engine right away; emergency
+            // requests still go on to the framework for a new fix
+            if (injectCachedOdcpi() && false == request.isEmergencyMode) {
+                mOdcpiRequestActive = true;
+                if (false == mOdcpiTimer.isActive()) {
+                    mOdcpiTimer.start();
+                }
+            } else if (false == mOdcpiRequestActive && false == mOdcpiTimer.isActive()) {
                 mOdcpiRequestCb(request);
+                mOdcpiCache.stats().frameworkRequests++;
                 mOdcpiRequestActive = true;
                 mOdcpiTimer.start();
             // if the current active odcpi session is non-emergency, and the new
@@ -3987,6 +4141,7 @@ void GnssAdapter::requestOdcpi(const OdcpiRequestInfo& request)
             } else if (false == mOdcpiRequest.isEmergencyMode &&
                        true == request.isEmergencyMode) {
                 mOdcpiRequestCb(request);
+                mOdcpiCache.stats().frameworkRequests++;
                 mOdcpiRequestActive = true;
                 if (true == mOdcpiTimer.isActive()) {
                     mOdcpiTimer.restart();
@@ -3998,8 +4153,12 @@ void GnssAdapter::requestOdcpi(const OdcpiRequestInfo& request)
             // before requesting new ODCPI to avoid spamming ODCPI requests
             } else if (false == mOdcpiRequestActive && true == mOdcpiTimer.isActive()) {
                 mOdcpiRequestActive = true;
+                mOdcpiCache.stats().coalesced++;
+            } else {
+                mOdcpiCache.stats().coalesced++;
             }
             mOdcpiRequest = request;
+            mOdcpiCache.logStats();
         // the request is being stopped, but allow timer to expire first
         // before stopping the timer just in case more ODCPI requests come
         // to avoid spamming more odcpi requests to the framework
@@ -4084,9 +4243,24 @@ void GnssAdapter::injectOdcpi(const Location& location)
             mOdcpiRequestActive, mOdcpiTimer.isActive(),
             location.latitude, location.longitude);
 
+    mOdcpiCache.update(location);
     mLocApi->injectPosition(location, true);
 }
 
+bool GnssAdapter::injectCachedOdcpi()
+{
+    Location location;
+    if (!mOdcpiCache.get(location)) {
+        return false;
+    }
+
+    LOC_LOGd("ODCPI from cache: lat %.7f long %.7f accuracy %.1f",
+             location.latitude, location.longitude, location.accuracy);
+    mOdcpiCache.stats().cacheHits++;
+    mLocApi->injectPosition(location, true);
+    return true;
+}
+
 // Called in the context of LocTimer thread
 void OdcpiTimer::timeOutCallback()
 {
@@ -4117,7 +4291,10 @@ void GnssAdapter::odcpiTimerExpire()
     // if ODCPI request is still active after timer
     // expires, request again and restart timer
     if (mOdcpiRequestActive) {
-        mOdcpiRequestCb(mOdcpiRequest);
+        if (mOdcpiRequest.isEmergencyMode || !injectCachedOdcpi()) {
+            mOdcpiRequestCb(mOdcpiRequest);
+            mOdcpiCache.stats().frameworkRequests++;
+        }
         mOdcpiTimer.restart();
     } else {
         mOdcpiTimer.stop();
@@ -4126,6 +4303,7 @@ void GnssAdapter::odcpiTimerExpire()
 
 void
 GnssAdapter::invokeGnssEnergyConsumedCallback(uint64_t energyConsumedSinceFirstBoot) {
+    mPowerPolicy.onEnergyConsumed(energyConsumedSinceFirstBoot, uptimeMillis());
     if (mGnssEnergyConsumedCb) {
         mGnssEnergyConsumedCb(energyConsumedSinceFirstBoot);
         mGnssEnergyConsumedCb = nullptr;
@@ -4156,17 +4334,15 @@ GnssAdapter::reportGnssEngEnergyConsumedEvent(uint64_t energyConsumedSinceFirstB
 void GnssAdapter::initDefaultAgps() {
     LOC_LOGD("%s]: ", __func__);
 
-    void *handle = nullptr;
-    if ((handle = dlopen("libloc_net_iface.so", RTLD_NOW)) == nullptr) {
+    if (LocDlRegistry::getLibHandle("libloc_net_iface.so") == nullptr) {
         LOC_LOGD("%s]: libloc_net_iface.so not found !", __func__);
         return;
     }
 
     LocAgpsGetAgpsCbInfo getAgpsCbInfo = (LocAgpsGetAgpsCbInfo)
-            dlsym(handle, "LocNetIfaceAgps_getAgpsCbInfo");
+            LocDlRegistry::getSymbol("libloc_net_iface.so", "LocNetIfaceAgps_getAgpsCbInfo");
     if (getAgpsCbInfo == nullptr) {
         LOC_LOGE("%s]: Failed to get method LocNetIfaceAgps_getStatusCb", __func__);
-        dlclose(handle);
         return;
     }
 
@@ -4174,7 +4350,6 @@ void GnssAdapter::initDefaultAgps() {
 
     if (cbInfo.statusV4Cb == nullptr) {
         LOC_LOGE("%s]: statusV4Cb is nullptr!", __func__);
-        dlclose(handle);
         return;
     }
 
@@ -4594,54 +4769,8 @@ bool GnssAdapter::getDebugReport(GnssDebugReport& r)
         return false;
     }
 
-    SystemStatusReports reports = {};
-    systemstatus->getReport(reports, true);
-
-    r.size = sizeof(r);
-
-    // location block
-    r.mLocation.size = sizeof(r.mLocation);
-    if(!reports.mLocation.empty() && reports.mLocation.back().mValid) {
-        r.mLocation.mValid = true;
-        r.mLocation.mLocation.latitude =
-            reports.mLocation.back().mLocation.gpsLocation.latitude;
-        r.mLocation.mLocation.longitude =
-            reports.mLocation.back().mLocation.gpsLocation.longitude;
-        r.mLocation.mLocation.altitude =
-            reports.mLocation.back().mLocation.gpsLocation.altitude;
-        r.mLocation.mLocation.speed =
-            (double)(reports.mLocation.back().mLocation.gpsLocation.speed);
-        r.mLocation.mLocation.bearing =
-            (double)(reports.mLocation.back().mLocation.gpsLocation.bearing);
-        r.mLocation.mLocation.accuracy =
-            (double)(reports.mLocation.back().mLocation.gpsLocation.accuracy);
-
-        r.mLocation.verticalAccuracyMeters =
-            reports.mLocation.back().mLocationEx.vert_unc;
-        r.mLocation.speedAccuracyMetersPerSecond =
-            reports.mLocation.back().mLocationEx.speed_unc;
-        r.mLocation.bearingAccuracyDegrees =
-            reports.mLocation.back().mLocationEx.bearing_unc;
-
-        r.mLocation.mUtcReported =
-            reports.mLocation.back().mUtcReported;
-    }
-    else if(!reports.mBestPosition.empty() && reports.mBestPosition.back().mValid) {
-        r.mLocation.mValid = true;
-        r.mLocation.mLocation.latitude =
-                (double)(reports.mBestPosition.back().mBestLat) * RAD2DEG;
-        r.mLocation.mLocation.longitude =
-                (double)(reports.mBestPosition.back().mBestLon) * RAD2DEG;
-        r.mLocation.mLocation.altitude = reports.mBestPosition.back().mBestAlt;
-        r.mLocation.mLocation.accuracy =
-                (double)(reports.mBestPosition.back().mBestHepe);
-
-        r.mLocation.mUtcReported = reports.mBestPosition.back().mUtcReported;
-    }
-    else {
-        r.mLocation.mValid = false;
-    }
-
+    // kept up to date from the adapter thread as fixes and debug NMEA arrive
+    mDebugSnapshot.get(r);
     if (r.mLocation.mValid) {
         LOC_LOGV("getDebugReport - lat=%f lon=%f alt=%f speed=%f",
             r.mLocation.mLocation.latitude,
@@ -4649,46 +4778,6 @@ bool GnssAdapter::getDebugReport(GnssDebugReport& r)
             r.mLocation.mLocation.altitude,
             r.mLocation.mLocation.speed);
     }
-
-    // time block
-    r.mTime.size = sizeof(r.mTime);
-    if(!reports.mTimeAndClock.empty() && reports.mTimeAndClock.back().mTimeValid) {
-        r.mTime.mValid = true;
-        r.mTime.timeEstimate =
-            (((int64_t)(reports.mTimeAndClock.back().mGpsWeek)*7 +
-                        GNSS_UTC_TIME_OFFSET)*24*60*60 -
-              (int64_t)(reports.mTimeAndClock.back().mLeapSeconds))*1000ULL +
-              (int64_t)(reports.mTimeAndClock.back().mGpsTowMs);
-
-        if (reports.mTimeAndClock.back().mTimeUncNs > 0) {
-            // TimeUncNs value is available
-            r.mTime.timeUncertaintyNs =
-                    (float)(reports.mTimeAndClock.back().mLeapSecUnc)*1000.0f +
-                    (float)(reports.mTimeAndClock.back().mTimeUncNs);
-        } else {
-            // fall back to legacy TimeUnc
-            r.mTime.timeUncertaintyNs =
-                    ((float)(reports.mTimeAndClock.back().mTimeUnc) +
-                     (float)(reports.mTimeAndClock.back().mLeapSecUnc))*1000.0f;
-        }
-
-        r.mTime.frequencyUncertaintyNsPerSec =
-            (float)(reports.mTimeAndClock.back().mClockFreqBiasUnc);
-        LOC_LOGV("getDebugReport - timeestimate=%" PRIu64 " unc=%f frequnc=%f",
-                r.mTime.timeEstimate,
-                r.mTime.timeUncertaintyNs, r.mTime.frequencyUncertaintyNsPerSec);
-    }
-    else {
-        r.mTime.mValid = false;
-    }
-
-    // satellite info block
-    convertSatelliteInfo(r.mSatelliteInfo, GNSS_SV_TYPE_GPS, reports);
-    convertSatelliteInfo(r.mSatelliteInfo, GNSS_SV_TYPE_GLONASS, reports);
-    convertSatelliteInfo(r.mSatelliteInfo, GNSS_SV_TYPE_QZSS, reports);
-    convertSatelliteInfo(r.mSatelliteInfo, GNSS_SV_TYPE_BEIDOU, reports);
-    convertSatelliteInfo(r.mSatelliteInfo, GNSS_SV_TYPE_GALILEO, reports);
-    convertSatelliteInfo(r.mSatelliteInfo, GNSS_SV_TYPE_NAVIC, reports);
     LOC_LOGV("getDebugReport - satellite=%zu", r.mSatelliteInfo.size());
 
     return true;
@@ -4955,46 +5044,21 @@ GnssAdapter::initEngHubProxy() {
     static bool firstTime = true;
     static bool engHubLoadSuccessful = false;
 
-    const char *error = nullptr;
-    unsigned int processListLength = 0;
-    loc_process_info_s_type* processInfoList = nullptr;
-
     do {
         // load eng hub only once
         if (firstTime == false) {
             break;
         }
 
-        int rc = loc_read_process_conf(LOC_PATH_IZAT_CONF, &processListLength,
-                                       &processInfoList);
-        if (rc != 0) {
-            LOC_LOGE("%s]: failed to parse conf file", __func__);
-            break;
-        }
-
-        bool pluginDaemonEnabled = false;
-        // go over the conf table to see whether any plugin daemon is enabled
-        for (unsigned int i = 0; i < processListLength; i++) {
-            if ((strncmp(processInfoList[i].name[0], PROCESS_NAME_ENGINE_SERVICE,
-                         strlen(PROCESS_NAME_ENGINE_SERVICE)) == 0) &&
-                (processInfoList[i].proc_status == ENABLED)) {
-                pluginDaemonEnabled = true;
-                break;
-            }
-        }
-
         // no plugin daemon is enabled for this platform, no need to load eng hub .so
-        if (pluginDaemonEnabled == false) {
+        if (ContextBase::isEngineServiceEnabled() == false) {
             break;
         }
 
         // load the engine hub .so, if the .so is not present
         // all EngHubProxyBase calls will turn into no-op.
-        void *handle = nullptr;
-        if ((handle = dlopen("libloc_eng_hub.so", RTLD_NOW)) == nullptr) {
-            if ((error = dlerror()) != nullptr) {
-                LOC_LOGE("%s]: libloc_eng_hub.so not found %s !", __func__, error);
-            }
+        if (LocDlRegistry::getLibHandle("libloc_eng_hub.so") == nullptr) {
+            LOC_LOGE("%s]: libloc_eng_hub.so not found !", __func__);
             break;
         }
 
@@ -5018,7 +5082,8 @@ GnssAdapter::initEngHubProxy() {
             mLocApi->requestForAidingData(svDataMask);
         };
 
-        getEngHubProxyFn* getter = (getEngHubProxyFn*) dlsym(handle, "getEngHubProxy");
+        getEngHubProxyFn* getter = (getEngHubProxyFn*)
+                LocDlRegistry::getSymbol("libloc_eng_hub.so", "getEngHubProxy");
         if(getter != nullptr) {
             EngineHubProxyBase* hubProxy = (*getter) (mMsgTask, mSystemStatus->getOsObserver(),
                                                       reportPositionEventCb,
@@ -5037,11 +5102,6 @@ GnssAdapter::initEngHubProxy() {
 
     } while (0);
 
-    if (processInfoList != nullptr) {
-        free (processInfoList);
-        processInfoList = nullptr;
-    }
-
     firstTime = false;
     return engHubLoadSuccessful;
 }
@@ -37,7 +37,13 @@
 #include <Agps.h>
 #include <SystemStatus.h>
 #include <XtraSystemStatusObserver.h>
+#include <GnssMeasurementStream.h>
+#include <GnssSvStatusFilter.h>
+#include <OdcpiCache.h>
+#include <GnssDebugSnapshot.h>
+#include <GnssPowerPolicy.h>
 #include <map>
+#include <memory>
 
 #define MAX_URL_LEN 256
 #define NMEA_SENTENCE_MAX_LENGTH 200
@@ -157,6 +163,14 @@ class GnssAdapter : public LocAdapterBase {
     GnssSvTypeConfigCallback mGnssSvTypeConfigCb;
     bool mSupportNfwControl;
 
+    /* ==== MEASUREMENTS =================================================================== */
+    // clients without an entry get every epoch unchanged
+    std::map<LocationAPI*, std::unique_ptr<GnssMeasurementStream>> mMeasurementStreams;
+
+    /* ==== SV STATUS ====================================================================== */
+    // clients without an entry get every SV report unchanged
+    std::map<LocationAPI*, std::unique_ptr<GnssSvStatusFilter>> mSvStatusFilters;
+
     /* ==== NI ============================================================================= */
     NiData mNiData;
 
@@ -178,10 +192,19 @@ class GnssAdapter : public LocAdapterBase {
     bool mOdcpiRequestActive;
     OdcpiTimer mOdcpiTimer;
     OdcpiRequestInfo mOdcpiRequest;
+    OdcpiCache mOdcpiCache;
     void odcpiTimerExpire();
+    bool injectCachedOdcpi();
 
     /* === SystemStatus ===================================================================== */
     SystemStatus* mSystemStatus;
+    GnssDebugSnapshot mDebugSnapshot;
+
+    /* ==== Power policy =================================================================== */
+    GnssPowerPolicy mPowerPolicy;
+    void adaptTrackingOptions(TrackingOptions& options);
+    void applyPowerPolicy();
+    void restartTimeBasedTracking();
     std::string mServerUrl;
     std::string mMoServerUrl;
     XtraSystemStatusObserver mXtraObserver;
@@ -299,6 +322,17 @@ public:
     void gnssGetSvTypeConfigCommand(GnssSvTypeConfigCallback callback);
     void gnssResetSvTypeConfigCommand();
 
+    /* ==== GNSS MEASUREMENT STREAM CONFIG ================================================= */
+    /* ==== COMMANDS ====(Called from Client Thread)======================================== */
+    /* ==== These commands are received directly from client bypassing Location API ======== */
+    void gnssUpdateMeasurementStreamConfigCommand(LocationAPI* client,
+                                                  const GnssMeasurementStreamConfig& config);
+
+    /* ==== GNSS SV STATUS CONFIG ========================================================== */
+    /* ==== COMMANDS ====(Called from Client Thread)======================================== */
+    /* ==== These commands are received directly from client bypassing Location API ======== */
+    void gnssUpdateSvStatusConfigCommand(LocationAPI* client, const GnssSvStatusConfig& config);
+
     /* ==== UTILITIES ====================================================================== */
     LocationError gnssSvIdConfigUpdateSync(const std::vector<GnssSvIdSource>& blacklistedSvIds);
     LocationError gnssSvIdConfigUpdateSync();
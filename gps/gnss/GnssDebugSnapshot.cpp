@@ -0,0 +1,186 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_TAG "LocSvc_GnssDebugSnapshot"
+
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+#include <sys/time.h>
+#include <log_util.h>
+#include <loc_nmea.h>
+#include <GnssAdapter.h>
+#include <GnssDebugSnapshot.h>
+
+using namespace loc_core;
+
+#define RAD2DEG    (180.0 / M_PI)
+
+static const GnssSvType sDebugConstellations[] = {
+    GNSS_SV_TYPE_GPS,
+    GNSS_SV_TYPE_GLONASS,
+    GNSS_SV_TYPE_QZSS,
+    GNSS_SV_TYPE_BEIDOU,
+    GNSS_SV_TYPE_GALILEO,
+    GNSS_SV_TYPE_NAVIC
+};
+
+GnssDebugSnapshot::GnssDebugSnapshot() :
+    mHasFix(false),
+    mFront(0)
+{
+    mWork.size = sizeof(mWork);
+    memset(&mWork.mLocation, 0, sizeof(mWork.mLocation));
+    mWork.mLocation.size = sizeof(mWork.mLocation);
+    memset(&mWork.mTime, 0, sizeof(mWork.mTime));
+    mWork.mTime.size = sizeof(mWork.mTime);
+    mWork.mSatelliteInfo.reserve(SV_ALL_NUM);
+    // satellite block without any debug NMEA yet, as from empty reports
+    updateSatelliteInfo();
+
+    mReports[0] = mWork;
+    mReports[1] = mWork;
+}
+
+void GnssDebugSnapshot::updateLocation(const UlpLocation& location,
+                                       const GpsLocationExtended& locationEx)
+{
+    GnssDebugLocation& l = mWork.mLocation;
+    l.mValid = true;
+    l.mLocation.latitude = location.gpsLocation.latitude;
+    l.mLocation.longitude = location.gpsLocation.longitude;
+    l.mLocation.altitude = location.gpsLocation.altitude;
+    l.mLocation.speed = (double)(location.gpsLocation.speed);
+    l.mLocation.bearing = (double)(location.gpsLocation.bearing);
+    l.mLocation.accuracy = (double)(location.gpsLocation.accuracy);
+    l.verticalAccuracyMeters = locationEx.vert_unc;
+    l.speedAccuracyMetersPerSecond = locationEx.speed_unc;
+    l.bearingAccuracyDegrees = locationEx.bearing_unc;
+    // same clock as the SystemStatus items
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    l.mUtcReported.tv_sec = tv.tv_sec;
+    l.mUtcReported.tv_nsec = tv.tv_usec*1000ULL;
+    mHasFix = true;
+
+    LOC_LOGV("updateLocation - lat=%f lon=%f alt=%f speed=%f",
+             l.mLocation.latitude, l.mLocation.longitude,
+             l.mLocation.altitude, l.mLocation.speed);
+    publish();
+}
+
+void GnssDebugSnapshot::updateFromNmea(const char* nmea, SystemStatus& systemStatus)
+{
+    // only these sentences feed the report
+    bool time = (0 == strncmp(nmea, "$PQWM1", sizeof("$PQWM1") - 1));
+    bool bestPosition = (0 == strncmp(nmea, "$PQWP2", sizeof("$PQWP2") - 1));
+    bool satellites = (0 == strncmp(nmea, "$PQWP3", sizeof("$PQWP3") - 1) ||
+                       0 == strncmp(nmea, "$PQWP5", sizeof("$PQWP5") - 1) ||
+                       0 == strncmp(nmea, "$PQWP7", sizeof("$PQWP7") - 1));
+    if (!time && !(bestPosition && !mHasFix) && !satellites) {
+        return;
+    }
+
+    systemStatus.getDebugReportItems(mInputs);
+    if (time) {
+        updateTime();
+    } else if (bestPosition) {
+        updateBestPosition();
+    } else {
+        updateSatelliteInfo();
+    }
+    publish();
+}
+
+void GnssDebugSnapshot::updateTime()
+{
+    GnssDebugTime& t = mWork.mTime;
+    if (!mInputs.mTimeAndClock.empty() && mInputs.mTimeAndClock.back().mTimeValid) {
+        const SystemStatusTimeAndClock& in = mInputs.mTimeAndClock.back();
+        t.mValid = true;
+        t.timeEstimate =
+            (((int64_t)(in.mGpsWeek)*7 + GNSS_UTC_TIME_OFFSET)*24*60*60 -
+              (int64_t)(in.mLeapSeconds))*1000ULL + (int64_t)(in.mGpsTowMs);
+
+        if (in.mTimeUncNs > 0) {
+            // TimeUncNs value is available
+            t.timeUncertaintyNs = (float)(in.mLeapSecUnc)*1000.0f + (float)(in.mTimeUncNs);
+        } else {
+            // fall back to legacy TimeUnc
+            t.timeUncertaintyNs = ((float)(in.mTimeUnc) + (float)(in.mLeapSecUnc))*1000.0f;
+        }
+        t.frequencyUncertaintyNsPerSec = (float)(in.mClockFreqBiasUnc);
+        LOC_LOGV("updateTime - timeestimate=%" PRIu64 " unc=%f frequnc=%f",
+                 t.timeEstimate, t.timeUncertaintyNs, t.frequencyUncertaintyNsPerSec);
+    } else {
+        t.mValid = false;
+    }
+}
+
+// location block until the first fix comes in
+void GnssDebugSnapshot::updateBestPosition()
+{
+    GnssDebugLocation& l = mWork.mLocation;
+    if (!mInputs.mBestPosition.empty() && mInputs.mBestPosition.back().mValid) {
+        const SystemStatusBestPosition& in = mInputs.mBestPosition.back();
+        l.mValid = true;
+        l.mLocation.latitude = (double)(in.mBestLat) * RAD2DEG;
+        l.mLocation.longitude = (double)(in.mBestLon) * RAD2DEG;
+        l.mLocation.altitude = in.mBestAlt;
+        l.mLocation.accuracy = (double)(in.mBestHepe);
+        l.mUtcReported = in.mUtcReported;
+    } else {
+        l.mValid = false;
+    }
+}
+
+void GnssDebugSnapshot::updateSatelliteInfo()
+{
+    mWork.mSatelliteInfo.clear();
+    for (GnssSvType constellation : sDebugConstellations) {
+        GnssAdapter::convertSatelliteInfo(mWork.mSatelliteInfo, constellation, mInputs);
+    }
+    LOC_LOGV("updateSatelliteInfo - satellite=%zu", mWork.mSatelliteInfo.size());
+}
+
+void GnssDebugSnapshot::publish()
+{
+    // no reader is on the back buffer, they only copy the front one under mLock;
+    // assigning into it reuses the vector's storage
+    uint32_t back = mFront ^ 1;
+    mReports[back] = mWork;
+
+    std::lock_guard<std::mutex> guard(mLock);
+    mFront = back;
+}
+
+void GnssDebugSnapshot::get(GnssDebugReport& report)
+{
+    std::lock_guard<std::mutex> guard(mLock);
+    report = mReports[mFront];
+}
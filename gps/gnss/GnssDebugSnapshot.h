@@ -0,0 +1,73 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef GNSS_DEBUG_SNAPSHOT_H
+#define GNSS_DEBUG_SNAPSHOT_H
+
+#include <mutex>
+#include <LocationAPI.h>
+#include <SystemStatus.h>
+
+using loc_core::SystemStatus;
+using loc_core::SystemStatusReports;
+
+/* GnssDebug report kept up to date as fixes and debug NMEA arrive, so that
+ * reading it is a copy of the last published report and never waits on the
+ * SystemStatus lock.
+ * The update methods run on the GnssAdapter thread only; they change a work
+ * copy and publish it into the back one of two buffers, then flip. get() may
+ * run on any thread. */
+class GnssDebugSnapshot {
+public:
+    GnssDebugSnapshot();
+    inline virtual ~GnssDebugSnapshot() {}
+
+    void updateLocation(const UlpLocation& location,
+                        const GpsLocationExtended& locationEx);
+    /* nmea has been consumed by systemStatus as debug NMEA */
+    void updateFromNmea(const char* nmea, SystemStatus& systemStatus);
+
+    void get(GnssDebugReport& report);
+
+private:
+    void updateTime();
+    void updateBestPosition();
+    void updateSatelliteInfo();
+    void publish();
+
+    // adapter thread only
+    GnssDebugReport mWork;
+    bool mHasFix;
+    SystemStatusReports mInputs;
+
+    std::mutex mLock;
+    GnssDebugReport mReports[2];
+    uint32_t mFront;
+};
+
+#endif // GNSS_DEBUG_SNAPSHOT_H
@@ -0,0 +1,248 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_TAG "LocSvc_GnssMeasurementStream"
+
+#include <string.h>
+#include <algorithm>
+#include <log_util.h>
+#include <GnssMeasurementStream.h>
+
+#define NSEC_PER_MSEC (1000000LL)
+
+GnssMeasurementStream::GnssMeasurementStream(const GnssMeasurementStreamConfig& config) :
+    mConfig(config),
+    mHasLastEpoch(false),
+    mLastEpochTimeNs(0),
+    mNextReportTimeNs(0),
+    mLastDiscontinuityCount(0),
+    mRecordsSinceKeyFrame(GNSS_MEAS_STREAM_KEY_FRAME_INTERVAL)
+{
+    memset(&mFiltered, 0, sizeof(mFiltered));
+    memset(&mPrevious, 0, sizeof(mPrevious));
+    if (mConfig.flags & GNSS_MEASUREMENT_STREAM_DELTA_ENCODED_BIT) {
+        mRecord.reserve(sizeof(GnssMeasurementsNotification));
+    }
+}
+
+bool
+GnssMeasurementStream::isPassThrough(const GnssMeasurementStreamConfig& config)
+{
+    return 0 == (config.flags & GNSS_MEASUREMENT_STREAM_DELTA_ENCODED_BIT) &&
+            0 == config.minIntervalMs &&
+            0 == config.svTypeMask &&
+            0 == config.codeTypeMask &&
+            0 == config.minCarrierFrequencyHz &&
+            0 == config.maxCarrierFrequencyHz;
+}
+
+bool
+GnssMeasurementStream::needReport(const GnssMeasurementsClock& clock)
+{
+    int64_t intervalNs = mConfig.minIntervalMs * NSEC_PER_MSEC;
+    bool continuous = mHasLastEpoch &&
+            clock.hwClockDiscontinuityCount == mLastDiscontinuityCount &&
+            clock.timeNs >= mLastEpochTimeNs;
+    int64_t epochNs = clock.timeNs - mLastEpochTimeNs;
+
+    mHasLastEpoch = true;
+    mLastEpochTimeNs = clock.timeNs;
+    mLastDiscontinuityCount = clock.hwClockDiscontinuityCount;
+
+    if (0 == intervalNs) {
+        return true;
+    }
+    if (continuous) {
+        // Epochs are reported on a schedule of the requested interval, an
+        // epoch jittering a little ahead of its slot still takes it. The
+        // allowance stays under half an engine epoch, so the next epoch is
+        // the one that takes the slot when they are evenly spaced.
+        int64_t jitterNs = std::min(intervalNs / 10, epochNs / 2);
+        if (clock.timeNs < mNextReportTimeNs - jitterNs) {
+            return false;
+        }
+        mNextReportTimeNs += intervalNs;
+    }
+    if (!continuous || clock.timeNs >= mNextReportTimeNs) {
+        // first epoch, or too far behind the schedule to catch up
+        mNextReportTimeNs = clock.timeNs + intervalNs;
+    }
+    return true;
+}
+
+bool
+GnssMeasurementStream::needReport(const GnssMeasurementsData& measurement) const
+{
+    if (0 != mConfig.svTypeMask &&
+            (measurement.svType >= 32 || 0 == (mConfig.svTypeMask & (1 << measurement.svType)))) {
+        return false;
+    }
+    if (0 != mConfig.codeTypeMask) {
+        // OTHER (255), and any code type past the mask, share the last bit
+        GnssMeasurementsCodeTypeMask codeTypeBit = (measurement.codeType < 31) ?
+                (1u << measurement.codeType) : GNSS_MEASUREMENTS_CODE_TYPE_OTHER_BIT;
+        if (0 == (mConfig.codeTypeMask & codeTypeBit)) {
+            return false;
+        }
+    }
+    if (0 != mConfig.minCarrierFrequencyHz &&
+            measurement.carrierFrequencyHz < mConfig.minCarrierFrequencyHz) {
+        return false;
+    }
+    if (0 != mConfig.maxCarrierFrequencyHz &&
+            measurement.carrierFrequencyHz > mConfig.maxCarrierFrequencyHz) {
+        return false;
+    }
+    return true;
+}
+
+void
+GnssMeasurementStream::report(const GnssMeasurementsNotification& measurements,
+        const gnssMeasurementsCallback& measurementsCb)
+{
+    if (!needReport(measurements.clock)) {
+        return;
+    }
+
+    mFiltered.size = sizeof(mFiltered);
+    mFiltered.count = 0;
+    for (uint32_t i = 0; i < measurements.count && i < GNSS_MEASUREMENTS_MAX; i++) {
+        if (needReport(measurements.measurements[i])) {
+            mFiltered.measurements[mFiltered.count++] = measurements.measurements[i];
+        }
+    }
+    mFiltered.clock = measurements.clock;
+
+    if (mConfig.flags & GNSS_MEASUREMENT_STREAM_DELTA_ENCODED_BIT) {
+        if (nullptr != mConfig.deltaCb) {
+            encode(mFiltered);
+            mConfig.deltaCb(mRecord.data(), mRecord.size());
+        }
+    } else if (nullptr != measurementsCb) {
+        measurementsCb(mFiltered);
+    }
+}
+
+void
+GnssMeasurementStream::encode(const GnssMeasurementsNotification& measurements)
+{
+    bool keyFrame = (mRecordsSinceKeyFrame >= GNSS_MEAS_STREAM_KEY_FRAME_INTERVAL);
+    mRecordsSinceKeyFrame = keyFrame ? 1 : mRecordsSinceKeyFrame + 1;
+
+    mRecord.clear();
+    put<uint8_t>(GNSS_MEAS_STREAM_VERSION);
+    put<uint8_t>(keyFrame ? GNSS_MEAS_STREAM_KEY_FRAME_BIT : 0);
+    put<uint16_t>(measurements.count);
+    put(measurements.clock);
+
+    for (uint32_t i = 0; i < measurements.count; i++) {
+        const GnssMeasurementsData& current = measurements.measurements[i];
+        uint16_t changeMask = GNSS_MEAS_STREAM_CHANGED_ALL;
+        if (!keyFrame && i < mPrevious.count) {
+            const GnssMeasurementsData& previous = mPrevious.measurements[i];
+            changeMask = 0;
+            if (current.svId != previous.svId)
+                changeMask |= GNSS_MEAS_STREAM_CHANGED_SV_ID;
+            if (current.svType != previous.svType)
+                changeMask |= GNSS_MEAS_STREAM_CHANGED_SV_TYPE;
+            if (current.codeType != previous.codeType ||
+                    (GNSS_MEASUREMENTS_CODE_TYPE_OTHER == current.codeType &&
+                     0 != strncmp(current.otherCodeTypeName, previous.otherCodeTypeName,
+                                  GNSS_MAX_NAME_LENGTH)))
+                changeMask |= GNSS_MEAS_STREAM_CHANGED_CODE_TYPE;
+            if (current.flags != previous.flags)
+                changeMask |= GNSS_MEAS_STREAM_CHANGED_FLAGS;
+            if (current.stateMask != previous.stateMask)
+                changeMask |= GNSS_MEAS_STREAM_CHANGED_STATE;
+            if (current.adrStateMask != previous.adrStateMask)
+                changeMask |= GNSS_MEAS_STREAM_CHANGED_ADR_STATE;
+            if (current.carrierFrequencyHz != previous.carrierFrequencyHz)
+                changeMask |= GNSS_MEAS_STREAM_CHANGED_CARRIER_FREQ;
+            if (current.multipathIndicator != previous.multipathIndicator)
+                changeMask |= GNSS_MEAS_STREAM_CHANGED_MULTIPATH;
+            if (current.timeOffsetNs != previous.timeOffsetNs)
+                changeMask |= GNSS_MEAS_STREAM_CHANGED_TIME_OFFSET;
+            if (current.agcLevelDb != previous.agcLevelDb)
+                changeMask |= GNSS_MEAS_STREAM_CHANGED_AGC;
+        }
+        put<uint16_t>(changeMask);
+        encodeSlow(current, changeMask);
+        encodeDynamic(current);
+        mPrevious.measurements[i] = current;
+    }
+    mPrevious.count = measurements.count;
+
+    LOC_LOGV("%s]: count %u key frame %d bytes %zu",
+             __func__, measurements.count, keyFrame, mRecord.size());
+}
+
+void
+GnssMeasurementStream::encodeSlow(const GnssMeasurementsData& measurement, uint16_t changeMask)
+{
+    if (changeMask & GNSS_MEAS_STREAM_CHANGED_SV_ID)
+        put<int16_t>(measurement.svId);
+    if (changeMask & GNSS_MEAS_STREAM_CHANGED_SV_TYPE)
+        put<uint8_t>(measurement.svType);
+    if (changeMask & GNSS_MEAS_STREAM_CHANGED_CODE_TYPE) {
+        put<uint8_t>(measurement.codeType);
+        if (GNSS_MEASUREMENTS_CODE_TYPE_OTHER == measurement.codeType) {
+            mRecord.insert(mRecord.end(), measurement.otherCodeTypeName,
+                           measurement.otherCodeTypeName + GNSS_MAX_NAME_LENGTH);
+        }
+    }
+    if (changeMask & GNSS_MEAS_STREAM_CHANGED_FLAGS)
+        put<uint32_t>(measurement.flags);
+    if (changeMask & GNSS_MEAS_STREAM_CHANGED_STATE)
+        put<uint32_t>(measurement.stateMask);
+    if (changeMask & GNSS_MEAS_STREAM_CHANGED_ADR_STATE)
+        put<uint32_t>(measurement.adrStateMask);
+    if (changeMask & GNSS_MEAS_STREAM_CHANGED_CARRIER_FREQ)
+        put<float>(measurement.carrierFrequencyHz);
+    if (changeMask & GNSS_MEAS_STREAM_CHANGED_MULTIPATH)
+        put<uint8_t>(measurement.multipathIndicator);
+    if (changeMask & GNSS_MEAS_STREAM_CHANGED_TIME_OFFSET)
+        put<double>(measurement.timeOffsetNs);
+    if (changeMask & GNSS_MEAS_STREAM_CHANGED_AGC)
+        put<double>(measurement.agcLevelDb);
+}
+
+void
+GnssMeasurementStream::encodeDynamic(const GnssMeasurementsData& measurement)
+{
+    put<int64_t>(measurement.receivedSvTimeNs);
+    put<int64_t>(measurement.receivedSvTimeUncertaintyNs);
+    put<double>(measurement.carrierToNoiseDbHz);
+    put<double>(measurement.pseudorangeRateMps);
+    put<double>(measurement.pseudorangeRateUncertaintyMps);
+    put<double>(measurement.adrMeters);
+    put<double>(measurement.adrUncertaintyMeters);
+    put<int64_t>(measurement.carrierCycles);
+    put<double>(measurement.carrierPhase);
+    put<double>(measurement.carrierPhaseUncertainty);
+    put<double>(measurement.signalToNoiseRatioDb);
+}
@@ -0,0 +1,105 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef GNSS_MEASUREMENT_STREAM_H
+#define GNSS_MEASUREMENT_STREAM_H
+
+#include <vector>
+#include <LocationAPI.h>
+#include <gps_extended_c.h>
+
+/* Delta encoded measurement record, all fields in host byte order:
+ *
+ *   uint8_t  version                  GNSS_MEAS_STREAM_VERSION
+ *   uint8_t  recordFlags              GNSS_MEAS_STREAM_KEY_FRAME_BIT
+ *   uint16_t count                    number of measurements that follow
+ *   GnssMeasurementsClock clock
+ *   count times:
+ *     uint16_t changeMask             GNSS_MEAS_STREAM_CHANGED_* bits
+ *     slow fields whose bit is set, in bit order
+ *     dynamic fields, always present, see encodeDynamic()
+ *
+ * Measurement i is compared against measurement i of the previous record.
+ * A key frame has every changeMask bit set and does not depend on any
+ * earlier record, one is sent every GNSS_MEAS_STREAM_KEY_FRAME_INTERVAL
+ * records so a decoder can join a running stream. */
+#define GNSS_MEAS_STREAM_VERSION            (1)
+#define GNSS_MEAS_STREAM_KEY_FRAME_BIT      (1<<0)
+#define GNSS_MEAS_STREAM_KEY_FRAME_INTERVAL (16)
+
+#define GNSS_MEAS_STREAM_CHANGED_SV_ID          (1<<0)  // int16_t
+#define GNSS_MEAS_STREAM_CHANGED_SV_TYPE        (1<<1)  // uint8_t
+#define GNSS_MEAS_STREAM_CHANGED_CODE_TYPE      (1<<2)  // uint8_t + otherCodeTypeName
+#define GNSS_MEAS_STREAM_CHANGED_FLAGS          (1<<3)  // uint32_t
+#define GNSS_MEAS_STREAM_CHANGED_STATE          (1<<4)  // uint32_t
+#define GNSS_MEAS_STREAM_CHANGED_ADR_STATE      (1<<5)  // uint32_t
+#define GNSS_MEAS_STREAM_CHANGED_CARRIER_FREQ   (1<<6)  // float
+#define GNSS_MEAS_STREAM_CHANGED_MULTIPATH      (1<<7)  // uint8_t
+#define GNSS_MEAS_STREAM_CHANGED_TIME_OFFSET    (1<<8)  // double
+#define GNSS_MEAS_STREAM_CHANGED_AGC            (1<<9)  // double
+#define GNSS_MEAS_STREAM_CHANGED_ALL            ((1<<10) - 1)
+
+/* Measurement stream of one client: decimates epochs to the requested
+ * interval, drops the measurements the client filtered out and, if asked
+ * for, delivers them delta encoded. Only used from the GnssAdapter thread. */
+class GnssMeasurementStream {
+public:
+    GnssMeasurementStream(const GnssMeasurementStreamConfig& config);
+    inline virtual ~GnssMeasurementStream() {}
+
+    /* true if config would deliver every epoch unchanged */
+    static bool isPassThrough(const GnssMeasurementStreamConfig& config);
+
+    void report(const GnssMeasurementsNotification& measurements,
+                const gnssMeasurementsCallback& measurementsCb);
+
+private:
+    bool needReport(const GnssMeasurementsClock& clock);
+    bool needReport(const GnssMeasurementsData& measurement) const;
+    void encode(const GnssMeasurementsNotification& measurements);
+    void encodeSlow(const GnssMeasurementsData& measurement, uint16_t changeMask);
+    void encodeDynamic(const GnssMeasurementsData& measurement);
+    template <typename T> inline void put(const T& value) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        mRecord.insert(mRecord.end(), bytes, bytes + sizeof(T));
+    }
+
+    GnssMeasurementStreamConfig mConfig;
+    bool mHasLastEpoch;
+    int64_t mLastEpochTimeNs;
+    // slot of the next decimated epoch
+    int64_t mNextReportTimeNs;
+    uint32_t mLastDiscontinuityCount;
+    uint32_t mRecordsSinceKeyFrame;
+    // filtered epoch and last encoded epoch, reused for every report
+    GnssMeasurementsNotification mFiltered;
+    GnssMeasurementsNotification mPrevious;
+    std::vector<uint8_t> mRecord;
+};
+
+#endif // GNSS_MEASUREMENT_STREAM_H
@@ -0,0 +1,346 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_TAG "LocSvc_GnssPowerPolicy"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <log_util.h>
+#include <loc_cfg.h>
+#include <loc_pla.h>
+#include <DataItemId.h>
+#include <DataItemConcreteTypesBase.h>
+#include <GnssPowerPolicy.h>
+
+using namespace loc_core;
+
+static const char* sPolicyNames[GNSS_POWER_POLICY_COUNT] = {
+    "CHARGING", "SCREEN_ON", "SCREEN_OFF", "OVER_BUDGET"
+};
+
+GnssPowerPolicy::GnssPowerPolicy(IOsObserver* sysStatObs, const MsgTask* msgTask,
+                                 const PolicyChangedCb& policyChangedCb,
+                                 const EnergyRequestCb& energyRequestCb) :
+    mSystemStatusObsrvr(sysStatObs),
+    mMsgTask(msgTask),
+    mPolicyChangedCb(policyChangedCb),
+    mEnergyRequestCb(energyRequestCb),
+    mEnergyBudgetMw(0),
+    mPolicy(GNSS_POWER_POLICY_SCREEN_ON),
+    mSubscribed(false),
+    mTracking(false),
+    mCharging(false),
+    mScreenOn(true),
+    mOverBudget(false),
+    mPolicyStartMs(0),
+    mLastFixMs(0),
+    mLastMeasurementMs(0),
+    mLastEnergy(0),
+    mLastEnergyMs(0),
+    mEnergyPollTimer(*this)
+{
+    // every policy passes through until gps.conf says otherwise
+    for (uint32_t i = 0; i < GNSS_POWER_POLICY_COUNT; i++) {
+        mTable[i] = {100, 0, true, 0};
+    }
+    memset(mCounters, 0, sizeof(mCounters));
+}
+
+GnssPowerPolicy::~GnssPowerPolicy()
+{
+    mEnergyPollTimer.stop();
+    subscribe(false);
+}
+
+void GnssPowerPolicy::init()
+{
+    char policies[GNSS_POWER_POLICY_COUNT][LOC_MAX_PARAM_STRING] = {};
+    uint32_t energyBudgetMw = 0;
+    const loc_param_s_type power_policy_conf_param_table[] =
+    {
+        {"POWER_POLICY_CHARGING",         &policies[GNSS_POWER_POLICY_CHARGING],    NULL, 's'},
+        {"POWER_POLICY_SCREEN_ON",        &policies[GNSS_POWER_POLICY_SCREEN_ON],   NULL, 's'},
+        {"POWER_POLICY_SCREEN_OFF",       &policies[GNSS_POWER_POLICY_SCREEN_OFF],  NULL, 's'},
+        {"POWER_POLICY_OVER_BUDGET",      &policies[GNSS_POWER_POLICY_OVER_BUDGET], NULL, 's'},
+        {"POWER_POLICY_ENERGY_BUDGET_MW", &energyBudgetMw,                          NULL, 'n'},
+    };
+    UTIL_READ_CONF(LOC_PATH_GPS_CONF, power_policy_conf_param_table);
+
+    const char* policyStrings[GNSS_POWER_POLICY_COUNT];
+    for (uint32_t i = 0; i < GNSS_POWER_POLICY_COUNT; i++) {
+        policyStrings[i] = policies[i];
+    }
+    init(policyStrings, energyBudgetMw);
+}
+
+void GnssPowerPolicy::init(const char* const policies[GNSS_POWER_POLICY_COUNT],
+                           uint32_t energyBudgetMw)
+{
+    for (uint32_t i = 0; i < GNSS_POWER_POLICY_COUNT; i++) {
+        uint32_t scale = 0, minInterval = 0, nmea = 0, measInterval = 0;
+        if (nullptr == policies[i] || '\0' == policies[i][0]) {
+            continue;
+        }
+        if (4 != sscanf(policies[i], "%u %u %u %u", &scale, &minInterval, &nmea, &measInterval) ||
+                scale < 100) {
+            LOC_LOGe("invalid POWER_POLICY_%s \"%s\", kept default", sPolicyNames[i], policies[i]);
+            continue;
+        }
+        mTable[i] = {scale, minInterval, (0 != nmea), measInterval};
+        LOC_LOGd("%s: interval scale %u%% floor %u ms nmea %u measurement interval %u ms",
+                 sPolicyNames[i], scale, minInterval, nmea, measInterval);
+    }
+    mEnergyBudgetMw = energyBudgetMw;
+    mPolicyStartMs = uptimeMillis();
+
+    subscribe(true);
+    if (mTracking && mEnergyBudgetMw > 0) {
+        mEnergyPollTimer.start(POWER_POLICY_ENERGY_POLL_MS, false);
+    }
+}
+
+void GnssPowerPolicy::subscribe(bool yes)
+{
+    if (nullptr == mSystemStatusObsrvr || yes == mSubscribed) {
+        return;
+    }
+    mSubscribed = yes;
+
+    list<DataItemId> subItemIdList;
+    subItemIdList.push_back(POWER_CONNECTED_STATE_DATA_ITEM_ID);
+    subItemIdList.push_back(SCREEN_STATE_DATA_ITEM_ID);
+    if (yes) {
+        mSystemStatusObsrvr->subscribe(subItemIdList, this);
+    } else {
+        mSystemStatusObsrvr->unsubscribe(subItemIdList, this);
+    }
+}
+
+// IDataItemObserver overrides
+void GnssPowerPolicy::getName(string& name)
+{
+    name = "GnssPowerPolicy";
+}
+
+void GnssPowerPolicy::notify(const list<IDataItemCore*>& dlist)
+{
+    struct HandlePowerStateMsg : public LocMsg {
+        GnssPowerPolicy& mPolicy;
+        bool mHasCharging, mCharging, mHasScreenOn, mScreenOn;
+        inline HandlePowerStateMsg(GnssPowerPolicy& policy,
+                                   bool hasCharging, bool charging,
+                                   bool hasScreenOn, bool screenOn) :
+            LocMsg(), mPolicy(policy),
+            mHasCharging(hasCharging), mCharging(charging),
+            mHasScreenOn(hasScreenOn), mScreenOn(screenOn) {}
+        inline void proc() const override {
+            mPolicy.onStateChanged(mHasCharging, mCharging, mHasScreenOn, mScreenOn);
+        }
+    };
+
+    // only two booleans are needed, no need to copy the data items over
+    bool hasCharging = false, charging = false, hasScreenOn = false, screenOn = false;
+    for (auto each : dlist) {
+        switch (each->getId()) {
+            case POWER_CONNECTED_STATE_DATA_ITEM_ID:
+                hasCharging = true;
+                charging = static_cast<PowerConnectStateDataItemBase*>(each)->mState;
+                break;
+            case SCREEN_STATE_DATA_ITEM_ID:
+                hasScreenOn = true;
+                screenOn = static_cast<ScreenStateDataItemBase*>(each)->mState;
+                break;
+            default:
+                break;
+        }
+    }
+    if (hasCharging || hasScreenOn) {
+        mMsgTask->sendMsg(new (nothrow) HandlePowerStateMsg(
+                *this, hasCharging, charging, hasScreenOn, screenOn));
+    }
+}
+
+void GnssPowerPolicy::onStateChanged(bool hasCharging, bool charging,
+                                     bool hasScreenOn, bool screenOn)
+{
+    if (hasCharging) {
+        mCharging = charging;
+    }
+    if (hasScreenOn) {
+        mScreenOn = screenOn;
+    }
+    LOC_LOGd("charging %d screen on %d", mCharging, mScreenOn);
+    evaluate(uptimeMillis());
+}
+
+void GnssPowerPolicy::evaluate(int64_t nowMs)
+{
+    GnssPowerPolicyId policy;
+    if (mCharging) {
+        policy = GNSS_POWER_POLICY_CHARGING;
+    } else if (mOverBudget) {
+        policy = GNSS_POWER_POLICY_OVER_BUDGET;
+    } else if (mScreenOn) {
+        policy = GNSS_POWER_POLICY_SCREEN_ON;
+    } else {
+        policy = GNSS_POWER_POLICY_SCREEN_OFF;
+    }
+
+    if (policy != mPolicy) {
+        logCounters(nowMs);
+        LOC_LOGi("power policy %s -> %s", sPolicyNames[mPolicy], sPolicyNames[policy]);
+        mPolicy = policy;
+        mLastFixMs = 0;
+        mPolicyChangedCb();
+    }
+}
+
+void GnssPowerPolicy::adaptTrackingOptions(TrackingOptions& options) const
+{
+    const GnssPowerPolicyEntry& entry = current();
+    uint64_t interval = (uint64_t)options.minInterval * entry.intervalScalePercent / 100;
+    if (interval < entry.minIntervalMs) {
+        interval = entry.minIntervalMs;
+    }
+    if (interval > UINT32_MAX) {
+        interval = UINT32_MAX;
+    }
+    if (interval != options.minInterval) {
+        LOC_LOGd("%s: minInterval %u -> %" PRIu64, sPolicyNames[mPolicy],
+                 options.minInterval, interval);
+        options.minInterval = (uint32_t)interval;
+    }
+}
+
+bool GnssPowerPolicy::allowMeasurementReport(int64_t nowMs)
+{
+    uint32_t interval = current().measurementIntervalMs;
+    if (0 != interval && 0 != mLastMeasurementMs && nowMs - mLastMeasurementMs < interval) {
+        return false;
+    }
+    mLastMeasurementMs = nowMs;
+    return true;
+}
+
+void GnssPowerPolicy::onFixReported(int64_t nowMs)
+{
+    GnssPowerPolicyCounters& counters = mCounters[mPolicy];
+    counters.fixes++;
+    if (0 != mLastFixMs) {
+        counters.fixIntervals++;
+        counters.fixLatencyMs += nowMs - mLastFixMs;
+    }
+    mLastFixMs = nowMs;
+}
+
+void GnssPowerPolicy::onEnergyConsumed(uint64_t energySinceBoot, int64_t nowMs)
+{
+    if (UINT64_MAX == energySinceBoot) {
+        return;
+    }
+
+    if (0 != mLastEnergyMs && energySinceBoot >= mLastEnergy && nowMs > mLastEnergyMs) {
+        uint64_t energy = energySinceBoot - mLastEnergy;
+        mCounters[mPolicy].energy += energy;
+
+        if (mEnergyBudgetMw > 0) {
+            // 0.1 mWs over ms is 100 mW
+            uint64_t averageMw = energy * 100 / (nowMs - mLastEnergyMs);
+            if (averageMw > mEnergyBudgetMw) {
+                mOverBudget = true;
+            } else if (averageMw * 100 <
+                       (uint64_t)mEnergyBudgetMw * POWER_POLICY_BUDGET_HYSTERESIS_PERCENT) {
+                mOverBudget = false;
+            }
+            LOC_LOGd("average %" PRIu64 " mW budget %u mW over budget %d",
+                     averageMw, mEnergyBudgetMw, mOverBudget);
+        }
+    }
+    mLastEnergy = energySinceBoot;
+    mLastEnergyMs = nowMs;
+    evaluate(nowMs);
+}
+
+void GnssPowerPolicy::logCounters(int64_t nowMs)
+{
+    mCounters[mPolicy].timeMs += nowMs - mPolicyStartMs;
+    mPolicyStartMs = nowMs;
+
+    for (uint32_t i = 0; i < GNSS_POWER_POLICY_COUNT; i++) {
+        const GnssPowerPolicyCounters& c = mCounters[i];
+        LOC_LOGi("%s: time %" PRIu64 " ms energy %" PRIu64 " mWs fixes %u"
+                 " average fix interval %" PRIu64 " ms",
+                 sPolicyNames[i], c.timeMs, c.energy / 10, c.fixes,
+                 (c.fixIntervals > 0) ? c.fixLatencyMs / c.fixIntervals : 0);
+    }
+}
+
+void GnssPowerPolicy::onTrackingStateChanged(bool tracking)
+{
+    if (tracking == mTracking) {
+        return;
+    }
+    mTracking = tracking;
+    if (0 == mEnergyBudgetMw) {
+        return;
+    }
+
+    if (tracking) {
+        // the engine was idle since the last sample, start the average over
+        mLastEnergyMs = 0;
+        mEnergyRequestCb();
+        mEnergyPollTimer.start(POWER_POLICY_ENERGY_POLL_MS, false);
+    } else {
+        // one last sample accounts the end of the session to the policy
+        mEnergyPollTimer.stop();
+        mEnergyRequestCb();
+    }
+}
+
+void GnssPowerPolicy::onEnergyPollTimer()
+{
+    // a poll queued just before tracking stopped
+    if (!mTracking) {
+        return;
+    }
+    mEnergyRequestCb();
+    mEnergyPollTimer.start(POWER_POLICY_ENERGY_POLL_MS, false);
+}
+
+// Called in the context of LocTimer thread
+void GnssPowerPolicy::EnergyPollTimer::timeOutCallback()
+{
+    struct EnergyPollMsg : public LocMsg {
+        GnssPowerPolicy& mPolicy;
+        inline EnergyPollMsg(GnssPowerPolicy& policy) : LocMsg(), mPolicy(policy) {}
+        inline void proc() const override {
+            mPolicy.onEnergyPollTimer();
+        }
+    };
+    mPolicy.mMsgTask->sendMsg(new (nothrow) EnergyPollMsg(mPolicy));
+}
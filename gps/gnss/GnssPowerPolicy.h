@@ -0,0 +1,145 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef GNSS_POWER_POLICY_H
+#define GNSS_POWER_POLICY_H
+
+#include <functional>
+#include <string>
+#include <list>
+#include <MsgTask.h>
+#include <LocTimer.h>
+#include <IOsObserver.h>
+#include <LocationAPI.h>
+
+using loc_core::IOsObserver;
+using loc_core::IDataItemObserver;
+using loc_core::IDataItemCore;
+
+/* engine energy is sampled this often during tracking when a budget is set */
+#define POWER_POLICY_ENERGY_POLL_MS (60 * 1000)
+/* back under budget once the average power drops below this share of it */
+#define POWER_POLICY_BUDGET_HYSTERESIS_PERCENT 90
+
+typedef enum {
+    GNSS_POWER_POLICY_CHARGING = 0,
+    GNSS_POWER_POLICY_SCREEN_ON,
+    GNSS_POWER_POLICY_SCREEN_OFF,
+    GNSS_POWER_POLICY_OVER_BUDGET,
+    GNSS_POWER_POLICY_COUNT
+} GnssPowerPolicyId;
+
+/* One row of the gps.conf policy table, see POWER_POLICY_* there */
+struct GnssPowerPolicyEntry {
+    uint32_t intervalScalePercent;  // tracking interval scale, 100 keeps it
+    uint32_t minIntervalMs;         // tracking interval floor, 0 for none
+    bool nmeaEnabled;               // NMEA generation and delivery
+    uint32_t measurementIntervalMs; // 0 delivers every measurement report
+};
+
+struct GnssPowerPolicyCounters {
+    uint64_t timeMs;        // time spent in the policy
+    uint64_t energy;        // engine energy used in the policy, 0.1 mWs
+    uint32_t fixes;         // fixes reported in the policy
+    uint32_t fixIntervals;  // consecutive fix pairs within the policy
+    uint64_t fixLatencyMs;  // sum of the times between those fixes
+};
+
+/* Picks the power policy from the charging and screen states, reported as
+ * data items by SystemStatus, and from the engine's average power against
+ * the configured budget, fed back from reportGnssEngEnergyConsumedEvent.
+ * GnssAdapter applies the current entry to tracking, NMEA and measurements.
+ * Everything but notify() runs on the GnssAdapter thread. */
+class GnssPowerPolicy : public IDataItemObserver {
+public:
+    typedef std::function<void()> PolicyChangedCb;
+    typedef std::function<void()> EnergyRequestCb;
+
+    GnssPowerPolicy(IOsObserver* sysStatObs, const MsgTask* msgTask,
+                    const PolicyChangedCb& policyChangedCb,
+                    const EnergyRequestCb& energyRequestCb);
+    virtual ~GnssPowerPolicy();
+
+    /* reads the policy table from gps.conf and starts observing */
+    void init();
+    /* same, with the POWER_POLICY_* strings and budget given as read from gps.conf */
+    void init(const char* const policies[GNSS_POWER_POLICY_COUNT], uint32_t energyBudgetMw);
+
+    // IDataItemObserver overrides
+    virtual void getName(std::string& name);
+    virtual void notify(const std::list<IDataItemCore*>& dlist);
+
+    inline const GnssPowerPolicyEntry& current() const { return mTable[mPolicy]; }
+    /* scales and floors the interval; callers leave emergency sessions alone */
+    void adaptTrackingOptions(TrackingOptions& options) const;
+    /* false when a measurement report comes sooner than the policy allows */
+    bool allowMeasurementReport(int64_t nowMs);
+    void onFixReported(int64_t nowMs);
+    void onEnergyConsumed(uint64_t energySinceBoot, int64_t nowMs);
+    void logCounters(int64_t nowMs);
+    /* the energy poll only runs while the engine is tracking */
+    void onTrackingStateChanged(bool tracking);
+
+    void onStateChanged(bool hasCharging, bool charging, bool hasScreenOn, bool screenOn);
+    void onEnergyPollTimer();
+
+private:
+    void evaluate(int64_t nowMs);
+    void subscribe(bool yes);
+
+    IOsObserver* mSystemStatusObsrvr;
+    const MsgTask* mMsgTask;
+    PolicyChangedCb mPolicyChangedCb;
+    EnergyRequestCb mEnergyRequestCb;
+
+    GnssPowerPolicyEntry mTable[GNSS_POWER_POLICY_COUNT];
+    GnssPowerPolicyCounters mCounters[GNSS_POWER_POLICY_COUNT];
+    uint32_t mEnergyBudgetMw;
+    GnssPowerPolicyId mPolicy;
+    bool mSubscribed;
+    bool mTracking;
+
+    bool mCharging;
+    bool mScreenOn;
+    bool mOverBudget;
+
+    int64_t mPolicyStartMs;
+    int64_t mLastFixMs;
+    int64_t mLastMeasurementMs;
+    uint64_t mLastEnergy;
+    int64_t mLastEnergyMs;
+
+    class EnergyPollTimer : public LocTimer {
+        GnssPowerPolicy& mPolicy;
+    public:
+        EnergyPollTimer(GnssPowerPolicy& policy) : mPolicy(policy) {}
+        void timeOutCallback() override;
+    } mEnergyPollTimer;
+};
+
+#endif // GNSS_POWER_POLICY_H
@@ -0,0 +1,138 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_TAG "LocSvc_GnssSvStatusFilter"
+
+#include <math.h>
+#include <string.h>
+#include <log_util.h>
+#include <GnssSvStatusFilter.h>
+
+// options whose change is always delivered
+#define SV_OPTIONS_TRACKED_MASK (GNSS_SV_OPTIONS_HAS_EPHEMER_BIT | \
+                                 GNSS_SV_OPTIONS_HAS_ALMANAC_BIT | \
+                                 GNSS_SV_OPTIONS_USED_IN_FIX_BIT)
+
+GnssSvStatusFilter::GnssSvStatusFilter(const GnssSvStatusConfig& config) :
+    mConfig(config),
+    mHasDelivered(false),
+    mLastDeliveryMs(0),
+    mEpoch(0)
+{
+    memset(&mDelta, 0, sizeof(mDelta));
+    mSvs.reserve(GNSS_SV_MAX);
+}
+
+bool
+GnssSvStatusFilter::isPassThrough(const GnssSvStatusConfig& config)
+{
+    return 0 == (config.flags & GNSS_SV_STATUS_DELTA_ONLY_BIT) &&
+            0 == config.minIntervalMs &&
+            0 == config.cN0ThresholdDbhz &&
+            0 == config.angleThresholdDeg;
+}
+
+static inline bool exceeds(float diff, float threshold)
+{
+    return (0 == threshold) ? (diff > 0) : (diff >= threshold);
+}
+
+bool
+GnssSvStatusFilter::isChanged(const GnssSv& last, const GnssSv& current) const
+{
+    if ((last.gnssSvOptionsMask ^ current.gnssSvOptionsMask) & SV_OPTIONS_TRACKED_MASK) {
+        return true;
+    }
+    float azimuthDiff = fabsf(current.azimuth - last.azimuth);
+    if (azimuthDiff > 180) {
+        azimuthDiff = 360 - azimuthDiff;
+    }
+    return exceeds(fabsf(current.cN0Dbhz - last.cN0Dbhz), mConfig.cN0ThresholdDbhz) ||
+            exceeds(fabsf(current.elevation - last.elevation), mConfig.angleThresholdDeg) ||
+            exceeds(azimuthDiff, mConfig.angleThresholdDeg);
+}
+
+void
+GnssSvStatusFilter::report(const GnssSvNotification& svNotify, int64_t nowMs,
+        const gnssSvCallback& svCb)
+{
+    if (mConfig.minIntervalMs > 0 && mHasDelivered &&
+            nowMs - mLastDeliveryMs < mConfig.minIntervalMs) {
+        return;
+    }
+
+    mEpoch++;
+    mDelta.size = sizeof(mDelta);
+    mDelta.count = 0;
+    mDelta.gnssSignalTypeMaskValid = svNotify.gnssSignalTypeMaskValid;
+    uint32_t changed = 0;
+    for (uint32_t i = 0; i < svNotify.count && i < GNSS_SV_MAX; i++) {
+        const GnssSv& current = svNotify.gnssSvs[i];
+        auto result = mSvs.emplace(key(current), SvState{current, mEpoch});
+        SvState& state = result.first->second;
+        state.epoch = mEpoch;
+        if (result.second || isChanged(state.sv, current)) {
+            state.sv = current;
+            changed++;
+            mDelta.gnssSvs[mDelta.count++] = current;
+        }
+    }
+    // SVs not present in this report are delivered once as lost; the ones
+    // that do not fit in a full delta stay cached and go out with a later one
+    uint32_t deferred = 0;
+    for (auto it = mSvs.begin(); it != mSvs.end(); /* no increment here*/) {
+        if (it->second.epoch == mEpoch) {
+            ++it;
+        } else if (mDelta.count < GNSS_SV_MAX) {
+            GnssSv& lost = mDelta.gnssSvs[mDelta.count++];
+            lost = it->second.sv;
+            lost.cN0Dbhz = 0;
+            lost.gnssSvOptionsMask = 0;
+            changed++;
+            it = mSvs.erase(it);
+        } else {
+            deferred++;
+            ++it;
+        }
+    }
+    if (deferred > 0) {
+        LOC_LOGD("%s]: %u lost SVs deferred to the next report", __func__, deferred);
+    }
+
+    if (0 == changed) {
+        return;
+    }
+    mHasDelivered = true;
+    mLastDeliveryMs = nowMs;
+    if (mConfig.flags & GNSS_SV_STATUS_DELTA_ONLY_BIT) {
+        LOC_LOGV("%s]: %u of %u SVs changed", __func__, mDelta.count, svNotify.count);
+        svCb(mDelta);
+    } else {
+        svCb(svNotify);
+    }
+}
@@ -0,0 +1,72 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef GNSS_SV_STATUS_FILTER_H
+#define GNSS_SV_STATUS_FILTER_H
+
+#include <unordered_map>
+#include <LocationAPI.h>
+#include <gps_extended_c.h>
+
+/* SV status cache of one client, keyed by (constellation, svId, signal).
+ * Remembers what was last delivered to the client and decides which SVs of
+ * a new report changed enough to be delivered again, see GnssSvStatusConfig.
+ * Only used from the GnssAdapter thread. */
+class GnssSvStatusFilter {
+public:
+    GnssSvStatusFilter(const GnssSvStatusConfig& config);
+    inline virtual ~GnssSvStatusFilter() {}
+
+    /* true for the all zero config, which delivers every report unchanged */
+    static bool isPassThrough(const GnssSvStatusConfig& config);
+
+    /* delivers svNotify, or the changed part of it, to svCb if needed;
+       nowMs is a monotonic timestamp */
+    void report(const GnssSvNotification& svNotify, int64_t nowMs,
+                const gnssSvCallback& svCb);
+
+private:
+    struct SvState {
+        GnssSv sv;          // as last delivered
+        uint32_t epoch;     // last report the SV was present in
+    };
+    static inline uint64_t key(const GnssSv& sv) {
+        return ((uint64_t)sv.type << 56) | ((uint64_t)sv.gnssSignalTypeMask << 16) | sv.svId;
+    }
+    bool isChanged(const GnssSv& last, const GnssSv& current) const;
+
+    GnssSvStatusConfig mConfig;
+    bool mHasDelivered;
+    int64_t mLastDeliveryMs;
+    uint32_t mEpoch;
+    std::unordered_map<uint64_t, SvState> mSvs;
+    // delta of the current report, reused for every report
+    GnssSvNotification mDelta;
+};
+
+#endif // GNSS_SV_STATUS_FILTER_H
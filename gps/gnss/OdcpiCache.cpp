@@ -0,0 +1,89 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_TAG "LocSvc_OdcpiCache"
+
+#include <time.h>
+#include <inttypes.h>
+#include <string.h>
+#include <log_util.h>
+#include <OdcpiCache.h>
+
+OdcpiCache::OdcpiCache() :
+    mValid(false),
+    mBootTimeMs(0)
+{
+    memset(&mLocation, 0, sizeof(mLocation));
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+// boot time keeps counting in suspend, unlike uptimeMillis()
+int64_t OdcpiCache::bootTimeMs()
+{
+    struct timespec ts = {};
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void OdcpiCache::update(const Location& location)
+{
+    // without an uncertainty the fix can't be judged later, don't reuse it
+    mValid = (location.flags & LOCATION_HAS_LAT_LONG_BIT) &&
+             (location.flags & LOCATION_HAS_ACCURACY_BIT);
+    if (mValid) {
+        mLocation = location;
+        mBootTimeMs = bootTimeMs();
+    }
+}
+
+bool OdcpiCache::get(Location& location) const
+{
+    if (!mValid) {
+        return false;
+    }
+
+    int64_t ageMs = bootTimeMs() - mBootTimeMs;
+    float accuracy = mLocation.accuracy + ODCPI_CACHE_UNC_GROWTH_MPS * ageMs / 1000.0f;
+    LOC_LOGd("cached fix age %" PRId64 " ms, accuracy %.1f m", ageMs, accuracy);
+    if (ageMs < 0 || ageMs > ODCPI_CACHE_MAX_AGE_MS || accuracy > ODCPI_CACHE_MAX_UNC_M) {
+        return false;
+    }
+
+    // timestamp stays the original fix time, so the engine sees the real age
+    location = mLocation;
+    location.accuracy = accuracy;
+    return true;
+}
+
+void OdcpiCache::logStats() const
+{
+    LOC_LOGd("requests %u cache hits %u (%u%%) framework requests %u coalesced %u",
+             mStats.requests, mStats.cacheHits,
+             (0 == mStats.requests) ? 0 : mStats.cacheHits * 100 / mStats.requests,
+             mStats.frameworkRequests, mStats.coalesced);
+}
@@ -0,0 +1,76 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef ODCPI_CACHE_H
+#define ODCPI_CACHE_H
+
+#include <stdint.h>
+#include <LocationAPI.h>
+
+/* oldest cached fix still used to answer an ODCPI request */
+#define ODCPI_CACHE_MAX_AGE_MS 60000
+/* largest horizontal uncertainty, after aging, still used from the cache */
+#define ODCPI_CACHE_MAX_UNC_M 2000.0f
+/* horizontal uncertainty added per second of age */
+#define ODCPI_CACHE_UNC_GROWTH_MPS 30.0f
+
+struct OdcpiCacheStats {
+    uint32_t requests;          // ODCPI start requests from the engine
+    uint32_t cacheHits;         // answered from the cache
+    uint32_t frameworkRequests; // forwarded to the framework
+    uint32_t coalesced;         // merged into a framework request in flight
+};
+
+/* Last network/fused location injected for ODCPI, with the boot time it
+ * arrived at. Lets GnssAdapter answer engine ODCPI requests right away when
+ * the fix is fresh enough, instead of a framework round trip.
+ * Only used from the GnssAdapter thread. */
+class OdcpiCache {
+public:
+    OdcpiCache();
+    inline virtual ~OdcpiCache() {}
+
+    void update(const Location& location);
+    /* copies the cached fix with its accuracy grown by age into location;
+       false if there is none, or it is too old or too uncertain */
+    bool get(Location& location) const;
+    inline void clear() { mValid = false; }
+
+    inline OdcpiCacheStats& stats() { return mStats; }
+    void logStats() const;
+
+private:
+    static int64_t bootTimeMs();
+
+    bool mValid;
+    Location mLocation;
+    int64_t mBootTimeMs;
+    OdcpiCacheStats mStats;
+};
+
+#endif // ODCPI_CACHE_H
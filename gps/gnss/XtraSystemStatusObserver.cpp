@@ -78,19 +78,24 @@ public:
 #endif
         } else if (!STRNCMP(data, "requestStatus")) {
             int32_t xtraStatusUpdated = 0;
-            sscanf(data, "%*s %d", &xtraStatusUpdated);
+            int32_t binaryVersion = 0;
+            sscanf(data, "%*s %d %d", &xtraStatusUpdated, &binaryVersion);
 
             struct HandleStatusRequestMsg : public LocMsg {
                 XtraSystemStatusObserver& mXSSO;
                 int32_t mXtraStatusUpdated;
+                int32_t mBinaryVersion;
                 inline HandleStatusRequestMsg(XtraSystemStatusObserver& xsso,
-                                              int32_t xtraStatusUpdated) :
-                        mXSSO(xsso), mXtraStatusUpdated(xtraStatusUpdated) {}
+                                              int32_t xtraStatusUpdated,
+                                              int32_t binaryVersion) :
+                        mXSSO(xsso), mXtraStatusUpdated(xtraStatusUpdated),
+                        mBinaryVersion(binaryVersion) {}
                 inline void proc() const override {
-                    mXSSO.onStatusRequested(mXtraStatusUpdated);
+                    mXSSO.onStatusRequested(mXtraStatusUpdated, mBinaryVersion);
                 }
             };
-            mMsgTask->sendMsg(new HandleStatusRequestMsg(mXSSO, xtraStatusUpdated));
+            mMsgTask->sendMsg(new HandleStatusRequestMsg(mXSSO, xtraStatusUpdated,
+                                                         binaryVersion));
         } else {
             LOC_LOGw("unknown event: %s", data);
         }
@@ -103,8 +108,11 @@ XtraSystemStatusObserver::XtraSystemStatusObserver(IOsObserver* sysStatObs,
         mGpsLock(-1), mConnections(~0), mXtraThrottle(true),
         mReqStatusReceived(false),
         mIsConnectivityStatusKnown(false),
+        mBinaryIpc(false),
+        mDirtyMask(0),
         mSender(LocIpc::getLocIpcLocalSender(LOC_IPC_XTRA)),
-        mDelayLocTimer(*mSender) {
+        mDelayLocTimer(*mSender),
+        mFlushTimer(*this) {
     subscribe(true);
     auto recver = LocIpc::getLocIpcLocalRecver(
             make_shared<XtraIpcListener>(sysStatObs, msgTask, *this),
@@ -113,6 +121,114 @@ XtraSystemStatusObserver::XtraSystemStatusObserver(IOsObserver* sysStatObs,
     mDelayLocTimer.start(100 /*.1 sec*/,  false);
 }
 
+// Called in the context of LocTimer thread
+void XtraSystemStatusObserver::FlushLocTimer::timeOutCallback() {
+    // holds the observer like every message GnssAdapter queues for itself,
+    // GnssAdapter (which owns the observer) must outlive its queued messages
+    struct FlushStatusMsg : public LocMsg {
+        XtraSystemStatusObserver& mXSSO;
+        inline FlushStatusMsg(XtraSystemStatusObserver& xsso) : mXSSO(xsso) {}
+        inline void proc() const override {
+            mXSSO.flushStatus();
+        }
+    };
+    mXSSO.getMsgTask()->sendMsg(new (nothrow) FlushStatusMsg(mXSSO));
+}
+
+void XtraSystemStatusObserver::markDirty(uint32_t mask) {
+    // the first change opens the window, later ones are merged into it
+    if (0 == mDirtyMask) {
+        mFlushTimer.start(XTRA_IPC_COALESCE_WINDOW_MS, false);
+    }
+    mDirtyMask |= mask;
+}
+
+void XtraSystemStatusObserver::flushStatus() {
+    uint32_t mask = mDirtyMask;
+    mDirtyMask = 0;
+    mFlushTimer.stop();
+
+    LOC_LOGd("dirty mask 0x%x binary %d", mask, mBinaryIpc);
+    if (0 == mask) {
+        return;
+    }
+
+    if (mBinaryIpc) {
+        sendBinaryStatus(mask, 0);
+    } else {
+        if (mask & XTRA_STATUS_GPS_LOCK_BIT) {
+            sendLockStatusText();
+        }
+        if (mask & XTRA_STATUS_CONNECTIONS_BIT) {
+            sendConnectionsText();
+        }
+        if (mask & XTRA_STATUS_TAC_BIT) {
+            sendTacText();
+        }
+        if (mask & XTRA_STATUS_MCCMNC_BIT) {
+            sendMccMncText();
+        }
+        if (mask & XTRA_STATUS_XTRA_THROTTLE_BIT) {
+            sendXtraThrottleText();
+        }
+    }
+}
+
+bool XtraSystemStatusObserver::sendBinaryStatus(uint32_t mask, uint8_t flags) {
+    uint8_t buf[512];
+    size_t len = 4;
+    uint8_t fieldCount = 0;
+
+    auto putField = [&](XtraIpcTag tag, const void* value, size_t valueLen) {
+        if (valueLen > UINT8_MAX || len + 2 + valueLen > sizeof(buf)) {
+            LOC_LOGe("field %d of %zu bytes dropped", tag, valueLen);
+            return;
+        }
+        buf[len++] = tag;
+        buf[len++] = (uint8_t)valueLen;
+        memcpy(buf + len, value, valueLen);
+        len += valueLen;
+        fieldCount++;
+    };
+
+    if (mask & XTRA_STATUS_GPS_LOCK_BIT) {
+        int32_t lock = mGpsLock;
+        putField(XTRA_IPC_TAG_GPS_LOCK, &lock, sizeof(lock));
+    }
+    if (mask & XTRA_STATUS_CONNECTIONS_BIT) {
+        uint8_t value[sizeof(uint64_t) * (1 + MAX_NETWORK_HANDLES) + MAX_NETWORK_HANDLES];
+        size_t valueLen = 0;
+        memcpy(value, &mConnections, sizeof(uint64_t));
+        valueLen += sizeof(uint64_t);
+        for (uint8_t i = 0; i < MAX_NETWORK_HANDLES; ++i) {
+            memcpy(value + valueLen, &mNetworkHandle[i].networkHandle, sizeof(uint64_t));
+            valueLen += sizeof(uint64_t);
+            value[valueLen++] = (uint8_t)mNetworkHandle[i].networkType;
+        }
+        putField(XTRA_IPC_TAG_CONNECTIONS, value, valueLen);
+    }
+    if (mask & XTRA_STATUS_TAC_BIT) {
+        putField(XTRA_IPC_TAG_TAC, mTac.data(), mTac.size());
+    }
+    if (mask & XTRA_STATUS_MCCMNC_BIT) {
+        putField(XTRA_IPC_TAG_MCCMNC, mMccmnc.data(), mMccmnc.size());
+    }
+    if (mask & XTRA_STATUS_XTRA_THROTTLE_BIT) {
+        uint8_t throttle = mXtraThrottle ? 1 : 0;
+        putField(XTRA_IPC_TAG_XTRA_THROTTLE, &throttle, sizeof(throttle));
+    }
+    if (flags & XTRA_IPC_FLAG_STATUS_RESPONSE) {
+        uint8_t known = mIsConnectivityStatusKnown ? 1 : 0;
+        putField(XTRA_IPC_TAG_CONNECTIVITY_KNOWN, &known, sizeof(known));
+    }
+
+    buf[0] = XTRA_IPC_BINARY_MAGIC;
+    buf[1] = XTRA_IPC_BINARY_VERSION;
+    buf[2] = flags;
+    buf[3] = fieldCount;
+    return ( LocIpc::send(*mSender, buf, len) );
+}
+
 bool XtraSystemStatusObserver::updateLockStatus(GnssConfigGpsLock lock) {
     // mask NI(NFW bit) since from XTRA's standpoint GPS is enabled if
     // MO(AFW bit) is enabled and disabled when MO is disabled
@@ -122,6 +238,11 @@ bool XtraSystemStatusObserver::updateLockStatus(GnssConfigGpsLock lock) {
         return true;
     }
 
+    markDirty(XTRA_STATUS_GPS_LOCK_BIT);
+    return true;
+}
+
+bool XtraSystemStatusObserver::sendLockStatusText() {
     stringstream ss;
     ss <<  "gpslock";
     ss << " " << mGpsLock;
@@ -145,6 +266,11 @@ bool XtraSystemStatusObserver::updateConnections(uint64_t allConnections,
         return true;
     }
 
+    markDirty(XTRA_STATUS_CONNECTIONS_BIT);
+    return true;
+}
+
+bool XtraSystemStatusObserver::sendConnectionsText() {
     stringstream ss;
     ss << "connection" << endl << mConnections << endl
             << mNetworkHandle[0].toString() << endl
@@ -168,9 +294,14 @@ bool XtraSystemStatusObserver::updateTac(const string& tac) {
         return true;
     }
 
+    markDirty(XTRA_STATUS_TAC_BIT);
+    return true;
+}
+
+bool XtraSystemStatusObserver::sendTacText() {
     stringstream ss;
     ss <<  "tac";
-    ss << " " << tac.c_str();
+    ss << " " << mTac.c_str();
     string s = ss.str();
     return ( LocIpc::send(*mSender, (const uint8_t*)s.data(), s.size()) );
 }
@@ -182,9 +313,14 @@ bool XtraSystemStatusObserver::updateMccMnc(const string& mccmnc) {
         return true;
     }
 
+    markDirty(XTRA_STATUS_MCCMNC_BIT);
+    return true;
+}
+
+bool XtraSystemStatusObserver::sendMccMncText() {
     stringstream ss;
     ss <<  "mncmcc";
-    ss << " " << mccmnc.c_str();
+    ss << " " << mMccmnc.c_str();
     string s = ss.str();
     return ( LocIpc::send(*mSender, (const uint8_t*)s.data(), s.size()) );
 }
@@ -196,20 +332,42 @@ bool XtraSystemStatusObserver::updateXtraThrottle(const bool enabled) {
         return true;
     }
 
+    markDirty(XTRA_STATUS_XTRA_THROTTLE_BIT);
+    return true;
+}
+
+bool XtraSystemStatusObserver::sendXtraThrottleText() {
     stringstream ss;
     ss <<  "xtrathrottle";
-    ss << " " << (enabled ? 1 : 0);
+    ss << " " << (mXtraThrottle ? 1 : 0);
     string s = ss.str();
     return ( LocIpc::send(*mSender, (const uint8_t*)s.data(), s.size()) );
 }
 
-inline bool XtraSystemStatusObserver::onStatusRequested(int32_t xtraStatusUpdated) {
+inline bool XtraSystemStatusObserver::onStatusRequested(int32_t xtraStatusUpdated,
+                                                        int32_t binaryVersion) {
     mReqStatusReceived = true;
+    mBinaryIpc = (binaryVersion >= XTRA_IPC_BINARY_VERSION);
 
     if (xtraStatusUpdated) {
         return true;
     }
 
+    // the full status below covers anything still waiting in the window
+    mDirtyMask = 0;
+    mFlushTimer.stop();
+
+    if (mBinaryIpc) {
+        uint32_t mask = XTRA_STATUS_TAC_BIT | XTRA_STATUS_MCCMNC_BIT;
+        if (mGpsLock != -1) {
+            mask |= XTRA_STATUS_GPS_LOCK_BIT;
+        }
+        if (mConnections != (uint64_t)~0) {
+            mask |= XTRA_STATUS_CONNECTIONS_BIT;
+        }
+        return sendBinaryStatus(mask, XTRA_IPC_FLAG_STATUS_RESPONSE);
+    }
+
     stringstream ss;
 
     ss << "respondStatus" << endl;
@@ -267,7 +425,7 @@ void XtraSystemStatusObserver::notify(const list<IDataItemCore*>& dlist)
                 const list<IDataItemCore*>& dataItemList) :
                 mXtraSysStatObj(xtraSysStatObs) {
             for (auto eachItem : dataItemList) {
-                IDataItemCore* dataitem = DataItemsFactoryProxy::createNewDataItem(
+                IDataItemCore* dataitem = DataItemsFactoryProxy::obtainDataItem(
                         eachItem->getId());
                 if (NULL == dataitem) {
                     break;
@@ -282,7 +440,7 @@ void XtraSystemStatusObserver::notify(const list<IDataItemCore*>& dlist)
         inline ~HandleOsObserverUpdateMsg() {
             for (auto itor = mDataItemList.begin(); itor != mDataItemList.end(); ++itor) {
                 if (*itor != nullptr) {
-                    delete *itor;
+                    DataItemsFactoryProxy::recycleDataItem(*itor);
                     *itor = nullptr;
                 }
             }
@@ -40,12 +40,41 @@ using loc_core::IOsObserver;
 using loc_core::IDataItemObserver;
 using loc_core::IDataItemCore;
 
+/* status items changed since the last message to the xtra daemon */
+#define XTRA_STATUS_GPS_LOCK_BIT      (1<<0)
+#define XTRA_STATUS_CONNECTIONS_BIT   (1<<1)
+#define XTRA_STATUS_TAC_BIT           (1<<2)
+#define XTRA_STATUS_MCCMNC_BIT        (1<<3)
+#define XTRA_STATUS_XTRA_THROTTLE_BIT (1<<4)
+
+/* changes within this window after the first one go out in one message */
+#define XTRA_IPC_COALESCE_WINDOW_MS 200
+
+/* Binary status message, used once the xtra daemon sends its binary version
+ * in requestStatus, i.e. "requestStatus <updated> <version>"; the text
+ * messages stay in use otherwise.
+ * Layout, host byte order: magic, version, flags, field count, then per field
+ * a tag, a value length and the value. */
+#define XTRA_IPC_BINARY_MAGIC          0xB7
+#define XTRA_IPC_BINARY_VERSION        1
+#define XTRA_IPC_FLAG_STATUS_RESPONSE  0x01
+typedef enum : uint8_t {
+    XTRA_IPC_TAG_GPS_LOCK = 1,      // int32_t
+    XTRA_IPC_TAG_CONNECTIONS,       // uint64_t all connections, then per handle
+                                    // uint64_t handle and uint8_t network type
+    XTRA_IPC_TAG_TAC,               // string, not terminated
+    XTRA_IPC_TAG_MCCMNC,            // string, not terminated
+    XTRA_IPC_TAG_XTRA_THROTTLE,     // uint8_t
+    XTRA_IPC_TAG_CONNECTIVITY_KNOWN // uint8_t, status response only
+} XtraIpcTag;
+
 class XtraSystemStatusObserver : public IDataItemObserver {
 public :
     // constructor & destructor
     XtraSystemStatusObserver(IOsObserver* sysStatObs, const MsgTask* msgTask);
     inline virtual ~XtraSystemStatusObserver() {
         subscribe(false);
+        mFlushTimer.stop();
         mIpc.stopNonBlockingListening();
     }
 
@@ -61,7 +90,8 @@ public :
     bool updateXtraThrottle(const bool enabled);
     inline const MsgTask* getMsgTask() { return mMsgTask; }
     void subscribe(bool yes);
-    bool onStatusRequested(int32_t xtraStatusUpdated);
+    bool onStatusRequested(int32_t xtraStatusUpdated, int32_t binaryVersion);
+    void flushStatus();
 
 private:
     IOsObserver*    mSystemStatusObsrvr;
@@ -75,8 +105,18 @@ private:
     bool mXtraThrottle;
     bool mReqStatusReceived;
     bool mIsConnectivityStatusKnown;
+    bool mBinaryIpc;
+    uint32_t mDirtyMask;
     shared_ptr<LocIpcSender> mSender;
 
+    void markDirty(uint32_t mask);
+    bool sendBinaryStatus(uint32_t mask, uint8_t flags);
+    bool sendLockStatusText();
+    bool sendConnectionsText();
+    bool sendTacText();
+    bool sendMccMncText();
+    bool sendXtraThrottleText();
+
     class DelayLocTimer : public LocTimer {
         LocIpcSender& mSender;
     public:
@@ -85,6 +125,13 @@ private:
             LocIpc::send(mSender, (const uint8_t*)"halinit", sizeof("halinit"));
         }
     } mDelayLocTimer;
+
+    class FlushLocTimer : public LocTimer {
+        XtraSystemStatusObserver& mXSSO;
+    public:
+        FlushLocTimer(XtraSystemStatusObserver& xsso) : mXSSO(xsso) {}
+        void timeOutCallback() override;
+    } mFlushTimer;
 };
 
 #endif
@@ -79,6 +79,9 @@ static void odcpiInject(const Location& location);
 static void blockCPI(double latitude, double longitude, float accuracy,
                      int blockDurationMsec, double latLonDiffThreshold);
 static void updateBatteryStatus(bool charging);
+static void gnssUpdateMeasurementStreamConfig(LocationAPI* client,
+                                              const GnssMeasurementStreamConfig& config);
+static void gnssUpdateSvStatusConfig(LocationAPI* client, const GnssSvStatusConfig& config);
 
 static const GnssInterface gGnssInterface = {
     sizeof(GnssInterface),
@@ -117,7 +120,9 @@ static const GnssInterface gGnssInterface = {
     nfwInit,
     getPowerStateChanges,
     injectLocationExt,
-    updateBatteryStatus
+    updateBatteryStatus,
+    gnssUpdateMeasurementStreamConfig,
+    gnssUpdateSvStatusConfig
 };
 
 #ifndef DEBUG_X86
@@ -390,3 +395,18 @@ static void updateBatteryStatus(bool charging) {
         gGnssAdapter->getSystemStatus()->updatePowerConnectState(charging);
     }
 }
+
+static void gnssUpdateMeasurementStreamConfig(LocationAPI* client,
+                                              const GnssMeasurementStreamConfig& config)
+{
+    if (NULL != gGnssAdapter) {
+        gGnssAdapter->gnssUpdateMeasurementStreamConfigCommand(client, config);
+    }
+}
+
+static void gnssUpdateSvStatusConfig(LocationAPI* client, const GnssSvStatusConfig& config)
+{
+    if (NULL != gGnssAdapter) {
+        gGnssAdapter->gnssUpdateSvStatusConfigCommand(client, config);
+    }
+}
@@ -0,0 +1,224 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// ATL open/close simulator for AgpsStateMachine. A fake modem opens and
+// closes ATL handles at random through AgpsManager, and a fake framework
+// answers the data call requests of the state machine in order, with some
+// of them denied. Every open/close status reported back to a handle is
+// checked against what that handle asked for, and the throughput of the
+// state machine is reported in cycles per second.
+
+#include <gtest/gtest.h>
+
+#include <inttypes.h>
+#include <chrono>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include <Agps.h>
+#include <ContextBase.h>
+
+#define SIM_HANDLES     (4)
+#define SIM_CYCLES      (20000)
+// one data call request in this many is denied
+#define SIM_DENY_ONE_IN (16)
+
+namespace {
+
+typedef enum {
+    HANDLE_IDLE = 0,
+    HANDLE_REQUESTED,   // requestATL sent, no open status yet
+    HANDLE_OPEN,        // open status received
+    HANDLE_RELEASING,   // releaseATL sent, no close status yet
+} HandleState;
+
+class AtlSimulator : public AgpsManager {
+public:
+    AtlSimulator() :
+        mHandles(SIM_HANDLES, HANDLE_IDLE), mCycles(0), mDenied(0), mErrors(0),
+        mRandom(1234) {
+        sInstance = this;
+        registerATLCallbacks(
+                [this] (int handle, int isSuccess, char*, uint32_t, AGpsBearerType,
+                        AGpsExtType, LocApnTypeMask) {
+                    onOpenStatus(handle, isSuccess);
+                },
+                [this] (int handle, int isSuccess) {
+                    onCloseStatus(handle, isSuccess);
+                });
+        AgpsCbInfo cbInfo = {};
+        cbInfo.statusV4Cb = (void*)frameworkStatusCb;
+        cbInfo.atlType = AGPS_ATL_TYPE_WWAN;
+        createAgpsStateMachines(cbInfo);
+    }
+    ~AtlSimulator() {
+        delete mInternetNif;
+        sInstance = nullptr;
+    }
+
+    // one random step of the modem or of the framework
+    void step() {
+        int handle = mRandom() % SIM_HANDLES;
+        switch (mRandom() % 3) {
+        case 0:
+            if (HANDLE_IDLE == mHandles[handle]) {
+                mHandles[handle] = HANDLE_REQUESTED;
+                requestATL(handle, LOC_AGPS_TYPE_WWAN_ANY, LOC_APN_TYPE_MASK_DEFAULT);
+            }
+            break;
+        case 1:
+            release(handle);
+            break;
+        default:
+            answerFramework();
+            break;
+        }
+    }
+
+    void release(int handle) {
+        if (HANDLE_REQUESTED == mHandles[handle] || HANDLE_OPEN == mHandles[handle]) {
+            mHandles[handle] = HANDLE_RELEASING;
+            releaseATL(handle);
+        }
+    }
+
+    // answers the oldest data call request, returns false if there is none
+    bool answerFramework() {
+        if (mFramework.empty()) {
+            return false;
+        }
+        AGnssExtStatusIpV4 request = mFramework.front();
+        mFramework.pop_front();
+        if (LOC_GPS_RELEASE_AGPS_DATA_CONN == request.status) {
+            reportAtlClosed(request.type);
+        } else if (0 == mRandom() % SIM_DENY_ONE_IN) {
+            mDenied++;
+            reportAtlOpenFailed(request.type);
+        } else {
+            char apn[] = "sim.apn";
+            reportAtlOpenSuccess(request.type, apn, sizeof(apn) - 1, AGPS_APN_BEARER_IPV4);
+        }
+        return true;
+    }
+
+    inline AgpsStateMachine* getStateMachine() const { return mInternetNif; }
+
+    std::vector<HandleState> mHandles;
+    std::deque<AGnssExtStatusIpV4> mFramework;
+    uint32_t mCycles;
+    uint32_t mDenied;
+    uint32_t mErrors;
+
+private:
+    static AtlSimulator* sInstance;
+    static void frameworkStatusCb(AGnssExtStatusIpV4 status) {
+        sInstance->mFramework.push_back(status);
+    }
+
+    void onOpenStatus(int handle, int isSuccess) {
+        if (handle < 0 || handle >= SIM_HANDLES || HANDLE_REQUESTED != mHandles[handle]) {
+            ADD_FAILURE() << "open status " << isSuccess << " for handle " << handle
+                          << " in state " << (handle >= 0 && handle < SIM_HANDLES ?
+                                                      mHandles[handle] : -1);
+            mErrors++;
+            return;
+        }
+        mHandles[handle] = isSuccess ? HANDLE_OPEN : HANDLE_IDLE;
+    }
+
+    void onCloseStatus(int handle, int isSuccess) {
+        // a forced release of the data call closes open handles unasked
+        if (handle < 0 || handle >= SIM_HANDLES || !isSuccess ||
+                (HANDLE_RELEASING != mHandles[handle] && HANDLE_OPEN != mHandles[handle])) {
+            ADD_FAILURE() << "close status " << isSuccess << " for handle " << handle
+                          << " in state " << (handle >= 0 && handle < SIM_HANDLES ?
+                                                      mHandles[handle] : -1);
+            mErrors++;
+            return;
+        }
+        mHandles[handle] = HANDLE_IDLE;
+        mCycles++;
+    }
+
+    std::mt19937 mRandom;
+};
+
+AtlSimulator* AtlSimulator::sInstance = nullptr;
+
+} // namespace
+
+TEST(AgpsStateMachineTest, OpenCloseCycles)
+{
+    AtlSimulator sim;
+    ASSERT_NE(nullptr, sim.getStateMachine());
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t steps = 0;
+    while (sim.mCycles < SIM_CYCLES && 0 == sim.mErrors) {
+        sim.step();
+        steps++;
+    }
+    double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+    // close everything and let the framework answer until nothing is left
+    for (int handle = 0; handle < SIM_HANDLES; handle++) {
+        sim.release(handle);
+    }
+    while (sim.answerFramework()) {
+        for (int handle = 0; handle < SIM_HANDLES; handle++) {
+            sim.release(handle);
+        }
+    }
+
+    EXPECT_EQ(0u, sim.mErrors);
+    EXPECT_GT(sim.mDenied, 0u);
+    for (int handle = 0; handle < SIM_HANDLES; handle++) {
+        EXPECT_EQ(HANDLE_IDLE, sim.mHandles[handle]) << "handle " << handle;
+    }
+    EXPECT_EQ(0u, sim.getStateMachine()->getSubscriberCount());
+
+    printf("%u open/close cycles, %" PRIu64 " steps in %.3f s: %.0f cycles/s\n",
+           sim.mCycles, steps, seconds, sim.mCycles / seconds);
+    RecordProperty("cycles_per_second", (int)(sim.mCycles / seconds));
+}
+
+TEST(AgpsStateMachineTest, ModemSsrDropsSubscribers)
+{
+    AtlSimulator sim;
+    ASSERT_NE(nullptr, sim.getStateMachine());
+
+    for (int handle = 0; handle < SIM_HANDLES; handle++) {
+        sim.requestATL(handle, LOC_AGPS_TYPE_WWAN_ANY, LOC_APN_TYPE_MASK_DEFAULT);
+    }
+    EXPECT_EQ((size_t)SIM_HANDLES, sim.getStateMachine()->getSubscriberCount());
+    sim.handleModemSSR();
+    EXPECT_EQ(0u, sim.getStateMachine()->getSubscriberCount());
+}
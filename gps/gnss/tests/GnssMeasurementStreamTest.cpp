@@ -0,0 +1,356 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Feeds synthetic measurement epochs to GnssMeasurementStream and checks
+// what a client receives: the decimated epochs, the measurements left by
+// its filters, and delta encoded records that decode back to them.
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <vector>
+
+#include <GnssMeasurementStream.h>
+
+#define EPOCH_NS        (100 * 1000000LL)   // 10Hz engine epochs
+#define L1_HZ           (1575.42e6f)
+#define L5_HZ           (1176.45e6f)
+
+namespace {
+
+void fillEpoch(GnssMeasurementsNotification& n, int epoch)
+{
+    memset(&n, 0, sizeof(n));
+    n.size = sizeof(n);
+    n.clock.timeNs = epoch * EPOCH_NS;
+    n.count = 8;
+    for (uint32_t i = 0; i < n.count; i++) {
+        GnssMeasurementsData& m = n.measurements[i];
+        m.size = sizeof(m);
+        m.svId = i + 1;
+        m.svType = (i % 2) ? GNSS_SV_TYPE_GALILEO : GNSS_SV_TYPE_GPS;
+        m.carrierFrequencyHz = (i % 4 < 2) ? L1_HZ : L5_HZ;
+        m.codeType = GNSS_MEASUREMENTS_CODE_TYPE_C;
+        m.stateMask = 0x47;
+        // one slow field changes now and then, the dynamic ones every epoch
+        m.multipathIndicator = (GnssMeasurementsMultipathIndicator)((epoch / 5 + i) % 3);
+        m.receivedSvTimeNs = epoch * EPOCH_NS + i;
+        m.carrierToNoiseDbHz = 30 + i + epoch * 0.01;
+        m.pseudorangeRateMps = -100.0 * i + epoch;
+        m.carrierCycles = epoch * 1000 + i;
+    }
+    // the last SV uses a code type only known by name
+    n.measurements[7].codeType = GNSS_MEASUREMENTS_CODE_TYPE_OTHER;
+    strncpy(n.measurements[7].otherCodeTypeName, "X5", GNSS_MAX_NAME_LENGTH);
+}
+
+/* Decodes the records of one stream, as documented in
+ * GnssMeasurementStream.h. */
+class DeltaDecoder {
+public:
+    DeltaDecoder() : mKeyFrames(0) { memset(&mPrevious, 0, sizeof(mPrevious)); }
+
+    bool decode(const uint8_t* data, size_t length, GnssMeasurementsNotification& out)
+    {
+        mData = data;
+        mEnd = data + length;
+        memset(&out, 0, sizeof(out));
+
+        uint8_t version = get<uint8_t>();
+        uint8_t recordFlags = get<uint8_t>();
+        out.count = get<uint16_t>();
+        out.clock = get<GnssMeasurementsClock>();
+        if (GNSS_MEAS_STREAM_VERSION != version || out.count > GNSS_MEASUREMENTS_MAX) {
+            return false;
+        }
+        bool keyFrame = recordFlags & GNSS_MEAS_STREAM_KEY_FRAME_BIT;
+        if (keyFrame) {
+            mKeyFrames++;
+        } else if (0 == mKeyFrames) {
+            return false;
+        }
+
+        for (uint32_t i = 0; i < out.count; i++) {
+            GnssMeasurementsData& m = out.measurements[i];
+            m = mPrevious.measurements[i];
+            uint16_t changeMask = get<uint16_t>();
+            if (keyFrame && GNSS_MEAS_STREAM_CHANGED_ALL != changeMask) {
+                return false;
+            }
+            if (changeMask & GNSS_MEAS_STREAM_CHANGED_SV_ID)
+                m.svId = get<int16_t>();
+            if (changeMask & GNSS_MEAS_STREAM_CHANGED_SV_TYPE)
+                m.svType = (GnssSvType)get<uint8_t>();
+            if (changeMask & GNSS_MEAS_STREAM_CHANGED_CODE_TYPE) {
+                m.codeType = (GnssMeasurementsCodeType)get<uint8_t>();
+                if (GNSS_MEASUREMENTS_CODE_TYPE_OTHER == m.codeType) {
+                    for (int c = 0; c < GNSS_MAX_NAME_LENGTH; c++)
+                        m.otherCodeTypeName[c] = get<char>();
+                }
+            }
+            if (changeMask & GNSS_MEAS_STREAM_CHANGED_FLAGS)
+                m.flags = get<uint32_t>();
+            if (changeMask & GNSS_MEAS_STREAM_CHANGED_STATE)
+                m.stateMask = get<uint32_t>();
+            if (changeMask & GNSS_MEAS_STREAM_CHANGED_ADR_STATE)
+                m.adrStateMask = get<uint32_t>();
+            if (changeMask & GNSS_MEAS_STREAM_CHANGED_CARRIER_FREQ)
+                m.carrierFrequencyHz = get<float>();
+            if (changeMask & GNSS_MEAS_STREAM_CHANGED_MULTIPATH)
+                m.multipathIndicator = (GnssMeasurementsMultipathIndicator)get<uint8_t>();
+            if (changeMask & GNSS_MEAS_STREAM_CHANGED_TIME_OFFSET)
+                m.timeOffsetNs = get<double>();
+            if (changeMask & GNSS_MEAS_STREAM_CHANGED_AGC)
+                m.agcLevelDb = get<double>();
+            m.receivedSvTimeNs = get<int64_t>();
+            m.receivedSvTimeUncertaintyNs = get<int64_t>();
+            m.carrierToNoiseDbHz = get<double>();
+            m.pseudorangeRateMps = get<double>();
+            m.pseudorangeRateUncertaintyMps = get<double>();
+            m.adrMeters = get<double>();
+            m.adrUncertaintyMeters = get<double>();
+            m.carrierCycles = get<int64_t>();
+            m.carrierPhase = get<double>();
+            m.carrierPhaseUncertainty = get<double>();
+            m.signalToNoiseRatioDb = get<double>();
+            mPrevious.measurements[i] = m;
+        }
+        return mData == mEnd;
+    }
+
+    uint32_t keyFrames() const { return mKeyFrames; }
+
+private:
+    template <typename T> T get()
+    {
+        T value;
+        memset(&value, 0, sizeof(value));
+        if (mData + sizeof(T) <= mEnd) {
+            memcpy(&value, mData, sizeof(T));
+        }
+        mData += sizeof(T);
+        return value;
+    }
+
+    const uint8_t* mData;
+    const uint8_t* mEnd;
+    uint32_t mKeyFrames;
+    GnssMeasurementsNotification mPrevious;
+};
+
+void expectSameMeasurement(const GnssMeasurementsData& expected,
+                           const GnssMeasurementsData& actual)
+{
+    EXPECT_EQ(expected.svId, actual.svId);
+    EXPECT_EQ(expected.svType, actual.svType);
+    EXPECT_EQ(expected.codeType, actual.codeType);
+    EXPECT_EQ(0, strncmp(expected.otherCodeTypeName, actual.otherCodeTypeName,
+                         GNSS_MAX_NAME_LENGTH));
+    EXPECT_EQ(expected.stateMask, actual.stateMask);
+    EXPECT_EQ(expected.carrierFrequencyHz, actual.carrierFrequencyHz);
+    EXPECT_EQ(expected.multipathIndicator, actual.multipathIndicator);
+    EXPECT_EQ(expected.receivedSvTimeNs, actual.receivedSvTimeNs);
+    EXPECT_EQ(expected.carrierToNoiseDbHz, actual.carrierToNoiseDbHz);
+    EXPECT_EQ(expected.pseudorangeRateMps, actual.pseudorangeRateMps);
+    EXPECT_EQ(expected.carrierCycles, actual.carrierCycles);
+}
+
+GnssMeasurementStreamConfig makeConfig()
+{
+    GnssMeasurementStreamConfig config = {};
+    config.size = sizeof(config);
+    return config;
+}
+
+} // namespace
+
+TEST(GnssMeasurementStreamTest, DefaultConfigIsPassThrough)
+{
+    GnssMeasurementStreamConfig config = makeConfig();
+    EXPECT_TRUE(GnssMeasurementStream::isPassThrough(config));
+
+    config.minIntervalMs = 1000;
+    EXPECT_FALSE(GnssMeasurementStream::isPassThrough(config));
+
+    config = makeConfig();
+    config.svTypeMask = (1 << GNSS_SV_TYPE_GPS);
+    EXPECT_FALSE(GnssMeasurementStream::isPassThrough(config));
+
+    config = makeConfig();
+    config.flags = GNSS_MEASUREMENT_STREAM_DELTA_ENCODED_BIT;
+    EXPECT_FALSE(GnssMeasurementStream::isPassThrough(config));
+}
+
+TEST(GnssMeasurementStreamTest, DecimatesToMinInterval)
+{
+    GnssMeasurementStreamConfig config = makeConfig();
+    config.minIntervalMs = 1000;
+    GnssMeasurementStream stream(config);
+    static GnssMeasurementsNotification epoch;
+    std::vector<int64_t> delivered;
+
+    for (int i = 0; i < 100; i++) {
+        fillEpoch(epoch, i);
+        stream.report(epoch, [&](GnssMeasurementsNotification n) {
+            delivered.push_back(n.clock.timeNs);
+        });
+    }
+
+    ASSERT_EQ(10u, delivered.size());
+    for (size_t i = 0; i < delivered.size(); i++) {
+        EXPECT_EQ((int64_t)i * 10 * EPOCH_NS, delivered[i]);
+    }
+
+    // a clock discontinuity restarts the interval
+    fillEpoch(epoch, 101);
+    epoch.clock.hwClockDiscontinuityCount = 1;
+    stream.report(epoch, [&](GnssMeasurementsNotification n) {
+        delivered.push_back(n.clock.timeNs);
+    });
+    EXPECT_EQ(11u, delivered.size());
+}
+
+TEST(GnssMeasurementStreamTest, KeepsJitteredEpochsAtTheInterval)
+{
+    GnssMeasurementStreamConfig config = makeConfig();
+    config.minIntervalMs = 1000;
+    GnssMeasurementStream stream(config);
+    static GnssMeasurementsNotification epoch;
+    int delivered = 0;
+
+    // 1Hz engine epochs, up to 20ms early or late: none is dropped
+    for (int i = 0; i < 60; i++) {
+        fillEpoch(epoch, 0);
+        epoch.clock.timeNs = i * 1000 * 1000000LL + (i % 3 - 1) * 20 * 1000000LL;
+        stream.report(epoch, [&](GnssMeasurementsNotification) { delivered++; });
+    }
+    EXPECT_EQ(60, delivered);
+}
+
+TEST(GnssMeasurementStreamTest, FiltersMeasurements)
+{
+    GnssMeasurementStreamConfig config = makeConfig();
+    config.svTypeMask = (1 << GNSS_SV_TYPE_GPS);
+    config.minCarrierFrequencyHz = 1500e6f;
+    GnssMeasurementStream stream(config);
+    static GnssMeasurementsNotification epoch;
+    int reports = 0;
+
+    fillEpoch(epoch, 0);
+    stream.report(epoch, [&](GnssMeasurementsNotification n) {
+        reports++;
+        // GPS on L1: SVs 1 and 5, in their original order
+        ASSERT_EQ(2u, n.count);
+        expectSameMeasurement(epoch.measurements[0], n.measurements[0]);
+        expectSameMeasurement(epoch.measurements[4], n.measurements[1]);
+        EXPECT_EQ(epoch.clock.timeNs, n.clock.timeNs);
+    });
+    EXPECT_EQ(1, reports);
+}
+
+TEST(GnssMeasurementStreamTest, FiltersCodeTypes)
+{
+    GnssMeasurementStreamConfig config = makeConfig();
+    static GnssMeasurementsNotification epoch;
+    std::vector<GnssMeasurementsNotification> delivered;
+    auto collect = [&](GnssMeasurementsNotification n) { delivered.push_back(n); };
+
+    fillEpoch(epoch, 0);
+    epoch.measurements[1].codeType = GNSS_MEASUREMENTS_CODE_TYPE_Q;
+
+    // C only: the OTHER SV is dropped along with the Q one
+    config.codeTypeMask = (1 << GNSS_MEASUREMENTS_CODE_TYPE_C);
+    GnssMeasurementStream cOnly(config);
+    cOnly.report(epoch, collect);
+    ASSERT_EQ(1u, delivered.size());
+    EXPECT_EQ(6u, delivered[0].count);
+    for (uint32_t i = 0; i < delivered[0].count; i++) {
+        EXPECT_EQ(GNSS_MEASUREMENTS_CODE_TYPE_C, delivered[0].measurements[i].codeType);
+    }
+
+    // OTHER has its own bit
+    delivered.clear();
+    config.codeTypeMask = GNSS_MEASUREMENTS_CODE_TYPE_OTHER_BIT;
+    GnssMeasurementStream otherOnly(config);
+    otherOnly.report(epoch, collect);
+    ASSERT_EQ(1u, delivered.size());
+    ASSERT_EQ(1u, delivered[0].count);
+    expectSameMeasurement(epoch.measurements[7], delivered[0].measurements[0]);
+
+    delivered.clear();
+    config.codeTypeMask = (1 << GNSS_MEASUREMENTS_CODE_TYPE_Q) |
+            GNSS_MEASUREMENTS_CODE_TYPE_OTHER_BIT;
+    GnssMeasurementStream qAndOther(config);
+    qAndOther.report(epoch, collect);
+    ASSERT_EQ(1u, delivered.size());
+    ASSERT_EQ(2u, delivered[0].count);
+    expectSameMeasurement(epoch.measurements[1], delivered[0].measurements[0]);
+    expectSameMeasurement(epoch.measurements[7], delivered[0].measurements[1]);
+}
+
+TEST(GnssMeasurementStreamTest, DeltaRecordsDecodeToEachEpoch)
+{
+    const int epochs = 3 * GNSS_MEAS_STREAM_KEY_FRAME_INTERVAL + 2;
+    GnssMeasurementStreamConfig config = makeConfig();
+    config.flags = GNSS_MEASUREMENT_STREAM_DELTA_ENCODED_BIT;
+    static GnssMeasurementsNotification epoch, decoded;
+    DeltaDecoder decoder;
+    size_t keyFrameBytes = 0, deltaBytes = 0;
+    int records = 0;
+
+    config.deltaCb = [&](const uint8_t* data, size_t length) {
+        records++;
+        ASSERT_TRUE(decoder.decode(data, length, decoded)) << "record " << records;
+        ASSERT_EQ(epoch.count, decoded.count);
+        EXPECT_EQ(epoch.clock.timeNs, decoded.clock.timeNs);
+        for (uint32_t i = 0; i < epoch.count; i++) {
+            expectSameMeasurement(epoch.measurements[i], decoded.measurements[i]);
+        }
+        if (1 == records) {
+            keyFrameBytes = length;
+        } else if (2 == records) {
+            deltaBytes = length;
+        }
+    };
+    GnssMeasurementStream stream(config);
+    bool measurementsCbCalled = false;
+
+    for (int i = 0; i < epochs; i++) {
+        fillEpoch(epoch, i);
+        stream.report(epoch, [&](GnssMeasurementsNotification) {
+            measurementsCbCalled = true;
+        });
+    }
+
+    EXPECT_EQ(epochs, records);
+    EXPECT_FALSE(measurementsCbCalled);
+    // records 1, 17, 33 and 49
+    EXPECT_EQ(4u, decoder.keyFrames());
+    EXPECT_LT(deltaBytes, keyFrameBytes);
+}
@@ -0,0 +1,276 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Drives GnssPowerPolicy with charging and screen states and with engine
+// energy samples, and checks the policy it picks in every transition, the
+// budget hysteresis, the conversion of the energy samples to an average
+// power, and the tracking intervals it hands out.
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <GnssPowerPolicy.h>
+
+#define BUDGET_MW       (500)
+#define SAMPLE_MS       (1000)
+// energy samples are in 0.1 mWs
+#define UNITS_PER_MWS   (10)
+
+namespace {
+
+// policies told apart by their interval scale
+const char* const sPolicies[GNSS_POWER_POLICY_COUNT] = {
+    "100 0 1 0",            // CHARGING
+    "150 1000 1 0",         // SCREEN_ON
+    "200 5000 0 1000",      // SCREEN_OFF
+    "400 10000 0 5000",     // OVER_BUDGET
+};
+const uint32_t sScales[GNSS_POWER_POLICY_COUNT] = {100, 150, 200, 400};
+
+class GnssPowerPolicyTest : public ::testing::Test {
+protected:
+    GnssPowerPolicyTest() :
+        mPolicy(nullptr, nullptr, [this] { mChanges++; }, [] {}),
+        mChanges(0), mEnergy(0), mNowMs(0) {}
+
+    void SetUp() override {
+        mPolicy.init(sPolicies, BUDGET_MW);
+        // the first sample only sets the start of the average
+        sample(0);
+    }
+
+    GnssPowerPolicyId policy() const {
+        for (uint32_t i = 0; i < GNSS_POWER_POLICY_COUNT; i++) {
+            if (sScales[i] == mPolicy.current().intervalScalePercent) {
+                return (GnssPowerPolicyId)i;
+            }
+        }
+        return GNSS_POWER_POLICY_COUNT;
+    }
+
+    // reports averageMw over the last SAMPLE_MS
+    void sample(uint64_t averageMw) {
+        mEnergy += averageMw * SAMPLE_MS / 1000 * UNITS_PER_MWS;
+        mNowMs += SAMPLE_MS;
+        mPolicy.onEnergyConsumed(mEnergy, mNowMs);
+    }
+
+    void setState(bool charging, bool screenOn) {
+        mPolicy.onStateChanged(true, charging, true, screenOn);
+    }
+
+    // back to CHARGING and under budget
+    void reset() {
+        setState(true, true);
+        sample(0);
+    }
+
+    // moves to policy id in a single change from any policy entered by reset()
+    // or by enter()
+    void enter(GnssPowerPolicyId id) {
+        switch (id) {
+        case GNSS_POWER_POLICY_CHARGING:
+            setState(true, true);
+            break;
+        case GNSS_POWER_POLICY_SCREEN_ON:
+            setState(false, true);
+            sample(0);
+            break;
+        case GNSS_POWER_POLICY_SCREEN_OFF:
+            setState(false, false);
+            sample(0);
+            break;
+        default:
+            sample(2 * BUDGET_MW);
+            setState(false, true);
+            break;
+        }
+    }
+
+    GnssPowerPolicy mPolicy;
+    int mChanges;
+    uint64_t mEnergy;
+    int64_t mNowMs;
+};
+
+} // namespace
+
+TEST_F(GnssPowerPolicyTest, StartsWithScreenOn)
+{
+    EXPECT_EQ(GNSS_POWER_POLICY_SCREEN_ON, policy());
+    EXPECT_EQ(0, mChanges);
+}
+
+TEST_F(GnssPowerPolicyTest, MakesEveryTransition)
+{
+    for (uint32_t from = 0; from < GNSS_POWER_POLICY_COUNT; from++) {
+        for (uint32_t to = 0; to < GNSS_POWER_POLICY_COUNT; to++) {
+            if (from == to) {
+                continue;
+            }
+            reset();
+            enter((GnssPowerPolicyId)from);
+            ASSERT_EQ(from, policy());
+            mChanges = 0;
+            enter((GnssPowerPolicyId)to);
+            EXPECT_EQ(to, policy()) << "from " << from;
+            EXPECT_EQ(1, mChanges) << "from " << from << " to " << to;
+        }
+    }
+}
+
+TEST_F(GnssPowerPolicyTest, ChargingOverridesTheOtherStates)
+{
+    enter(GNSS_POWER_POLICY_OVER_BUDGET);
+    setState(true, false);
+    EXPECT_EQ(GNSS_POWER_POLICY_CHARGING, policy());
+
+    // still over budget when unplugged
+    mChanges = 0;
+    setState(false, false);
+    EXPECT_EQ(GNSS_POWER_POLICY_OVER_BUDGET, policy());
+    EXPECT_EQ(1, mChanges);
+}
+
+TEST_F(GnssPowerPolicyTest, KeepsUnreportedState)
+{
+    setState(false, false);
+    mChanges = 0;
+
+    // a charging update leaves the screen state alone and the other way around
+    mPolicy.onStateChanged(true, false, false, true);
+    EXPECT_EQ(GNSS_POWER_POLICY_SCREEN_OFF, policy());
+    mPolicy.onStateChanged(false, true, true, false);
+    EXPECT_EQ(GNSS_POWER_POLICY_SCREEN_OFF, policy());
+    EXPECT_EQ(0, mChanges);
+}
+
+TEST_F(GnssPowerPolicyTest, AppliesBudgetHysteresis)
+{
+    // at the budget is not over it
+    sample(BUDGET_MW);
+    EXPECT_EQ(GNSS_POWER_POLICY_SCREEN_ON, policy());
+    sample(BUDGET_MW + 1);
+    EXPECT_EQ(GNSS_POWER_POLICY_OVER_BUDGET, policy());
+
+    // back under budget only below 90% of it
+    sample(BUDGET_MW);
+    EXPECT_EQ(GNSS_POWER_POLICY_OVER_BUDGET, policy());
+    sample(BUDGET_MW * POWER_POLICY_BUDGET_HYSTERESIS_PERCENT / 100);
+    EXPECT_EQ(GNSS_POWER_POLICY_OVER_BUDGET, policy());
+    sample(BUDGET_MW * POWER_POLICY_BUDGET_HYSTERESIS_PERCENT / 100 - 1);
+    EXPECT_EQ(GNSS_POWER_POLICY_SCREEN_ON, policy());
+
+    // and over it again only above the budget
+    sample(BUDGET_MW);
+    EXPECT_EQ(GNSS_POWER_POLICY_SCREEN_ON, policy());
+}
+
+TEST_F(GnssPowerPolicyTest, ConvertsEnergyToAveragePower)
+{
+    // 0.1 mWs units over ms: 6 units in 1 ms are 600 mW
+    mNowMs += 1;
+    mEnergy += 6;
+    mPolicy.onEnergyConsumed(mEnergy, mNowMs);
+    EXPECT_EQ(GNSS_POWER_POLICY_OVER_BUDGET, policy());
+
+    // 4490 units in 1 s are 449 mW, under 90% of the budget
+    mNowMs += 1000;
+    mEnergy += 4490;
+    mPolicy.onEnergyConsumed(mEnergy, mNowMs);
+    EXPECT_EQ(GNSS_POWER_POLICY_SCREEN_ON, policy());
+
+    // 5010 units in 1 s are 501 mW
+    mNowMs += 1000;
+    mEnergy += 5010;
+    mPolicy.onEnergyConsumed(mEnergy, mNowMs);
+    EXPECT_EQ(GNSS_POWER_POLICY_OVER_BUDGET, policy());
+}
+
+TEST_F(GnssPowerPolicyTest, IgnoresInvalidEnergySamples)
+{
+    sample(2 * BUDGET_MW);
+    ASSERT_EQ(GNSS_POWER_POLICY_OVER_BUDGET, policy());
+
+    // unknown energy, a counter gone backwards and no time elapsed are not
+    // averaged; the sample after them starts the average over
+    mPolicy.onEnergyConsumed(UINT64_MAX, mNowMs + SAMPLE_MS);
+    EXPECT_EQ(GNSS_POWER_POLICY_OVER_BUDGET, policy());
+    mEnergy = 0;
+    mNowMs += SAMPLE_MS;
+    mPolicy.onEnergyConsumed(mEnergy, mNowMs);
+    EXPECT_EQ(GNSS_POWER_POLICY_OVER_BUDGET, policy());
+    mPolicy.onEnergyConsumed(mEnergy + 1000, mNowMs);
+    EXPECT_EQ(GNSS_POWER_POLICY_OVER_BUDGET, policy());
+
+    mEnergy += 1000;
+    sample(0);
+    EXPECT_EQ(GNSS_POWER_POLICY_SCREEN_ON, policy());
+}
+
+TEST_F(GnssPowerPolicyTest, AdaptsTrackingInterval)
+{
+    TrackingOptions options;
+
+    // SCREEN_ON scales by 150% with a 1000 ms floor
+    options.minInterval = 0;
+    mPolicy.adaptTrackingOptions(options);
+    EXPECT_EQ(1000u, options.minInterval);
+    options.minInterval = 2000;
+    mPolicy.adaptTrackingOptions(options);
+    EXPECT_EQ(3000u, options.minInterval);
+
+    // OVER_BUDGET scales by 400%, which saturates
+    enter(GNSS_POWER_POLICY_OVER_BUDGET);
+    options.minInterval = UINT32_MAX / 2;
+    mPolicy.adaptTrackingOptions(options);
+    EXPECT_EQ(UINT32_MAX, options.minInterval);
+    options.minInterval = UINT32_MAX;
+    mPolicy.adaptTrackingOptions(options);
+    EXPECT_EQ(UINT32_MAX, options.minInterval);
+}
+
+TEST(GnssPowerPolicyDefaultTest, PassesIntervalsThrough)
+{
+    const char* const noPolicies[GNSS_POWER_POLICY_COUNT] = {};
+    GnssPowerPolicy policy(nullptr, nullptr, [] {}, [] {});
+    policy.init(noPolicies, 0);
+
+    TrackingOptions options;
+    const uint32_t intervals[] = {0, 1000, UINT32_MAX};
+    for (uint32_t interval : intervals) {
+        options.minInterval = interval;
+        policy.adaptTrackingOptions(options);
+        EXPECT_EQ(interval, options.minInterval);
+    }
+    EXPECT_TRUE(policy.current().nmeaEnabled);
+    EXPECT_TRUE(policy.allowMeasurementReport(0));
+    EXPECT_TRUE(policy.allowMeasurementReport(1));
+}
@@ -17,7 +17,8 @@ LOCAL_SHARED_LIBRARIES := \
     liblog
 
 LOCAL_SRC_FILES += \
-   gnsspps.c
+   gnsspps.c \
+   ppsmodel.c
 
 LOCAL_CFLAGS += \
     -fno-short-enums \
@@ -34,3 +35,19 @@ include $(CLEAR_VARS)
 LOCAL_MODULE := libgnsspps_headers
 LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)
 include $(BUILD_HEADER_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := libgnsspps-model-test
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_SRC_FILES := \
+    tests/PpsModelTest.cpp \
+    ppsmodel.c
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)
+
+LOCAL_CFLAGS += \
+     -fno-short-enums \
+
+include $(BUILD_HOST_NATIVE_TEST)
@@ -40,15 +40,30 @@
 #include <inttypes.h>
 #include <time.h>
 #include <math.h>
+#include <gnsspps.h>
+#include <ppsmodel.h>
 
 #define BILLION_NSEC  (1E9)
 
 typedef struct timespec pps_sync_time;
 
-//DRsync kernel timestamp
-static struct timespec drsyncKernelTs = {0,0};
-//DRsync userspace timestamp
-static struct timespec drsyncUserTs = {0,0};
+/* PPS state published by the PPS thread */
+typedef struct {
+    //DRsync kernel timestamp
+    struct timespec kernelTs;
+    //DRsync userspace timestamp
+    struct timespec userTs;
+    pps_clock_model model;
+} pps_snapshot;
+
+/* ppsSnapshot is only written by the PPS thread and read lock free: ppsSeq is
+   odd while an update is in progress, readers retry if it was odd or changed
+   while they copied the snapshot */
+static pps_snapshot ppsSnapshot;
+static uint32_t ppsSeq = 0;
+
+/* pulses the clock model is fitted over, PPS thread only */
+static pps_model_window ppsWindow;
 
 static struct timespec prevDrsyncKernelTs = {0,0};
 
@@ -56,7 +71,6 @@ static struct timespec prevDrsyncKernelTs = {0,0};
 static int isActive = 0;
 static pps_handle handle;
 
-static pthread_mutex_t ts_lock;
 static int skipPPSPulseCnt = 0;
 static int gnssOutageInSec = 1;
 static loc_param_s_type gps_conf_param_table[] =
@@ -164,13 +178,17 @@ static kernel_reported_time_e get_reported_time_type(pps_sync_time userBootTs,
     return reportedTime;
 }
 
-/*compute_real_to_boot_time - converts the kernel real time stamp to boot time reference*/
-static int compute_real_to_boot_time(pps_info ppsFetchTime)
+/*compute_real_to_boot_time - converts the kernel real time stamp to boot time reference,
+  the results are returned in drsyncKernelTs and drsyncUserTs*/
+static int compute_real_to_boot_time(pps_info ppsFetchTime, pps_sync_time* drsyncKernelTs,
+                                     pps_sync_time* drsyncUserTs)
 {
     int retVal = 0;
     /*Offset between REAL_TIME to BOOT_TIME*/
     static pps_sync_time time_offset = {0, 0};
-    pps_sync_time  drSyncUserRealTs, drSyncUserBootTs;
+    /*Clock the kernel reported the previous pulse in*/
+    static kernel_reported_time_e prevPpsTimeType = KERNEL_REPORTED_CLOCK_UNKNOWN;
+    pps_sync_time  drSyncUserRealTs = {0, 0}, drSyncUserBootTs;
     pps_sync_time  deltaRealToBootTime = {0, 0};
     pps_sync_time  deltaOffsetTime = {0, 0};
     kernel_reported_time_e  ppsTimeType;
@@ -181,23 +199,32 @@ static int compute_real_to_boot_time(pps_info ppsFetchTime)
         retVal = -1;
         goto exit0;
     }
-    retVal = clock_gettime(CLOCK_REALTIME,&drSyncUserRealTs);
-    if (retVal != 0){
-        LOC_LOGE("[%s]Error Reading CLOCK_REALTIME", __func__);
-        retVal = -1;
-        goto exit0;
-    }
 
-    ppsTimeType = get_reported_time_type(drSyncUserBootTs, drSyncUserRealTs, ppsFetchTime);
+    if (KERNEL_REPORTED_CLOCK_BOOTTIME == prevPpsTimeType &&
+        fabs(convertTimeToMilliSec(drSyncUserBootTs) - convertTimeToMilliSec(ppsFetchTime)) <=
+        MAX_PPS_KERNEL_TO_USERSPACE_LATENCY) {
+        /*Kernel still reports CLOCK_BOOTTIME, CLOCK_REALTIME is not needed*/
+        ppsTimeType = KERNEL_REPORTED_CLOCK_BOOTTIME;
+    } else {
+        retVal = clock_gettime(CLOCK_REALTIME,&drSyncUserRealTs);
+        if (retVal != 0){
+            LOC_LOGE("[%s]Error Reading CLOCK_REALTIME", __func__);
+            retVal = -1;
+            goto exit0;
+        }
+
+        ppsTimeType = get_reported_time_type(drSyncUserBootTs, drSyncUserRealTs, ppsFetchTime);
+    }
+    prevPpsTimeType = ppsTimeType;
 
     if (KERNEL_REPORTED_CLOCK_BOOTTIME == ppsTimeType) {
 
         /*Store PPS kernel time*/
-        drsyncKernelTs.tv_sec = ppsFetchTime.tv_sec;
-        drsyncKernelTs.tv_nsec = ppsFetchTime.tv_nsec;
+        drsyncKernelTs->tv_sec = ppsFetchTime.tv_sec;
+        drsyncKernelTs->tv_nsec = ppsFetchTime.tv_nsec;
         /*Store User PPS fetch time*/
-        drsyncUserTs.tv_sec = drSyncUserBootTs.tv_sec;
-        drsyncUserTs.tv_nsec = drSyncUserBootTs.tv_nsec;
+        drsyncUserTs->tv_sec = drSyncUserBootTs.tv_sec;
+        drsyncUserTs->tv_nsec = drSyncUserBootTs.tv_nsec;
 
         LOC_LOGV("[compute_real_to_boot] PPS TimeType CLOCK_BOOTTIME -- report as is");
         retVal = 0;
@@ -213,9 +240,9 @@ static int compute_real_to_boot_time(pps_info ppsFetchTime)
             (isTimeOffsetOk(deltaOffsetTime))) {
             /* if Time Offset does not change beyond threshold then
             ** convert to boot time*/
-            drsyncUserTs.tv_sec = drSyncUserBootTs.tv_sec;
-            drsyncUserTs.tv_nsec = drSyncUserBootTs.tv_nsec;
-            pps_sync_time_add(ppsFetchTime, deltaRealToBootTime, &drsyncKernelTs);
+            drsyncUserTs->tv_sec = drSyncUserBootTs.tv_sec;
+            drsyncUserTs->tv_nsec = drSyncUserBootTs.tv_nsec;
+            pps_sync_time_add(ppsFetchTime, deltaRealToBootTime, drsyncKernelTs);
             retVal = 0;
         } else {
             /*The offset is too high, jump detected in realTime tick, either
@@ -230,14 +257,14 @@ static int compute_real_to_boot_time(pps_info ppsFetchTime)
 
         LOC_LOGV("[compute_real_to_boot] KernelRealTs %ld:%ld ComputedTs %ld:%ld RealTs %ld:%ld BootTs %ld:%ld Offset %ld:%ld retVal %d ",
                 ppsFetchTime.tv_sec, ppsFetchTime.tv_nsec,
-                drsyncKernelTs.tv_sec, drsyncKernelTs.tv_nsec, drSyncUserRealTs.tv_sec,
-                drSyncUserRealTs.tv_nsec, drsyncUserTs.tv_sec, drsyncUserTs.tv_nsec,
+                drsyncKernelTs->tv_sec, drsyncKernelTs->tv_nsec, drSyncUserRealTs.tv_sec,
+                drSyncUserRealTs.tv_nsec, drsyncUserTs->tv_sec, drsyncUserTs->tv_nsec,
                 time_offset.tv_sec, time_offset.tv_nsec, retVal);
     } else {
         LOC_LOGV("[compute_real_to_boot] PPS TimeType Unknown -- KernelTs %ld:%ld userRealTs %ld:%ld userBootTs %ld:%ld",
                 ppsFetchTime.tv_sec, ppsFetchTime.tv_nsec,
                 drSyncUserRealTs.tv_sec, drSyncUserRealTs.tv_nsec,
-                drsyncUserTs.tv_sec, drsyncUserTs.tv_nsec);
+                drSyncUserBootTs.tv_sec, drSyncUserBootTs.tv_nsec);
         retVal = -1;
     }
 
@@ -247,6 +274,29 @@ exit0:
 }
 
 
+/* publishes the PPS state to the getPPS() and getPPSModel() readers */
+static void publish_pps_snapshot(const pps_snapshot* snapshot)
+{
+    uint32_t seq = __atomic_load_n(&ppsSeq, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&ppsSeq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    ppsSnapshot = *snapshot;
+    __atomic_store_n(&ppsSeq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/* copies the last published PPS state, never blocks the PPS thread */
+static void read_pps_snapshot(pps_snapshot* snapshot)
+{
+    uint32_t seq;
+
+    do {
+        seq = __atomic_load_n(&ppsSeq, __ATOMIC_ACQUIRE);
+        *snapshot = ppsSnapshot;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&ppsSeq, __ATOMIC_RELAXED));
+}
+
 /* fetches the timestamp from the PPS source */
 int read_pps(pps_handle *handle)
 {
@@ -255,6 +305,9 @@ int read_pps(pps_handle *handle)
     int ret;
     static  bool isFirstPulseReceived = false;
     static unsigned int skipPulseCnt = 0;
+    /*working copy of the published state, PPS thread only*/
+    static pps_snapshot snapshot;
+    pps_sync_time kernelTs, userTs;
     // 3sec timeout
     timeout.tv_sec = 3;
     timeout.tv_nsec = 0;
@@ -287,12 +340,19 @@ int read_pps(pps_handle *handle)
         return 0;
     }
     /* update dr syncpulse time*/
-
-    pthread_mutex_lock(&ts_lock);
-
-    ret = compute_real_to_boot_time(infobuf);
-
-    pthread_mutex_unlock(&ts_lock);
+    ret = compute_real_to_boot_time(infobuf, &kernelTs, &userTs);
+    if (0 == ret) {
+        if (0 != pps_model_add_pulse(&ppsWindow, kernelTs, gnssOutageInSec, &snapshot.model)) {
+            LOC_LOGV("%s:%d spurious pps pulse %ld (sec) %ld (nsec), ignored",
+                     __func__, __LINE__, kernelTs.tv_sec, kernelTs.tv_nsec);
+            return 0;
+        }
+        LOC_LOGV("%s:%d pulses %u drift %.1f ppb jitter %.1f nsec", __func__, __LINE__,
+                 snapshot.model.numPulses, snapshot.model.driftPpb, snapshot.model.jitterNs);
+        snapshot.kernelTs = kernelTs;
+        snapshot.userTs = userTs;
+        publish_pps_snapshot(&snapshot);
+    }
 
     return 0;
 }
@@ -308,7 +368,7 @@ void *thread_handle(void *input)
     {
         LOC_LOGV("%s:%d Thread Input is present", __func__, __LINE__);
     }
-    while(isActive)
+    while(__atomic_load_n(&isActive, __ATOMIC_RELAXED))
     {
         ret = read_pps(&handle);
 
@@ -334,7 +394,6 @@ int initPPS(char *devname)
         return 0;
     }
     UTIL_READ_CONF(LOC_PATH_GPS_CONF, gps_conf_param_table);
-    pthread_mutex_init(&ts_lock,NULL);
 
     pid = pthread_create(&thread,NULL,&thread_handle,NULL);
     if(pid != 0)
@@ -348,11 +407,7 @@ int initPPS(char *devname)
 /* stops fetching and closes the device */
 void deInitPPS()
 {
-    pthread_mutex_lock(&ts_lock);
-    isActive = 0;
-    pthread_mutex_unlock(&ts_lock);
-
-    pthread_mutex_destroy(&ts_lock);
+    __atomic_store_n(&isActive, 0, __ATOMIC_RELAXED);
     pps_destroy(handle);
 }
 
@@ -367,16 +422,13 @@ int getPPS(struct timespec *fineKernelTs ,struct timespec *currentTs,
            struct timespec *fineUserTs)
 {
     int ret;
+    pps_snapshot snapshot;
 
-    pthread_mutex_lock(&ts_lock);
-    fineKernelTs->tv_sec = drsyncKernelTs.tv_sec;
-    fineKernelTs->tv_nsec = drsyncKernelTs.tv_nsec;
-
-    fineUserTs->tv_sec = drsyncUserTs.tv_sec;
-    fineUserTs->tv_nsec = drsyncUserTs.tv_nsec;
+    read_pps_snapshot(&snapshot);
+    *fineKernelTs = snapshot.kernelTs;
+    *fineUserTs = snapshot.userTs;
 
     ret = clock_gettime(CLOCK_BOOTTIME,currentTs);
-    pthread_mutex_unlock(&ts_lock);
     if(ret != 0)
     {
        LOC_LOGV("%s:%d clock_gettime() error",__func__,__LINE__);
@@ -385,6 +437,23 @@ int getPPS(struct timespec *fineKernelTs ,struct timespec *currentTs,
     return 1;
 }
 
+/* retrieves the running clock model of CLOCK_BOOTTIME against the PPS pulses */
+/* Returns:
+ *     1. @Param out clock model
+ *     returns 1 if the model is fitted over 2 pulses or more, 0 otherwise
+ */
+int getPPSModel(pps_clock_model *model)
+{
+    pps_snapshot snapshot;
+
+    if (NULL == model) {
+        return 0;
+    }
+    read_pps_snapshot(&snapshot);
+    *model = snapshot.model;
+    return (snapshot.model.numPulses >= 2) ? 1 : 0;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -28,14 +28,33 @@
 #ifndef _GNSSPPS_H
 #define _GNSSPPS_H
 
+#include <stdint.h>
+#include <time.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* running model of CLOCK_BOOTTIME against the PPS pulses, fitted over the
+   last pulses received without an outage */
+typedef struct {
+    /* boot time of the last pulse, on the fitted line */
+    struct timespec lastPulseBootTs;
+    /* CLOCK_BOOTTIME rate error, boot time nsec per pulse second - 1E9 */
+    double driftPpb;
+    /* RMS distance of the pulses from the fitted line, in nsec */
+    double jitterNs;
+    /* number of pulses the model is fitted over */
+    uint32_t numPulses;
+} pps_clock_model;
+
 /*  opens the device and fetches from PPS source */
 int initPPS(char *devname);
 /* updates the fine time stamp */
 int getPPS(struct timespec *current_ts, struct timespec *current_boottime, struct timespec *last_boottime);
+/* retrieves the clock model, the next pulse is expected at
+   lastPulseBootTs + 1E9 + driftPpb nsec; returns 0 until 2 pulses are seen */
+int getPPSModel(pps_clock_model *model);
 /* stops fetching and closes the device */
 void deInitPPS();
 
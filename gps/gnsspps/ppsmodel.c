@@ -0,0 +1,120 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <math.h>
+#include <ppsmodel.h>
+
+#define BILLION_NSEC  (1E9)
+
+/* fits the model over the window, returns 0 if the fit is degenerate */
+static int fit_pps_model(const pps_model_window *window, pps_clock_model *model)
+{
+    uint32_t i, idx, first, last;
+    double meanX = 0, meanY = 0, sxx = 0, sxy = 0, residual2 = 0;
+    double slope, intercept, fittedNs;
+    int64_t pulseBootNs;
+
+    /* fit relative to the oldest pulse to keep the precision of the doubles */
+    first = (window->head + PPS_MODEL_WINDOW - window->count) % PPS_MODEL_WINDOW;
+    last = (window->head + PPS_MODEL_WINDOW - 1) % PPS_MODEL_WINDOW;
+    for (i = 0; i < window->count; i++) {
+        idx = (first + i) % PPS_MODEL_WINDOW;
+        meanX += (double)(window->sec[idx] - window->sec[first]);
+        meanY += (double)(window->bootNs[idx] - window->bootNs[first]);
+    }
+    meanX /= window->count;
+    meanY /= window->count;
+    for (i = 0; i < window->count; i++) {
+        idx = (first + i) % PPS_MODEL_WINDOW;
+        double x = (double)(window->sec[idx] - window->sec[first]) - meanX;
+        double y = (double)(window->bootNs[idx] - window->bootNs[first]) - meanY;
+        sxx += x * x;
+        sxy += x * y;
+    }
+    /* every pulse on the same second, there is no line to fit */
+    if (!(sxx > 0)) {
+        return 0;
+    }
+    slope = sxy / sxx;
+    intercept = meanY - slope * meanX;
+    for (i = 0; i < window->count; i++) {
+        idx = (first + i) % PPS_MODEL_WINDOW;
+        double r = (double)(window->bootNs[idx] - window->bootNs[first]) -
+                   (intercept + slope * (double)(window->sec[idx] - window->sec[first]));
+        residual2 += r * r;
+    }
+
+    fittedNs = intercept + slope * (double)(window->sec[last] - window->sec[first]);
+    pulseBootNs = window->bootNs[first] + (int64_t)llround(fittedNs);
+    model->lastPulseBootTs.tv_sec = pulseBootNs / 1000000000LL;
+    model->lastPulseBootTs.tv_nsec = pulseBootNs % 1000000000LL;
+    model->driftPpb = slope - BILLION_NSEC;
+    model->jitterNs = sqrt(residual2 / window->count);
+    model->numPulses = window->count;
+    return 1;
+}
+
+int pps_model_add_pulse(pps_model_window *window, struct timespec pulseBootTs,
+                        int outageSec, pps_clock_model *model)
+{
+    int64_t pulseBootNs = (int64_t)pulseBootTs.tv_sec * 1000000000LL + pulseBootTs.tv_nsec;
+    int64_t pulseSec = 0;
+
+    if (window->count > 0) {
+        uint32_t last = (window->head + PPS_MODEL_WINDOW - 1) % PPS_MODEL_WINDOW;
+        int64_t deltaNs = pulseBootNs - window->bootNs[last];
+        if (deltaNs <= 0 || deltaNs > (int64_t)(outageSec + 1) * 1000000000LL) {
+            window->count = 0;
+        } else {
+            int64_t deltaSec = (int64_t)llround(deltaNs / BILLION_NSEC);
+            if (0 == deltaSec) {
+                /* spurious edge, it would be a second pulse on the same second */
+                return -1;
+            }
+            pulseSec = window->sec[last] + deltaSec;
+        }
+    }
+    window->bootNs[window->head] = pulseBootNs;
+    window->sec[window->head] = pulseSec;
+    window->head = (window->head + 1) % PPS_MODEL_WINDOW;
+    if (window->count < PPS_MODEL_WINDOW) {
+        window->count++;
+    }
+
+    if (window->count >= 2 && fit_pps_model(window, model)) {
+        return 0;
+    }
+    /* a single pulse, or no line through the window: restart from this
+       pulse rather than publish a NaN model */
+    window->count = 1;
+    model->lastPulseBootTs = pulseBootTs;
+    model->driftPpb = 0;
+    model->jitterNs = 0;
+    model->numPulses = 1;
+    return 0;
+}
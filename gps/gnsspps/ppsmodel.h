@@ -0,0 +1,65 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef _PPSMODEL_H
+#define _PPSMODEL_H
+
+#include <stdint.h>
+#include <time.h>
+#include <gnsspps.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* number of pulses the clock model is fitted over */
+#define PPS_MODEL_WINDOW  16
+
+/* pulses the clock model is fitted over, oldest first from
+   head - count, as boot time and pulse second */
+typedef struct {
+    int64_t bootNs[PPS_MODEL_WINDOW];
+    int64_t sec[PPS_MODEL_WINDOW];
+    uint32_t count;
+    uint32_t head;
+} pps_model_window;
+
+/* adds a pulse to the window and refits the clock model: a least squares
+   line of pulse boot time against pulse second. The window restarts when
+   the pulse is not after the last one or comes after an outage longer than
+   outageSec; a pulse less than half a second after the last one is a
+   spurious edge and is rejected.
+   returns 0 if the pulse was added and model updated, -1 if it was rejected
+   and model left as is */
+int pps_model_add_pulse(pps_model_window *window, struct timespec pulseBootTs,
+                        int outageSec, pps_clock_model *model);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
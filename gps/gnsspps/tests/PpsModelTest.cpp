@@ -0,0 +1,200 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Feeds synthetic PPS pulses to the clock model and checks the fitted
+// drift and jitter, and what happens to the window on spurious, repeated
+// and late pulses.
+
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <string.h>
+
+#include <ppsmodel.h>
+
+#define SEC_NS          (1000000000LL)
+#define OUTAGE_SEC      (1)
+
+namespace {
+
+struct timespec toTimespec(int64_t ns)
+{
+    struct timespec ts;
+    ts.tv_sec = ns / SEC_NS;
+    ts.tv_nsec = ns % SEC_NS;
+    return ts;
+}
+
+int64_t toNs(const struct timespec& ts)
+{
+    return (int64_t)ts.tv_sec * SEC_NS + ts.tv_nsec;
+}
+
+class PpsModelTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        memset(&window, 0, sizeof(window));
+        memset(&model, 0, sizeof(model));
+    }
+
+    int addPulse(int64_t bootNs) {
+        return pps_model_add_pulse(&window, toTimespec(bootNs), OUTAGE_SEC, &model);
+    }
+
+    void expectFinite() {
+        EXPECT_TRUE(std::isfinite(model.driftPpb));
+        EXPECT_TRUE(std::isfinite(model.jitterNs));
+        EXPECT_GE(model.lastPulseBootTs.tv_nsec, 0);
+        EXPECT_LT(model.lastPulseBootTs.tv_nsec, SEC_NS);
+    }
+
+    pps_model_window window;
+    pps_clock_model model;
+};
+
+TEST_F(PpsModelTest, FitsDrift) {
+    const int64_t start = 100 * SEC_NS;
+    const int64_t periodNs = SEC_NS + 50;     // boot clock 50 ppb fast
+
+    ASSERT_EQ(0, addPulse(start));
+    EXPECT_EQ(1u, model.numPulses);
+    EXPECT_EQ(0, model.driftPpb);
+    for (int i = 1; i < 40; i++) {
+        ASSERT_EQ(0, addPulse(start + i * periodNs));
+        expectFinite();
+    }
+    EXPECT_EQ((uint32_t)PPS_MODEL_WINDOW, model.numPulses);
+    EXPECT_NEAR(50, model.driftPpb, 0.01);
+    EXPECT_NEAR(0, model.jitterNs, 1);
+    EXPECT_NEAR(start + 39 * periodNs, toNs(model.lastPulseBootTs), 1);
+}
+
+TEST_F(PpsModelTest, FitsJitteredPulses) {
+    const int64_t start = 100 * SEC_NS;
+    // Edges up to 300 usec away from the second, the model sees through them
+    const int64_t jitterNs[] = { 0, 300000, -200000, 100000, -300000, 250000, -50000, 0 };
+    const int n = sizeof(jitterNs) / sizeof(jitterNs[0]);
+
+    for (int i = 0; i < n; i++) {
+        ASSERT_EQ(0, addPulse(start + i * SEC_NS + jitterNs[i]));
+        expectFinite();
+    }
+    EXPECT_EQ((uint32_t)n, model.numPulses);
+    EXPECT_GT(model.jitterNs, 100000);
+    EXPECT_LT(model.jitterNs, 300000);
+    EXPECT_LT(fabs(model.driftPpb), 100000);
+    // The last pulse is put back on the fitted line
+    EXPECT_NEAR(start + (n - 1) * SEC_NS, toNs(model.lastPulseBootTs), 300000);
+}
+
+TEST_F(PpsModelTest, RejectsSpuriousEdge) {
+    const int64_t start = 100 * SEC_NS;
+
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(0, addPulse(start + i * SEC_NS));
+    }
+    pps_clock_model before = model;
+
+    // A second edge 0.3 sec after the last pulse rounds to the same second
+    EXPECT_EQ(-1, addPulse(start + 3 * SEC_NS + 300000000LL));
+    EXPECT_EQ(before.numPulses, model.numPulses);
+    EXPECT_EQ(before.driftPpb, model.driftPpb);
+    EXPECT_EQ(toNs(before.lastPulseBootTs), toNs(model.lastPulseBootTs));
+
+    // The next real pulse is still one second after the last real one
+    ASSERT_EQ(0, addPulse(start + 4 * SEC_NS));
+    EXPECT_EQ(5u, model.numPulses);
+    EXPECT_NEAR(0, model.driftPpb, 0.01);
+    expectFinite();
+}
+
+TEST_F(PpsModelTest, RestartsOnRepeatedPulse) {
+    const int64_t start = 100 * SEC_NS;
+
+    ASSERT_EQ(0, addPulse(start));
+    ASSERT_EQ(0, addPulse(start + SEC_NS));
+    // The same timestamp again is not after the last pulse
+    ASSERT_EQ(0, addPulse(start + SEC_NS));
+    EXPECT_EQ(1u, model.numPulses);
+    EXPECT_EQ(0, model.driftPpb);
+    EXPECT_EQ(start + SEC_NS, toNs(model.lastPulseBootTs));
+    expectFinite();
+}
+
+TEST_F(PpsModelTest, RestartsAfterOutage) {
+    const int64_t start = 100 * SEC_NS;
+
+    for (int i = 0; i < 5; i++) {
+        ASSERT_EQ(0, addPulse(start + i * SEC_NS));
+    }
+    EXPECT_EQ(5u, model.numPulses);
+
+    // Pulses lost for longer than the outage the window bridges
+    const int64_t restart = start + (4 + OUTAGE_SEC + 2) * SEC_NS;
+    ASSERT_EQ(0, addPulse(restart));
+    EXPECT_EQ(1u, model.numPulses);
+    EXPECT_EQ(restart, toNs(model.lastPulseBootTs));
+
+    ASSERT_EQ(0, addPulse(restart + SEC_NS + 20));
+    EXPECT_EQ(2u, model.numPulses);
+    EXPECT_NEAR(20, model.driftPpb, 0.01);
+    expectFinite();
+}
+
+TEST_F(PpsModelTest, BridgesShortOutage) {
+    const int64_t start = 100 * SEC_NS;
+
+    ASSERT_EQ(0, addPulse(start));
+    ASSERT_EQ(0, addPulse(start + SEC_NS));
+    // One pulse missed, the next is counted as two seconds later
+    ASSERT_EQ(0, addPulse(start + 3 * SEC_NS));
+    EXPECT_EQ(3u, model.numPulses);
+    EXPECT_NEAR(0, model.driftPpb, 0.01);
+    EXPECT_EQ(start + 3 * SEC_NS, toNs(model.lastPulseBootTs));
+}
+
+TEST_F(PpsModelTest, StaysFiniteOnAnyPulses) {
+    // Real, spurious, repeated, early and late pulses, in a fixed order
+    const int64_t stepNs[] = { SEC_NS, 0, SEC_NS + 400000, 300000000LL, 499999999LL,
+                               -SEC_NS, SEC_NS, 2 * SEC_NS, 500000000LL, 10 * SEC_NS,
+                               SEC_NS - 1, 1, SEC_NS };
+    int64_t bootNs = 100 * SEC_NS;
+
+    for (int round = 0; round < 8; round++) {
+        for (int64_t step : stepNs) {
+            bootNs += step;
+            addPulse(bootNs);
+            expectFinite();
+            EXPECT_GE(model.numPulses, 1u);
+            EXPECT_LE(model.numPulses, (uint32_t)PPS_MODEL_WINDOW);
+        }
+    }
+}
+
+} // namespace
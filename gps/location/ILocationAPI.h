@@ -155,6 +155,20 @@ public:
                 LOCATION_ERROR_ID_UNKNOWN if id is not associated with a geofence session */
     virtual void resumeGeofences(size_t count, uint32_t* ids) = 0;
 
+    /** @brief Applies any mix of add, remove, modify, pause and resume requests as a single
+       transaction and returns an array of geofence ids, one per request. Add requests get a
+       newly generated id, all other requests echo the id they carry. Requests are programmed
+       to the engine in order with a bounded number of them outstanding, and one
+       collectiveResponseCallback reports the error of every request of the batch. The id
+       array returned will be valid until the collectiveResponseCallback is called and has
+       returned.
+       @return id array
+        collectiveResponseCallback returns, per request:
+                LOCATION_ERROR_SUCCESS if successful
+                LOCATION_ERROR_ID_UNKNOWN if id is not associated with a geofence session
+                LOCATION_ERROR_INVALID_PARAMETER if any parameters are invalid */
+    virtual uint32_t* geofenceBatch(size_t count, GeofenceBatchRequest* requests) = 0;
+
     /* ================================== GNSS ====================================== */
 
      /** @brief gnssNiResponse is called in response to a gnssNiCallback.
@@ -577,6 +577,23 @@ LocationAPI::resumeGeofences(size_t count, uint32_t* ids)
     pthread_mutex_unlock(&gDataMutex);
 }
 
+uint32_t*
+LocationAPI::geofenceBatch(size_t count, GeofenceBatchRequest* requests)
+{
+    uint32_t* ids = NULL;
+    pthread_mutex_lock(&gDataMutex);
+
+    if (gData.geofenceInterface != NULL) {
+        ids = gData.geofenceInterface->geofenceBatch(this, count, requests);
+    } else {
+        LOC_LOGE("%s:%d]: No geofence interface available for Location API client %p ",
+                 __func__, __LINE__, this);
+    }
+
+    pthread_mutex_unlock(&gDataMutex);
+    return ids;
+}
+
 void
 LocationAPI::gnssNiResponse(uint32_t id, GnssNiResponse response)
 {
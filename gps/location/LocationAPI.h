@@ -170,6 +170,16 @@ public:
                 LOCATION_ERROR_ID_UNKNOWN if id is not associated with a geofence session */
     virtual void resumeGeofences(size_t count, uint32_t* ids) override;
 
+    /* geofenceBatch applies any mix of add, remove, modify, pause and resume requests as a
+       single transaction and returns an array of geofence ids, one per request. Add requests
+       get a newly generated id, all other requests echo the id they carry. The id array
+       returned will be valid until the collectiveResponseCallback is called and has returned.
+        collectiveResponseCallback returns, per request:
+                LOCATION_ERROR_SUCCESS if successful
+                LOCATION_ERROR_ID_UNKNOWN if id is not associated with a geofence session
+                LOCATION_ERROR_INVALID_PARAMETER if any parameters are invalid */
+    virtual uint32_t* geofenceBatch(size_t count, GeofenceBatchRequest* requests) override;
+
     /* ================================== GNSS ====================================== */
 
      /* gnssNiResponse is called in response to a gnssNiCallback.
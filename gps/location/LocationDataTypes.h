@@ -846,6 +846,22 @@ typedef struct {
     double radius;    // in meters
 } GeofenceInfo;
 
+typedef enum {
+    GEOFENCE_BATCH_OP_ADD = 0,
+    GEOFENCE_BATCH_OP_REMOVE,
+    GEOFENCE_BATCH_OP_MODIFY,
+    GEOFENCE_BATCH_OP_PAUSE,
+    GEOFENCE_BATCH_OP_RESUME,
+} GeofenceBatchOp;
+
+typedef struct {
+    uint32_t size;          // set to sizeof(GeofenceBatchRequest)
+    GeofenceBatchOp op;     // operation to apply to the geofence
+    uint32_t id;            // geofence id, ignored for GEOFENCE_BATCH_OP_ADD
+    GeofenceOption options; // used by GEOFENCE_BATCH_OP_ADD and GEOFENCE_BATCH_OP_MODIFY
+    GeofenceInfo info;      // used by GEOFENCE_BATCH_OP_ADD
+} GeofenceBatchRequest;
+
 typedef struct {
     uint32_t size;             // set to sizeof(GeofenceBreachNotification)
     uint32_t count;            // number of ids in array
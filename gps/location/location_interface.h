@@ -88,6 +88,9 @@ struct GnssInterface {
     void (*getPowerStateChanges)(void* powerStateCb);
     void (*injectLocationExt)(const GnssLocationInfoNotification &locationInfo);
     void (*updateBatteryStatus)(bool charging);
+    void (*gnssUpdateMeasurementStreamConfig)(LocationAPI* client,
+                                              const GnssMeasurementStreamConfig& config);
+    void (*gnssUpdateSvStatusConfig)(LocationAPI* client, const GnssSvStatusConfig& config);
 };
 
 struct BatchingInterface {
@@ -116,6 +119,8 @@ struct GeofenceInterface {
                             GeofenceOption* options);
     void (*pauseGeofences)(LocationAPI* client, size_t count, uint32_t* ids);
     void (*resumeGeofences)(LocationAPI* client, size_t count, uint32_t* ids);
+    uint32_t* (*geofenceBatch)(LocationAPI* client, size_t count,
+                               GeofenceBatchRequest* requests);
 };
 
 #endif /* LOCATION_INTERFACE_H */
@@ -43,11 +43,13 @@
 #include <gps_extended.h>
 #include "loc_pla.h"
 #include <loc_cfg.h>
+#include <LocDlRegistry.h>
 #include <LocContext.h>
 #include <SynergyLocApi.h>
 
 using namespace std;
 using namespace loc_core;
+using namespace loc_util;
 
 
 #define SL_MAX_SV_CNT_SUPPORTED_IN_ONE_CONSTELLATION (64)
@@ -1213,7 +1215,6 @@ SynergyLocApi::SynergyLocApi(LOC_API_ADAPTER_EVENT_MASK_T exMask,
     const char * libName = nullptr;
     void *handle = nullptr;
     int isSllSimEnabled = 0;
-    const char *error = nullptr;
 
     loc_param_s_type gps_conf_param_table[] =
     {
@@ -1228,14 +1229,10 @@ SynergyLocApi::SynergyLocApi(LOC_API_ADAPTER_EVENT_MASK_T exMask,
         libName = SLL_CORE_LIB_NAME;
     }
 
-    if ((handle = dlopen(libName, RTLD_NOW)) != nullptr) {
+    if ((handle = LocDlRegistry::getLibHandle(libName)) != nullptr) {
         LOC_LOGv("%s is present", libName);
-        get_sll_if_api_t getter = (get_sll_if_api_t)dlsym(handle, "get_sll_if_api");
-
-        if ((error = dlerror()) != nullptr) {
-            LOC_LOGe("dlsym for %s get_sll_if_api failed, error = %s", libName, error);
-            getter = nullptr;
-        }
+        get_sll_if_api_t getter =
+                (get_sll_if_api_t)LocDlRegistry::getSymbol(libName, "get_sll_if_api");
 
         if (getter != nullptr) {
             sllReqIf = (getter)(&sllEventCb, ((void *)this));
@@ -1246,7 +1243,7 @@ SynergyLocApi::SynergyLocApi(LOC_API_ADAPTER_EVENT_MASK_T exMask,
             }
         }
     } else {
-        LOC_LOGe("dlopen for %s failed, handle %p error: %s", libName, handle, dlerror())
+        LOC_LOGe("dlopen for %s failed", libName);
     }
 
     sllReqIf = &sllDefultReq;
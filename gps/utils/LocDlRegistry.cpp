@@ -0,0 +1,191 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_TAG "LocSvc_DlRegistry"
+
+#include <dlfcn.h>
+#include <time.h>
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <log_util.h>
+#include <LocDlRegistry.h>
+
+namespace loc_util {
+
+struct LocDlLib {
+    std::once_flag loadFlag;
+    void* handle = nullptr;
+    int64_t loadTimeUs = 0;
+    // symbols resolved so far, nullptr for the ones that were not found
+    std::unordered_map<std::string, void*> symbols;
+};
+
+struct LocDlLibs {
+    std::mutex lock;
+    std::unordered_map<std::string, std::shared_ptr<LocDlLib>> libs;
+    // libraries unload() was called on, the prelink thread does not load them
+    std::unordered_set<std::string> unloaded;
+};
+
+// never destroyed, symbols may still be looked up by static destructors
+static LocDlLibs& getLibs() {
+    static LocDlLibs* libs = new LocDlLibs();
+    return *libs;
+}
+
+static int64_t getMonotonicUs() {
+    struct timespec ts = {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// nullptr if prelinking and libName was unloaded
+static std::shared_ptr<LocDlLib> getLib(const char* libName, bool prelinking = false) {
+    LocDlLibs& libs = getLibs();
+    std::shared_ptr<LocDlLib> lib;
+    {
+        std::lock_guard<std::mutex> guard(libs.lock);
+        if (prelinking && libs.unloaded.end() != libs.unloaded.find(libName)) {
+            return nullptr;
+        }
+        std::shared_ptr<LocDlLib>& entry = libs.libs[libName];
+        if (nullptr == entry) {
+            entry = std::make_shared<LocDlLib>();
+        }
+        lib = entry;
+    }
+
+    // dlopen outside of the registry lock, a slow load only holds back the
+    // callers of the same library
+    std::call_once(lib->loadFlag, [&lib, libName] {
+        int64_t start = getMonotonicUs();
+        void* handle = dlopen(libName, RTLD_NOW);
+        int64_t loadTimeUs = getMonotonicUs() - start;
+        if (nullptr == handle) {
+            const char* err = dlerror();
+            LOC_LOGe("dlopen %s failed: %s", libName, (nullptr == err) ? "unknown" : err);
+        } else {
+            LOC_LOGd("%s loaded in %" PRId64 " us", libName, loadTimeUs);
+        }
+        std::lock_guard<std::mutex> guard(getLibs().lock);
+        lib->handle = handle;
+        lib->loadTimeUs = loadTimeUs;
+    });
+    return lib;
+}
+
+void* LocDlRegistry::getLibHandle(const char* libName) {
+    return (nullptr == libName) ? nullptr : getLib(libName)->handle;
+}
+
+void* LocDlRegistry::getSymbol(const char* libName, const char* symName) {
+    if (nullptr == libName || nullptr == symName) {
+        LOC_LOGe("libName (%p) and symName (%p) can not be null", libName, symName);
+        return nullptr;
+    }
+
+    std::shared_ptr<LocDlLib> lib = getLib(libName);
+    if (nullptr == lib->handle) {
+        return nullptr;
+    }
+
+    LocDlLibs& libs = getLibs();
+    std::lock_guard<std::mutex> guard(libs.lock);
+    auto it = lib->symbols.find(symName);
+    if (lib->symbols.end() != it) {
+        return it->second;
+    }
+    void* sym = dlsym(lib->handle, symName);
+    if (nullptr == sym) {
+        const char* err = dlerror();
+        LOC_LOGe("dlsym %s in %s failed: %s", symName, libName,
+                 (nullptr == err) ? "unknown" : err);
+    }
+    lib->symbols.emplace(symName, sym);
+    return sym;
+}
+
+void LocDlRegistry::prelink(const char* const libNames[], size_t count) {
+    std::vector<std::string> names(libNames, libNames + count);
+    std::thread([names] {
+        int64_t start = getMonotonicUs();
+        for (const std::string& name : names) {
+            if (nullptr == getLib(name.c_str(), true)) {
+                LOC_LOGd("%s unloaded before it was prelinked", name.c_str());
+            }
+        }
+        LOC_LOGd("prelinked %zu libraries in %" PRId64 " us",
+                 names.size(), getMonotonicUs() - start);
+    }).detach();
+}
+
+void LocDlRegistry::unload(const char* libName) {
+    if (nullptr == libName) {
+        return;
+    }
+
+    std::shared_ptr<LocDlLib> lib;
+    {
+        LocDlLibs& libs = getLibs();
+        std::lock_guard<std::mutex> guard(libs.lock);
+        // the prelink thread may not have got to libName yet
+        libs.unloaded.insert(libName);
+        auto it = libs.libs.find(libName);
+        if (libs.libs.end() == it) {
+            return;
+        }
+        lib = it->second;
+        libs.libs.erase(it);
+    }
+
+    // waits for a load of the library still in progress
+    std::call_once(lib->loadFlag, [] {});
+    if (nullptr != lib->handle) {
+        dlclose(lib->handle);
+        lib->handle = nullptr;
+    }
+}
+
+void LocDlRegistry::logStats() {
+    LocDlLibs& libs = getLibs();
+    std::lock_guard<std::mutex> guard(libs.lock);
+    for (auto& entry : libs.libs) {
+        const LocDlLib& lib = *entry.second;
+        LOC_LOGi("%s: %s, load time %" PRId64 " us, %zu symbols", entry.first.c_str(),
+                 (nullptr != lib.handle) ? "loaded" : "not loaded",
+                 lib.loadTimeUs, lib.symbols.size());
+    }
+}
+
+} // namespace loc_util
@@ -0,0 +1,64 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LOC_DL_REGISTRY__
+#define __LOC_DL_REGISTRY__
+
+#include <stddef.h>
+
+namespace loc_util {
+
+/* Process wide registry of dynamically loaded libraries. Each library is
+ * dlopen'ed at most once and each symbol dlsym'ed at most once, later lookups
+ * are served from the registry; failures are remembered as well, so a missing
+ * optional library costs one dlopen per process. Libraries stay loaded for the
+ * life of the process unless unload() is called.
+ *
+ * The time spent in dlopen is recorded per library and logged, libraries known
+ * to be needed can be prelinked on a background thread during startup.
+ */
+class LocDlRegistry {
+public:
+    // handle of libName, loaded on first use; nullptr if it can not be loaded
+    static void* getLibHandle(const char* libName);
+    // symName of libName, resolved on first use; nullptr if not found
+    static void* getSymbol(const char* libName, const char* symName);
+    // loads the count libraries of libNames on a detached thread, except the
+    // ones unload() is called on before the thread gets to them
+    static void prelink(const char* const libNames[], size_t count);
+    // drops libName from the registry and dlcloses it; the caller must make
+    // sure none of its symbols are still in use. A later getLibHandle() or
+    // getSymbol() loads it again, prelink() does not
+    static void unload(const char* libName);
+    // logs the load time and number of symbols of every library
+    static void logStats();
+};
+
+} // namespace loc_util
+
+#endif // __LOC_DL_REGISTRY__
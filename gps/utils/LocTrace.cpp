@@ -0,0 +1,403 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_TAG "LocSvc_Trace"
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <list>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <LocTrace.h>
+#include <LocThread.h>
+#include <log_util.h>
+#if defined (USE_ANDROID_LOGGING) || defined (ANDROID)
+#include <log/log.h>
+#endif
+
+// records per thread, a power of 2
+#define LOC_TRACE_RING_SIZE     (256)
+// the drain thread wakes up at least this often
+#define LOC_TRACE_DRAIN_MS      (100)
+#define LOC_TRACE_LINE_MAX      (512)
+
+namespace loc_util {
+
+using namespace std;
+
+struct LocTraceTag {
+    string name;
+    atomic<bool> enabled;
+    inline LocTraceTag(const char* tagName, bool on) : name(tagName), enabled(on) {}
+};
+
+// written by the owning thread only, except tail which the drain thread owns
+struct LocTraceRing {
+    LocTraceRecord records[LOC_TRACE_RING_SIZE];
+    atomic<uint32_t> head;
+    atomic<uint32_t> tail;
+    atomic<uint32_t> dropped;
+    atomic<bool> ownerGone;
+    pid_t tid;
+    inline LocTraceRing() : head(0), tail(0), dropped(0), ownerGone(false), tid(gettid()) {}
+};
+
+// lets the drain thread free the ring once the thread has exited
+struct LocTraceRingOwner {
+    LocTraceRing* ring;
+    inline LocTraceRingOwner() : ring(nullptr) {}
+    inline ~LocTraceRingOwner() {
+        if (nullptr != ring) {
+            ring->ownerGone.store(true, memory_order_release);
+        }
+    }
+};
+
+class LocTraceDrainer : public LocRunnable {
+public:
+    virtual bool run() override;
+};
+
+// never destroyed, trace points may still run while the process exits
+struct LocTraceState {
+    mutex lock;
+    condition_variable drainCond;
+    list<LocTraceTag> tags;
+    vector<string> enabledTags;
+    // tags set through setTagEnabled(), not changed by setEnabledTags()
+    vector<pair<string, bool>> overrides;
+    bool allTagsEnabled;
+    list<LocTraceRing*> rings;
+    LocThread drainThread;
+    bool drainStarted;
+    inline LocTraceState() : allTagsEnabled(false), drainStarted(false) {}
+};
+
+static LocTraceState& getState()
+{
+    static LocTraceState* state = new LocTraceState();
+    return *state;
+}
+
+static thread_local LocTraceRingOwner tRing;
+
+static bool isTagListed(const string& tag)
+{
+    LocTraceState& state = getState();
+    for (auto& each : state.overrides) {
+        if (each.first == tag) {
+            return each.second;
+        }
+    }
+    if (state.allTagsEnabled) {
+        return true;
+    }
+    for (auto& each : state.enabledTags) {
+        if (each == tag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static atomic<bool>& getTagSwitch(const char* tag)
+{
+    LocTraceState& state = getState();
+    lock_guard<mutex> guard(state.lock);
+    for (auto& each : state.tags) {
+        if (each.name == tag) {
+            return each.enabled;
+        }
+    }
+    state.tags.emplace_back(tag, isTagListed(tag));
+    return state.tags.back().enabled;
+}
+
+const atomic<bool>* LocTraceSite::bind()
+{
+    // a site running on two threads at once may bind twice, to the same switch
+    const atomic<bool>* enabled = &getTagSwitch(mTag);
+    mEnabled.store(enabled, memory_order_release);
+    return enabled;
+}
+
+void LocTrace::setEnabledTags(const char* tags)
+{
+    LocTraceState& state = getState();
+    lock_guard<mutex> guard(state.lock);
+    state.enabledTags.clear();
+    state.allTagsEnabled = false;
+    string list(nullptr != tags ? tags : "");
+    size_t start = 0;
+    while (start < list.size()) {
+        size_t end = list.find(',', start);
+        if (string::npos == end) {
+            end = list.size();
+        }
+        string tag = list.substr(start, end - start);
+        size_t first = tag.find_first_not_of(' ');
+        size_t last = tag.find_last_not_of(' ');
+        if (string::npos != first) {
+            tag = tag.substr(first, last - first + 1);
+            if ("*" == tag) {
+                state.allTagsEnabled = true;
+            } else {
+                state.enabledTags.push_back(tag);
+            }
+        }
+        start = end + 1;
+    }
+    for (auto& each : state.tags) {
+        each.enabled.store(isTagListed(each.name), memory_order_relaxed);
+    }
+}
+
+void LocTrace::setTagEnabled(const char* tag, bool enabled)
+{
+    atomic<bool>& tagSwitch = getTagSwitch(tag);
+    LocTraceState& state = getState();
+    lock_guard<mutex> guard(state.lock);
+    bool found = false;
+    for (auto& each : state.overrides) {
+        if (each.first == tag) {
+            each.second = enabled;
+            found = true;
+        }
+    }
+    if (!found) {
+        state.overrides.emplace_back(tag, enabled);
+    }
+    tagSwitch.store(enabled, memory_order_relaxed);
+}
+
+LocTraceRecord* LocTrace::begin(const LocTraceSite& site)
+{
+    LocTraceRing* ring = tRing.ring;
+    if (nullptr == ring) {
+        ring = new LocTraceRing();
+        LocTraceState& state = getState();
+        lock_guard<mutex> guard(state.lock);
+        state.rings.push_back(ring);
+        if (!state.drainStarted) {
+            state.drainStarted =
+                    state.drainThread.start("LocTraceDrain", new LocTraceDrainer(), false);
+        }
+        tRing.ring = ring;
+    }
+
+    uint32_t head = ring->head.load(memory_order_relaxed);
+    if (head - ring->tail.load(memory_order_acquire) >= LOC_TRACE_RING_SIZE) {
+        ring->dropped.fetch_add(1, memory_order_relaxed);
+        return nullptr;
+    }
+    LocTraceRecord* r = &ring->records[head & (LOC_TRACE_RING_SIZE - 1)];
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    r->site = &site;
+    r->timeNs = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    return r;
+}
+
+void LocTrace::commit()
+{
+    LocTraceRing* ring = tRing.ring;
+    uint32_t head = ring->head.load(memory_order_relaxed) + 1;
+    ring->head.store(head, memory_order_release);
+    // do not wait for the periodic drain if the ring is filling up
+    if (head - ring->tail.load(memory_order_relaxed) == LOC_TRACE_RING_SIZE / 2) {
+        getState().drainCond.notify_one();
+    }
+}
+
+void LocTrace::putString(LocTraceRecord& r, const char* s)
+{
+    r.types[r.numArgs] = LOC_TRACE_ARG_STR;
+    r.args[r.numArgs++].s = r.stringsLen;
+    if (nullptr == s) {
+        s = "(null)";
+    }
+    size_t room = LOC_TRACE_MAX_STRINGS - r.stringsLen;
+    if (room > 0) {
+        size_t len = strnlen(s, room - 1);
+        memcpy(r.strings + r.stringsLen, s, len);
+        r.strings[r.stringsLen + len] = '\0';
+        r.stringsLen += len + 1;
+    }
+}
+
+static inline int64_t argAsInt(const LocTraceRecord& r, int i)
+{
+    switch (r.types[i]) {
+    case LOC_TRACE_ARG_DOUBLE: return (int64_t)r.args[i].d;
+    case LOC_TRACE_ARG_PTR:    return (int64_t)(intptr_t)r.args[i].p;
+    case LOC_TRACE_ARG_STR:    return 0;
+    default:                   return r.args[i].i;
+    }
+}
+
+static inline double argAsDouble(const LocTraceRecord& r, int i)
+{
+    switch (r.types[i]) {
+    case LOC_TRACE_ARG_DOUBLE: return r.args[i].d;
+    case LOC_TRACE_ARG_INT:    return (double)r.args[i].i;
+    case LOC_TRACE_ARG_UINT:   return (double)r.args[i].u;
+    default:                   return 0;
+    }
+}
+
+// formats a record the way printf would have formatted its trace point
+static void formatRecord(const LocTraceRecord& r, char* buf, size_t size)
+{
+    size_t len = snprintf(buf, size, "[%" PRId64 ".%06" PRId64 "] ",
+                          (int64_t)(r.timeNs / 1000000000LL),
+                          (int64_t)((r.timeNs / 1000) % 1000000));
+    int arg = 0;
+    for (const char* f = r.site->getFormat(); *f && len < size - 1; ) {
+        if ('%' != *f || '%' == f[1]) {
+            buf[len++] = *f;
+            f += ('%' == *f) ? 2 : 1;
+            continue;
+        }
+        char spec[32] = { '%' };
+        size_t specLen = 1;
+        for (f++; *f && strchr("-+ #0123456789.*", *f); f++) {
+            if ('*' == *f) {
+                int v = (arg < r.numArgs) ? (int)argAsInt(r, arg++) : 0;
+                if (specLen < sizeof(spec) - 4) {
+                    // keep what snprintf wrote, not what it would have written
+                    size_t room = sizeof(spec) - 4 - specLen;
+                    int n = snprintf(spec + specLen, room, "%d", v);
+                    specLen += (n > 0) ? min((size_t)n, room - 1) : 0;
+                }
+            } else if (specLen < sizeof(spec) - 4) {
+                spec[specLen++] = *f;
+            }
+        }
+        // the arguments are stored at 64 bit, drop the length modifiers
+        while (*f && strchr("hljztL", *f)) {
+            f++;
+        }
+        char conv = *f;
+        if ('\0' == conv) {
+            break;
+        }
+        f++;
+        if (arg >= r.numArgs) {
+            buf[len++] = '?';
+            continue;
+        }
+        int n = 0;
+        switch (conv) {
+        case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+            spec[specLen++] = 'l';
+            spec[specLen++] = 'l';
+            spec[specLen++] = conv;
+            n = (LOC_TRACE_ARG_UINT == r.types[arg]) ?
+                    snprintf(buf + len, size - len, spec, (unsigned long long)r.args[arg].u) :
+                    snprintf(buf + len, size - len, spec, (long long)argAsInt(r, arg));
+            break;
+        case 'c':
+            spec[specLen++] = conv;
+            n = snprintf(buf + len, size - len, spec, (int)argAsInt(r, arg));
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            spec[specLen++] = conv;
+            n = snprintf(buf + len, size - len, spec, argAsDouble(r, arg));
+            break;
+        case 's':
+            spec[specLen++] = conv;
+            n = snprintf(buf + len, size - len, spec,
+                         (LOC_TRACE_ARG_STR == r.types[arg] && r.args[arg].s < r.stringsLen) ?
+                         r.strings + r.args[arg].s : "?");
+            break;
+        case 'p':
+            spec[specLen++] = conv;
+            n = snprintf(buf + len, size - len, spec,
+                         (LOC_TRACE_ARG_PTR == r.types[arg]) ? r.args[arg].p : nullptr);
+            break;
+        default:
+            break;
+        }
+        arg++;
+        len += (n > 0) ? min((size_t)n, size - 1 - len) : 0;
+    }
+    len = (len < size) ? len : size - 1;
+    buf[len] = '\0';
+}
+
+static void writeLine(const char* tag, const char* line)
+{
+#if defined (USE_ANDROID_LOGGING) || defined (ANDROID)
+    __android_log_write(ANDROID_LOG_DEBUG, tag, line);
+#else
+    fprintf(stdout, "T/%s: %s\n", tag, line);
+#endif
+}
+
+bool LocTraceDrainer::run()
+{
+    LocTraceState& state = getState();
+    vector<LocTraceRing*> rings;
+    {
+        unique_lock<mutex> lock(state.lock);
+        state.drainCond.wait_for(lock, chrono::milliseconds(LOC_TRACE_DRAIN_MS));
+        rings.assign(state.rings.begin(), state.rings.end());
+    }
+
+    char line[LOC_TRACE_LINE_MAX];
+    for (auto ring : rings) {
+        bool ownerGone = ring->ownerGone.load(memory_order_acquire);
+        uint32_t tail = ring->tail.load(memory_order_relaxed);
+        uint32_t head = ring->head.load(memory_order_acquire);
+        for (; tail != head; tail++) {
+            const LocTraceRecord& r = ring->records[tail & (LOC_TRACE_RING_SIZE - 1)];
+            formatRecord(r, line, sizeof(line));
+            writeLine(r.site->getTag(), line);
+        }
+        ring->tail.store(tail, memory_order_release);
+
+        uint32_t dropped = ring->dropped.exchange(0, memory_order_relaxed);
+        if (dropped > 0) {
+            LOC_LOGW("%s]: thread %d dropped %u trace records", __func__, ring->tid, dropped);
+        }
+        if (ownerGone) {
+            lock_guard<mutex> guard(state.lock);
+            state.rings.remove(ring);
+            delete ring;
+        }
+    }
+    return true;
+}
+
+} // namespace loc_util
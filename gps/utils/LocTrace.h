@@ -0,0 +1,206 @@
+/* Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LOC_TRACE__
+#define __LOC_TRACE__
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+/* Binary trace for hot paths. A trace point records the id of its format and
+ * its raw arguments into a lock free ring owned by the calling thread; the
+ * text is only formatted later, on the trace drain thread, and written to the
+ * log with the tag of the trace point. Tracing is enabled per LOG_TAG at run
+ * time, from TRACE_TAGS in gps.conf or LocTrace::setTagEnabled(); a disabled
+ * trace point costs two relaxed loads.
+ *
+ * Formats are printf formats with at most LOC_TRACE_MAX_ARGS arguments of
+ * integer, enum, floating point, pointer or string type, '*' width and
+ * precision included. The format must be a string literal; the number of
+ * arguments is checked against it at compile time, and the trace point is
+ * constant initialized, so nothing is registered until it first runs.
+ * String arguments are copied, up to LOC_TRACE_MAX_STRINGS bytes per record
+ * in total.
+ *
+ *     LOC_TRACE("%s]: sv %u cn0 %f", __func__, svId, cn0);
+ */
+#define LOC_TRACE(fmt, ...)                                                   \
+    do {                                                                      \
+        static_assert(loc_util::LocTrace::countConversions(fmt) ==            \
+                      sizeof(loc_util::LocTrace::countArgs(__VA_ARGS__)) - 1, \
+                      "trace arguments do not match the format");             \
+        static loc_util::LocTraceSite _locTraceSite(LOG_TAG, fmt);            \
+        if (_locTraceSite.isEnabled()) {                                      \
+            loc_util::LocTrace::record(_locTraceSite, ##__VA_ARGS__);         \
+        }                                                                     \
+    } while (0)
+
+#define LOC_TRACE_MAX_ARGS    (10)
+#define LOC_TRACE_MAX_STRINGS (48)
+
+namespace loc_util {
+
+typedef enum {
+    LOC_TRACE_ARG_INT = 0,
+    LOC_TRACE_ARG_UINT,
+    LOC_TRACE_ARG_DOUBLE,
+    LOC_TRACE_ARG_PTR,
+    LOC_TRACE_ARG_STR,
+} LocTraceArgType;
+
+/* A trace point, its address is the format id stored in the records. It is
+ * bound to the switch of its tag the first time it runs. */
+class LocTraceSite {
+    const char* mTag;
+    const char* mFormat;
+    std::atomic<const std::atomic<bool>*> mEnabled;
+    const std::atomic<bool>* bind();
+public:
+    constexpr LocTraceSite(const char* tag, const char* format) :
+        mTag(tag), mFormat(format), mEnabled(nullptr) {}
+    inline bool isEnabled() {
+        const std::atomic<bool>* enabled = mEnabled.load(std::memory_order_acquire);
+        if (nullptr == enabled) {
+            enabled = bind();
+        }
+        return enabled->load(std::memory_order_relaxed);
+    }
+    inline const char* getTag() const { return mTag; }
+    inline const char* getFormat() const { return mFormat; }
+};
+
+struct LocTraceRecord {
+    const LocTraceSite* site;
+    int64_t timeNs;
+    uint8_t numArgs;
+    uint8_t stringsLen;
+    uint8_t types[LOC_TRACE_MAX_ARGS];
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        const void* p;
+        uint32_t s; // offset into strings
+    } args[LOC_TRACE_MAX_ARGS];
+    char strings[LOC_TRACE_MAX_STRINGS];
+};
+
+class LocTrace {
+public:
+    // enables the tags of a comma separated list, "*" enables every tag;
+    // tags set with setTagEnabled() keep their setting
+    static void setEnabledTags(const char* tags);
+    static void setTagEnabled(const char* tag, bool enabled);
+
+    // only used unevaluated, sizeof the result is the number of arguments + 1
+    template <typename... ARGS>
+    static char (&countArgs(const ARGS&...))[sizeof...(ARGS) + 1];
+
+    // number of arguments a printf format takes, '*' width and precision included
+    static constexpr size_t countConversions(const char* f) {
+        size_t conversions = 0;
+        while ('\0' != *f) {
+            if ('%' != *f++) {
+                continue;
+            }
+            if ('%' == *f) {
+                f++;
+                continue;
+            }
+            conversions++;
+            for (; '\0' != *f && isFormatFlag(*f); f++) {
+                if ('*' == *f) {
+                    conversions++;
+                }
+            }
+            if ('\0' != *f) {
+                f++;
+            }
+        }
+        return conversions;
+    }
+
+    template <typename... ARGS>
+    static inline void record(const LocTraceSite& site, const ARGS&... args) {
+        static_assert(sizeof...(ARGS) <= LOC_TRACE_MAX_ARGS, "too many trace arguments");
+        LocTraceRecord* r = begin(site);
+        if (nullptr != r) {
+            r->numArgs = 0;
+            r->stringsLen = 0;
+            int expand[] = { 0, (put(*r, args), 0)... };
+            (void)expand;
+            commit();
+        }
+    }
+
+private:
+    static constexpr bool isFormatFlag(char c) {
+        return ('0' <= c && '9' >= c) || '-' == c || '+' == c || ' ' == c || '#' == c ||
+                '.' == c || '*' == c || 'h' == c || 'l' == c || 'j' == c || 'z' == c ||
+                't' == c || 'L' == c;
+    }
+
+    // returns the next free record of the ring of this thread, nullptr if full
+    static LocTraceRecord* begin(const LocTraceSite& site);
+    static void commit();
+    static void putString(LocTraceRecord& r, const char* s);
+
+    template <typename T>
+    static inline typename std::enable_if<std::is_integral<T>::value ||
+                                          std::is_enum<T>::value>::type
+    put(LocTraceRecord& r, const T& v) {
+        if (std::is_signed<T>::value || std::is_enum<T>::value) {
+            r.types[r.numArgs] = LOC_TRACE_ARG_INT;
+            r.args[r.numArgs++].i = (int64_t)v;
+        } else {
+            r.types[r.numArgs] = LOC_TRACE_ARG_UINT;
+            r.args[r.numArgs++].u = (uint64_t)v;
+        }
+    }
+    template <typename T>
+    static inline typename std::enable_if<std::is_floating_point<T>::value>::type
+    put(LocTraceRecord& r, const T& v) {
+        r.types[r.numArgs] = LOC_TRACE_ARG_DOUBLE;
+        r.args[r.numArgs++].d = (double)v;
+    }
+    template <typename T>
+    static inline void put(LocTraceRecord& r, T* const& v) {
+        r.types[r.numArgs] = LOC_TRACE_ARG_PTR;
+        r.args[r.numArgs++].p = (const void*)v;
+    }
+    static inline void put(LocTraceRecord& r, const char* const& v) { putString(r, v); }
+    static inline void put(LocTraceRecord& r, char* const& v) { putString(r, v); }
+    template <size_t N>
+    static inline void put(LocTraceRecord& r, const char (&v)[N]) { putString(r, v); }
+};
+
+} // namespace loc_util
+
+#endif //__LOC_TRACE__
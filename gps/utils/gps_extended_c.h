@@ -2159,6 +2159,66 @@ typedef std::function<void(
     const GnssSvTypeConfig& config
 )> GnssSvTypeConfigCallback;
 
+/* Mask of GnssMeasurementsCodeType values, bit (1 << codeType), except
+ * GNSS_MEASUREMENTS_CODE_TYPE_OTHER which is GNSS_MEASUREMENTS_CODE_TYPE_OTHER_BIT */
+typedef uint32_t GnssMeasurementsCodeTypeMask;
+#define GNSS_MEASUREMENTS_CODE_TYPE_OTHER_BIT   (1u<<31)
+
+typedef uint32_t GnssMeasurementStreamFlagsMask;
+typedef enum {
+    /* deliver epochs as compact binary records, delta encoded against the
+     * previously delivered epoch, on deltaCb instead of gnssMeasurementsCb */
+    GNSS_MEASUREMENT_STREAM_DELTA_ENCODED_BIT = (1<<0),
+} GnssMeasurementStreamFlagsBits;
+
+/* Receives one delta encoded measurement epoch, see GnssMeasurementStream.h */
+typedef std::function<void(
+    const uint8_t* data, size_t length
+)> GnssMeasurementsDeltaCallback;
+
+/* Per client measurement stream options. These are injected directly to
+ * GNSS Adapter bypassing Location API */
+typedef struct {
+    uint32_t size; // set to sizeof(GnssMeasurementStreamConfig)
+    GnssMeasurementStreamFlagsMask flags;
+    // minimum time between two delivered epochs, 0 delivers every epoch
+    uint32_t minIntervalMs;
+    // constellations to deliver, bit (1 << GnssSvType), 0 for all
+    uint32_t svTypeMask;
+    // code types to deliver, 0 for all
+    GnssMeasurementsCodeTypeMask codeTypeMask;
+    // carrier frequency band to deliver, 0 for no bound
+    float minCarrierFrequencyHz;
+    float maxCarrierFrequencyHz;
+    // mandatory with GNSS_MEASUREMENT_STREAM_DELTA_ENCODED_BIT, the client
+    // must still register gnssMeasurementsCb for measurements to be enabled
+    GnssMeasurementsDeltaCallback deltaCb;
+} GnssMeasurementStreamConfig;
+
+typedef uint32_t GnssSvStatusFlagsMask;
+typedef enum {
+    /* deliver only the SVs whose status changed since the last delivery to
+     * the client, an SV that is no longer tracked is delivered once with
+     * cN0Dbhz 0 and no options */
+    GNSS_SV_STATUS_DELTA_ONLY_BIT = (1<<0),
+} GnssSvStatusFlagsBits;
+
+/* Per client SV status options. An SV counts as changed when it is new,
+ * gone, its USED_IN_FIX/ephemeris/almanac options differ or a value moved
+ * by at least its threshold since it was last delivered. Epochs without any
+ * changed SV are not delivered. These are injected directly to GNSS Adapter
+ * bypassing Location API */
+typedef struct {
+    uint32_t size; // set to sizeof(GnssSvStatusConfig)
+    GnssSvStatusFlagsMask flags;
+    // minimum time between two delivered epochs, 0 for no limit
+    uint32_t minIntervalMs;
+    // C/N0 change that counts as changed, 0 for any change
+    float cN0ThresholdDbhz;
+    // elevation/azimuth change that counts as changed, 0 for any change
+    float angleThresholdDeg;
+} GnssSvStatusConfig;
+
 /*
  * Represents the status of AGNSS augmented to support IPv4.
  */
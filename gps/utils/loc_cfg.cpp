@@ -43,6 +43,7 @@
 #include <loc_pla.h>
 #include <loc_target.h>
 #include <loc_misc_utils.h>
+#include <LocTrace.h>
 #ifdef USE_GLIB
 #include <glib.h>
 #endif
@@ -58,6 +59,7 @@
 static uint32_t DEBUG_LEVEL = 0xff;
 static uint32_t TIMESTAMP = 0;
 static uint32_t DATUM_TYPE = 0;
+static char TRACE_TAGS[LOC_MAX_PARAM_STRING] = "";
 static bool sVendorEnhanced = true;
 
 /* Parameter spec table */
@@ -66,6 +68,7 @@ static const loc_param_s_type loc_param_table[] =
     {"DEBUG_LEVEL",        &DEBUG_LEVEL,        NULL,    'n'},
     {"TIMESTAMP",          &TIMESTAMP,          NULL,    'n'},
     {"DATUM_TYPE",         &DATUM_TYPE,         NULL,    'n'},
+    {"TRACE_TAGS",         &TRACE_TAGS,         NULL,    's'},
 };
 static const int loc_param_num = sizeof(loc_param_table) / sizeof(loc_param_s_type);
 
@@ -441,6 +444,7 @@ void loc_read_conf(const char* conf_file_name, const loc_param_s_type* config_ta
     }
     /* Initialize logging mechanism with parsed data */
     loc_logger_init(DEBUG_LEVEL, TIMESTAMP);
+    loc_util::LocTrace::setEnabledTags(TRACE_TAGS);
 }
 
 /*=============================================================================
@@ -33,8 +33,11 @@
 #include <dlfcn.h>
 #include <log_util.h>
 #include <loc_misc_utils.h>
+#include <LocDlRegistry.h>
 #include <ctype.h>
 
+using namespace loc_util;
+
 
 int loc_util_split_string(char *raw_string, char **split_strings_ptr,
                           int max_num_substrings, char delimiter)
@@ -124,13 +127,13 @@ void* dlGetSymFromLib(void*& libHandle, const char* libName, const char* symName
     void* sym = nullptr;
     if ((nullptr != libHandle || nullptr != libName) && nullptr != symName) {
         if (nullptr == libHandle) {
-            libHandle = dlopen(libName, RTLD_NOW);
-            if (nullptr == libHandle) {
-                logDlError("dlopen");
+            // resolved once per process through the registry, which also
+            // keeps the library loaded
+            libHandle = LocDlRegistry::getLibHandle(libName);
+            if (nullptr != libHandle) {
+                sym = LocDlRegistry::getSymbol(libName, symName);
             }
-        }
-        // NOT else, as libHandle gets assigned 5 line above
-        if (nullptr != libHandle) {
+        } else {
             sym = dlsym(libHandle, symName);
             if (nullptr == sym) {
                 logDlError("dlsym");
@@ -102,7 +102,8 @@ DESCRIPTION
    If libHandle is not null, it will be used as the handle to the library. In
    that case libName wll not be used;
    libHandle is an in / out parameter.
-   If libHandle is null, libName will be used to dlopen.
+   If libHandle is null, libName will be looked up in LocDlRegistry, which
+   dlopens it and resolves symName only once per process.
    Either libHandle or libName must not be nullptr.
    symName must not be null.
 
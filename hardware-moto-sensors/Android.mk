@@ -126,7 +126,9 @@ ifeq ($(BOARD_USES_MOT_SENSOR_HUB), true)
             $(SH_PATH)/SensorBase.cpp   \
             $(SH_PATH)/SensorHal.cpp    \
             $(SH_PATH)/HubSensors.cpp   \
-            $(SH_PATH)/SensorList.cpp
+            $(SH_PATH)/SensorList.cpp   \
+            DirectChannel.cpp           \
+            SensorTrace.cpp
 
         ifeq ($(MOT_SENSOR_HUB_HW_TYPE_L0), true)
             # Sensor HAL file for M0 hub (low-tier) products (athene, etc...)
@@ -134,7 +136,8 @@ ifeq ($(BOARD_USES_MOT_SENSOR_HUB), true)
                 $(SH_PATH)/Quaternion.cpp \
                 $(SH_PATH)/GyroIntegration.cpp \
                 $(SH_PATH)/GameRotationVector.cpp \
-                $(SH_PATH)/LinearAccelGravity.cpp
+                $(SH_PATH)/LinearAccelGravity.cpp \
+                $(SH_PATH)/FusionEngine.cpp
             ifeq ($(MOT_SENSOR_HUB_HW_AK09912), true)
                 LOCAL_SRC_FILES += \
                     $(SH_PATH)/GeoMagRotationVector.cpp \
@@ -144,6 +147,7 @@ ifeq ($(BOARD_USES_MOT_SENSOR_HUB), true)
         endif
 
         ifeq ($(MOT_SENSOR_HUB_HW_TYPE_L4), true)
+            LOCAL_SRC_FILES += $(SH_PATH)/SoftwareBatcher.cpp
             LOCAL_REQUIRED_MODULES += sensors.iio
         endif
 
@@ -183,6 +187,119 @@ ifeq ($(BOARD_USES_MOT_SENSOR_HUB), true)
 
         include $(BUILD_SHARED_LIBRARY)
 
+        ###############################
+        # Hub trace replay test       #
+        ###############################
+        # Replays a trace through HubSensors without opening the hub. Built
+        # for the target, the hub record layout comes from the kernel headers.
+        include $(CLEAR_VARS)
+
+        LOCAL_CFLAGS := -DLOG_TAG=\"SensorsTest\"
+        LOCAL_CFLAGS += $(SH_CFLAGS)
+        LOCAL_CFLAGS += -Wall -Wextra
+        LOCAL_CXX_FLAGS += -std=c++14
+
+        LOCAL_SRC_FILES :=                  \
+            $(SH_PATH)/tests/HubSensorsTest.cpp \
+            $(SH_PATH)/SensorBase.cpp       \
+            $(SH_PATH)/HubSensors.cpp       \
+            $(SH_PATH)/SensorList.cpp       \
+            DirectChannel.cpp               \
+            SensorTrace.cpp
+
+        ifeq ($(MOT_SENSOR_HUB_HW_TYPE_L0), true)
+            LOCAL_SRC_FILES += \
+                $(SH_PATH)/Quaternion.cpp \
+                $(SH_PATH)/GyroIntegration.cpp \
+                $(SH_PATH)/GameRotationVector.cpp \
+                $(SH_PATH)/LinearAccelGravity.cpp \
+                $(SH_PATH)/FusionEngine.cpp
+            ifeq ($(MOT_SENSOR_HUB_HW_AK09912), true)
+                LOCAL_SRC_FILES += \
+                    $(SH_PATH)/GeoMagRotationVector.cpp \
+                    $(SH_PATH)/RotationVector.cpp
+            endif
+        endif
+
+        ifeq ($(MOT_SENSOR_HUB_HW_TYPE_L4), true)
+            LOCAL_SRC_FILES += $(SH_PATH)/SoftwareBatcher.cpp
+        endif
+
+        LOCAL_C_INCLUDES += $(LOCAL_PATH)/$(SH_PATH)
+        LOCAL_C_INCLUDES += external/zlib
+        LOCAL_C_INCLUDES += system/core/base/include
+
+        LOCAL_HEADER_LIBRARIES += generated_kernel_headers libhardware_headers
+        LOCAL_SHARED_LIBRARIES += liblog libcutils libz libdl libutils
+        LOCAL_MODULE := $(SH_MODULE)_hub_sensors_test
+        LOCAL_MODULE_TAGS := optional
+
+        include $(BUILD_NATIVE_TEST)
+
+        ifeq ($(MOT_SENSOR_HUB_HW_TYPE_L0), true)
+            ###############################
+            # Host sensor fusion library  #
+            ###############################
+            # The M0 hub fusion algorithms only, without the HAL, so that
+            # recorded sensor traces can be replayed through them offline.
+            include $(CLEAR_VARS)
+
+            LOCAL_CFLAGS := -DLOG_TAG=\"MotoSensorsFusion\"
+            LOCAL_CFLAGS += -D_ENABLE_MAGNETOMETER
+            LOCAL_CFLAGS += -Wall -Wextra
+
+            LOCAL_SRC_FILES :=                          \
+                $(SH_PATH)/Quaternion.cpp               \
+                $(SH_PATH)/GyroIntegration.cpp          \
+                $(SH_PATH)/GameRotationVector.cpp       \
+                $(SH_PATH)/LinearAccelGravity.cpp       \
+                $(SH_PATH)/GeoMagRotationVector.cpp     \
+                $(SH_PATH)/RotationVector.cpp           \
+                $(SH_PATH)/FusionEngine.cpp
+
+            LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)/$(SH_PATH)
+            LOCAL_HEADER_LIBRARIES := libhardware_headers libbase_headers liblog_headers
+            LOCAL_MODULE := libstml0xx_fusion
+            LOCAL_MODULE_TAGS := optional
+
+            include $(BUILD_HOST_STATIC_LIBRARY)
+
+            ###############################
+            # Host sensor fusion test     #
+            ###############################
+            # Checks FusionEngine against the outputs of the old fusion
+            # singletons.
+            include $(CLEAR_VARS)
+
+            LOCAL_CFLAGS := -D_ENABLE_MAGNETOMETER
+            LOCAL_CFLAGS += -Wall -Wextra
+
+            LOCAL_SRC_FILES := $(SH_PATH)/tests/FusionEngineTest.cpp
+            LOCAL_STATIC_LIBRARIES := libstml0xx_fusion
+            LOCAL_HEADER_LIBRARIES := libhardware_headers libbase_headers liblog_headers
+            LOCAL_MODULE := stml0xx_fusion_test
+            LOCAL_MODULE_TAGS := optional
+
+            include $(BUILD_HOST_NATIVE_TEST)
+
+            ###############################
+            # Host fusion benchmark       #
+            ###############################
+            # Error bound and speedup of the quaternion/trig fast path
+            # against the scalar code it replaced.
+            include $(CLEAR_VARS)
+
+            LOCAL_CFLAGS := -Wall -Wextra -O2
+
+            LOCAL_SRC_FILES := $(SH_PATH)/benchmarks/FusionBenchmark.cpp
+            LOCAL_STATIC_LIBRARIES := libstml0xx_fusion
+            LOCAL_HEADER_LIBRARIES := libhardware_headers libbase_headers liblog_headers
+            LOCAL_MODULE := stml0xx_fusion_benchmark
+            LOCAL_MODULE_TAGS := optional
+
+            include $(BUILD_HOST_EXECUTABLE)
+        endif
+
     endif # !TARGET_SIMULATOR
 
     #########################
@@ -19,12 +19,14 @@
 
 #include <vector>
 #include <memory>
+#include <algorithm>
 #include <cstdint>
 #include <cinttypes>
 #include <hardware/sensors.h>
 
 #include "SensorBase.h"
 #include "SensorsLog.h"
+#include "DirectChannel.h"
 
 
 /** This BaseHal class maintains a list of sensor drivers that service this HAL
@@ -71,8 +73,9 @@ public:
         return mode == 0 ? 0 : -EINVAL;
     }
 
-    /// Map sensor handle/id to the corresponding driver
-    std::shared_ptr<SensorBase> handleToDriver(int handle) {
+    /** Map sensor handle/id to the corresponding driver. Derived classes
+     * whose driver list changes at run time override this. */
+    virtual std::shared_ptr<SensorBase> handleToDriver(int handle) {
         for (const auto& d : drivers) {
             if (d->hasSensor(handle)) return d;
         }
@@ -97,7 +100,11 @@ public:
 
         std::shared_ptr<SensorBase> s = handleToDriver(handle);
         if (s == nullptr) return -EINVAL;
-        return s->setEnable(handle, enabled);
+
+        // A sensor streaming to a direct channel stays enabled
+        directReport.setPollEnabled(handle, enabled);
+        int64_t ns = 0, timeout = 0;
+        return enableDriver(s, handle, directReport.getRate(handle, ns, timeout));
     }
 
     /**
@@ -133,6 +140,10 @@ public:
     virtual int batch(int handle, int flags, int64_t ns, int64_t timeout) {
         std::shared_ptr<SensorBase> s = handleToDriver(handle);
         if (s == nullptr) return -EINVAL;
+
+        // A direct report may need a faster rate than the poll path
+        directReport.setPollRate(handle, ns, timeout);
+        directReport.getRate(handle, ns, timeout);
         return s->batch(handle, flags, ns, timeout);
     }
 
@@ -154,8 +165,95 @@ public:
         return s->flush(handle);
     }
 
+    /**
+     * Registers (mem != NULL) or unregisters (mem == NULL) a shared memory
+     * channel through which sensor events are reported directly to a client,
+     * bypassing poll().
+     *
+     * @return a positive channel handle when registering, 0 when
+     * unregistering, negative errno code otherwise.
+     */
+    virtual int registerDirectChannel(const struct sensors_direct_mem_t* mem, int channel) {
+        S_LOGD("mem=%p channel=%d", mem, channel);
+
+        if (mem) {
+            return directReport.registerChannel(mem);
+        }
+        for (int handle : directReport.unregisterChannel(channel)) {
+            updateDirectReport(handle);
+        }
+        return 0;
+    }
+
+    /**
+     * Starts, changes or stops the direct report of a sensor on a channel.
+     * A handle of -1 with SENSOR_DIRECT_RATE_STOP stops all the sensors of
+     * the channel.
+     *
+     * @return a positive report token when starting, 0 when stopping,
+     * negative errno code otherwise.
+     */
+    virtual int configDirectReport(int handle, int channel, const struct sensors_direct_cfg_t *config) {
+        S_LOGD("handle=%d channel=%d", handle, channel);
+
+        if (!config) return -EINVAL;
+
+        if (handle == -1) {
+            if (config->rate_level != SENSOR_DIRECT_RATE_STOP) return -EINVAL;
+            for (int h : directReport.stopChannel(channel)) {
+                updateDirectReport(h);
+            }
+            return 0;
+        }
+
+        std::shared_ptr<SensorBase> s = handleToDriver(handle);
+        if (s == nullptr) return -EINVAL;
+
+        std::vector<struct sensor_t> list;
+        s->getSensorsList(list);
+        auto sensor = std::find_if(list.begin(), list.end(),
+                [handle](const struct sensor_t &t) { return t.handle == handle; });
+        if (sensor == list.end() || config->rate_level > DirectReport::getMaxRateLevel(*sensor)) {
+            return -EINVAL;
+        }
+
+        int token = directReport.configure(handle, channel, config->rate_level);
+        if (token < 0) return token;
+
+        int ret = updateDirectReport(handle);
+        return ret < 0 ? ret : token;
+    }
+
+    /** Called by SensorsModuleT on the events returned by poll().
+     * @return the number of events left for the poll() path. */
+    int dispatchDirectReport(sensors_event_t* data, int count) {
+        return directReport.dispatch(data, count);
+    }
+
 protected:
     std::vector<std::shared_ptr<SensorBase>> drivers;
+
+    DirectReport directReport;
+
+    /** Enables or disables the driver of a sensor. Derived classes that need
+     * to synchronize with their poll() can override this. */
+    virtual int enableDriver(std::shared_ptr<SensorBase> s, int handle, int enabled) {
+        return s->setEnable(handle, enabled);
+    }
+
+    /** Applies the combined poll and direct report rate to a sensor's driver. */
+    int updateDirectReport(int handle) {
+        std::shared_ptr<SensorBase> s = handleToDriver(handle);
+        if (s == nullptr) return -EINVAL;
+
+        int64_t ns = 0, timeout = 0;
+        bool enabled = directReport.getRate(handle, ns, timeout);
+        if (enabled) {
+            int ret = s->batch(handle, 0, ns, timeout);
+            if (ret < 0) return ret;
+        }
+        return enableDriver(s, handle, enabled);
+    }
 };
 
 
@@ -212,7 +310,7 @@ struct SensorsModuleT : public sensors_module_t {
 
         // v0.common is a hw_device_t
         hal->v0.common.tag       = HARDWARE_DEVICE_TAG;
-        hal->v0.common.version   = SENSORS_DEVICE_API_VERSION_1_3;
+        hal->v0.common.version   = SENSORS_DEVICE_API_VERSION_1_4;
         hal->v0.common.module    = const_cast<hw_module_t*>(module);
         hal->v0.common.close     = close;
 
@@ -221,6 +319,9 @@ struct SensorsModuleT : public sensors_module_t {
         hal->v0.poll             = poll;
         hal->v1.batch            = batch;
         hal->v1.flush            = flush;
+        hal->v1.inject_sensor_data      = injectSensorData;
+        hal->v1.register_direct_channel = registerDirectChannel;
+        hal->v1.config_direct_report    = configDirectReport;
 
         *device = &hal->v0.common;
         return 0;
@@ -247,6 +348,9 @@ struct SensorsModuleT : public sensors_module_t {
         int ret = 0;
         do {
             ret = getHal()->poll(data, count);
+            if (ret > 0) {
+                ret = getHal()->dispatchDirectReport(data, ret);
+            }
         } while( ret == 0 );
         return ret;
     }
@@ -262,6 +366,25 @@ struct SensorsModuleT : public sensors_module_t {
         return getHal()->flush(handle);
     }
 
+    /** Data injection requires setOperationMode(1), which isn't supported. */
+    static int injectSensorData(sensors_poll_device_1_t *dev, const sensors_event_t *data) {
+        (void)dev;
+        (void)data;
+        return -EPERM;
+    }
+
+    static int registerDirectChannel(sensors_poll_device_1_t *dev,
+            const struct sensors_direct_mem_t* mem, int channel) {
+        (void)dev;
+        return getHal()->registerDirectChannel(mem, channel);
+    }
+
+    static int configDirectReport(sensors_poll_device_1_t *dev, int handle,
+            int channel, const struct sensors_direct_cfg_t *config) {
+        (void)dev;
+        return getHal()->configDirectReport(handle, channel, config);
+    }
+
 private:
     struct hw_module_methods_t moduleMethods;
     const char *name;
@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2017 Motorola Mobility
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+
+#include <cutils/native_handle.h>
+
+#include "DirectChannel.h"
+#include "SensorsLog.h"
+
+using namespace std;
+
+std::unique_ptr<DirectChannel> DirectChannel::create(const struct sensors_direct_mem_t *mem) {
+    if (!mem || !mem->handle) {
+        return nullptr;
+    }
+    if (mem->type != SENSOR_DIRECT_MEM_TYPE_ASHMEM) {
+        S_LOGE("Unsupported memory type %d", mem->type);
+        return nullptr;
+    }
+    if (mem->format != SENSOR_DIRECT_FMT_SENSORS_EVENT) {
+        S_LOGE("Unsupported format %d", mem->format);
+        return nullptr;
+    }
+    if (mem->handle->numFds < 1 || mem->size < sizeof(sensors_event_t)) {
+        S_LOGE("Bad channel memory fds=%d size=%zu", mem->handle->numFds, mem->size);
+        return nullptr;
+    }
+
+    // The mapping keeps the ashmem region alive, so the fd isn't kept.
+    void *base = mmap(nullptr, mem->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+            mem->handle->data[0], 0);
+    if (base == MAP_FAILED) {
+        S_LOGE("mmap failed: %s", strerror(errno));
+        return nullptr;
+    }
+
+    return unique_ptr<DirectChannel>(new DirectChannel(base, mem->size));
+}
+
+DirectChannel::DirectChannel(void *base, size_t length) :
+    base(base), length(length),
+    ring(static_cast<sensors_event_t *>(base)),
+    slots(length / sizeof(sensors_event_t)),
+    head(0), counter(1)
+{
+    memset(base, 0, length);
+}
+
+DirectChannel::~DirectChannel() {
+    munmap(base, length);
+}
+
+void DirectChannel::write(const sensors_event_t &ev, int32_t token) {
+    sensors_event_t *dst = &ring[head];
+    const size_t counterEnd = offsetof(sensors_event_t, reserved0) + sizeof(dst->reserved0);
+
+    // Everything but the counter first, so that a reader never sees a new
+    // counter value with stale contents.
+    memcpy(dst, &ev, offsetof(sensors_event_t, reserved0));
+    memcpy(reinterpret_cast<uint8_t *>(dst) + counterEnd,
+            reinterpret_cast<const uint8_t *>(&ev) + counterEnd,
+            sizeof(sensors_event_t) - counterEnd);
+    dst->version = sizeof(sensors_event_t);
+    dst->sensor = token;
+
+    atomic_thread_fence(memory_order_release);
+    dst->reserved0 = static_cast<int32_t>(counter);
+    atomic_thread_fence(memory_order_release);
+
+    if (++counter == 0) {
+        counter = 1;
+    }
+    if (++head == slots) {
+        head = 0;
+    }
+}
+
+DirectReport::DirectReport() :
+    lock(), channels(), sensors(), activeReports(0), nextChannel(1), nextToken(1)
+{
+}
+
+void DirectReport::advertise(struct sensor_t &sensor) {
+    switch (sensor.type) {
+        case SENSOR_TYPE_ACCELEROMETER:
+        case SENSOR_TYPE_GYROSCOPE:
+        case SENSOR_TYPE_GYROSCOPE_UNCALIBRATED:
+        case SENSOR_TYPE_MAGNETIC_FIELD:
+        case SENSOR_TYPE_MAGNETIC_FIELD_UNCALIBRATED:
+        case SENSOR_TYPE_GAME_ROTATION_VECTOR:
+        case SENSOR_TYPE_ROTATION_VECTOR:
+        case SENSOR_TYPE_GEOMAGNETIC_ROTATION_VECTOR:
+        case SENSOR_TYPE_GRAVITY:
+        case SENSOR_TYPE_LINEAR_ACCELERATION:
+            break;
+        default:
+            return;
+    }
+
+    // Only continuous, non wake-up sensors can be reported directly
+    if ((sensor.flags & (REPORTING_MODE_MASK | SENSOR_FLAG_WAKE_UP)) != SENSOR_FLAG_CONTINUOUS_MODE
+            || sensor.minDelay <= 0) {
+        return;
+    }
+
+    int level = SENSOR_DIRECT_RATE_VERY_FAST;
+    while (level > SENSOR_DIRECT_RATE_STOP
+            && sensor.minDelay * 1000LL > rateLevelToPeriodNs(level)) {
+        level--;
+    }
+    if (level == SENSOR_DIRECT_RATE_STOP) {
+        return;
+    }
+
+    sensor.flags &= ~SENSOR_FLAG_MASK_DIRECT_REPORT;
+    sensor.flags |= (level << SENSOR_FLAG_SHIFT_DIRECT_REPORT) | SENSOR_FLAG_DIRECT_CHANNEL_ASHMEM;
+}
+
+int DirectReport::getMaxRateLevel(const struct sensor_t &sensor) {
+    return (sensor.flags & SENSOR_FLAG_MASK_DIRECT_REPORT) >> SENSOR_FLAG_SHIFT_DIRECT_REPORT;
+}
+
+int64_t DirectReport::rateLevelToPeriodNs(int rateLevel) {
+    switch (rateLevel) {
+        case SENSOR_DIRECT_RATE_NORMAL:
+            return 20000000LL;  // 50Hz
+        case SENSOR_DIRECT_RATE_FAST:
+            return 5000000LL;   // 200Hz
+        case SENSOR_DIRECT_RATE_VERY_FAST:
+            return 1250000LL;   // 800Hz
+        default:
+            return 0;
+    }
+}
+
+int DirectReport::registerChannel(const struct sensors_direct_mem_t *mem) {
+    unique_ptr<DirectChannel> channel = DirectChannel::create(mem);
+    if (!channel) {
+        return -EINVAL;
+    }
+
+    lock_guard<mutex> _l(lock);
+    int handle = nextChannel++;
+    channels[handle] = move(channel);
+    S_LOGD("channel=%d size=%zu", handle, mem->size);
+    return handle;
+}
+
+vector<int> DirectReport::unregisterChannel(int channel) {
+    lock_guard<mutex> _l(lock);
+    vector<int> stopped = stopChannelLocked(channel);
+    channels.erase(channel);
+    S_LOGD("channel=%d", channel);
+    return stopped;
+}
+
+vector<int> DirectReport::stopChannel(int channel) {
+    lock_guard<mutex> _l(lock);
+    return stopChannelLocked(channel);
+}
+
+vector<int> DirectReport::stopChannelLocked(int channel) {
+    vector<int> stopped;
+
+    for (auto &s : sensors) {
+        if (s.second.reports.erase(channel)) {
+            activeReports--;
+            stopped.push_back(s.first);
+        }
+    }
+    return stopped;
+}
+
+int DirectReport::configure(int handle, int channel, int rateLevel) {
+    lock_guard<mutex> _l(lock);
+
+    if (!channels.count(channel)) {
+        return -EINVAL;
+    }
+
+    SensorState &s = sensors[handle];
+    auto it = s.reports.find(channel);
+
+    if (rateLevel == SENSOR_DIRECT_RATE_STOP) {
+        if (it != s.reports.end()) {
+            s.reports.erase(it);
+            activeReports--;
+        }
+        return 0;
+    }
+
+    int64_t periodNs = rateLevelToPeriodNs(rateLevel);
+    if (!periodNs) {
+        return -EINVAL;
+    }
+
+    if (it == s.reports.end()) {
+        int32_t token = nextToken++;
+        if (nextToken <= 0) {
+            nextToken = 1;
+        }
+        it = s.reports.emplace(channel, Report{token, 0, 0}).first;
+        activeReports++;
+    }
+    it->second.periodNs = periodNs;
+
+    S_LOGD("handle=%d channel=%d level=%d token=%d", handle, channel, rateLevel,
+            it->second.token);
+    return it->second.token;
+}
+
+void DirectReport::setPollEnabled(int handle, bool enabled) {
+    lock_guard<mutex> _l(lock);
+    sensors[handle].pollEnabled = enabled;
+}
+
+void DirectReport::setPollRate(int handle, int64_t periodNs, int64_t latencyNs) {
+    lock_guard<mutex> _l(lock);
+    SensorState &s = sensors[handle];
+    s.pollPeriodNs = periodNs;
+    s.pollLatencyNs = latencyNs;
+}
+
+bool DirectReport::getRate(int handle, int64_t &periodNs, int64_t &latencyNs) {
+    lock_guard<mutex> _l(lock);
+
+    auto it = sensors.find(handle);
+    if (it == sensors.end()) {
+        return false;
+    }
+
+    const SensorState &s = it->second;
+    if (s.reports.empty()) {
+        periodNs = s.pollPeriodNs;
+        latencyNs = s.pollLatencyNs;
+        return s.pollEnabled;
+    }
+
+    periodNs = s.pollEnabled && s.pollPeriodNs > 0 ? s.pollPeriodNs : INT64_MAX;
+    for (const auto &r : s.reports) {
+        periodNs = min(periodNs, r.second.periodNs);
+    }
+    latencyNs = 0;
+    return true;
+}
+
+int DirectReport::dispatch(sensors_event_t *data, int count) {
+    if (!activeReports.load(memory_order_relaxed)) {
+        return count;
+    }
+
+    lock_guard<mutex> _l(lock);
+    int kept = 0;
+
+    for (int i = 0; i < count; ++i) {
+        const sensors_event_t &ev = data[i];
+        bool keep = true;
+
+        if (ev.type != SENSOR_TYPE_META_DATA && ev.type != SENSOR_TYPE_DYNAMIC_SENSOR_META) {
+            auto s = sensors.find(ev.sensor);
+            if (s != sensors.end() && !s->second.reports.empty()) {
+                for (auto &r : s->second.reports) {
+                    Report &report = r.second;
+                    // The driver may run faster than this report (for the
+                    // poll path or another channel). Decimate against a
+                    // fixed schedule, so the average rate is the report's,
+                    // allowing for some timestamp jitter.
+                    if (ev.timestamp < report.nextTimestamp - report.periodNs / 4) {
+                        continue;
+                    }
+                    auto c = channels.find(r.first);
+                    if (c != channels.end()) {
+                        c->second->write(ev, report.token);
+                        report.nextTimestamp += report.periodNs;
+                        // First event, or the driver is slower than the
+                        // report or skipped: restart the schedule here.
+                        if (report.nextTimestamp <= ev.timestamp) {
+                            report.nextTimestamp = ev.timestamp + report.periodNs;
+                        }
+                    }
+                }
+                keep = s->second.pollEnabled;
+            }
+        }
+
+        if (keep) {
+            if (kept != i) {
+                data[kept] = ev;
+            }
+            kept++;
+        }
+    }
+
+    return kept;
+}
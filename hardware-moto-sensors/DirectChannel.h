@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2017 Motorola Mobility
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DIRECT_CHANNEL_H
+#define DIRECT_CHANNEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <hardware/sensors.h>
+
+/**
+ * A shared memory (ashmem) ring of sensors_event_t registered by the
+ * framework through register_direct_channel(). Events are written in the
+ * SENSOR_DIRECT_FMT_SENSORS_EVENT format: sensors_event_t::sensor holds the
+ * report token and sensors_event_t::reserved0 is an atomic counter, written
+ * last, which readers use to detect new and overwritten slots.
+ */
+class DirectChannel {
+public:
+    /** Maps the memory described by mem.
+     * @return the channel, or nullptr if the memory type or format isn't
+     * supported or can't be mapped. */
+    static std::unique_ptr<DirectChannel> create(const struct sensors_direct_mem_t *mem);
+
+    ~DirectChannel();
+
+    DirectChannel(const DirectChannel&) = delete;
+    DirectChannel& operator=(const DirectChannel&) = delete;
+
+    /** Appends ev to the ring, overwriting the oldest event once full. */
+    void write(const sensors_event_t &ev, int32_t token);
+
+private:
+    DirectChannel(void *base, size_t length);
+
+    void *base;
+    size_t length;
+    sensors_event_t *ring;
+    size_t slots;
+    size_t head;
+    /// Value of reserved0 for the next event. Never 0, which marks an unwritten slot.
+    uint32_t counter;
+};
+
+/**
+ * Direct report bookkeeping for one HAL: the registered channels, the
+ * sensors configured on each of them, and the rate the poll() path asked for.
+ * The HAL folds both into what it applies to its drivers (getRate()), and
+ * passes the events read by poll() through dispatch(), which copies them into
+ * the channels.
+ *
+ * All methods are thread safe.
+ */
+class DirectReport {
+public:
+    DirectReport();
+
+    DirectReport(const DirectReport&) = delete;
+    DirectReport& operator=(const DirectReport&) = delete;
+
+    /** Sets the direct report flags of the IMU and fusion sensors, for the
+     * highest rate level their minDelay supports. Other sensors are left
+     * untouched. */
+    static void advertise(struct sensor_t &sensor);
+
+    /** @return the highest rate level advertised in the flags of sensor. */
+    static int getMaxRateLevel(const struct sensor_t &sensor);
+
+    /** @return the nominal sampling period of a SENSOR_DIRECT_RATE_* level,
+     * or 0 for SENSOR_DIRECT_RATE_STOP. */
+    static int64_t rateLevelToPeriodNs(int rateLevel);
+
+    /** @return a positive channel handle, or a negative errno code. */
+    int registerChannel(const struct sensors_direct_mem_t *mem);
+
+    /** Stops every report on the channel and unmaps it.
+     * @return the handles of the sensors that were configured on it. */
+    std::vector<int> unregisterChannel(int channel);
+
+    /** Starts, changes or stops (SENSOR_DIRECT_RATE_STOP) the report of one
+     * sensor on a channel.
+     * @return the report token, 0 when stopping, or a negative errno code. */
+    int configure(int handle, int channel, int rateLevel);
+
+    /** Stops every report on the channel.
+     * @return the handles of the sensors that were configured on it. */
+    std::vector<int> stopChannel(int channel);
+
+    /// Records the state requested through activate().
+    void setPollEnabled(int handle, bool enabled);
+
+    /// Records the rate requested through batch().
+    void setPollRate(int handle, int64_t periodNs, int64_t latencyNs);
+
+    /** Computes what to apply to the driver of a sensor: the fastest of the
+     * poll and direct report periods, and no batching while any direct
+     * report is active. Without a direct report, this is what the poll
+     * path last asked for.
+     * @return true if the sensor must be enabled. */
+    bool getRate(int handle, int64_t &periodNs, int64_t &latencyNs);
+
+    /** Writes the events of directly reported sensors to their channels,
+     * and drops those of sensors that weren't activated through the poll()
+     * path.
+     * @return the number of events left in data. */
+    int dispatch(sensors_event_t *data, int count);
+
+private:
+    struct Report {
+        int32_t token;
+        int64_t periodNs;
+        /// Nominal timestamp of the next event to write, 0 before the first.
+        int64_t nextTimestamp;
+    };
+
+    struct SensorState {
+        SensorState() : pollEnabled(false), pollPeriodNs(0), pollLatencyNs(0), reports() { }
+
+        bool pollEnabled;
+        int64_t pollPeriodNs;
+        int64_t pollLatencyNs;
+        /// Keyed by channel handle
+        std::map<int, Report> reports;
+    };
+
+    std::vector<int> stopChannelLocked(int channel);
+
+    std::mutex lock;
+    std::map<int, std::unique_ptr<DirectChannel>> channels;
+    std::map<int, SensorState> sensors;
+    /// Number of active reports, checked by dispatch() before taking the lock.
+    std::atomic<int> activeReports;
+    int nextChannel;
+    int32_t nextToken;
+};
+
+#endif // DIRECT_CHANNEL_H
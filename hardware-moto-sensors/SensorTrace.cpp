@@ -0,0 +1,330 @@
+/*
+ * Copyright (C) 2017 Motorola Mobility
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+#include <cutils/properties.h>
+
+#include "SensorTrace.h"
+#include "SensorsLog.h"
+
+using namespace std;
+
+static int64_t bootTimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/** Reads a trace or replay path property, which user builds ignore.
+ * @return false if it is unset or ignored. */
+static bool getPathProperty(const char *name, char *path) {
+    if (property_get(name, path, "") <= 0) {
+        return false;
+    }
+    if (!property_get_bool("ro.debuggable", false)) {
+        S_LOGE("Ignoring %s on a non debuggable build", name);
+        return false;
+    }
+    return true;
+}
+
+static int writeAll(int fd, struct iovec *iov, int iovcnt) {
+    while (iovcnt) {
+        ssize_t ret = writev(fd, iov, iovcnt);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        for (; iovcnt && (size_t)ret >= iov->iov_len; iov++, iovcnt--) {
+            ret -= iov->iov_len;
+        }
+        if (iovcnt) {
+            iov->iov_base = (uint8_t *)iov->iov_base + ret;
+            iov->iov_len -= ret;
+        }
+    }
+    return 0;
+}
+
+unique_ptr<SensorTraceRecorder> SensorTraceRecorder::create(const char *hub,
+        size_t recordSize, size_t typeOffset) {
+    char path[PROPERTY_VALUE_MAX];
+
+    if (!getPathProperty(SENSOR_TRACE_PROPERTY, path)) {
+        return nullptr;
+    }
+
+    int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (fd < 0) {
+        S_LOGE("Couldn't create %s (%s)", path, strerror(errno));
+        return nullptr;
+    }
+
+    struct sensor_trace_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SENSOR_TRACE_MAGIC;
+    header.version = SENSOR_TRACE_VERSION;
+    header.recordSize = recordSize;
+    header.typeOffset = typeOffset;
+    strncpy(header.hub, hub, sizeof(header.hub) - 1);
+    struct iovec iov = { &header, sizeof(header) };
+    int err = writeAll(fd, &iov, 1);
+    if (err) {
+        S_LOGE("Couldn't write %s (%s)", path, strerror(-err));
+        close(fd);
+        return nullptr;
+    }
+
+    S_LOGI("Recording %s records to %s", hub, path);
+    return unique_ptr<SensorTraceRecorder>(new SensorTraceRecorder(fd, sizeof(header)));
+}
+
+SensorTraceRecorder::SensorTraceRecorder(int fd, size_t size) :
+    fd(fd), size(size)
+{
+}
+
+SensorTraceRecorder::~SensorTraceRecorder() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+void SensorTraceRecorder::write(const void *buf, size_t length) {
+    struct sensor_trace_chunk chunk;
+
+    if (fd < 0) {
+        return;
+    }
+    if (size + sizeof(chunk) + length > SENSOR_TRACE_MAX_SIZE) {
+        S_LOGI("Trace reached %zu bytes, recording stopped", size);
+        close(fd);
+        fd = -1;
+        return;
+    }
+
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.timestamp = bootTimeNs();
+    chunk.length = length;
+
+    // One write() per chunk: a trace cut short by a crash ends on a whole one
+    struct iovec iov[] = {
+        { &chunk, sizeof(chunk) },
+        { const_cast<void *>(buf), length },
+    };
+    int err = writeAll(fd, iov, 2);
+    if (err) {
+        S_LOGE("Trace write failed (%s), recording stopped", strerror(-err));
+        close(fd);
+        fd = -1;
+        return;
+    }
+    size += sizeof(chunk) + length;
+}
+
+unique_ptr<SensorTraceReader> SensorTraceReader::open(const char *path) {
+    FILE *fp = fopen(path, "re");
+    if (!fp) {
+        S_LOGE("Couldn't open %s (%s)", path, strerror(errno));
+        return nullptr;
+    }
+
+    struct sensor_trace_header header;
+    if (fread(&header, sizeof(header), 1, fp) != 1
+            || header.magic != SENSOR_TRACE_MAGIC
+            || header.version != SENSOR_TRACE_VERSION
+            || !header.recordSize || header.typeOffset >= header.recordSize) {
+        S_LOGE("%s isn't a version %d sensor trace", path, SENSOR_TRACE_VERSION);
+        fclose(fp);
+        return nullptr;
+    }
+    header.hub[sizeof(header.hub) - 1] = '\0';
+
+    return unique_ptr<SensorTraceReader>(new SensorTraceReader(fp, header));
+}
+
+SensorTraceReader::SensorTraceReader(FILE *fp, const struct sensor_trace_header &header) :
+    fp(fp), header(header)
+{
+}
+
+SensorTraceReader::~SensorTraceReader() {
+    fclose(fp);
+}
+
+bool SensorTraceReader::next(struct sensor_trace_chunk &chunk, vector<uint8_t> &data) {
+    if (fread(&chunk, sizeof(chunk), 1, fp) != 1) {
+        return false;
+    }
+    data.resize(chunk.length);
+    return chunk.length == 0 || fread(data.data(), chunk.length, 1, fp) == 1;
+}
+
+void SensorTraceReader::rewind() {
+    fseek(fp, sizeof(header), SEEK_SET);
+}
+
+int sensorTraceOpenReplay() {
+    char path[PROPERTY_VALUE_MAX];
+
+    if (!getPathProperty(SENSOR_REPLAY_PROPERTY, path)) {
+        return -1;
+    }
+
+    if (mkfifo(path, 0660) < 0 && errno != EEXIST) {
+        S_LOGE("Couldn't create %s (%s)", path, strerror(errno));
+        return -1;
+    }
+
+    int fd = ::open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        S_LOGE("Couldn't open %s (%s)", path, strerror(errno));
+        return -1;
+    }
+
+    S_LOGI("Replaying records from %s", path);
+    return fd;
+}
+
+unique_ptr<SensorReplayStats> SensorReplayStats::create() {
+    char path[PROPERTY_VALUE_MAX + sizeof(SENSOR_REPLAY_STATS_SUFFIX)];
+
+    if (!getPathProperty(SENSOR_REPLAY_PROPERTY, path)) {
+        return nullptr;
+    }
+    strcat(path, SENSOR_REPLAY_STATS_SUFFIX);
+
+    int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        S_LOGE("Couldn't create %s (%s)", path, strerror(errno));
+        return nullptr;
+    }
+    if (ftruncate(fd, sizeof(struct sensor_replay_stats)) < 0) {
+        S_LOGE("Couldn't size %s (%s)", path, strerror(errno));
+        close(fd);
+        return nullptr;
+    }
+
+    void *base = mmap(NULL, sizeof(struct sensor_replay_stats), PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        S_LOGE("Couldn't map %s (%s)", path, strerror(errno));
+        return nullptr;
+    }
+
+    auto stats = static_cast<struct sensor_replay_stats *>(base);
+    stats->magic = SENSOR_REPLAY_STATS_MAGIC;
+    return unique_ptr<SensorReplayStats>(new SensorReplayStats(stats));
+}
+
+unique_ptr<SensorReplayStats> SensorReplayStats::open(const char *fifoPath) {
+    string path = string(fifoPath) + SENSOR_REPLAY_STATS_SUFFIX;
+    struct stat st;
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct sensor_replay_stats)) {
+        close(fd);
+        return nullptr;
+    }
+
+    void *base = mmap(NULL, sizeof(struct sensor_replay_stats), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return nullptr;
+    }
+
+    auto stats = static_cast<struct sensor_replay_stats *>(base);
+    if (stats->magic != SENSOR_REPLAY_STATS_MAGIC) {
+        munmap(base, sizeof(struct sensor_replay_stats));
+        return nullptr;
+    }
+    return unique_ptr<SensorReplayStats>(new SensorReplayStats(stats));
+}
+
+SensorReplayStats::SensorReplayStats(struct sensor_replay_stats *stats) :
+    stats(stats)
+{
+}
+
+SensorReplayStats::~SensorReplayStats() {
+    munmap(stats, sizeof(struct sensor_replay_stats));
+}
+
+void SensorReplayStats::beginRead() {
+    stats->seq++;
+    atomic_thread_fence(memory_order_release);
+}
+
+void SensorReplayStats::addEvents(const sensors_event_t *first, const sensors_event_t *last,
+        int64_t decodeNs) {
+    if (first == last) {
+        return;
+    }
+
+    // The decoders are timed per record, which the events share
+    uint64_t perEvent = max<int64_t>(decodeNs, 0) / (last - first);
+    size_t bucket = sensorReplayBucket(perEvent);
+
+    for (const sensors_event_t *e = first; e < last; e++) {
+        size_t handle = min<size_t>(e->sensor, SENSOR_REPLAY_MAX_HANDLE);
+        stats->sensorEvents[handle]++;
+        stats->sensorType[handle] = e->type;
+        stats->latency[bucket]++;
+    }
+    stats->events += last - first;
+}
+
+void SensorReplayStats::endRead(size_t records) {
+    stats->records += records;
+    atomic_thread_fence(memory_order_release);
+    stats->seq++;
+}
+
+bool SensorReplayStats::snapshot(struct sensor_replay_stats &out) const {
+    const volatile struct sensor_replay_stats *shared = stats;
+
+    // An update takes a few us, unless the HAL died in the middle of one
+    for (int tries = 0; tries < 10000; tries++) {
+        uint32_t seq = shared->seq;
+        atomic_thread_fence(memory_order_acquire);
+        memcpy(&out, const_cast<const struct sensor_replay_stats *>(stats), sizeof(out));
+        atomic_thread_fence(memory_order_acquire);
+        if (!(seq & 1) && seq == shared->seq) {
+            return true;
+        }
+        sched_yield();
+    }
+    return false;
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2017 Motorola Mobility
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SENSOR_TRACE_H
+#define SENSOR_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include <memory>
+#include <vector>
+
+#include <hardware/sensors.h>
+
+/**
+ * Sensor hub traces: the raw records the motosh and stml0xx HALs read from
+ * their data node, with the time of each read(), so that a session can be
+ * replayed without the hub.
+ *
+ * A trace is a sensor_trace_header followed by one sensor_trace_chunk, and
+ * its bytes, per read(). All fields are little endian, as written by the AP.
+ *
+ * Both properties below are ignored unless ro.debuggable is set.
+ */
+
+/// Setting this property to a file path records every HAL read() to it.
+#define SENSOR_TRACE_PROPERTY  "vendor.sensors.trace"
+/** Setting this property to a FIFO path makes the HAL read its records from
+ * the FIFO (fed by `sensortrace replay`) rather than from the hub. */
+#define SENSOR_REPLAY_PROPERTY "vendor.sensors.replay"
+
+/// Recording stops once a trace reaches this size
+#define SENSOR_TRACE_MAX_SIZE  (64 * 1024 * 1024)
+
+#define SENSOR_TRACE_MAGIC   0x43525453 /* "STRC" */
+#define SENSOR_TRACE_VERSION 1
+
+struct sensor_trace_header {
+    uint32_t magic;
+    uint32_t version;
+    /// sizeof(struct motosh_android_sensor_data) or its stml0xx equivalent
+    uint32_t recordSize;
+    /// Offset of the one byte record type within a record
+    uint32_t typeOffset;
+    /// "motosh" or "stml0xx", NUL padded
+    char hub[16];
+};
+
+struct sensor_trace_chunk {
+    /// CLOCK_BOOTTIME time the read() returned, in ns
+    int64_t timestamp;
+    /// Number of bytes following, a multiple of recordSize
+    uint32_t length;
+    uint32_t reserved;
+};
+
+/**
+ * Writes the records read by a HAL to the trace file named by
+ * SENSOR_TRACE_PROPERTY. Each read() is written as it is recorded, so the
+ * trace is complete up to the last one whenever it is pulled, and recording
+ * stops at SENSOR_TRACE_MAX_SIZE.
+ */
+class SensorTraceRecorder {
+public:
+    /** @return the recorder, or nullptr if recording isn't enabled or the
+     * trace can't be created. */
+    static std::unique_ptr<SensorTraceRecorder> create(const char *hub,
+            size_t recordSize, size_t typeOffset);
+
+    ~SensorTraceRecorder();
+
+    SensorTraceRecorder(const SensorTraceRecorder&) = delete;
+    SensorTraceRecorder& operator=(const SensorTraceRecorder&) = delete;
+
+    /// Appends the bytes returned by one read().
+    void write(const void *buf, size_t length);
+
+private:
+    SensorTraceRecorder(int fd, size_t size);
+
+    int fd;
+    /// Bytes written so far, header included
+    size_t size;
+};
+
+/**
+ * Sequential access to a trace, for the replay tool.
+ */
+class SensorTraceReader {
+public:
+    /** @return the reader, or nullptr if path isn't a trace of a known
+     * version. */
+    static std::unique_ptr<SensorTraceReader> open(const char *path);
+
+    ~SensorTraceReader();
+
+    SensorTraceReader(const SensorTraceReader&) = delete;
+    SensorTraceReader& operator=(const SensorTraceReader&) = delete;
+
+    const struct sensor_trace_header &getHeader() const {
+        return header;
+    }
+
+    /** Reads the next chunk into chunk and data.
+     * @return false at the end of the trace or if it is truncated. */
+    bool next(struct sensor_trace_chunk &chunk, std::vector<uint8_t> &data);
+
+    /// Goes back to the first chunk.
+    void rewind();
+
+private:
+    SensorTraceReader(FILE *fp, const struct sensor_trace_header &header);
+
+    FILE *fp;
+    struct sensor_trace_header header;
+};
+
+/** Opens the FIFO named by SENSOR_REPLAY_PROPERTY, creating it if needed,
+ * for a HAL to read its records from.
+ *
+ * The FIFO is opened read-write so that the open doesn't wait for the
+ * replay tool, and reads never see end of file between two replays; and
+ * non-blocking, so that an empty FIFO reads as EAGAIN rather than stalling
+ * poll().
+ *
+ * @return the fd, or -1 if replay isn't enabled or the FIFO can't be opened. */
+int sensorTraceOpenReplay();
+
+/** Suffix of the file, next to the replay FIFO, the HAL reports its side of
+ * a replay in. */
+#define SENSOR_REPLAY_STATS_SUFFIX ".stats"
+
+#define SENSOR_REPLAY_STATS_MAGIC 0x53505253 /* "SRPS" */
+/// Buckets of the decode latency histogram, see sensorReplayBucket()
+#define SENSOR_REPLAY_BUCKETS     256
+/// Events of handles from this one on are counted together
+#define SENSOR_REPLAY_MAX_HANDLE  128
+
+/**
+ * What the HAL decoded from a replay FIFO, since it opened it. The counters
+ * only grow, so a replay is the difference of two snapshots.
+ */
+struct sensor_replay_stats {
+    uint32_t magic;
+    /// Odd while the HAL updates the counters below
+    uint32_t seq;
+    /// Records read from the FIFO
+    uint64_t records;
+    /// Events decoded from them
+    uint64_t events;
+    /// Events by decode latency, in sensorReplayBucket() buckets
+    uint64_t latency[SENSOR_REPLAY_BUCKETS];
+    /// Events by sensor handle
+    uint64_t sensorEvents[SENSOR_REPLAY_MAX_HANDLE + 1];
+    /// Type of the last event of each handle
+    int32_t sensorType[SENSOR_REPLAY_MAX_HANDLE + 1];
+};
+
+/** @return the histogram bucket of a latency. Buckets are a quarter of a
+ * power of two wide, so within 25% of the latencies they hold. */
+static inline size_t sensorReplayBucket(uint64_t ns) {
+    if (ns < 4) {
+        return ns;
+    }
+    int msb = 63 - __builtin_clzll(ns);
+    return (msb - 1) * 4 + ((ns >> (msb - 2)) & 3);
+}
+
+/// @return the lowest latency of a sensorReplayBucket() bucket.
+static inline uint64_t sensorReplayBucketFloor(size_t bucket) {
+    if (bucket < 4) {
+        return bucket;
+    }
+    return (uint64_t)(4 + bucket % 4) << (bucket / 4 - 1);
+}
+
+/**
+ * The shared mapping of the replay stats file. The HAL updates it as it
+ * decodes replayed records, with plain stores so that it costs no system
+ * call, and `sensortrace replay` reads it to report the HAL's side.
+ */
+class SensorReplayStats {
+public:
+    /** Creates the stats file for the FIFO named by SENSOR_REPLAY_PROPERTY,
+     * for the HAL.
+     * @return the stats, or nullptr if replay isn't enabled or the file
+     * can't be created. */
+    static std::unique_ptr<SensorReplayStats> create();
+
+    /** Maps the stats of a replay FIFO read-only, for the replay tool.
+     * @return the stats, or nullptr if the HAL hasn't created them. */
+    static std::unique_ptr<SensorReplayStats> open(const char *fifoPath);
+
+    ~SensorReplayStats();
+
+    SensorReplayStats(const SensorReplayStats&) = delete;
+    SensorReplayStats& operator=(const SensorReplayStats&) = delete;
+
+    /// Starts updating the counters for one read().
+    void beginRead();
+
+    /** Counts the events decoded from one record, which took decodeNs. */
+    void addEvents(const sensors_event_t *first, const sensors_event_t *last,
+            int64_t decodeNs);
+
+    /// Ends the update started by beginRead(), which read records records.
+    void endRead(size_t records);
+
+    /** Copies a consistent snapshot of the counters.
+     * @return false if the HAL never finished its update. */
+    bool snapshot(struct sensor_replay_stats &out) const;
+
+private:
+    explicit SensorReplayStats(struct sensor_replay_stats *stats);
+
+    struct sensor_replay_stats *stats;
+};
+
+#endif // SENSOR_TRACE_H
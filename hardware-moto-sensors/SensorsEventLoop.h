@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2017 Motorola Mobility
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SENSORS_EVENT_LOOP_H
+#define SENSORS_EVENT_LOOP_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/epoll.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <hardware/sensors.h>
+#include <log/log.h>
+
+#include "SensorsLog.h"
+
+/**
+ * The poll() loop shared by the SensorsPollContext of the motosh, stml0xx,
+ * tof and vl53l0 HALs.
+ *
+ * Every driver fd is registered with a single epoll instance whose
+ * epoll_event.data.ptr points straight at the driver's slot, so a wakeup is
+ * dispatched without any fd lookup. When several drivers are ready, each
+ * gets an equal share of the caller's buffer and the first driver served
+ * rotates from one call to the next, so a busy driver can't starve the
+ * others.
+ *
+ * DriverT is the HAL's SensorBase. If it provides
+ * readEvents(data, count, fd) that overload is used, otherwise
+ * readEvents(data, count).
+ */
+template <class DriverT>
+class SensorsEventLoop {
+public:
+    /// Per-driver counters, for dumpStats().
+    struct DriverStats {
+        /// Number of times epoll reported the driver's fd as readable.
+        uint64_t wakeups;
+        /// Number of events the driver returned.
+        uint64_t events;
+        /// Number of failed readEvents() calls.
+        uint64_t errors;
+    };
+
+    /** Aborts if the epoll instance can't be created: without it poll()
+     * could never block, and the HAL would spin. */
+    SensorsEventLoop() :
+        epollFd(epoll_create1(EPOLL_CLOEXEC)), slots(), ready(1), next(0)
+    {
+        LOG_ALWAYS_FATAL_IF(epollFd < 0, "epoll_create1 failed: %s", strerror(errno));
+    }
+
+    ~SensorsEventLoop() {
+        close(epollFd);
+    }
+
+    SensorsEventLoop(const SensorsEventLoop&) = delete;
+    SensorsEventLoop& operator=(const SensorsEventLoop&) = delete;
+
+    /** Registers a driver. If fd is negative the driver is only serviced
+     * through hasPendingEvents(). A driver listening on several fds may be
+     * added once per fd.
+     *
+     * @return 0 on success, negative errno code otherwise. */
+    int addDriver(DriverT *driver, int fd) {
+        if (!driver) {
+            return -EINVAL;
+        }
+
+        slots.emplace_back(new Slot{driver, fd, {0, 0, 0}});
+        Slot *slot = slots.back().get();
+        if (fd < 0) {
+            return 0;
+        }
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = slot;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            int err = errno;
+            S_LOGE("epoll_ctl(ADD, %d) failed: %s", fd, strerror(err));
+            slots.pop_back();
+            return -err;
+        }
+
+        ready.resize(std::max<size_t>(1, std::min(slots.size(), MAX_READY)));
+        return 0;
+    }
+
+    /** Reads up to count events into data. Drivers with pending events are
+     * drained first; if there are none this blocks until a driver fd is
+     * readable. With no fd registered it blocks forever rather than return
+     * 0 events, which the framework would call again right away.
+     *
+     * @return the number of events read, or a negative errno code. */
+    int poll(sensors_event_t *data, int count) {
+        int nbEvents = 0;
+        size_t n = slots.size();
+
+        if (!data || count <= 0) {
+            return -EINVAL;
+        }
+        size_t first = n ? next++ % n : 0;
+
+        // Leftovers from a previous call don't need to wait on epoll
+        for (size_t i = 0; i < n && count > 0; ++i) {
+            Slot *s = slots[(first + i) % n].get();
+            if (s->driver->hasPendingEvents()) {
+                int nb = serve(s, -1, data, count);
+                data += nb;
+                count -= nb;
+                nbEvents += nb;
+            }
+        }
+
+        if (count <= 0) {
+            // Anything still readable is reported again by the next call
+            return nbEvents;
+        }
+
+        int nready;
+        do {
+            nready = epoll_wait(epollFd, ready.data(), ready.size(),
+                    nbEvents ? 0 : -1);
+        } while (nready < 0 && errno == EINTR);
+
+        if (nready < 0) {
+            int err = errno;
+            S_LOGE("epoll_wait failed: %s", strerror(err));
+            return nbEvents ? nbEvents : -err;
+        }
+        if (nready == 0) {
+            return nbEvents;
+        }
+
+        int quota = std::max(1, count / nready);
+        first = next % nready;
+        for (int i = 0; i < nready && count > 0; ++i) {
+            const struct epoll_event &ev = ready[(first + i) % nready];
+            Slot *s = static_cast<Slot *>(ev.data.ptr);
+            s->stats.wakeups++;
+            if (ev.events & EPOLLIN) {
+                int nb = serve(s, s->fd, data, std::min(count, quota));
+                data += nb;
+                count -= nb;
+                nbEvents += nb;
+            }
+        }
+
+        return nbEvents;
+    }
+
+    /** Logs the counters of every registered driver. */
+    void dumpStats() const {
+        for (const auto &s : slots) {
+            S_LOGD("driver=%p fd=%d wakeups=%" PRIu64 " events=%" PRIu64
+                    " errors=%" PRIu64, s->driver, s->fd, s->stats.wakeups,
+                    s->stats.events, s->stats.errors);
+        }
+    }
+
+private:
+    /// Upper bound on the number of fds retrieved by one epoll_wait().
+    static const size_t MAX_READY = 16;
+
+    struct Slot {
+        DriverT *driver;
+        int fd;
+        DriverStats stats;
+    };
+
+    int epollFd;
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::vector<struct epoll_event> ready;
+    size_t next;
+
+    template <class D>
+    static auto readDriver(D *d, sensors_event_t *data, int count, int fd, int)
+            -> decltype(d->readEvents(data, count, fd)) {
+        return d->readEvents(data, count, fd);
+    }
+
+    template <class D>
+    static int readDriver(D *d, sensors_event_t *data, int count, int fd, long) {
+        (void)fd;
+        return d->readEvents(data, count);
+    }
+
+    /** Reads up to count events from one driver.
+     * @return the number of events read. A failed read returns 0 so that the
+     * events read from the other drivers are still delivered. */
+    static int serve(Slot *s, int fd, sensors_event_t *data, int count) {
+        int nb = readDriver(s->driver, data, count, fd, 0);
+        if (nb < 0) {
+            s->stats.errors++;
+            S_LOGE("reading events failed fd=%d nb=%d", fd, nb);
+            return 0;
+        }
+        s->stats.events += nb;
+        return nb;
+    }
+};
+
+template <class DriverT>
+const size_t SensorsEventLoop<DriverT>::MAX_READY;
+
+#endif /* SENSORS_EVENT_LOOP_H */
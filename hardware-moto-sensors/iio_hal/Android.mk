@@ -33,7 +33,8 @@ LOCAL_SRC_FILES := \
     DynamicMetaSensor.cpp \
     IioSensor.cpp \
     UeventListener.cpp \
-    ../motosh_hal/SensorBase.cpp
+    ../motosh_hal/SensorBase.cpp \
+    ../DirectChannel.cpp
 
 LOCAL_C_INCLUDES += \
     $(LOCAL_PATH)/.. \
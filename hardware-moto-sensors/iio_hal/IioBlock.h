@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2016 Motorola Mobility
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IIO_BLOCK
+#define IIO_BLOCK
+
+#include <stdint.h>
+#include <sys/ioctl.h>
+
+/** The IIO block (mmap) buffer interface. It is not part of the uapi
+ * headers: drivers that implement it are out of tree, and libiio's local
+ * backend uses it when the buffer's character device answers
+ * IIO_BLOCK_ALLOC_IOCTL.
+ *
+ * Userspace allocates count blocks of size bytes, mmap()s each one at its
+ * offset in the character device, and enqueues them. The kernel fills the
+ * enqueued blocks, and userspace dequeues them once filled, reads them in
+ * place, and enqueues them again. */
+struct iio_block_alloc_req {
+    uint32_t type, size, count, id;
+};
+
+struct iio_block {
+    uint32_t id, size, bytes_used, type, flags, offset;
+    uint64_t timestamp;
+};
+
+#define IIO_BLOCK_ALLOC_IOCTL   _IOWR('i', 0xa0, struct iio_block_alloc_req)
+#define IIO_BLOCK_FREE_IOCTL    _IO('i', 0xa1)
+#define IIO_BLOCK_QUERY_IOCTL   _IOWR('i', 0xa2, struct iio_block)
+#define IIO_BLOCK_ENQUEUE_IOCTL _IOWR('i', 0xa3, struct iio_block)
+#define IIO_BLOCK_DEQUEUE_IOCTL _IOWR('i', 0xa4, struct iio_block)
+
+#endif // IIO_BLOCK
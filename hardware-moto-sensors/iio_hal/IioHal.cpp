@@ -34,6 +34,7 @@
 #include <android-base/macros.h>
 #include <utils/Mutex.h>
 
+#include <sys/epoll.h>
 #include <sys/select.h>
 #include <sys/timerfd.h>
 
@@ -50,11 +51,12 @@
 using namespace std;
 using namespace android;
 
-IioHal::IioHal() : pipeFd{0, 0}, timerFd(-1) {
+IioHal::IioHal() : driversLock(), driverSet(make_shared<DriverSet>()),
+    pipeFd{0, 0}, timerFd(-1), epollFd(-1) {
     //S_LOGD("this=%08" PRIxPTR, this);
     S_LOGD("+");
 
-    if (pipe(pipeFd)) {
+    if (pipe2(pipeFd, O_NONBLOCK | O_CLOEXEC)) {
         S_LOGE("Unable to create pipe: %s", strerror(errno));
         pipeFd[0] = pipeFd[1] = 0;
     }
@@ -63,12 +65,26 @@ IioHal::IioHal() : pipeFd{0, 0}, timerFd(-1) {
     if (timerFd == -1) {
         S_LOGE("Unable to create timer fd: %s", strerror(errno));
     }
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1) {
+        S_LOGE("Unable to create epoll fd: %s", strerror(errno));
+    }
+
+    for (int fd : { pipeFd[0], timerFd }) {
+        if (fd <= 0) continue;
+        struct epoll_event ev = { .events = EPOLLIN, .data = { .fd = fd } };
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev))
+            S_LOGE("Unable to add fd %d: %s", fd, strerror(errno));
+    }
 }
 
 void IioHal::init() {
     S_LOGD("+");
     std::shared_ptr<SensorBase> dynamic = std::make_shared<DynamicMetaSensor>(0, *this);
 
+    AutoLock _d(driversLock);
+
     // Using emplace() because getSensorsList() assumes the Meta Sensor is
     // the first driver in the list. At this point the Meta Sensor may have
     // already added some IIO sensor drivers to the list in its constructor.
@@ -78,7 +94,7 @@ void IioHal::init() {
     // short delay.
     delay();
 
-    updateFdLists();
+    publishDriverSet();
     S_LOGD("-");
 }
 
@@ -92,24 +108,31 @@ void IioHal::delay() {
         S_LOGE("error setting time on timer Fd: %d", errno);
 }
 
-int IioHal::activate(int handle, int enabled) {
+shared_ptr<SensorBase> IioHal::handleToDriver(int handle) {
+    for (const auto& d : getDriverSet()->drivers) {
+        if (d->hasSensor(handle)) return d;
+    }
+
+    S_LOGE("No driver for handle %d", handle);
+    return nullptr;
+}
+
+int IioHal::enableDriver(shared_ptr<SensorBase> s, int handle, int enabled) {
     int ret = -EBADFD;
 
     S_LOGD("handle=%d enabled=%d pid=%d tid=%d", handle, enabled, getpid(), gettid());
 
-    shared_ptr<SensorBase> s = handleToDriver(handle);
-    if (s == nullptr) {
-        S_LOGE("No driver found for handle %d (en=%d)", handle, enabled);
+    AutoLock _d(driversLock);
+
+    // activate() found s in a snapshot, removeSensor() may have dropped it
+    // since. Enabling it would register fds nothing ever unregisters.
+    if (find(begin(drivers), end(drivers), s) == drivers.end()) {
+        S_LOGE("handle=%d was removed", handle);
         return -EINVAL;
     }
 
-    // Try to stop the poll() so we can modify underlying structures
-    AutoLock _p(pollLock);
-    releasePoll(ReleaseReason::Activate);
-    AutoLock _d(driversLock);
-
     ret = s->setEnable(handle, enabled);
-    updateFdLists();
+    publishDriverSet();
 
     return ret;
 }
@@ -117,8 +140,6 @@ int IioHal::activate(int handle, int enabled) {
 shared_ptr<SensorBase> IioHal::removeSensor(const char *name) {
     if (!name) return nullptr;
 
-    AutoLock _p(pollLock);
-    releasePoll(ReleaseReason::SensorRemove);
     AutoLock _d(driversLock);
 
     auto it = find_if(begin(drivers), end(drivers),
@@ -136,18 +157,16 @@ shared_ptr<SensorBase> IioHal::removeSensor(const char *name) {
 
     drivers.erase(it);
 
-    bool wasEnabled = (s->getFd() >= 0);
-    // updateFdLists() will only remove it if it's disabled (fd < 0)
+    // Unregister its fds before setEnable() closes them
+    publishDriverSet();
     s->setEnable(-1, 0);
-    if (wasEnabled) {
-        updateFdLists();
-    }
 
     return s;
 }
 
 int IioHal::poll(sensors_event_t* data, int count) {
     int pollRes, eventsRead = 0;
+    struct epoll_event ready[16];
     //S_LOGD("+");
 
     if (!data || count < 1) {
@@ -164,71 +183,67 @@ int IioHal::poll(sensors_event_t* data, int count) {
         return evtCount;
     };
 
-    // See if we have any pending events before blocking on poll()
-    driversLock.lock();
-    for (const auto& d : drivers) {
+    // See if we have any pending events before blocking on epoll_wait()
+    for (const auto& d : getDriverSet()->drivers) {
         if (d->hasPendingEvents()) {
             updateCounts(d->readEvents(data, count, -1));
         }
     }
-    driversLock.unlock();
 
     if (eventsRead) return eventsRead;
 
-    pollLock.lock();
-    AutoLock _d(driversLock);
-    pollLock.unlock();
-
-    pollRes = TEMP_FAILURE_RETRY(::poll(&pollFds.front(), pollFds.size(), -1));
+    pollRes = TEMP_FAILURE_RETRY(epoll_wait(epollFd, ready, sizeof(ready) / sizeof(ready[0]), -1));
 
     if (pollRes >= 0) {
         // Success
-        for (const auto& p : pollFds) {
-            if (p.revents & POLLIN && p.fd >= 0) {
-                if (p.fd == pipeFd[0]) { // Someone needs the driversLock
-                    uint8_t reason = 255;
-                    read(pipeFd[0], &reason, sizeof(reason));
-                    //S_LOGD("Released poll because %d", reason);
-                } else if (p.fd == timerFd) { // Delay timer expired
-                    uint64_t expirations = 0;
-                    ssize_t size;
-                    size = read(timerFd, &expirations, sizeof(expirations));
-
-                    //S_LOGD("timer read size %d with %ld expirations", size, expirations);
-                    std::shared_ptr<DynamicMetaSensor> dyn =
-                        static_pointer_cast<DynamicMetaSensor>(drivers[0]);
-                    if (dyn && dyn->hasSensor(0) &&
-                        size == sizeof(uint64_t) && expirations > 0)
-                        updateCounts(dyn->checkPermsAndAddToPending(data, count));
-                } else {
-                    int res = updateCounts(fd2driver[p.fd]->readEvents(data, count, p.fd));
-                    // Need to relay any errors upward.
-                    if (res < 0) {
-                        S_LOGE("reading events failed fd=%d nb=%d", p.fd, res);
-                        return 0;
-                    }
+        for (int i = 0; i < pollRes; i++) {
+            const struct epoll_event& p = ready[i];
+            if (!(p.events & EPOLLIN))
+                continue;
+
+            if (p.data.fd == pipeFd[0]) { // Someone needs poll() to return
+                uint8_t reason[16];
+                while (read(pipeFd[0], reason, sizeof(reason)) > 0);
+                //S_LOGD("Released poll because %d", reason[0]);
+            } else if (p.data.fd == timerFd) { // Delay timer expired
+                uint64_t expirations = 0;
+                ssize_t size;
+                size = read(timerFd, &expirations, sizeof(expirations));
+
+                //S_LOGD("timer read size %d with %ld expirations", size, expirations);
+                std::shared_ptr<DynamicMetaSensor> dyn =
+                    static_pointer_cast<DynamicMetaSensor>(getDriverSet()->drivers[0]);
+                if (dyn && dyn->hasSensor(0) &&
+                    size == sizeof(uint64_t) && expirations > 0)
+                    updateCounts(dyn->checkPermsAndAddToPending(data, count));
+            } else {
+                // Looked up in the latest snapshot: an earlier event of this
+                // batch may have removed the sensor the fd belonged to.
+                std::shared_ptr<const DriverSet> set = getDriverSet();
+                auto d = set->fd2driver.find(p.data.fd);
+                if (d == set->fd2driver.end())
+                    continue;
+
+                int res = updateCounts(d->second->readEvents(data, count, p.data.fd));
+                // Need to relay any errors upward.
+                if (res < 0) {
+                    S_LOGE("reading events failed fd=%d nb=%d", p.data.fd, res);
+                    return 0;
                 }
             }
         }
     } else {
-        S_LOGE("poll() failed with %d (%s)", errno, strerror(errno));
+        S_LOGE("epoll_wait() failed with %d (%s)", errno, strerror(errno));
     }
 
     return eventsRead;
 }
 
-/** Since there are different strategies for acquiring the driversLock, caller
- * must acquire the lock before calling this function. */
-void IioHal::updateFdLists() {
-    fd2driver.clear();
-    pollFds.clear();
+void IioHal::publishDriverSet() {
+    std::shared_ptr<const DriverSet> prev = getDriverSet();
+    std::shared_ptr<DriverSet> next = make_shared<DriverSet>();
 
-    if (pipeFd[0] > 0) {
-        pollFds.push_back({.fd = pipeFd[0], .events = POLLIN, .revents = 0});
-    }
-
-    if (timerFd > 0)
-        pollFds.push_back({.fd = timerFd, .events = POLLIN, .revents = 0});
+    next->drivers = drivers;
 
     for (const auto& driver : drivers) {
         if (!driver) {
@@ -236,38 +251,52 @@ void IioHal::updateFdLists() {
             continue;
         }
         int fd = driver->getFd();
-        //S_LOGD("Adding fd=%d for driver=0x%08x @ %d", fd, driver.get(), pollFds.size());
         if (fd >= 0) {
-            fd2driver[fd] = driver;
-            pollFds.push_back({
-                    .fd = fd,
-                    .events = POLLIN,
-                    .revents = 0
-            });
+            next->fd2driver[fd] = driver;
         }
-    }
 
-    for (const auto& driver : drivers) {
         if (isIioSensor(driver)) {
             IioSensor *sensor = static_cast<IioSensor *>(driver.get());
-            int fd = sensor->getEventFd();
-            if (fd >= 0 && sensor->getFd() >= 0) {
-                S_LOGD("Add eventFd %d", fd);
-                fd2driver[fd] = driver;
-                pollFds.push_back({
-                        .fd = fd,
-                        .events = POLLIN,
-                        .revents = 0
-                });
+            int eventFd = sensor->getEventFd();
+            if (eventFd >= 0 && fd >= 0) {
+                next->fd2driver[eventFd] = driver;
             }
         }
     }
+
+    // Only the fds that changed are (un)registered. A closed fd is already
+    // gone from the epoll set, hence ENOENT/EBADF are expected on removal.
+    for (const auto& p : prev->fd2driver) {
+        auto n = next->fd2driver.find(p.first);
+        if (n != next->fd2driver.end() && n->second == p.second)
+            continue;
+        if (epoll_ctl(epollFd, EPOLL_CTL_DEL, p.first, NULL) && errno != ENOENT && errno != EBADF)
+            S_LOGE("Unable to remove fd %d: %s", p.first, strerror(errno));
+    }
+    for (const auto& n : next->fd2driver) {
+        auto p = prev->fd2driver.find(n.first);
+        if (p != prev->fd2driver.end() && p->second == n.second)
+            continue;
+        // The same fd number may have been closed and reopened by a driver
+        // since the previous snapshot.
+        struct epoll_event ev = { .events = EPOLLIN, .data = { .fd = n.first } };
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, n.first, &ev)
+                && (errno != EEXIST || epoll_ctl(epollFd, EPOLL_CTL_MOD, n.first, &ev))) {
+            S_LOGE("Unable to add fd %d: %s", n.first, strerror(errno));
+        } else {
+            S_LOGD("Add fd %d", n.first);
+        }
+    }
+
+    std::atomic_store(&driverSet, std::shared_ptr<const DriverSet>(next));
 }
 
 list< shared_ptr<IioSensor> > IioHal::updateSensorList(const IioHal::IioSensorCont & currSensors) {
     list< shared_ptr<IioSensor> > newSensors;
     S_LOGD("+");
 
+    AutoLock _d(driversLock);
+
     for (const auto& sensor : currSensors) {
         const char *id = sensor->getIioId();
         auto it = find_if(begin(drivers), end(drivers),
@@ -282,6 +311,11 @@ list< shared_ptr<IioSensor> > IioHal::updateSensorList(const IioHal::IioSensorCo
         }
     }
 
+    // New sensors start disabled, without fds, but activate() must find them
+    if (!newSensors.empty()) {
+        publishDriverSet();
+    }
+
     return newSensors;
 }
 
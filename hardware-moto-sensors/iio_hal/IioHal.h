@@ -30,6 +30,7 @@
 #include <vector>
 #include <list>
 #include <map>
+#include <memory>
 #include <type_traits>
 #include <cstdint>
 #include <cinttypes>
@@ -40,6 +41,7 @@
 #include <android-base/macros.h>
 #include <utils/Mutex.h>
 
+#include <sys/epoll.h>
 #include <sys/select.h>
 
 #include <hardware/sensors.h>
@@ -70,7 +72,6 @@ public:
     virtual ~IioHal() = default;
 
     virtual int poll(sensors_event_t* data, int count) override;
-    virtual int activate(int handle, int enabled) override;
 
     /** IIO dynamic sensor addition/removal is reported from the poll() call.
      * There is only 1 non-dynamic sensor reported by this HAL: the Dynamic
@@ -80,7 +81,7 @@ public:
         static std::vector<struct sensor_t> sensorsList;
 
         sensorsList.clear();
-        drivers[0]->getSensorsList(sensorsList);
+        getDriverSet()->drivers[0]->getSensorsList(sensorsList);
         *list = &sensorsList[0];
         // The Dynamic Meta Sensor has a handle of 0.
         assert(sensorsList[0].handle == 0);
@@ -116,66 +117,59 @@ public:
         Undefined, Activate, SensorAdd, SensorRemove, FlushResponseDue
     };
 
-    /** Makes the ::poll() inside IioHal::poll() release so that the locks held
-     * by that function are released. */
+    /** Wakes up the epoll_wait() inside IioHal::poll(), for events that
+     * aren't signalled through a driver fd (ex: the Dynamic Meta Sensor's
+     * flush complete). Changes to the driver set don't need this. */
     void releasePoll(ReleaseReason reason = ReleaseReason::Undefined) {
         write(pipeFd[1], &reason, 1);
-        fsync(pipeFd[1]);
     }
 
+    virtual std::shared_ptr<SensorBase> handleToDriver(int handle) override;
+
     // start a timer using the timerFd
     void delay(void);
 
+protected:
+    /** Enables the driver and publishes its new fds, without waiting for
+     * poll(). */
+    virtual int enableDriver(std::shared_ptr<SensorBase> s, int handle, int enabled) override;
+
 private:
     DISALLOW_COPY_AND_ASSIGN(IioHal);
 
-    typedef std::lock_guard<std::recursive_mutex> AutoLock;
+    typedef std::lock_guard<std::mutex> AutoLock;
 
     /**
-     * @{
-     *
-     * There are 2 threads that need to be synchronized. 1. The thread that
-     * calls pollEvents()/poll(). 2. The thread that calls activate(). The
-     * activate() thread needs to modify the pollFds container and add/remove
-     * file descriptors for sensors that have been enabled/disabled and the
-     * pollEvents() thread is using that data for the poll() call.
+     * An immutable snapshot of the drivers and of the fds poll() listens on.
      *
-     * We need to ensure that the pollFds vector doesn't change while poll() is
-     * blocked. We also need to make sure that once poll() releases it doesn't
-     * reacquire the driversLock before the activate() thread has had a chance
-     * to modify pollFds.
-     *
-     * This is a simplified diagram of the order of events:
-     * @verbatim
-
-     pollLock.lock()
-     driversLock.lock()
-     pollLock.unlock()
-     poll()
-                                pollLock.lock()
-                                releasePoll()
-                                driversLock.lock()
-    poll() exit
-    driversLock.unlock()
-    pollLock.lock()             driversLock acquired
-                                modify pollFds
-                                driversLock.unlock()
-                                pollLock.unlock()
-    pollLock acquired
-    driversLock.lock()
-    pollLock.unlock()
-    poll()
-
-    @endverbatim */
-
-    /** Used to lock the list of drivers and associated file descriptors (the
-     * drivers, pollFds, and fd2driver containers). */
-    std::recursive_mutex driversLock;
-
-    /** Used to prevent the attempt by IioHal::poll() to lock driversLock and
-     * call poll(). Typically used to update the pollFds vector. */
-    std::recursive_mutex pollLock;
-    /** @} */
+     * The poll() thread, and the framework threads calling activate() or
+     * batch(), only ever read the current snapshot (getDriverSet()), without
+     * taking any lock. Changes (activate(), dynamic sensor addition/removal)
+     * build a new snapshot under driversLock, update the epoll registrations
+     * that differ from the previous one, and publish it atomically. A reader
+     * holding the previous snapshot keeps its drivers alive until it is done.
+     */
+    struct DriverSet {
+        DriverSet() : drivers(), fd2driver() { }
+
+        /// drivers[0] is the Dynamic Meta Sensor
+        std::vector<std::shared_ptr<SensorBase>> drivers;
+        /// The driver fds registered with epollFd
+        std::map<int, std::shared_ptr<SensorBase>> fd2driver;
+    };
+
+    std::shared_ptr<const DriverSet> getDriverSet() const {
+        return std::atomic_load(&driverSet);
+    }
+
+    /** Serializes the writers of BaseHal::drivers and driverSet. The poll()
+     * thread only takes it while the Dynamic Meta Sensor adds or removes a
+     * sensor, never across epoll_wait(), so activate() doesn't wait for
+     * poll() to return. */
+    std::mutex driversLock;
+
+    /// The current snapshot, only accessed through std::atomic_load/store.
+    std::shared_ptr<const DriverSet> driverSet;
 
     // Pipe to communicate with the poll() thread.
     int pipeFd[2];
@@ -184,15 +178,13 @@ private:
     // labels to switch before sensor is accessed.
     int timerFd;
 
-    // File descriptors we're listening on
-    std::vector<struct pollfd> pollFds;
-
-    // Used to map file descriptors to corresponding drivers
-    std::map<int, std::shared_ptr<SensorBase>> fd2driver;
+    // Every fd poll() listens on: pipeFd[0], timerFd and those of driverSet
+    int epollFd;
 
-    /** Updates all the containers that change when sensors are added/removed
-     * or enabled/disabled. */
-    void updateFdLists();
+    /** Builds a snapshot of BaseHal::drivers, updates the epoll
+     * registrations accordingly and publishes it. Callers must hold
+     * driversLock. */
+    void publishDriverSet();
 
     // This is a brittle hack. Need some kind of pseudo RTTI.
     bool isIioSensor(std::shared_ptr<SensorBase> sensor) {
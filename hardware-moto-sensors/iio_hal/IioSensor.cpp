@@ -19,13 +19,19 @@
 #include <chrono>
 #include <cstdint>
 #include <cinttypes>
+#include <type_traits>
+#include <endian.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/ioctl.h>
+#include <cutils/properties.h>
 #include "SensorsLog.h"
+#include "DirectChannel.h"
 #include <linux/iio/events.h>
 #include <linux/iio/types.h>
 
+#include "IioBlock.h"
 #include "IioSensor.h"
 #include "iio.h"
 
@@ -33,9 +39,49 @@ using namespace std;
 
 chrono::milliseconds IioSensor::timeout(chrono::seconds(10));
 
+namespace {
+
+inline uint8_t swapBytes(uint8_t v) { return v; }
+inline uint16_t swapBytes(uint16_t v) { return __builtin_bswap16(v); }
+inline uint32_t swapBytes(uint32_t v) { return __builtin_bswap32(v); }
+inline uint64_t swapBytes(uint64_t v) { return __builtin_bswap64(v); }
+
+/** Reads an unsigned storage word of type U, in host byte order. */
+template<typename U, bool Swap>
+int64_t loadWord(const uint8_t *src) {
+    U u;
+    memcpy(&u, src, sizeof(u));
+    if (Swap) {
+        u = swapBytes(u);
+    }
+    return static_cast<int64_t>(u);
+}
+
+/** @return the loader for a storage word of the given size, or nullptr. */
+int64_t (*selectLoader(unsigned bytes, bool swap))(const uint8_t *) {
+    switch (bytes) {
+        case 1: return swap ? loadWord<uint8_t, true>  : loadWord<uint8_t, false>;
+        case 2: return swap ? loadWord<uint16_t, true> : loadWord<uint16_t, false>;
+        case 4: return swap ? loadWord<uint32_t, true> : loadWord<uint32_t, false>;
+        case 8: return swap ? loadWord<uint64_t, true> : loadWord<uint64_t, false>;
+        default: return nullptr;
+    }
+}
+
+#if __BYTE_ORDER == __BIG_ENDIAN
+const bool HOST_IS_BE = true;
+#else
+const bool HOST_IS_BE = false;
+#endif
+
+} // namespace
+
 IioSensor::IioSensor(shared_ptr<struct iio_context> iio_ctx, const struct iio_device* dev, int handle) :
     SensorBase("", "", ""), remaining_samples(0), copied_samples(0), eventFd(-1),
-    iio_ctx(iio_ctx), iio_dev(dev), iio_buf(nullptr) {
+    inflight_flushes(0), pending_flush_completes(0),
+    iio_ctx(iio_ctx), iio_dev(dev), iio_buf(nullptr), data_decode(),
+    timestamp_decode(), has_timestamp(false), sample_size(0),
+    decode_sample(&IioSensor::decodeSample), tuning(), zero_copy(false) {
 
     for (unsigned c = 0; c < iio_device_get_channels_count(iio_dev); ++c) {
         struct iio_channel *chan = iio_device_get_channel(iio_dev, c);
@@ -71,6 +117,8 @@ IioSensor::IioSensor(shared_ptr<struct iio_context> iio_ctx, const struct iio_de
     sensor.reserved[1]              = 0;
 
     setType(readIioInt<uint32_t>("greybus_type", 0));
+    DirectReport::advertise(sensor);
+    loadBufferTuning();
 
     // Note: We have no way to communicate to the framework the number of
     // channels (reading_size) for non-standard sensors.
@@ -158,21 +206,182 @@ const char *IioSensor::readIioStr(const char *lenAttr, const char *strAttr, cons
     return strdup(defaultVal);
 }
 
-void IioSensor::computeChannelOffsets() {
-    channel_offset.reserve(iio_device_get_channels_count(iio_dev));
+void IioSensor::loadBufferTuning() {
+    // Longer than PROPERTY_KEY_MAX: "vendor.sensors.iio.<type>.block_count"
+    // doesn't fit in 32 bytes
+    char prop[64];
 
-    for (unsigned c = 0; c < iio_device_get_channels_count(iio_dev); ++c) {
+    tuning.block_len = BUFFER_LEN;
+    tuning.block_count = BUFFER_BLOCKS;
+    tuning.watermark = 1;
+
+    snprintf(prop, sizeof(prop), "vendor.sensors.iio.%u.block_len", sensor.type);
+    unsigned block_len = property_get_int32(prop, tuning.block_len);
+    snprintf(prop, sizeof(prop), "vendor.sensors.iio.%u.block_count", sensor.type);
+    unsigned block_count = property_get_int32(prop, tuning.block_count);
+
+    setBufferTuning(block_len, block_count);
+}
+
+void IioSensor::setBufferTuning(unsigned block_len, unsigned block_count) {
+    tuning.block_len = max(1u, min<unsigned>(block_len, MAX_BUFFER_LEN));
+    tuning.block_count = max(1u, min<unsigned>(block_count, MAX_BUFFER_BLOCKS));
+    tuning.watermark = min(tuning.watermark, tuning.block_len);
+    S_LOGD("%s: block_len=%u block_count=%u", sensor.name, tuning.block_len,
+            tuning.block_count);
+}
+
+int IioSensor::writeBufferAttr(const char *attr, long long val) {
+    char path[PATH_MAX];
+    char buf[32];
+
+    snprintf(path, sizeof(path), "/sys/bus/iio/devices/%s/buffer/%s",
+            iio_device_get_id(iio_dev), attr);
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+    int len = snprintf(buf, sizeof(buf), "%lld", val);
+    int ret = write(fd, buf, len) == len ? 0 : -errno;
+    close(fd);
+    return ret;
+}
+
+int IioSensor::bufferIoctl(unsigned long request, void *arg) {
+    return ioctl(getFd(), request, arg) == 0 ? 0 : -errno;
+}
+
+bool IioSensor::probeZeroCopy() {
+    struct iio_block block;
+
+    // Block 0 only exists if libiio allocated blocks for the buffer
+    memset(&block, 0, sizeof(block));
+    return bufferIoctl(IIO_BLOCK_QUERY_IOCTL, &block) == 0;
+}
+
+void IioSensor::buildDecodePlan() {
+    int channels = iio_device_get_channels_count(iio_dev);
+    uintptr_t start = reinterpret_cast<uintptr_t>(iio_buffer_start(iio_buf));
+    size_t max_index = sizeof(((sensors_event_t *)0)->data) / sizeof(float);
+
+    data_decode.clear();
+    has_timestamp = false;
+    decode_sample = &IioSensor::decodeSample;
+
+    sample_size = iio_device_get_sample_size(iio_dev);
+    if (sample_size <= 0) {
+        S_LOGE("Invalid sample size for %s: %zd", sensor.name, sample_size);
+        sample_size = 0;
+        return;
+    }
+
+    for (int c = 0; c < min<int>(channels, +MAX_CHANNELS); ++c) {
         struct iio_channel *chan = iio_device_get_channel(iio_dev, c);
-        long idx = iio_channel_get_index(chan);
-        if (idx >= 0 && iio_channel_is_scan_element(chan)) {
-            channel_offset[idx] =
-                reinterpret_cast<uintptr_t>(iio_buffer_first(iio_buf, chan)) -
-                reinterpret_cast<uintptr_t>(iio_buffer_start(iio_buf));
+        long index = iio_channel_get_index(chan);
+        const char *chan_id = iio_channel_get_id(chan);
+        if (index < 0 || !chan_id || !iio_channel_is_scan_element(chan) ||
+                !iio_channel_is_enabled(chan)) {
+            continue;
+        }
+
+        const struct iio_data_format *fmt = iio_channel_get_data_format(chan);
+        if (fmt->length == 0 || fmt->length > 64) {
+            S_LOGE("%s: channel %s has an unsupported %u bit storage", sensor.name,
+                    chan_id, fmt->length);
+            continue;
+        }
+        unsigned valid = fmt->is_fully_defined ? fmt->length : fmt->bits;
+        ChannelDecode cd;
+        cd.offset = reinterpret_cast<uintptr_t>(iio_buffer_first(iio_buf, chan)) - start;
+        cd.chan = chan;
+        cd.shift = fmt->shift;
+        cd.is_signed = fmt->is_signed;
+        cd.index = index;
+        // Storage sizes without a loader (ex: 3 byte words) are converted
+        // by libiio
+        if (fmt->length % 8 == 0 && fmt->shift < 64) {
+            cd.load = selectLoader(fmt->length / 8, fmt->is_be != HOST_IS_BE);
+        } else {
+            cd.load = nullptr;
+        }
+        cd.ext = 64 - max(1u, min(valid, fmt->length));
+
+        if (0 == strcmp(chan_id, "timestamp")) {
+            timestamp_decode = cd;
+            has_timestamp = true;
+        } else if (static_cast<size_t>(index) < max_index) {
+            data_decode.push_back(cd);
+        } else {
+            S_LOGE("%s: channel %s index %ld out of range", sensor.name, chan_id, index);
         }
     }
+
+    // Use a specialized loop if all data channels share the same plain format
+    int64_t (*load)(const uint8_t *) = nullptr;
+    bool is_signed = false;
+    unsigned ext = 0;
+    bool uniform = !data_decode.empty();
+    for (const ChannelDecode &cd : data_decode) {
+        if (&cd == &data_decode.front()) {
+            load = cd.load;
+            is_signed = cd.is_signed;
+            ext = cd.ext;
+        }
+        uniform = uniform && cd.load == load && cd.is_signed == is_signed &&
+            cd.ext == ext && cd.shift == 0;
+    }
+    if (uniform && load == selectLoader(4, false) && ext == 32) {
+        decode_sample = is_signed ? &IioSensor::decodeSampleUniform<int32_t> :
+            &IioSensor::decodeSampleUniform<uint32_t>;
+    } else if (uniform && load == selectLoader(2, false) && ext == 48) {
+        decode_sample = is_signed ? &IioSensor::decodeSampleUniform<int16_t> :
+            &IioSensor::decodeSampleUniform<uint16_t>;
+    }
+
+    S_LOGD("%s: sample_size=%zd data_channels=%zu timestamp=%d uniform=%d",
+            sensor.name, sample_size, data_decode.size(), has_timestamp,
+            decode_sample != &IioSensor::decodeSample);
 }
 
-int IioSensor::readEvents(sensors_event_t* data, int count) {
+int64_t IioSensor::decodeRaw(const ChannelDecode &cd, const uint8_t *sample) {
+    uint64_t raw;
+
+    if (!cd.load) {
+        // iio_channel_convert() writes the storage word in host order, and
+        // leaves the rest of the 64 bits alone
+        int64_t converted = 0;
+        iio_channel_convert(cd.chan, &converted, sample + cd.offset);
+        raw = static_cast<uint64_t>(converted);
+        if (!HOST_IS_BE) {
+            raw <<= cd.ext;
+        }
+    } else {
+        raw = static_cast<uint64_t>(cd.load(sample + cd.offset)) >> cd.shift;
+        raw <<= cd.ext;
+    }
+    if (cd.is_signed) {
+        return static_cast<int64_t>(raw) >> cd.ext;
+    } else {
+        return static_cast<int64_t>(raw >> cd.ext);
+    }
+}
+
+void IioSensor::decodeSample(sensors_event_t &d, const uint8_t *sample) {
+    for (const ChannelDecode &cd : data_decode) {
+        d.data[cd.index] = (float)convRaw(decodeRaw(cd, sample));
+    }
+}
+
+template<typename T>
+void IioSensor::decodeSampleUniform(sensors_event_t &d, const uint8_t *sample) {
+    for (const ChannelDecode &cd : data_decode) {
+        T raw;
+        memcpy(&raw, sample + cd.offset, sizeof(raw));
+        d.data[cd.index] = (float)convRaw(raw);
+    }
+}
+
+int IioSensor::readSamples(sensors_event_t* data, int count) {
 
     /* BIG ASSUMPTION: We (sensors HAL) are the only ones using these IIO
      * devices. No one else is modifying them (enabling/disabling channels)
@@ -182,17 +391,25 @@ int IioSensor::readEvents(sensors_event_t* data, int count) {
      * sample_size == iio_buffer_step() when all channels are enabled (which we
      * always do). In general: iio_buffer_step() <= sample_size.
      * */
-    ssize_t sample_size = iio_device_get_sample_size(iio_dev);
-    int channels = iio_device_get_channels_count(iio_dev);
     uintptr_t start;
 
-    if (channel_offset.size() == 0) {
-        computeChannelOffsets();
+    if (!iio_buf) {
+        return 0;
+    }
+
+    if (sample_size == 0) {
+        buildDecodePlan();
+        if (sample_size == 0) {
+            return 0;
+        }
     }
 
     if (remaining_samples == 0) {
         ssize_t buffer_bytes = iio_buffer_refill(iio_buf);
-        if (buffer_bytes < 0) {
+        if (buffer_bytes == -EAGAIN) {
+            // Non-blocking buffer with nothing queued
+            return 0;
+        } else if (buffer_bytes < 0) {
             S_LOGE("Unable to fill buffer: %s", strerror(-buffer_bytes));
             return 0;
         }
@@ -211,26 +428,17 @@ int IioSensor::readEvents(sensors_event_t* data, int count) {
     for ( ; copied < remaining_samples && copied < count;
             ++copied, start += sample_size) {
 
+        const uint8_t *sample = reinterpret_cast<const uint8_t *>(start);
         sensors_event_t &d = data[copied];
         d.version   = sizeof(sensors_event_t);
         d.sensor    = sensor.handle;
         d.type      = sensor.type;
         bzero(d.data, sizeof(d.data)); // For debug purposes
 
-        int32_t unscaled;
-        for (int c = 0; c < min<int>(channels, +MAX_CHANNELS); ++c) {
-            struct iio_channel *chan = iio_device_get_channel(iio_dev, c);
-            long index = iio_channel_get_index(chan);
-            const char *chan_id = iio_channel_get_id(chan);
-            if (index >= 0 && chan_id) {
-                if (0 == strcmp(chan_id, "timestamp")) {
-                    iio_channel_convert(chan, &(d.timestamp), reinterpret_cast<void *>(start + channel_offset[index]));
-                } else {
-                    iio_channel_convert(chan, &unscaled, reinterpret_cast<void *>(start + channel_offset[index]));
-                    d.data[index] = (float)convVal(unscaled);
-                }
-            }
+        if (has_timestamp) {
+            d.timestamp = decodeRaw(timestamp_decode, sample);
         }
+        (this->*decode_sample)(d, sample);
 
         d.flags = 0;
     }
@@ -245,12 +453,49 @@ int IioSensor::readEvents(sensors_event_t* data, int count) {
     return copied;
 }
 
+int IioSensor::drainBuffer(sensors_event_t* data, int count) {
+    int copied = 0;
+
+    while (copied < count) {
+        int res = readSamples(data + copied, count - copied);
+        if (res <= 0) break;
+        copied += res;
+    }
+    return copied;
+}
+
 int IioSensor::readIioEvents(sensors_event_t* data, int count) {
     S_LOGD("+");
     if (eventFd < 0) return 0;
 
     int copied;
     for (copied = 0; copied < count; ) {
+        if (pending_flush_completes > 0) {
+            copied += drainBuffer(data + copied, count - copied);
+            if (copied == count) {
+                // No room for the flush complete. hasPendingEvents() brings
+                // us back here on the next poll().
+                break;
+            }
+
+            sensors_event_t &d = data[copied];
+
+            d.version = META_DATA_VERSION;
+            d.sensor = 0;
+            d.type = SENSOR_TYPE_META_DATA;
+            d.reserved0 = 0;
+            d.timestamp = 0;
+            d.meta_data.what = META_DATA_FLUSH_COMPLETE;
+            d.meta_data.sensor = sensor.handle;
+
+            copied++;
+            pending_flush_completes--;
+            if (inflight_flushes > 0 && --inflight_flushes == 0 && iio_buf) {
+                writeBufferAttr("watermark", tuning.watermark);
+            }
+            continue;
+        }
+
         struct iio_event_data event;
         int ret = read(eventFd, &event, sizeof(event));
         if (ret == -1) {
@@ -277,18 +522,9 @@ int IioSensor::readIioEvents(sensors_event_t* data, int count) {
                 (ev_dir == IIO_EV_DIR_FALLING) &&
                 (ch_type == IIO_PROPRIETARY) &&
                 (ch == 0)) {
-
-                sensors_event_t &d = data[copied];
-
-                d.version = META_DATA_VERSION;
-                d.sensor = 0;
-                d.type = SENSOR_TYPE_META_DATA;
-                d.reserved0 = 0;
-                d.timestamp = 0;
-                d.meta_data.what = META_DATA_FLUSH_COMPLETE;
-                d.meta_data.sensor = sensor.handle;
-
-                copied++;
+                // Reported at the top of the loop, after the samples
+                // queued ahead of it
+                pending_flush_completes++;
             }
 
             //S_LOGD("Event EvType=%d EvDir=%d, ChType=%d, Ch=%d copied=%d", ev_type, ev_dir, ch_type, ch, copied);
@@ -308,6 +544,7 @@ int IioSensor::getFd() const {
 
 int IioSensor::setEnable(int32_t handle, int enabled) {
     int ret = 0;
+    AutoLock _l(ioLock);
     S_LOGD("handle=%d enabled=%d iio_buf=%08llx", handle, enabled, reinterpret_cast<long long>(iio_buf));
 
     if (handle == -1) {
@@ -329,9 +566,13 @@ int IioSensor::setEnable(int32_t handle, int enabled) {
         }
 
         if (!iio_buf) {
+            // Number of blocks libiio asks for if the driver implements the
+            // block (mmap) interface. Ignored on the read() path.
+            iio_device_set_kernel_buffers_count(iio_dev, tuning.block_count);
+
             // We must use cyclic=false or else we won't be able to configure
             // the buffer to non-blocking below.
-            iio_buf = iio_device_create_buffer(iio_dev, BUFFER_LEN, false);
+            iio_buf = iio_device_create_buffer(iio_dev, tuning.block_len, false);
             S_LOGD("Enabled %d (fd=%d)", iio_buf != NULL, getFd());
             if (!iio_buf) {
                 ret = -errno;
@@ -339,18 +580,26 @@ int IioSensor::setEnable(int32_t handle, int enabled) {
                 goto exit;
             }
 
+            zero_copy = probeZeroCopy();
+            int wm_res = writeBufferAttr("watermark", tuning.watermark);
+            S_LOGD("%s: zero_copy=%d block_len=%u block_count=%u watermark=%u (%d)",
+                    sensor.name, zero_copy, tuning.block_len, tuning.block_count,
+                    tuning.watermark, wm_res);
+
             // Set the buffer to non-blocking, so libiio doesn't POLLIN.
             // We will do the poll(POLLIN) ourselves.
             iio_buffer_set_blocking_mode(iio_buf, false);
 
-            int ret = ioctl(getFd(), IIO_GET_EVENT_FD_IOCTL, &eventFd);
-            if (ret == -1 || eventFd == -1) {
-                S_LOGE("Failed to retrieve IIO event FD for %s (%s)", sensor.name, strerror(errno));
+            int ret = bufferIoctl(IIO_GET_EVENT_FD_IOCTL, &eventFd);
+            if (ret < 0 || eventFd == -1) {
+                S_LOGE("Failed to retrieve IIO event FD for %s (%s)", sensor.name, strerror(-ret));
                 eventFd = -1;
             } else {
                 S_LOGD("Got event FD for %s (%d)", sensor.name, eventFd);
                 fcntl(eventFd, F_SETFL, O_NONBLOCK);
             }
+
+            buildDecodePlan();
         }
     } else {
         int channels = iio_device_get_channels_count(iio_dev);
@@ -368,6 +617,13 @@ int IioSensor::setEnable(int32_t handle, int enabled) {
             }
             iio_buffer_destroy(iio_buf);
             iio_buf = nullptr;
+            zero_copy = false;
+            // The flush completes of a destroyed buffer never arrive
+            inflight_flushes = 0;
+            pending_flush_completes = 0;
+            data_decode.clear();
+            has_timestamp = false;
+            sample_size = 0;
         }
     }
 
@@ -386,11 +642,25 @@ int IioSensor::batch(int32_t handle, int flags, int64_t sampling_period_ns,
 
     if (! hasSensor(handle) || period < chrono::microseconds(1)) return -EINVAL;
 
+    AutoLock _l(ioLock);
+
     res = iio_device_attr_write_longlong(iio_dev, "max_latency_ns", max_report_latency_ns);
     if (res < 0) {
         S_LOGD("Setting max_latency res=%d err=%s", res, res < 0 ? strerror(-res) : "NoError");
     }
 
+    // Let the kernel queue up to max_report_latency_ns worth of samples (at
+    // most one block) before waking us up.
+    int64_t latency_samples = max_report_latency_ns / sampling_period_ns;
+    tuning.watermark = max<int64_t>(1, min<int64_t>(latency_samples, tuning.block_len));
+    // A flush in progress restores the watermark once it completes.
+    if (iio_buf && inflight_flushes == 0) {
+        res = writeBufferAttr("watermark", tuning.watermark);
+        if (res < 0) {
+            S_LOGD("Setting watermark res=%d err=%s", res, strerror(-res));
+        }
+    }
+
     double freq = chrono::duration<double>(1.0) / period;
     res = iio_device_attr_write_double(iio_dev, "in_sampling_frequency", freq);
     if (res < 0) {
@@ -408,7 +678,17 @@ int IioSensor::flush(int32_t handle) {
             return -EINVAL;
         } else {
             S_LOGD("flushing");
-            return iio_device_attr_write_longlong(iio_dev, "flush", 1);
+            AutoLock _l(ioLock);
+            // Don't let the kernel sit on samples below the watermark while
+            // the flush completes. Restored in readIioEvents().
+            if (inflight_flushes++ == 0 && iio_buf && tuning.watermark > 1) {
+                writeBufferAttr("watermark", 1);
+            }
+            int res = iio_device_attr_write_longlong(iio_dev, "flush", 1);
+            if (res < 0 && --inflight_flushes == 0 && iio_buf) {
+                writeBufferAttr("watermark", tuning.watermark);
+            }
+            return res;
         }
     }
     return -EINVAL;
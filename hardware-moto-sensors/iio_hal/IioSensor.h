@@ -20,6 +20,7 @@
 #include <vector>
 #include <memory>
 #include <chrono>
+#include <mutex>
 
 #include <hardware/sensors.h>
 #include <android-base/macros.h>
@@ -35,6 +36,9 @@
  *
  * This class is able to read both sensor events (ex: accel data), and IIO
  * events (ex: flush complete).
+ *
+ * The poll() thread reads the buffer while framework threads enable,
+ * disable, batch or flush the sensor, so each of these holds ioLock.
  */
 class IioSensor : public SensorBase {
 public:
@@ -42,18 +46,23 @@ public:
             const struct iio_device* dev, int handle);
     virtual ~IioSensor();
 
-    virtual int readEvents(sensors_event_t* data, int count) override;
+    virtual int readEvents(sensors_event_t* data, int count) override {
+        AutoLock _l(ioLock);
+        return readSamples(data, count);
+    }
 
     virtual int readEvents(sensors_event_t* data, int count, int fd) override {
-        if (fd == eventFd) {
+        AutoLock _l(ioLock);
+        if (fd == eventFd || pending_flush_completes > 0) {
             return readIioEvents(data, count);
         } else {
-            return readEvents(data, count);
+            return readSamples(data, count);
         }
     }
 
     virtual bool hasPendingEvents() const override {
-        return remaining_samples > 0;
+        AutoLock _l(ioLock);
+        return remaining_samples > 0 || pending_flush_completes > 0;
     }
     virtual int getFd() const override;
 
@@ -94,6 +103,30 @@ public:
         return eventFd;
     }
 
+    /** Geometry of the IIO buffer. When the kernel driver implements the IIO
+     * block interface, libiio mmap()s block_count blocks of block_len samples
+     * and iio_buffer_refill() returns a mapped block without copying it.
+     * Otherwise libiio read()s up to block_len samples into its own buffer.
+     * The kernel wakes up the poll fd once watermark samples are queued. */
+    struct BufferTuning {
+        unsigned block_len;
+        unsigned block_count;
+        unsigned watermark;
+    };
+
+    /** Changes the block length and count. They take effect the next time
+     * the sensor is enabled. */
+    void setBufferTuning(unsigned block_len, unsigned block_count);
+
+    const BufferTuning &getBufferTuning() const {
+        return tuning;
+    }
+
+    /** @return true if the enabled buffer is backed by mmap()ed kernel blocks. */
+    bool isZeroCopy() const {
+        return zero_copy;
+    }
+
     /** The ID of the IIO device being wrapped. Ex: "iio:device2" */
     virtual const char * getIioId() const {
         if (iio_dev) {
@@ -107,6 +140,15 @@ protected:
     /// Default IIO buffer length. The number of samples the IIO buffer can hold.
     static const int BUFFER_LEN = 5;
 
+    /// Default number of kernel blocks for the block (mmap) interface.
+    static const int BUFFER_BLOCKS = 4;
+
+    /// Upper bound for a tuned buffer length, in samples.
+    static const int MAX_BUFFER_LEN = 256;
+
+    /// Upper bound for a tuned number of kernel blocks.
+    static const int MAX_BUFFER_BLOCKS = 32;
+
     /// This is the maximum number of channels handled by the Android framework.
     static const int MAX_CHANNELS = 16;
 
@@ -122,6 +164,14 @@ protected:
     // File descriptor on which we listen for events.
     int eventFd;
 
+    /** Flushes requested and not yet reported complete. While there are any,
+     * the buffer watermark is 1 so that the kernel does not hold samples back
+     * until after the flush complete. */
+    int inflight_flushes;
+    /** Flush completes read from eventFd but not reported yet, because the
+     * samples queued before them did not fit in the poll() destination. */
+    int pending_flush_completes;
+
     /** Must be set to slightly longer than the fastest sample rate.
      * The same value is used for all devices/sensors. */
     static std::chrono::milliseconds timeout;
@@ -143,6 +193,11 @@ protected:
         return (static_cast<double>(raw) + iio_offset) * iio_scale;
     }
 
+    /** Same as convVal(), for channels wider than 32 bits. */
+    inline double convRaw(int64_t raw) {
+        return (static_cast<double>(raw) + iio_offset) * iio_scale;
+    }
+
     /** Read an attribute that is of string type from sysfs.
      *
      * @param lenAttr The name of an integer attribute that tells us the size
@@ -174,17 +229,100 @@ protected:
         }
     }
 
-    /** Computes the offset of each channel's data, relative to the start of a
-     * data sample (or event). */
-    void computeChannelOffsets(void);
+    /** How to decode one channel of a sample. Computed once per buffer from
+     * the channel's iio_data_format, so that readEvents() doesn't have to
+     * look up channel metadata for every sample. */
+    struct ChannelDecode {
+        /// Offset of the channel's data relative to the start of a sample.
+        ptrdiff_t offset;
+        /** Reads the channel's storage word, byte swapped to host order and
+         * sign or zero extended to 64 bits. nullptr if the storage size is
+         * not 1, 2, 4 or 8 bytes, in which case chan is converted by libiio. */
+        int64_t (*load)(const uint8_t *src);
+        const struct iio_channel *chan;
+        /// Right shift to apply to the storage word.
+        unsigned shift;
+        /// 64 minus the number of valid bits, used to sign extend or mask.
+        unsigned ext;
+        bool is_signed;
+        /// Index of the channel in sensors_event_t::data.
+        int index;
+    };
 
-    /** The offset of each channel's data relative to the start of a data
-     * sample. */
-    std::vector<ptrdiff_t> channel_offset;
+    /** Decodes one sample into d. Picked by buildDecodePlan(). */
+    typedef void (IioSensor::*SampleDecoder)(sensors_event_t &d, const uint8_t *sample);
 
-    /** IIO Events are used to signal things such as flush complete. */
+    /** Builds the decode plan for the current buffer. Must be called after
+     * the buffer is created, since channel offsets depend on the enabled
+     * channels. */
+    void buildDecodePlan(void);
+
+    /** Decodes a channel's raw value, applying shift and sign/mask. */
+    static int64_t decodeRaw(const ChannelDecode &cd, const uint8_t *sample);
+
+    /** Decodes a sample with any mix of channel formats. */
+    void decodeSample(sensors_event_t &d, const uint8_t *sample);
+
+    /** Decodes a sample whose data channels are all stored as a fully
+     * defined, unshifted, host endian T. This is the common case
+     * (ex: le:s32/32>>0). */
+    template<typename T>
+    void decodeSampleUniform(sensors_event_t &d, const uint8_t *sample);
+
+    /** Data channels, in channel order. */
+    std::vector<ChannelDecode> data_decode;
+    ChannelDecode timestamp_decode;
+    bool has_timestamp;
+    /** Size of one sample in the buffer, in bytes. 0 until the plan is built. */
+    ssize_t sample_size;
+    SampleDecoder decode_sample;
+
+    BufferTuning tuning;
+    bool zero_copy;
+
+    /** Sets the default buffer tuning, then applies the optional overrides
+     * vendor.sensors.iio.<type>.block_len and .block_count, where <type> is
+     * the sensor type in decimal. */
+    void loadBufferTuning(void);
+
+    /** Writes an attribute of the device's buffer/ sysfs directory, which
+     * libiio has no API for.
+     * @return 0 on success, or a negative errno code. */
+    virtual int writeBufferAttr(const char *attr, long long val);
+
+    /** Issues an ioctl on the buffer's character device, which libiio has no
+     * API for either. Together with writeBufferAttr(), this is all the HAL
+     * does to the device behind libiio's back, so a fake device only has to
+     * override these two.
+     * @return 0 on success, or a negative errno code. */
+    virtual int bufferIoctl(unsigned long request, void *arg);
+
+    /** Checks whether libiio set up the block interface on the buffer. */
+    bool probeZeroCopy(void);
+
+    typedef std::lock_guard<std::mutex> AutoLock;
+
+    /** Held while the buffer, eventFd or the flush and sample counters are
+     * used or changed, so that disabling the sensor doesn't destroy them
+     * under a poll() reading them. */
+    mutable std::mutex ioLock;
+
+    /** Decodes samples from the buffer, refilling it if needed. Callers must
+     * hold ioLock. */
+    int readSamples(sensors_event_t* data, int count);
+
+    /** IIO Events are used to signal things such as flush complete. Callers
+     * must hold ioLock. */
     virtual int readIioEvents(sensors_event_t* data, int count);
 
+    /** Reads every sample the kernel has queued, without waiting for the
+     * watermark. Flush completes are reported after this, so that no sample
+     * from before the flush follows its flush complete. Callers must hold
+     * ioLock.
+     *
+     * @return The number of events written to data. */
+    int drainBuffer(sensors_event_t* data, int count);
+
     /** All GB sensors with a type of 0 (i.e. undefined or custom) will be
      * assigned a new unique type since a type of 0 is not allowed. */
     void setType(uint32_t type);
@@ -18,6 +18,7 @@
 
 #define __STDC_FORMAT_MACROS
 
+#include <algorithm>
 #include <assert.h>
 #include <dirent.h>
 #include <dlfcn.h>
@@ -37,13 +38,21 @@
 
 #include <hardware/mot_sensorhub_motosh.h>
 
+#include <cutils/properties.h>
+
 #include "HubSensors.h"
 #include "SensorsLog.h"
 
 /*****************************************************************************/
 
 HubSensors::HubSensors()
-: SensorBase(SENSORHUB_DEVICE_NAME, NULL, SENSORHUB_AS_DATA_NAME),
+: HubSensors(sensorTraceOpenReplay())
+{
+}
+
+HubSensors::HubSensors(int replayFd)
+: SensorBase(replayFd < 0 ? SENSORHUB_DEVICE_NAME : NULL, NULL,
+          replayFd < 0 ? SENSORHUB_AS_DATA_NAME : NULL),
       mEnabled(0),
       mWakeEnabled(0),
       mPendingMask(0),
@@ -60,10 +69,16 @@ HubSensors::HubSensors()
       mOrientReqDelay(USHRT_MAX),
       mGyroDelay(USHRT_MAX),
       mEcompassDelay(USHRT_MAX),
+      mBatcher(),
+      mBatchScratch(),
+      mTrace(SensorTraceRecorder::create("motosh", sizeof(struct motosh_android_sensor_data),
+              offsetof(struct motosh_android_sensor_data, type))),
+      mReplayStats(),
+      mReplaying(replayFd >= 0),
       nextPendingEvent(0)
 {
     // read the actual value of all sensors if they're enabled already
-    char flags[3];
+    char flags[3] = { 0 };
     FILE *fp;
     int size;
     int cal_data;
@@ -76,15 +91,22 @@ HubSensors::HubSensors()
     memset(mGyroCal, 0, sizeof(mGyroCal));
     memset(mAccelCal, 0, sizeof(mAccelCal));
     memset(mErrorCnt, 0, sizeof(mErrorCnt));
+    memset(&mReadStats, 0, sizeof(mReadStats));
+    initDecoders();
     S_LOGI("Sensorhub hal created");
 
+    if (mReplaying) {
+        data_fd = replayFd;
+        mReplayStats = SensorReplayStats::create();
+    }
+
     open_device();
 
-    if (!motosh_ioctl(dev_fd, MOTOSH_IOCTL_GET_SENSORS, flags))  {
+    if (!hubIoctl(MOTOSH_IOCTL_GET_SENSORS, flags))  {
         mEnabled = flags[0] | (flags[1] << 8) | (flags[2] << 16);
     }
 
-    if (!motosh_ioctl(dev_fd, MOTOSH_IOCTL_GET_WAKESENSORS, flags))  {
+    if (!hubIoctl(MOTOSH_IOCTL_GET_WAKESENSORS, flags))  {
         mWakeEnabled = flags[0] | (flags[1] << 8) | (flags[2] << 16);
     }
 
@@ -98,7 +120,7 @@ HubSensors::HubSensors()
             mMagCal[size] = cal_data;
         }
         fclose(fp);
-        err = motosh_ioctl(dev_fd, MOTOSH_IOCTL_SET_MAG_CAL, mMagCal);
+        err = hubIoctl(MOTOSH_IOCTL_SET_MAG_CAL, mMagCal);
         if (err < 0) {
            ALOGE("Can't send Mag Cal data");
         }
@@ -114,7 +136,7 @@ HubSensors::HubSensors()
             mGyroCal[size] = cal_data;
         }
         fclose(fp);
-        err = motosh_ioctl(dev_fd, MOTOSH_IOCTL_SET_GYRO_CAL, mGyroCal);
+        err = hubIoctl(MOTOSH_IOCTL_SET_GYRO_CAL, mGyroCal);
         if (err < 0) {
            ALOGE("Can't send Gyro Cal data");
         }
@@ -126,7 +148,7 @@ HubSensors::HubSensors()
             ALOGE("Accel Cal file read failed");
             memset(mAccelCal, 0, sizeof(mAccelCal));
         } else {
-            err = ioctl(dev_fd, MOTOSH_IOCTL_SET_ACCEL_CAL, mAccelCal);
+            err = hubIoctl(MOTOSH_IOCTL_SET_ACCEL_CAL, mAccelCal);
             if (err < 0)
                 ALOGE("Can't send Accel Cal data");
         }
@@ -135,6 +157,35 @@ HubSensors::HubSensors()
     for (const auto& s : hubSensorList()) {
         mIdToSensor.insert(std::make_pair(s.handle, &s));
     }
+    initBatching();
+}
+
+void HubSensors::initBatching()
+{
+    // The accelerometer is batched by the hub (MOTOSH_IOCTL_SET_ACC_DELAY)
+    static const int handles[] = {
+        ID_G, ID_UNCALIB_GYRO, ID_M, ID_UNCALIB_MAG, ID_O, ID_L,
+        ID_QUAT_6AXIS, ID_QUAT_9AXIS, ID_GAME_RV,
+#ifdef _ENABLE_LA
+        ID_LA,
+#endif
+#ifdef _ENABLE_GR
+        ID_GRAVITY,
+#endif
+    };
+    char prop[PROPERTY_KEY_MAX];
+
+    // ro.vendor.sensors.fifo sets the FIFO size of all these sensors, and
+    // ro.vendor.sensors.fifo.<handle> that of one sensor. 0 disables it.
+    int32_t events = property_get_int32("ro.vendor.sensors.fifo", HUB_SW_FIFO_EVENTS);
+    for (int handle : handles) {
+        if (!mIdToSensor.count(handle))
+            continue;
+        snprintf(prop, sizeof(prop), "ro.vendor.sensors.fifo.%d", handle);
+        int32_t n = property_get_int32(prop, events);
+        if (n > 0)
+            mBatcher.setCapacity(handle, n);
+    }
 }
 
 HubSensors::~HubSensors()
@@ -142,6 +193,24 @@ HubSensors::~HubSensors()
   ALOGE("Sensorhub hal destroyed");
 }
 
+int HubSensors::hubIoctl(unsigned long request, void *arg)
+{
+    if (!mReplaying)
+        return motosh_ioctl(dev_fd, request, arg);
+
+    switch (request) {
+        case MOTOSH_IOCTL_GET_SENSORS:
+        case MOTOSH_IOCTL_GET_WAKESENSORS:
+        case MOTOSH_IOCTL_GET_MAG_CAL:
+        case MOTOSH_IOCTL_GET_GYRO_CAL:
+        case MOTOSH_IOCTL_GET_ACCEL_CAL:
+            // Nothing to read back, and no calibration to save
+            return -ENODEV;
+        default:
+            return 0;
+    }
+}
+
 bool HubSensors::isHandleEnabled(uint64_t handle)
 {
     return (mEnabledHandles & ((decltype(mEnabledHandles))1 << handle)) != 0;
@@ -162,6 +231,10 @@ int HubSensors::setEnable(int32_t handle, int en)
     ALOGI("Sensorhub hal setEnable: sensor=\"%s\" handle=%d enable=%d",
             mIdToSensor[handle]->name, handle, en);
 
+    // Deliver what was batched in software before the sensor went quiet
+    if (!newState)
+        mBatcher.expire(handle);
+
     new_enabled = mEnabled;
     switch (handle) {
         case ID_A:
@@ -339,7 +412,7 @@ int HubSensors::setEnable(int32_t handle, int en)
             FILE *fp;
             int i;
 
-            err = motosh_ioctl(dev_fd, MOTOSH_IOCTL_GET_MAG_CAL, mMagCal);
+            err = hubIoctl(MOTOSH_IOCTL_GET_MAG_CAL, mMagCal);
             if (err < 0) {
                 ALOGE("Can't read Mag Cal data");
             } else {
@@ -362,7 +435,7 @@ int HubSensors::setEnable(int32_t handle, int en)
         updateGyroRate();
 
     if (found && (new_enabled != mEnabled)) {
-        err = motosh_ioctl(dev_fd, MOTOSH_IOCTL_SET_SENSORS, &new_enabled);
+        err = hubIoctl(MOTOSH_IOCTL_SET_SENSORS, &new_enabled);
         ALOGE_IF(err, "Could not change sensor state (%s)", strerror(-err));
         // Never return this error to the caller. This would result in a
         // failure to registerListener(), but regardless of failure, we
@@ -463,7 +536,7 @@ int HubSensors::setEnable(int32_t handle, int en)
     }
 
     if (found && (new_enabled != mWakeEnabled)) {
-        err = motosh_ioctl(dev_fd, MOTOSH_IOCTL_SET_WAKESENSORS, &new_enabled);
+        err = hubIoctl(MOTOSH_IOCTL_SET_WAKESENSORS, &new_enabled);
         ALOGE_IF(err, "Could not change sensor state (%s)", strerror(-err));
         // Never return this error to the caller. This would result in a
         // failure to registerListener(), but regardless of failure, we
@@ -505,12 +578,12 @@ int HubSensors::batch(int32_t handle, int32_t flags, int64_t ns, int64_t timeout
 
     switch (handle) {
         case ID_A:
-            status = motosh_ioctl(dev_fd,  MOTOSH_IOCTL_SET_ACC_DELAY, &batch_cfg);
+            status = hubIoctl(MOTOSH_IOCTL_SET_ACC_DELAY, &batch_cfg);
             break;
         case ID_G:
             mGyroReqDelay = delay;
             break;
-        case ID_PR: status = motosh_ioctl(dev_fd,  MOTOSH_IOCTL_SET_PRES_DELAY, &delay); break;
+        case ID_PR: status = hubIoctl(MOTOSH_IOCTL_SET_PRES_DELAY, &delay); break;
         case ID_M:
             mMagReqDelay = delay;
             break;
@@ -519,7 +592,7 @@ int HubSensors::batch(int32_t handle, int32_t flags, int64_t ns, int64_t timeout
             break;
         case ID_T: status = 0;                                                    break;
         case ID_L:
-            status = motosh_ioctl(dev_fd, MOTOSH_IOCTL_SET_ALS_DELAY, &delay);
+            status = hubIoctl(MOTOSH_IOCTL_SET_ALS_DELAY, &delay);
             break;
 #ifdef _ENABLE_LA
         case ID_LA:
@@ -554,8 +627,8 @@ int HubSensors::batch(int32_t handle, int32_t flags, int64_t ns, int64_t timeout
         case ID_S: status = 0;                                                    break;
         case ID_CA: status = 0;                                                   break;
 #ifdef _ENABLE_IR
-        case ID_IR_GESTURE: status = motosh_ioctl(dev_fd, MOTOSH_IOCTL_SET_IR_GESTURE_DELAY, &delay); break;
-        case ID_IR_RAW: status = motosh_ioctl(dev_fd, MOTOSH_IOCTL_SET_IR_RAW_DELAY, &delay); break;
+        case ID_IR_GESTURE: status = hubIoctl(MOTOSH_IOCTL_SET_IR_GESTURE_DELAY, &delay); break;
+        case ID_IR_RAW: status = hubIoctl(MOTOSH_IOCTL_SET_IR_RAW_DELAY, &delay); break;
         case ID_IR_OBJECT: status = 0;                                            break;
 #endif /* _ENABLE_IR */
         case ID_SIM: status = 0;                                                  break;
@@ -573,7 +646,7 @@ int HubSensors::batch(int32_t handle, int32_t flags, int64_t ns, int64_t timeout
             else if (delay > 3600) // 1 hour
                 delay = 3600;
 
-            status = motosh_ioctl(dev_fd,  MOTOSH_IOCTL_SET_STEP_COUNTER_DELAY, &delay);
+            status = hubIoctl(MOTOSH_IOCTL_SET_STEP_COUNTER_DELAY, &delay);
             break;
         case ID_STEP_DETECTOR:status = 0;                                         break;
 #endif
@@ -633,6 +706,9 @@ int HubSensors::batch(int32_t handle, int32_t flags, int64_t ns, int64_t timeout
     else if( handle == ID_G || handle == ID_UNCALIB_GYRO )
         status = updateGyroRate();
 
+    // No-op for the sensors the hub batches itself
+    mBatcher.configure(handle, ns, timeout);
+
     // Never return this error to the caller. This would result in a
     // failure to registerListener(), but regardless of failure, we
     // will consider these sensors 'registered' at the rate we tried
@@ -657,16 +733,8 @@ void HubSensors::logAlsEvent(int32_t lux, int64_t ts_ns) {
 
 int HubSensors::readEvents(sensors_event_t* d, int dLen)
 {
-    struct motosh_android_sensor_data buff;
     int ret;
-    char timeBuf[32];
-    struct tm* ptm = NULL;
-    struct timeval timeutc;
-    static long int sent_bug2go_sec = 0;
-    int32_t sensorId;
     sensors_event_t* data = d;
-    FILE *fp;
-    int size;
 
     sensors_event_t const* const dataEnd = d + dLen;
 
@@ -688,10 +756,23 @@ int HubSensors::readEvents(sensors_event_t* d, int dLen)
         }
     }
 
+    // Where the events decoded below start
+    sensors_event_t* const decoded = data;
+    const size_t pendingStart = pendingEvents.size();
+
     while (!bufferFull()) {
+        // Read as many records as there are free slots, most records decode
+        // to a single event.
+        size_t count = std::min<size_t>(HUB_READ_BATCH, dataEnd - data);
+
         errno = 0;
-        ret = read(data_fd, &buff, sizeof(struct motosh_android_sensor_data));
+        ret = read(data_fd, mReadBuf, count * sizeof(mReadBuf[0]));
+        mReadStats.reads++;
         if (ret < 0) {
+            if (errno == EAGAIN) {
+                // A replay FIFO (sensorTraceOpenReplay()) that was drained
+                break;
+            }
             S_LOGE("Error reading data_fd. ret=%d errno=%d %s", ret, errno, strerror(errno));
             return -errno;
         } else if (ret == 0) {
@@ -701,509 +782,810 @@ int HubSensors::readEvents(sensors_event_t* d, int dLen)
             break;
         }
 
-        /* these sensors are not supported, upload a bug2go if its been at least 24hrs since previous bug2go*/
-        if (buff.type == DT_PRESSURE || buff.type == DT_TEMP ||
-            buff.type == DT_DOCK ||
-            buff.type == DT_NFC || buff.type == DT_RESET) {
-            if (buff.type == DT_RESET) {
-                //reset reason should be between 1 and ERROR_TYPES
-                if (buff.data[0] >= 1 && buff.data[0] <= ERROR_TYPES)
-                    mErrorCnt[buff.data[0]]++;
+        if (mTrace) {
+            mTrace->write(mReadBuf, ret);
+        }
+
+        size_t records = ret / sizeof(mReadBuf[0]);
+        if (ret % sizeof(mReadBuf[0])) {
+            S_LOGE("Dropping partial record of %zu bytes", ret % sizeof(mReadBuf[0]));
+        }
+
+        int64_t decodeStart = getTimestamp();
+        if (mReplayStats) {
+            mReplayStats->beginRead();
+        }
+        for (size_t i = 0; i < records; i++) {
+            const struct motosh_android_sensor_data& buff = mReadBuf[i];
+            Decoder decode = mDecoders[buff.type];
+            int64_t recordStart = mReplayStats ? getTimestamp() : 0;
+
+            if (decode == NULL) {
+                S_LOGE("Unrecognized sensor: %d", buff.type);
+            } else if (dataEnd - data >= HUB_MAX_EVENTS_PER_RECORD) {
+                sensors_event_t* first = data;
+                data = (this->*decode)(buff, data, dataEnd);
+                if (mReplayStats) {
+                    mReplayStats->addEvents(first, data, getTimestamp() - recordStart);
+                }
             } else {
-                //index 0 is for counting invalid sensor type occurrences
-                mErrorCnt[0]++;
+                // Not enough room for every event the record may decode to,
+                // the ones which do not fit go to pendingEvents.
+                sensors_event_t overflow[HUB_MAX_EVENTS_PER_RECORD];
+                sensors_event_t* overflowEnd =
+                    (this->*decode)(buff, overflow, overflow + HUB_MAX_EVENTS_PER_RECORD);
+                if (mReplayStats) {
+                    mReplayStats->addEvents(overflow, overflowEnd, getTimestamp() - recordStart);
+                }
+                for (sensors_event_t* e = overflow; e < overflowEnd; e++) {
+                    if (!bufferFull()) {
+                        *data++ = *e;
+                    } else {
+                        pendingEvents.push_back(*e);
+                    }
+                }
             }
+        }
+        if (mReplayStats) {
+            mReplayStats->endRead(records);
+        }
+        mReadStats.records += records;
+        mReadStats.decodeNs += getTimestamp() - decodeStart;
+        if (records > mReadStats.maxBatch) {
+            mReadStats.maxBatch = records;
+        }
+        if (mReadStats.reads % HUB_READ_STATS_PERIOD == 0) {
+            logReadStats();
+        }
+    }
 
-            time(&timeutc.tv_sec);
+    if (mBatcher.isBatching()) {
+        data = batchEvents(decoded, data, dataEnd, pendingStart);
+    }
 
-            if ((sent_bug2go_sec == 0) ||
-                (timeutc.tv_sec - sent_bug2go_sec > 24*60*60)) {
-                // put timestamp in dropbox file
-                ptm = localtime(&(timeutc.tv_sec));
-                if (ptm != NULL) {
-                    strftime(timeBuf, sizeof(timeBuf), "%m-%d %H:%M:%S", ptm);
-                    capture_dump(timeBuf, buff.type, SENSORHUB_DUMPFILE,
-                    DROPBOX_FLAG_TEXT | DROPBOX_FLAG_GZIP);
-                }
-                sent_bug2go_sec = timeutc.tv_sec;
+    return data - d;
+}
+
+int HubSensors::readEvents(sensors_event_t* d, int dLen, int fd)
+{
+    if (fd < 0 || fd != mBatcher.getFd())
+        return readEvents(d, dLen);
+
+    sensors_event_t* data = d;
+    sensors_event_t const* const dataEnd = d + dLen;
+    // Released events must not overtake those already queued
+    bool queue = hasPendingEvents();
+
+    mBatcher.releaseExpired([&](const sensors_event_t& e) {
+        if (!queue && data < dataEnd) {
+            *data++ = e;
+        } else {
+            pendingEvents.push_back(e);
+            queue = true;
+        }
+    });
+    return data - d;
+}
+
+sensors_event_t* HubSensors::batchEvents(sensors_event_t* first, sensors_event_t* last,
+        sensors_event_t const* dataEnd, size_t pendingStart)
+{
+    // Events may be held back or released from earlier calls, so they can't
+    // be filtered in place.
+    mBatchScratch.assign(first, last);
+    mBatchScratch.insert(mBatchScratch.end(), pendingEvents.begin() + pendingStart,
+            pendingEvents.end());
+    pendingEvents.resize(pendingStart);
+
+    sensors_event_t* data = first;
+    for (const auto& ev : mBatchScratch) {
+        mBatcher.push(ev, [&](const sensors_event_t& e) {
+            if (data < dataEnd) {
+                *data++ = e;
+            } else {
+                pendingEvents.push_back(e);
             }
+        });
+    }
+    return data;
+}
+
+void HubSensors::logReadStats()
+{
+    S_LOGD("reads %" PRIu64 " records %" PRIu64 " (max %" PRIu64 " per read) decode %" PRIu64 " ns/record",
+           mReadStats.reads, mReadStats.records, mReadStats.maxBatch,
+           mReadStats.records ? mReadStats.decodeNs / mReadStats.records : 0);
+}
+
+void HubSensors::initDecoders()
+{
+    static const struct {
+        int type;
+        Decoder decode;
+    } decoders[] = {
+        { DT_PRESSURE, &HubSensors::decodeUnsupported },
+        { DT_TEMP, &HubSensors::decodeUnsupported },
+        { DT_DOCK, &HubSensors::decodeUnsupported },
+        { DT_NFC, &HubSensors::decodeUnsupported },
+        { DT_RESET, &HubSensors::decodeUnsupported },
+        { DT_FLUSH, &HubSensors::decodeFlush },
+        { DT_ACCEL, &HubSensors::decodeAccel },
+        { DT_GYRO, &HubSensors::decodeGyro },
+        { DT_UNCALIB_GYRO, &HubSensors::decodeUncalibGyro },
+        { DT_UNCALIB_MAG, &HubSensors::decodeUncalibMag },
+        { DT_QUAT_6AXIS, &HubSensors::decodeQuat6axis },
+        { DT_QUAT_9AXIS, &HubSensors::decodeQuat9axis },
+        { DT_GAME_RV, &HubSensors::decodeGameRv },
+#ifdef _ENABLE_PEDO
+        { DT_STEP_COUNTER, &HubSensors::decodeStepCounter },
+        { DT_STEP_DETECTOR, &HubSensors::decodeStepDetector },
+#endif
+        { DT_MAG, &HubSensors::decodeMag },
+        { DT_ORIENT, &HubSensors::decodeOrient },
+        { DT_ALS, &HubSensors::decodeAls },
+#ifdef _ENABLE_LA
+        { DT_LIN_ACCEL, &HubSensors::decodeLinAccel },
+#endif
+#ifdef _ENABLE_GR
+        { DT_GRAVITY, &HubSensors::decodeGravity },
+#endif
+        { DT_DISP_ROTATE, &HubSensors::decodeDispRotate },
+        { DT_PROX, &HubSensors::decodeProx },
+        { DT_FLAT_UP, &HubSensors::decodeFlatUp },
+        { DT_FLAT_DOWN, &HubSensors::decodeFlatDown },
+        { DT_STOWED, &HubSensors::decodeStowed },
+        { DT_CAMERA_ACT, &HubSensors::decodeCameraAct },
+#ifdef _ENABLE_IR
+        { DT_IR_GESTURE, &HubSensors::decodeIrGesture },
+        { DT_IR_RAW, &HubSensors::decodeIrRaw },
+        { DT_IR_OBJECT, &HubSensors::decodeIrObject },
+#endif
+        { DT_SIM, &HubSensors::decodeSim },
+#ifdef _ENABLE_CHOPCHOP
+        { DT_CHOPCHOP, &HubSensors::decodeChopchop },
+#endif
+#ifdef _ENABLE_LIFT
+        { DT_LIFT, &HubSensors::decodeLift },
+#endif
+        { DT_GLANCE, &HubSensors::decodeGlance },
+        { DT_GYRO_CAL, &HubSensors::decodeGyroCal },
+        { DT_ACCEL_CAL, &HubSensors::decodeAccelCal },
+        { DT_MOTO_MOD_CURRENT_DRAIN, &HubSensors::decodeMotoModCurrentDrain },
+        { DT_MOTION_DETECT, &HubSensors::decodeMotionDetect },
+        { DT_STATIONARY_DETECT, &HubSensors::decodeStationaryDetect },
+    };
+
+    memset(mDecoders, 0, sizeof(mDecoders));
+    for (const auto& entry : decoders) {
+        if (entry.type < 0 || entry.type >= HUB_DECODER_TABLE_SIZE) {
+            S_LOGE("Sensor type %d out of decoder table", entry.type);
             continue;
         }
+        mDecoders[entry.type] = entry.decode;
+    }
+}
+
+sensors_event_t* HubSensors::decodeUnsupported(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    char timeBuf[32];
+    struct tm* ptm = NULL;
+    struct timeval timeutc;
+
+    /* these sensors are not supported, upload a bug2go if its been at least 24hrs since previous bug2go*/
+    static long int sent_bug2go_sec = 0;
+
+    if (buff.type == DT_RESET) {
+        //reset reason should be between 1 and ERROR_TYPES
+        if (buff.data[0] >= 1 && buff.data[0] <= ERROR_TYPES)
+            mErrorCnt[buff.data[0]]++;
+    } else {
+        //index 0 is for counting invalid sensor type occurrences
+        mErrorCnt[0]++;
+    }
+
+    time(&timeutc.tv_sec);
+
+    if ((sent_bug2go_sec == 0) ||
+        (timeutc.tv_sec - sent_bug2go_sec > 24*60*60)) {
+        // put timestamp in dropbox file
+        ptm = localtime(&(timeutc.tv_sec));
+        if (ptm != NULL) {
+            strftime(timeBuf, sizeof(timeBuf), "%m-%d %H:%M:%S", ptm);
+            capture_dump(timeBuf, buff.type, SENSORHUB_DUMPFILE,
+            DROPBOX_FLAG_TEXT | DROPBOX_FLAG_GZIP);
+        }
+        sent_bug2go_sec = timeutc.tv_sec;
+    }
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeFlush(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    int32_t sensorId;
+
+    sensorId = STM32TOH(buff.data + FLUSH_FLUSH);
+    if( !mIdToSensor.count(sensorId) )
+        return data;
+    data->version = META_DATA_VERSION;
+    data->sensor = 0;
+    data->type = SENSOR_TYPE_META_DATA;
+    data->reserved0 = 0;
+    data->timestamp = 0;
+    data->meta_data.what = META_DATA_FLUSH_COMPLETE;
+    data->meta_data.sensor = sensorId;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeAccel(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_A;
+    data->type = SENSOR_TYPE_ACCELEROMETER;
+    data->acceleration.x = STM16TOH(buff.data+ACCEL_X) * CONVERT_A_X;
+    data->acceleration.y = STM16TOH(buff.data+ACCEL_Y) * CONVERT_A_Y;
+    data->acceleration.z = STM16TOH(buff.data+ACCEL_Z) * CONVERT_A_Z;
+    data->acceleration.status = SENSOR_STATUS_ACCURACY_HIGH;
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeGyro(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_G;
+    data->type = SENSOR_TYPE_GYROSCOPE;
+    data->gyro.x = STM16TOH(buff.data + GYRO_X) * CONVERT_G_P;
+    data->gyro.y = STM16TOH(buff.data + GYRO_Y) * CONVERT_G_R;
+    data->gyro.z = STM16TOH(buff.data + GYRO_Z) * CONVERT_G_Y;
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeUncalibGyro(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_UNCALIB_GYRO;
+    data->type = SENSOR_TYPE_GYROSCOPE_UNCALIBRATED;
+    data->uncalibrated_gyro.x_uncalib = STM16TOH(buff.data + UNCALIB_GYRO_X) * CONVERT_G_P;
+    data->uncalibrated_gyro.y_uncalib = STM16TOH(buff.data + UNCALIB_GYRO_Y) * CONVERT_G_R;
+    data->uncalibrated_gyro.z_uncalib = STM16TOH(buff.data + UNCALIB_GYRO_Z) * CONVERT_G_Y;
+    data->uncalibrated_gyro.x_bias = STM16TOH(buff.data + UNCALIB_GYRO_X_BIAS) * CONVERT_BIAS_G_P;
+    data->uncalibrated_gyro.y_bias = STM16TOH(buff.data + UNCALIB_GYRO_Y_BIAS) * CONVERT_BIAS_G_R;
+    data->uncalibrated_gyro.z_bias = STM16TOH(buff.data + UNCALIB_GYRO_Z_BIAS) * CONVERT_BIAS_G_Y;
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeUncalibMag(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_UNCALIB_MAG;
+    data->type = SENSOR_TYPE_MAGNETIC_FIELD_UNCALIBRATED;
+    data->uncalibrated_magnetic.x_uncalib = STM16TOH(buff.data + UNCALIB_MAGNETIC_X) * CONVERT_M_X;
+    data->uncalibrated_magnetic.y_uncalib = STM16TOH(buff.data + UNCALIB_MAGNETIC_Y) * CONVERT_M_Y;
+    data->uncalibrated_magnetic.z_uncalib = STM16TOH(buff.data + UNCALIB_MAGNETIC_Z) * CONVERT_M_Z;
+    data->uncalibrated_magnetic.x_bias = STM16TOH(buff.data + UNCALIB_MAGNETIC_X_BIAS) * CONVERT_BIAS_M_X;
+    data->uncalibrated_magnetic.y_bias = STM16TOH(buff.data + UNCALIB_MAGNETIC_Y_BIAS) * CONVERT_BIAS_M_Y;
+    data->uncalibrated_magnetic.z_bias = STM16TOH(buff.data + UNCALIB_MAGNETIC_Z_BIAS) * CONVERT_BIAS_M_Z;
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeQuat6axis(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_QUAT_6AXIS;
+    data->type = SENSOR_TYPE_GEOMAGNETIC_ROTATION_VECTOR;
+    data->data[0] = STM16TOH(buff.data + QUAT_6AXIS_A) * CONVERT_RV;
+    data->data[1] = STM16TOH(buff.data + QUAT_6AXIS_B) * CONVERT_RV;
+    data->data[2] = STM16TOH(buff.data + QUAT_6AXIS_C) * CONVERT_RV;
+    data->data[3] = STM16TOH(buff.data + QUAT_6AXIS_W) * CONVERT_RV;
+    data->data[4] = 5.f * (3.14159f/180.f); // 5 degrees accuracy?
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeQuat9axis(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor = SENSORS_HANDLE_BASE + ID_QUAT_9AXIS;
+    data->type = SENSOR_TYPE_ROTATION_VECTOR;
+    data->data[0] = STM16TOH(buff.data + QUAT_9AXIS_A) * CONVERT_RV;
+    data->data[1] = STM16TOH(buff.data + QUAT_9AXIS_B) * CONVERT_RV;
+    data->data[2] = STM16TOH(buff.data + QUAT_9AXIS_C) * CONVERT_RV;
+    data->data[3] = STM16TOH(buff.data + QUAT_9AXIS_W) * CONVERT_RV;
+    data->data[4] = 5.f * (3.14159f/180.f); // 5 degrees accuracy?
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeGameRv(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor = SENSORS_HANDLE_BASE + ID_GAME_RV;
+    data->type = SENSOR_TYPE_GAME_ROTATION_VECTOR;
+    data->data[0] = STM16TOH(buff.data + GAME_RV_A) * CONVERT_RV;
+    data->data[1] = STM16TOH(buff.data + GAME_RV_B) * CONVERT_RV;
+    data->data[2] = STM16TOH(buff.data + GAME_RV_C) * CONVERT_RV;
+    data->data[3] = STM16TOH(buff.data + GAME_RV_W) * CONVERT_RV;
+    data->data[4] = 5.f * (3.14159f/180.f); // 5 degrees accuracy?
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
 
-        switch (buff.type) {
-            case DT_FLUSH:
-                sensorId = STM32TOH(buff.data + FLUSH_FLUSH);
-                if( !mIdToSensor.count(sensorId) )
-                    break;
-                data->version = META_DATA_VERSION;
-                data->sensor = 0;
-                data->type = SENSOR_TYPE_META_DATA;
-                data->reserved0 = 0;
-                data->timestamp = 0;
-                data->meta_data.what = META_DATA_FLUSH_COMPLETE;
-                data->meta_data.sensor = sensorId;
-                data++;
-                break;
-            case DT_ACCEL:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_A;
-                data->type = SENSOR_TYPE_ACCELEROMETER;
-                data->acceleration.x = STM16TOH(buff.data+ACCEL_X) * CONVERT_A_X;
-                data->acceleration.y = STM16TOH(buff.data+ACCEL_Y) * CONVERT_A_Y;
-                data->acceleration.z = STM16TOH(buff.data+ACCEL_Z) * CONVERT_A_Z;
-                data->acceleration.status = SENSOR_STATUS_ACCURACY_HIGH;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_GYRO:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_G;
-                data->type = SENSOR_TYPE_GYROSCOPE;
-                data->gyro.x = STM16TOH(buff.data + GYRO_X) * CONVERT_G_P;
-                data->gyro.y = STM16TOH(buff.data + GYRO_Y) * CONVERT_G_R;
-                data->gyro.z = STM16TOH(buff.data + GYRO_Z) * CONVERT_G_Y;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_UNCALIB_GYRO:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_UNCALIB_GYRO;
-                data->type = SENSOR_TYPE_GYROSCOPE_UNCALIBRATED;
-                data->uncalibrated_gyro.x_uncalib = STM16TOH(buff.data + UNCALIB_GYRO_X) * CONVERT_G_P;
-                data->uncalibrated_gyro.y_uncalib = STM16TOH(buff.data + UNCALIB_GYRO_Y) * CONVERT_G_R;
-                data->uncalibrated_gyro.z_uncalib = STM16TOH(buff.data + UNCALIB_GYRO_Z) * CONVERT_G_Y;
-                data->uncalibrated_gyro.x_bias = STM16TOH(buff.data + UNCALIB_GYRO_X_BIAS) * CONVERT_BIAS_G_P;
-                data->uncalibrated_gyro.y_bias = STM16TOH(buff.data + UNCALIB_GYRO_Y_BIAS) * CONVERT_BIAS_G_R;
-                data->uncalibrated_gyro.z_bias = STM16TOH(buff.data + UNCALIB_GYRO_Z_BIAS) * CONVERT_BIAS_G_Y;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_UNCALIB_MAG:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_UNCALIB_MAG;
-                data->type = SENSOR_TYPE_MAGNETIC_FIELD_UNCALIBRATED;
-                data->uncalibrated_magnetic.x_uncalib = STM16TOH(buff.data + UNCALIB_MAGNETIC_X) * CONVERT_M_X;
-                data->uncalibrated_magnetic.y_uncalib = STM16TOH(buff.data + UNCALIB_MAGNETIC_Y) * CONVERT_M_Y;
-                data->uncalibrated_magnetic.z_uncalib = STM16TOH(buff.data + UNCALIB_MAGNETIC_Z) * CONVERT_M_Z;
-                data->uncalibrated_magnetic.x_bias = STM16TOH(buff.data + UNCALIB_MAGNETIC_X_BIAS) * CONVERT_BIAS_M_X;
-                data->uncalibrated_magnetic.y_bias = STM16TOH(buff.data + UNCALIB_MAGNETIC_Y_BIAS) * CONVERT_BIAS_M_Y;
-                data->uncalibrated_magnetic.z_bias = STM16TOH(buff.data + UNCALIB_MAGNETIC_Z_BIAS) * CONVERT_BIAS_M_Z;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_QUAT_6AXIS:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_QUAT_6AXIS;
-                data->type = SENSOR_TYPE_GEOMAGNETIC_ROTATION_VECTOR;
-                data->data[0] = STM16TOH(buff.data + QUAT_6AXIS_A) * CONVERT_RV;
-                data->data[1] = STM16TOH(buff.data + QUAT_6AXIS_B) * CONVERT_RV;
-                data->data[2] = STM16TOH(buff.data + QUAT_6AXIS_C) * CONVERT_RV;
-                data->data[3] = STM16TOH(buff.data + QUAT_6AXIS_W) * CONVERT_RV;
-                data->data[4] = 5.f * (3.14159f/180.f); // 5 degrees accuracy?
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_QUAT_9AXIS:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor = SENSORS_HANDLE_BASE + ID_QUAT_9AXIS;
-                data->type = SENSOR_TYPE_ROTATION_VECTOR;
-                data->data[0] = STM16TOH(buff.data + QUAT_9AXIS_A) * CONVERT_RV;
-                data->data[1] = STM16TOH(buff.data + QUAT_9AXIS_B) * CONVERT_RV;
-                data->data[2] = STM16TOH(buff.data + QUAT_9AXIS_C) * CONVERT_RV;
-                data->data[3] = STM16TOH(buff.data + QUAT_9AXIS_W) * CONVERT_RV;
-                data->data[4] = 5.f * (3.14159f/180.f); // 5 degrees accuracy?
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_GAME_RV:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor = SENSORS_HANDLE_BASE + ID_GAME_RV;
-                data->type = SENSOR_TYPE_GAME_ROTATION_VECTOR;
-                data->data[0] = STM16TOH(buff.data + GAME_RV_A) * CONVERT_RV;
-                data->data[1] = STM16TOH(buff.data + GAME_RV_B) * CONVERT_RV;
-                data->data[2] = STM16TOH(buff.data + GAME_RV_C) * CONVERT_RV;
-                data->data[3] = STM16TOH(buff.data + GAME_RV_W) * CONVERT_RV;
-                data->data[4] = 5.f * (3.14159f/180.f); // 5 degrees accuracy?
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
 #ifdef _ENABLE_PEDO
-            case DT_STEP_COUNTER:
-            {
-                static uint32_t last_stepcount;
-                static uint32_t step_offset;
-                uint32_t stepcount;
-
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_STEP_COUNTER;
-                data->type = SENSOR_TYPE_STEP_COUNTER;
-                /* data from sensors sent as 4 bytes. Thats plenty of steps */
-                stepcount = (buff.data[0] << 24 |
-                             buff.data[1] << 16 |
-                             buff.data[2] << 8  |
-                             buff.data[3]);
-                if(stepcount + step_offset < last_stepcount)
-                {
-                    /* hub reset, determine offset and apply, so users
-                       only see contiguous steps */
-                    step_offset = last_stepcount;
-                    ALOGD("Saving %d footsteps", step_offset);
-                }
-                last_stepcount = stepcount + step_offset;
+sensors_event_t* HubSensors::decodeStepCounter(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    static uint32_t last_stepcount;
+    static uint32_t step_offset;
+    uint32_t stepcount;
+
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_STEP_COUNTER;
+    data->type = SENSOR_TYPE_STEP_COUNTER;
+    /* data from sensors sent as 4 bytes. Thats plenty of steps */
+    stepcount = (buff.data[0] << 24 |
+                 buff.data[1] << 16 |
+                 buff.data[2] << 8  |
+                 buff.data[3]);
+    if(stepcount + step_offset < last_stepcount)
+    {
+        /* hub reset, determine offset and apply, so users
+           only see contiguous steps */
+        step_offset = last_stepcount;
+        ALOGD("Saving %d footsteps", step_offset);
+    }
+    last_stepcount = stepcount + step_offset;
 
-                data->u64.step_counter = (uint64_t)(last_stepcount);
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            }
-            case DT_STEP_DETECTOR:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_STEP_DETECTOR;
-                data->type = SENSOR_TYPE_STEP_DETECTOR;
-                data->data[0] = (uint16_t)buff.data[0];
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
+    data->u64.step_counter = (uint64_t)(last_stepcount);
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeStepDetector(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_STEP_DETECTOR;
+    data->type = SENSOR_TYPE_STEP_DETECTOR;
+    data->data[0] = (uint16_t)buff.data[0];
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
 #endif
-            case DT_PRESSURE:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_PR;
-                data->type = SENSOR_TYPE_PRESSURE;
-                data->pressure = STM32TOH(buff.data + PRESSURE_PRESSURE) * CONVERT_B;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_MAG:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_M;
-                data->type = SENSOR_TYPE_MAGNETIC_FIELD;
-                data->magnetic.x = STM16TOH(buff.data + MAGNETIC_X) * CONVERT_M_X;
-                data->magnetic.y = STM16TOH(buff.data + MAGNETIC_Y) * CONVERT_M_Y;
-                data->magnetic.z = STM16TOH(buff.data + MAGNETIC_Z) * CONVERT_M_Z;
-                data->magnetic.status = buff.status;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_ORIENT:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_O;
-                data->type = SENSOR_TYPE_ORIENTATION;
-                data->orientation.azimuth = STM16TOH(buff.data + ORIENTATION_AZIMUTH) * CONVERT_O_Y;
-                data->orientation.pitch = STM16TOH(buff.data + ORIENTATION_PITCH) * CONVERT_O_P;
-                // Roll value should not be negated.
-                data->orientation.roll = STM16TOH(buff.data + ORIENTATION_ROLL) * CONVERT_O_R;
-                data->orientation.status = buff.status;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_TEMP:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_T;
-                data->type = SENSOR_TYPE_TEMPERATURE;
-                data->temperature = STM16TOH(buff.data + TEMPERATURE_TEMPERATURE) * CONVERT_T;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_ALS:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_L;
-                data->type = SENSOR_TYPE_LIGHT;
-                data->light = (uint16_t)STM16TOH(buff.data + LIGHT_LIGHT);
-                data->timestamp = buff.timestamp;
-                logAlsEvent(data->light, data->timestamp);
-                data++;
-                break;
+
+sensors_event_t* HubSensors::decodeMag(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_M;
+    data->type = SENSOR_TYPE_MAGNETIC_FIELD;
+    data->magnetic.x = STM16TOH(buff.data + MAGNETIC_X) * CONVERT_M_X;
+    data->magnetic.y = STM16TOH(buff.data + MAGNETIC_Y) * CONVERT_M_Y;
+    data->magnetic.z = STM16TOH(buff.data + MAGNETIC_Z) * CONVERT_M_Z;
+    data->magnetic.status = buff.status;
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeOrient(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_O;
+    data->type = SENSOR_TYPE_ORIENTATION;
+    data->orientation.azimuth = STM16TOH(buff.data + ORIENTATION_AZIMUTH) * CONVERT_O_Y;
+    data->orientation.pitch = STM16TOH(buff.data + ORIENTATION_PITCH) * CONVERT_O_P;
+    // Roll value should not be negated.
+    data->orientation.roll = STM16TOH(buff.data + ORIENTATION_ROLL) * CONVERT_O_R;
+    data->orientation.status = buff.status;
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeAls(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_L;
+    data->type = SENSOR_TYPE_LIGHT;
+    data->light = (uint16_t)STM16TOH(buff.data + LIGHT_LIGHT);
+    data->timestamp = buff.timestamp;
+    logAlsEvent(data->light, data->timestamp);
+    data++;
+    return data;
+}
+
 #ifdef _ENABLE_LA
-            case DT_LIN_ACCEL:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_LA;
-                data->type = SENSOR_TYPE_LINEAR_ACCELERATION;
-                data->acceleration.x = STM16TOH(buff.data + ACCEL_X) * CONVERT_A_LIN;
-                data->acceleration.y = STM16TOH(buff.data + ACCEL_Y) * CONVERT_A_LIN;
-                data->acceleration.z = STM16TOH(buff.data + ACCEL_Z) * CONVERT_A_LIN;
-                data->acceleration.status = SENSOR_STATUS_ACCURACY_HIGH;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
+sensors_event_t* HubSensors::decodeLinAccel(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_LA;
+    data->type = SENSOR_TYPE_LINEAR_ACCELERATION;
+    data->acceleration.x = STM16TOH(buff.data + ACCEL_X) * CONVERT_A_LIN;
+    data->acceleration.y = STM16TOH(buff.data + ACCEL_Y) * CONVERT_A_LIN;
+    data->acceleration.z = STM16TOH(buff.data + ACCEL_Z) * CONVERT_A_LIN;
+    data->acceleration.status = SENSOR_STATUS_ACCURACY_HIGH;
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
 #endif
+
 #ifdef _ENABLE_GR
-            case DT_GRAVITY:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_GRAVITY;
-                data->type = SENSOR_TYPE_GRAVITY;
-                data->acceleration.x = STM16TOH(buff.data + GRAVITY_X) * CONVERT_GRAVITY;
-                data->acceleration.y = STM16TOH(buff.data + GRAVITY_Y) * CONVERT_GRAVITY;
-                data->acceleration.z = STM16TOH(buff.data + GRAVITY_Z) * CONVERT_GRAVITY;
-                data->acceleration.status = SENSOR_STATUS_ACCURACY_HIGH;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
+sensors_event_t* HubSensors::decodeGravity(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_GRAVITY;
+    data->type = SENSOR_TYPE_GRAVITY;
+    data->acceleration.x = STM16TOH(buff.data + GRAVITY_X) * CONVERT_GRAVITY;
+    data->acceleration.y = STM16TOH(buff.data + GRAVITY_Y) * CONVERT_GRAVITY;
+    data->acceleration.z = STM16TOH(buff.data + GRAVITY_Z) * CONVERT_GRAVITY;
+    data->acceleration.status = SENSOR_STATUS_ACCURACY_HIGH;
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
 #endif
-            case DT_DISP_ROTATE:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor = SENSORS_HANDLE_BASE + ID_DR;
-                data->type = SENSOR_TYPE_DISPLAY_ROTATE;
-                if (buff.data[ROTATE_ROTATE] == DISP_FLAT)
-                    data->data[0] = DISP_UNKNOWN;
-                else
-                    data->data[0] = buff.data[ROTATE_ROTATE];
-
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_PROX:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_P;
-                data->type = SENSOR_TYPE_PROXIMITY;
-                if (buff.data[PROXIMITY_PROXIMITY] == 0) {
-                    data->distance = PROX_UNCOVERED;
-                    ALOGI("Proximity uncovered");
-                } else if (buff.data[PROXIMITY_PROXIMITY] == 1) {
-                    data->distance = PROX_COVERED;
-                    ALOGI("Proximity covered");
-                } else {
-                    data->distance = PROX_SATURATED;
-                    ALOGI("Proximity covered saturated");
-                }
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_FLAT_UP:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_FU;
-                data->type = SENSOR_TYPE_FLAT_UP;
-                if (buff.data[FLAT_FLAT] == 0x01)
-                    data->data[0] = FLAT_DETECTED;
-                else
-                    data->data[0] = FLAT_NOTDETECTED;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_FLAT_DOWN:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_FD;
-                data->type = SENSOR_TYPE_FLAT_DOWN;
-                if (buff.data[FLAT_FLAT] == 0x02)
-                    data->data[0] = FLAT_DETECTED;
-                else
-                    data->data[0] = FLAT_NOTDETECTED;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_STOWED:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_S;
-                data->type = SENSOR_TYPE_STOWED;
-                data->data[0] = buff.data[STOWED_STOWED];
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_CAMERA_ACT:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_CA;
-                data->type = SENSOR_TYPE_CAMERA_ACTIVATE;
-                data->data[0] = MOTOSH_CAMERA_DATA;
-                data->data[1] = STM16TOH(buff.data + CAMERA_CAMERA);
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
+
+sensors_event_t* HubSensors::decodeDispRotate(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor = SENSORS_HANDLE_BASE + ID_DR;
+    data->type = SENSOR_TYPE_DISPLAY_ROTATE;
+    if (buff.data[ROTATE_ROTATE] == DISP_FLAT)
+        data->data[0] = DISP_UNKNOWN;
+    else
+        data->data[0] = buff.data[ROTATE_ROTATE];
+
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeProx(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_P;
+    data->type = SENSOR_TYPE_PROXIMITY;
+    if (buff.data[PROXIMITY_PROXIMITY] == 0) {
+        data->distance = PROX_UNCOVERED;
+        ALOGI("Proximity uncovered");
+    } else if (buff.data[PROXIMITY_PROXIMITY] == 1) {
+        data->distance = PROX_COVERED;
+        ALOGI("Proximity covered");
+    } else {
+        data->distance = PROX_SATURATED;
+        ALOGI("Proximity covered saturated");
+    }
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeFlatUp(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_FU;
+    data->type = SENSOR_TYPE_FLAT_UP;
+    if (buff.data[FLAT_FLAT] == 0x01)
+        data->data[0] = FLAT_DETECTED;
+    else
+        data->data[0] = FLAT_NOTDETECTED;
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeFlatDown(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_FD;
+    data->type = SENSOR_TYPE_FLAT_DOWN;
+    if (buff.data[FLAT_FLAT] == 0x02)
+        data->data[0] = FLAT_DETECTED;
+    else
+        data->data[0] = FLAT_NOTDETECTED;
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeStowed(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_S;
+    data->type = SENSOR_TYPE_STOWED;
+    data->data[0] = buff.data[STOWED_STOWED];
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeCameraAct(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_CA;
+    data->type = SENSOR_TYPE_CAMERA_ACTIVATE;
+    data->data[0] = MOTOSH_CAMERA_DATA;
+    data->data[1] = STM16TOH(buff.data + CAMERA_CAMERA);
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
 #ifdef _ENABLE_IR
-            case DT_IR_GESTURE:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_IR_GESTURE;
-                data->type = SENSOR_TYPE_IR_GESTURE;
-                data->ir_gesture.event_id = buff.data[IR_EVENT];
-                data->ir_gesture.gesture_id = buff.data[IR_GESTURE];
-                data->ir_gesture.direction = buff.data[IR_DIRECTION] & 0x0F;
-                data->ir_gesture.magnitude = buff.data[IR_MAGNITUDE] >> 4;
-                data->ir_gesture.motion = buff.data[IR_MOTION];
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_IR_RAW:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_IR_RAW;
-                data->type = SENSOR_TYPE_IR_RAW;
-                data->ir_raw.top_right_high = STM16TOH(buff.data + IR_TR_H);
-                data->ir_raw.bottom_left_high = STM16TOH(buff.data + IR_BL_H);
-                data->ir_raw.bottom_right_high = STM16TOH(buff.data + IR_BR_H);
-                data->ir_raw.bottom_both_high = STM16TOH(buff.data + IR_BB_H);
-                data->ir_raw.top_right_low = STM16TOH(buff.data + IR_TR_L);
-                data->ir_raw.bottom_left_low = STM16TOH(buff.data + IR_BL_L);
-                data->ir_raw.bottom_right_low = STM16TOH(buff.data + IR_BR_L);
-                data->ir_raw.bottom_both_low = STM16TOH(buff.data + IR_BB_L);
-                data->ir_raw.ambient_high = STM16TOH(buff.data + IR_AMBIENT_H);
-                data->ir_raw.ambient_low = STM16TOH(buff.data + IR_AMBIENT_L);
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_IR_OBJECT:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_IR_OBJECT;
-                data->type = SENSOR_TYPE_IR_OBJECT;
-                data->data[0] = (*(buff.data + IR_OBJ) >> IR_OBJ_SHIFT) & 0x01;
-                data->timestamp = buff.timestamp;
-                data++;
-                setEnable(ID_IR_OBJECT, 0); /* One-shot sensor. Disable now */
-                break;
-#endif /* _ENABLE_IR */
-            case DT_SIM:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_SIM;
-                data->type = SENSOR_TYPE_SIGNIFICANT_MOTION;
-                data->data[0] = 1;
-                data->timestamp = buff.timestamp;
-                data++;
-                setEnable(ID_SIM, 0);
-                break;
+sensors_event_t* HubSensors::decodeIrGesture(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_IR_GESTURE;
+    data->type = SENSOR_TYPE_IR_GESTURE;
+    data->ir_gesture.event_id = buff.data[IR_EVENT];
+    data->ir_gesture.gesture_id = buff.data[IR_GESTURE];
+    data->ir_gesture.direction = buff.data[IR_DIRECTION] & 0x0F;
+    data->ir_gesture.magnitude = buff.data[IR_MAGNITUDE] >> 4;
+    data->ir_gesture.motion = buff.data[IR_MOTION];
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeIrRaw(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_IR_RAW;
+    data->type = SENSOR_TYPE_IR_RAW;
+    data->ir_raw.top_right_high = STM16TOH(buff.data + IR_TR_H);
+    data->ir_raw.bottom_left_high = STM16TOH(buff.data + IR_BL_H);
+    data->ir_raw.bottom_right_high = STM16TOH(buff.data + IR_BR_H);
+    data->ir_raw.bottom_both_high = STM16TOH(buff.data + IR_BB_H);
+    data->ir_raw.top_right_low = STM16TOH(buff.data + IR_TR_L);
+    data->ir_raw.bottom_left_low = STM16TOH(buff.data + IR_BL_L);
+    data->ir_raw.bottom_right_low = STM16TOH(buff.data + IR_BR_L);
+    data->ir_raw.bottom_both_low = STM16TOH(buff.data + IR_BB_L);
+    data->ir_raw.ambient_high = STM16TOH(buff.data + IR_AMBIENT_H);
+    data->ir_raw.ambient_low = STM16TOH(buff.data + IR_AMBIENT_L);
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeIrObject(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_IR_OBJECT;
+    data->type = SENSOR_TYPE_IR_OBJECT;
+    data->data[0] = (*(buff.data + IR_OBJ) >> IR_OBJ_SHIFT) & 0x01;
+    data->timestamp = buff.timestamp;
+    data++;
+    setEnable(ID_IR_OBJECT, 0); /* One-shot sensor. Disable now */
+    return data;
+}
+#endif
+
+sensors_event_t* HubSensors::decodeSim(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_SIM;
+    data->type = SENSOR_TYPE_SIGNIFICANT_MOTION;
+    data->data[0] = 1;
+    data->timestamp = buff.timestamp;
+    data++;
+    setEnable(ID_SIM, 0);
+    return data;
+}
+
 #ifdef _ENABLE_CHOPCHOP
-            case DT_CHOPCHOP:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_CHOPCHOP_GESTURE;
-                data->type = SENSOR_TYPE_CHOPCHOP_GESTURE;
-                data->data[0] = STM16TOH(buff.data + CHOPCHOP_CHOPCHOP);
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
+sensors_event_t* HubSensors::decodeChopchop(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_CHOPCHOP_GESTURE;
+    data->type = SENSOR_TYPE_CHOPCHOP_GESTURE;
+    data->data[0] = STM16TOH(buff.data + CHOPCHOP_CHOPCHOP);
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
 #endif
+
 #ifdef _ENABLE_LIFT
-            case DT_LIFT:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_LIFT_GESTURE;
-                data->type = SENSOR_TYPE_LIFT_GESTURE;
-                data->data[0] = STM32TOH(buff.data + LIFT_DISTANCE);
-                data->data[1] = STM32TOH(buff.data + LIFT_ROTATION);
-                data->data[2] = STM32TOH(buff.data + LIFT_GRAV_DIFF);
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
+sensors_event_t* HubSensors::decodeLift(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_LIFT_GESTURE;
+    data->type = SENSOR_TYPE_LIFT_GESTURE;
+    data->data[0] = STM32TOH(buff.data + LIFT_DISTANCE);
+    data->data[1] = STM32TOH(buff.data + LIFT_ROTATION);
+    data->data[2] = STM32TOH(buff.data + LIFT_GRAV_DIFF);
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
 #endif
-            case DT_GLANCE:
-                if (isHandleEnabled(ID_MOTO_GLANCE_GESTURE)) {
-                    data->version = SENSORS_EVENT_T_SIZE;
-                    data->sensor = ID_MOTO_GLANCE_GESTURE;
-                    data->type = SENSOR_TYPE_MOTO_GLANCE_GESTURE;
-                    data->data[0] = STM16TOH(buff.data); /* Gesture that triggered glance */
-                    data->data[1] = 0;
-                    data->data[2] = 0;
-                    data->timestamp = buff.timestamp;
-                    data++;
-
-                    /* Disable, because this is a one shot sensor */
-                    setEnable(ID_MOTO_GLANCE_GESTURE, 0);
-                }
 
-                if (isHandleEnabled(ID_GLANCE_GESTURE)) {
-                    sensors_event_t* dest;
-                    if (!bufferFull()) {
-                        dest = data;
-                    } else {
-                        pendingEvents.emplace_back(sensors_event_t());
-                        dest = &pendingEvents.back();
-                    }
-                    dest->version = SENSORS_EVENT_T_SIZE;
-                    dest->sensor = ID_GLANCE_GESTURE;
-                    dest->type = SENSOR_TYPE_GLANCE_GESTURE;
-                    dest->data[0] = 1.0;                   /* set to 1 for Android compatibility */
-                    dest->data[1] = STM16TOH(buff.data);   /* Currently blocked by Android FW */
-                    dest->data[2] = 0;
-                    dest->timestamp = buff.timestamp;
-
-                    if (dest == data) {
-                        data++;
-                    } else {
-                        // Data was placed in the pendingEvents queue. No need to do anything.
-                    }
+sensors_event_t* HubSensors::decodeGlance(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* dataEnd)
+{
+    if (isHandleEnabled(ID_MOTO_GLANCE_GESTURE)) {
+        data->version = SENSORS_EVENT_T_SIZE;
+        data->sensor = ID_MOTO_GLANCE_GESTURE;
+        data->type = SENSOR_TYPE_MOTO_GLANCE_GESTURE;
+        data->data[0] = STM16TOH(buff.data); /* Gesture that triggered glance */
+        data->data[1] = 0;
+        data->data[2] = 0;
+        data->timestamp = buff.timestamp;
+        data++;
+
+        /* Disable, because this is a one shot sensor */
+        setEnable(ID_MOTO_GLANCE_GESTURE, 0);
+    }
 
-                    /* Disable, because this is a one shot sensor */
-                    setEnable(ID_GLANCE_GESTURE, 0);
-                }
+    if (isHandleEnabled(ID_GLANCE_GESTURE)) {
+        sensors_event_t* dest;
+        if (data < dataEnd) {
+            dest = data;
+        } else {
+            pendingEvents.emplace_back(sensors_event_t());
+            dest = &pendingEvents.back();
+        }
+        dest->version = SENSORS_EVENT_T_SIZE;
+        dest->sensor = ID_GLANCE_GESTURE;
+        dest->type = SENSOR_TYPE_GLANCE_GESTURE;
+        dest->data[0] = 1.0;                   /* set to 1 for Android compatibility */
+        dest->data[1] = STM16TOH(buff.data);   /* Currently blocked by Android FW */
+        dest->data[2] = 0;
+        dest->timestamp = buff.timestamp;
+
+        if (dest == data) {
+            data++;
+        } else {
+            // Data was placed in the pendingEvents queue. No need to do anything.
+        }
 
-                break;
-            case DT_GYRO_CAL:
-                ret = motosh_ioctl(dev_fd, MOTOSH_IOCTL_GET_GYRO_CAL, mGyroCal);
-                if (ret < 0) {
-                    ALOGE("Can't read Gyro Cal data");
-                } else {
-                    if ((fp = fopen(GYRO_CAL_FILE, "w")) == NULL) {
-                        ALOGE("Can't open Gyro Cal file");
-                    } else {
-                        for (size=0; size<MOTOSH_GYRO_CAL_SIZE; size++) {
-                            fputc(mGyroCal[size], fp);
-                        }
-                        fclose(fp);
-                    }
-                }
-                break;
-            case DT_ACCEL_CAL:
-                ret = ioctl(dev_fd, MOTOSH_IOCTL_GET_ACCEL_CAL, mAccelCal);
-                if (ret < 0) {
-                    ALOGE("Can't read Accel Cal data");
-                } else {
-                    if ((fp = fopen(ACCEL_CAL_FILE, "w")) == NULL) {
-                        ALOGE("Can't open Accel Cal file");
-                    } else {
-                        size = fwrite(mAccelCal, 1, MOTOSH_ACCEL_CAL_SIZE, fp);
-                        fclose(fp);
-                        if (size != MOTOSH_ACCEL_CAL_SIZE)
-                            ALOGE("Error writing Accel Cal file");
-                    }
-                }
-                break;
-            case DT_MOTO_MOD_CURRENT_DRAIN:
-            {
-                static uint32_t last_mAH;
-                static uint32_t mAH_offset;
-                uint32_t mAH;
-
-                memset(data, 0, sizeof(*data));
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor = SENSORS_HANDLE_BASE + ID_MOTO_MOD_CURRENT_DRAIN;
-                data->type = SENSOR_TYPE_MOTO_MOD_CURRENT_DRAIN;
-
-                mAH = STMU32TOH(buff.data);
-
-                if(mAH + mAH_offset < last_mAH)
-                {
-                    /* hub reset, determine offset and apply, so users
-                       only see contiguous mAH */
-                    mAH_offset = last_mAH;
-                    ALOGD("Saving %d mAH offset", mAH_offset);
-                }
-                last_mAH = mAH + mAH_offset;
+        /* Disable, because this is a one shot sensor */
+        setEnable(ID_GLANCE_GESTURE, 0);
+    }
 
-                data->data[0] = last_mAH;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeGyroCal(const struct motosh_android_sensor_data& /* buff */,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    int ret;
+    FILE *fp;
+    int size;
+
+    ret = hubIoctl(MOTOSH_IOCTL_GET_GYRO_CAL, mGyroCal);
+    if (ret < 0) {
+        ALOGE("Can't read Gyro Cal data");
+    } else {
+        if ((fp = fopen(GYRO_CAL_FILE, "w")) == NULL) {
+            ALOGE("Can't open Gyro Cal file");
+        } else {
+            for (size=0; size<MOTOSH_GYRO_CAL_SIZE; size++) {
+                fputc(mGyroCal[size], fp);
             }
-            case DT_MOTION_DETECT:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_MOTION_DETECT;
-                data->type = SENSOR_TYPE_MOTION_DETECT;
-                data->data[0] = 1.0;
-                data->timestamp = buff.timestamp;
-                data++;
-                /* Disable, because this is a one shot sensor */
-                setEnable(ID_MOTION_DETECT, 0);
-                break;
-            case DT_STATIONARY_DETECT:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_STATIONARY_DETECT;
-                data->type = SENSOR_TYPE_STATIONARY_DETECT;
-                data->data[0] = 1.0;
-		data->timestamp = buff.timestamp;
-                data++;
-                /* Disable, because this is a one shot sensor */
-                setEnable(ID_STATIONARY_DETECT, 0);
-                break;
-            default:
-                S_LOGE("Unrecognized sensor: %d", buff.type);
-                break;
+            fclose(fp);
         }
     }
+    return data;
+}
 
-    return data - d;
+sensors_event_t* HubSensors::decodeAccelCal(const struct motosh_android_sensor_data& /* buff */,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    int ret;
+    FILE *fp;
+    int size;
+
+    ret = hubIoctl(MOTOSH_IOCTL_GET_ACCEL_CAL, mAccelCal);
+    if (ret < 0) {
+        ALOGE("Can't read Accel Cal data");
+    } else {
+        if ((fp = fopen(ACCEL_CAL_FILE, "w")) == NULL) {
+            ALOGE("Can't open Accel Cal file");
+        } else {
+            size = fwrite(mAccelCal, 1, MOTOSH_ACCEL_CAL_SIZE, fp);
+            fclose(fp);
+            if (size != MOTOSH_ACCEL_CAL_SIZE)
+                ALOGE("Error writing Accel Cal file");
+        }
+    }
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeMotoModCurrentDrain(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    static uint32_t last_mAH;
+    static uint32_t mAH_offset;
+    uint32_t mAH;
+
+    memset(data, 0, sizeof(*data));
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor = SENSORS_HANDLE_BASE + ID_MOTO_MOD_CURRENT_DRAIN;
+    data->type = SENSOR_TYPE_MOTO_MOD_CURRENT_DRAIN;
+
+    mAH = STMU32TOH(buff.data);
+
+    if(mAH + mAH_offset < last_mAH)
+    {
+        /* hub reset, determine offset and apply, so users
+           only see contiguous mAH */
+        mAH_offset = last_mAH;
+        ALOGD("Saving %d mAH offset", mAH_offset);
+    }
+    last_mAH = mAH + mAH_offset;
+
+    data->data[0] = last_mAH;
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeMotionDetect(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_MOTION_DETECT;
+    data->type = SENSOR_TYPE_MOTION_DETECT;
+    data->data[0] = 1.0;
+    data->timestamp = buff.timestamp;
+    data++;
+    /* Disable, because this is a one shot sensor */
+    setEnable(ID_MOTION_DETECT, 0);
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeStationaryDetect(const struct motosh_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_STATIONARY_DETECT;
+    data->type = SENSOR_TYPE_STATIONARY_DETECT;
+    data->data[0] = 1.0;
+    data->timestamp = buff.timestamp;
+    data++;
+    /* Disable, because this is a one shot sensor */
+    setEnable(ID_STATIONARY_DETECT, 0);
+    return data;
 }
 
 int HubSensors::flush(int32_t handle)
@@ -1218,7 +1600,7 @@ int HubSensors::flush(int32_t handle)
     if ((mIdToSensor[handle]->flags & REPORTING_MODE_MASK) == SENSOR_FLAG_ONE_SHOT_MODE)
         return ret;
 
-    ret = motosh_ioctl(dev_fd, MOTOSH_IOCTL_SET_FLUSH, &handle);
+    ret = hubIoctl(MOTOSH_IOCTL_SET_FLUSH, &handle);
     return ret;
 }
 
@@ -1290,7 +1672,7 @@ int HubSensors::updateEcompassRate()
     else if( mEcompassDelay != minReqDelay )
     {
         mEcompassDelay = minReqDelay;
-        ret = motosh_ioctl(dev_fd,  MOTOSH_IOCTL_SET_MAG_DELAY, &mEcompassDelay);
+        ret = hubIoctl(MOTOSH_IOCTL_SET_MAG_DELAY, &mEcompassDelay);
     }
 
     return ret;
@@ -1320,7 +1702,7 @@ int HubSensors::updateGyroRate()
     else if( mGyroDelay != minReqDelay )
     {
         mGyroDelay = minReqDelay;
-        ret = motosh_ioctl(dev_fd,  MOTOSH_IOCTL_SET_GYRO_DELAY, &mGyroDelay);
+        ret = hubIoctl(MOTOSH_IOCTL_SET_GYRO_DELAY, &mGyroDelay);
     }
 
     return ret;
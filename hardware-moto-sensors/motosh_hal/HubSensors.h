@@ -29,6 +29,7 @@
 #include <zlib.h>
 #include <time.h>
 #include <iterator>
+#include <algorithm>
 #include <vector>
 
 #include <linux/motosh.h>
@@ -37,6 +38,9 @@
 #include "Sensors.h"
 #include "SensorBase.h"
 #include "SensorsLog.h"
+#include "DirectChannel.h"
+#include "SoftwareBatcher.h"
+#include "SensorTrace.h"
 
 /*****************************************************************************/
 
@@ -169,6 +173,15 @@
 
 #define ERROR_TYPES    9  /* Largest error code reported by the sensor hub */
 
+/* Records asked for per read(). The motosh driver returns a single record per
+ * read() whatever the length, so a batch only saves read() calls on a replay
+ * FIFO until the driver copies out every queued record (a kernel change). */
+#define HUB_READ_BATCH            32
+#define HUB_MAX_EVENTS_PER_RECORD 2     /* Most events decoded from a record (DT_GLANCE) */
+#define HUB_DECODER_TABLE_SIZE    256   /* Record types are one byte */
+#define HUB_READ_STATS_PERIOD     10000 /* read() calls between two stats logs */
+#define HUB_SW_FIFO_EVENTS        300   /* Default HAL FIFO size of sensors batched in software */
+
 struct input_event;
 
 class HubSensors : public SensorBase {
@@ -179,6 +192,9 @@ public:
     virtual int setEnable(int32_t handle, int enabled) override;
     virtual int batch(int32_t handle, int32_t flags, int64_t ns, int64_t timeout) override;
     virtual int readEvents(sensors_event_t* data, int count) override;
+    /** Reads the hub, or releases the software FIFOs when fd is the batch
+     * timer (getBatchFd()). */
+    virtual int readEvents(sensors_event_t* data, int count, int fd) override;
     virtual bool hasPendingEvents() const override {
         return !pendingEvents.empty();
     }
@@ -188,9 +204,38 @@ public:
              HubSensors();
     virtual ~HubSensors();
     virtual void getSensorsList(std::vector<struct sensor_t> &list) override {
+        size_t first = list.size();
         std::copy(hubSensorList().begin(), hubSensorList().end(), std::inserter(list, list.end()));
+        for (auto it = list.begin() + first; it != list.end(); ++it) {
+            // The IMU and fusion sensors can also be reported through direct channels
+            DirectReport::advertise(*it);
+            // Sensors batched in software report their HAL FIFO
+            if (size_t fifo = mBatcher.getCapacity(it->handle)) {
+                it->fifoReservedEventCount = fifo;
+                it->fifoMaxEventCount = fifo;
+            }
+        }
+    }
+
+    /** The timerfd to poll for software batching timeouts. Readable when
+     * readEvents() must be called with it. */
+    int getBatchFd() const {
+        return mBatcher.getFd();
     }
 
+protected:
+    /** Reads the hub's records from replayFd rather than from the hub if it
+     * is not negative, like the default constructor does with a replay FIFO
+     * (SENSOR_REPLAY_PROPERTY). The hub's nodes are not opened then, so that
+     * a trace replays where there is no hub. */
+    explicit HubSensors(int replayFd);
+
+    /** Issues an ioctl on the hub's control node. While replaying, the
+     * requests which configure the hub succeed without effect, and those
+     * which read from it fail with -ENODEV.
+     * @return 0 on success, or a negative value on error. */
+    virtual int hubIoctl(unsigned long request, void *arg);
+
 private:
     /** Returns the (static) list of sensors handled by the Sensor Hub. */
     const std::vector<struct sensor_t> & hubSensorList();
@@ -266,6 +311,132 @@ private:
 
     void logAlsEvent(int32_t lux, int64_t ts_ns);
 
+    /**
+     * Records read from the sensor hub are decoded by the decoder of their
+     * type. A decoder writes the events of a record from data on, at most
+     * HUB_MAX_EVENTS_PER_RECORD, and returns the end of what it wrote.
+     */
+    typedef sensors_event_t* (HubSensors::*Decoder)(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    static_assert(sizeof(motosh_android_sensor_data::type) == 1,
+        "record types must index the decoder table");
+
+    struct ReadStats {
+        uint64_t reads;     //!< read() calls on data_fd
+        uint64_t records;   //!< records decoded
+        uint64_t maxBatch;  //!< most records returned by one read()
+        uint64_t decodeNs;  //!< time spent decoding records
+    };
+
+    //! \brief Decoder of each record type, NULL for unknown types
+    Decoder mDecoders[HUB_DECODER_TABLE_SIZE];
+    //! \brief Records of the last read() on data_fd
+    struct motosh_android_sensor_data mReadBuf[HUB_READ_BATCH];
+    ReadStats mReadStats;
+
+    /** The sensors the hub can't batch (all but the accelerometer) are
+     * batched in software when a max report latency is requested. */
+    SoftwareBatcher mBatcher;
+    //! \brief Events of one readEvents() call, while they go through mBatcher
+    std::vector<sensors_event_t> mBatchScratch;
+
+    //! \brief Set when recording reads to a trace (SENSOR_TRACE_PROPERTY)
+    std::unique_ptr<SensorTraceRecorder> mTrace;
+    //! \brief Set when reading from a replay FIFO (SENSOR_REPLAY_PROPERTY)
+    std::unique_ptr<SensorReplayStats> mReplayStats;
+    //! \brief Set when reading from a replay fd rather than from the hub
+    bool mReplaying;
+
+    /** Passes the events decoded by one readEvents() call, in [first, last)
+     * then pendingEvents from pendingStart on, through mBatcher.
+     * @return the new end of the events in the poll buffer. */
+    sensors_event_t* batchEvents(sensors_event_t* first, sensors_event_t* last,
+            sensors_event_t const* dataEnd, size_t pendingStart);
+    void initBatching();
+
+    void initDecoders();
+    void logReadStats();
+    sensors_event_t* decodeUnsupported(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeFlush(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeAccel(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeGyro(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeUncalibGyro(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeUncalibMag(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeQuat6axis(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeQuat9axis(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeGameRv(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#ifdef _ENABLE_PEDO
+    sensors_event_t* decodeStepCounter(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeStepDetector(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#endif
+    sensors_event_t* decodeMag(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeOrient(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeAls(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#ifdef _ENABLE_LA
+    sensors_event_t* decodeLinAccel(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#endif
+#ifdef _ENABLE_GR
+    sensors_event_t* decodeGravity(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#endif
+    sensors_event_t* decodeDispRotate(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeProx(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeFlatUp(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeFlatDown(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeStowed(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeCameraAct(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#ifdef _ENABLE_IR
+    sensors_event_t* decodeIrGesture(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeIrRaw(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeIrObject(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#endif
+    sensors_event_t* decodeSim(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#ifdef _ENABLE_CHOPCHOP
+    sensors_event_t* decodeChopchop(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#endif
+#ifdef _ENABLE_LIFT
+    sensors_event_t* decodeLift(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#endif
+    sensors_event_t* decodeGlance(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeGyroCal(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeAccelCal(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeMotoModCurrentDrain(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeMotionDetect(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeStationaryDetect(const struct motosh_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+
     /**
      * Virtual sensors may generate more than one sensor event per event
      * received. If there's not enough room in the poll buffer, we need to
@@ -43,6 +43,7 @@
 #include "Sensors.h"
 #include "HubSensors.h"
 #include "BaseHal.h"
+#include "SensorsEventLoop.h"
 
 /**
  * This is a HAL primarily dedicated to handling SensorHub sensors. The bulk of
@@ -57,13 +58,13 @@ public:
 
     virtual int getSensorsList(struct sensor_t const** list) override;
 
+    virtual int close() override;
+
 private:
     DISALLOW_COPY_AND_ASSIGN(SensorsPollContext);
 
-    std::vector<struct pollfd> pollFds;
-
-    /// Used to map file descriptors to corresponding drivers
-    std::map<int, std::shared_ptr<SensorBase>> fd2driver;
+    /// Dispatches fd wakeups to the drivers, which are owned by BaseHal::drivers
+    SensorsEventLoop<SensorBase> eventLoop;
 };
 
 #endif /* SENSORS_POLL_CONTEXT_H */
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2017 Motorola Mobility
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+#include <algorithm>
+
+#include "SoftwareBatcher.h"
+#include "SensorsLog.h"
+
+using namespace std;
+
+SoftwareBatcher::SoftwareBatcher() :
+    lock(), fifos(),
+    timerFd(timerfd_create(CLOCK_BOOTTIME, TFD_NONBLOCK | TFD_CLOEXEC)),
+    nextDeadline(0), active(0)
+{
+    if (timerFd < 0) {
+        S_LOGE("timerfd_create failed, no software batching: %s", strerror(errno));
+    }
+}
+
+SoftwareBatcher::~SoftwareBatcher() {
+    if (timerFd >= 0) {
+        close(timerFd);
+    }
+}
+
+void SoftwareBatcher::setCapacity(int handle, size_t events) {
+    // Without the timer, held events could outlive their max report latency
+    if (timerFd < 0) {
+        return;
+    }
+
+    lock_guard<mutex> _l(lock);
+    Fifo &f = fifos[handle];
+    f.capacity = max<size_t>(events, 1);
+    f.watermark = min(f.watermark, f.capacity);
+    f.events.reserve(f.capacity);
+}
+
+size_t SoftwareBatcher::getCapacity(int handle) const {
+    lock_guard<mutex> _l(lock);
+    auto it = fifos.find(handle);
+    return it == fifos.end() ? 0 : it->second.capacity;
+}
+
+void SoftwareBatcher::configure(int handle, int64_t periodNs, int64_t latencyNs) {
+    lock_guard<mutex> _l(lock);
+    auto it = fifos.find(handle);
+    if (it == fifos.end()) {
+        return;
+    }
+
+    // The timer can't honour a latency below what the hub was asked for
+    Fifo &f = it->second;
+    f.latencyNs = latencyNs > periodNs ? latencyNs : 0;
+    f.watermark = f.capacity;
+    if (f.latencyNs && periodNs > 0) {
+        f.watermark = max<int64_t>(1, min<int64_t>(f.latencyNs / periodNs, f.capacity));
+    }
+    // Events held beyond the new watermark would otherwise wait for the
+    // next push or the old deadline
+    if (!f.latencyNs || f.events.size() >= f.watermark) {
+        expireLocked(f);
+    }
+    updateActive();
+
+    S_LOGD("handle=%d latency=%" PRId64 " watermark=%zu capacity=%zu", handle,
+            f.latencyNs, f.watermark, f.capacity);
+}
+
+void SoftwareBatcher::expire(int handle) {
+    lock_guard<mutex> _l(lock);
+    auto it = fifos.find(handle);
+    if (it != fifos.end()) {
+        expireLocked(it->second);
+    }
+}
+
+void SoftwareBatcher::expireLocked(Fifo &f) {
+    if (f.events.empty()) {
+        return;
+    }
+    f.deadline = now();
+    armTimer(f.deadline);
+}
+
+int64_t SoftwareBatcher::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void SoftwareBatcher::armTimer(int64_t deadline) {
+    struct itimerspec spec;
+
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = deadline / 1000000000LL;
+    spec.it_value.tv_nsec = deadline % 1000000000LL;
+    if (timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+        S_LOGE("timerfd_settime failed: %s", strerror(errno));
+        return;
+    }
+    nextDeadline = deadline;
+}
+
+void SoftwareBatcher::updateActive() {
+    int n = 0;
+    for (const auto &it : fifos) {
+        if (it.second.latencyNs || !it.second.events.empty()) {
+            n++;
+        }
+    }
+    active.store(n, memory_order_relaxed);
+}
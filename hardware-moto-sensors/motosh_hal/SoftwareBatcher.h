@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2017 Motorola Mobility
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SOFTWARE_BATCHER_H
+#define SOFTWARE_BATCHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <hardware/sensors.h>
+
+/**
+ * Per-sensor FIFOs that batch, in the HAL, the events of sensors the hub
+ * can't batch itself. An event pushed for a batching sensor (one with a non
+ * zero max report latency) is held until one of:
+ *  - its FIFO reaches the watermark: the number of samples that fit in the
+ *    max report latency, bounded by the FIFO capacity.
+ *  - the max report latency elapses since the first held event. A timerfd,
+ *    polled by the HAL alongside the hub fd, fires at the earliest deadline.
+ *  - a META_DATA_FLUSH_COMPLETE event for the sensor is pushed. The held
+ *    events are released ahead of it, as the framework expects.
+ *
+ * Released events are handed to an emit(const sensors_event_t&) callback
+ * in the order they were pushed.
+ */
+class SoftwareBatcher {
+public:
+    SoftwareBatcher();
+    ~SoftwareBatcher();
+
+    SoftwareBatcher(const SoftwareBatcher&) = delete;
+    SoftwareBatcher& operator=(const SoftwareBatcher&) = delete;
+
+    /// The timerfd which becomes readable when a FIFO is due.
+    int getFd() const {
+        return timerFd;
+    }
+
+    /** Gives a sensor a FIFO of the given number of events, which makes it
+     * eligible for software batching. Ignored if the timerfd couldn't be
+     * created, so the sensor is never batched here. */
+    void setCapacity(int handle, size_t events);
+
+    /** @return the FIFO capacity of a sensor, 0 if it isn't batched here. */
+    size_t getCapacity(int handle) const;
+
+    /** Applies the rate requested through batch(). A latency of 0 disables
+     * batching. Events already held are released on the next timer expiry
+     * when batching is disabled, or when they reach the new watermark. */
+    void configure(int handle, int64_t periodNs, int64_t latencyNs);
+
+    /** Releases the events held for a sensor on the next timer expiry,
+     * typically because it was disabled. */
+    void expire(int handle);
+
+    /// @return true if any sensor is batching, or has events held.
+    bool isBatching() const {
+        return active.load(std::memory_order_relaxed) > 0;
+    }
+
+    /** Holds ev in its sensor's FIFO, or passes it (and whatever it
+     * releases) to emit. */
+    template <class Emit>
+    void push(const sensors_event_t &ev, Emit emit) {
+        std::lock_guard<std::mutex> _l(lock);
+
+        int handle = ev.sensor;
+        if (ev.type == SENSOR_TYPE_META_DATA) {
+            if (ev.meta_data.what != META_DATA_FLUSH_COMPLETE) {
+                emit(ev);
+                return;
+            }
+            handle = ev.meta_data.sensor;
+        }
+
+        auto it = fifos.find(handle);
+        if (it == fifos.end()) {
+            emit(ev);
+            return;
+        }
+
+        Fifo &f = it->second;
+        if (ev.type == SENSOR_TYPE_META_DATA || !f.latencyNs) {
+            release(f, emit);
+            emit(ev);
+            return;
+        }
+
+        if (f.events.empty()) {
+            f.deadline = now() + f.latencyNs;
+            if (!nextDeadline || f.deadline < nextDeadline) {
+                armTimer(f.deadline);
+            }
+        }
+        f.events.push_back(ev);
+        if (f.events.size() >= f.watermark) {
+            release(f, emit);
+        }
+    }
+
+    /** Called when the timerfd is readable: releases every FIFO whose
+     * deadline has passed and re-arms the timer for the next one. */
+    template <class Emit>
+    void releaseExpired(Emit emit) {
+        // This only clears the readable state, deadlines are checked below
+        uint64_t expirations;
+        ssize_t ret = read(timerFd, &expirations, sizeof(expirations));
+        (void)ret;
+
+        std::lock_guard<std::mutex> _l(lock);
+        int64_t t = now();
+        int64_t next = 0;
+        for (auto &it : fifos) {
+            Fifo &f = it.second;
+            if (f.events.empty()) {
+                continue;
+            }
+            if (f.deadline <= t) {
+                release(f, emit);
+            } else if (!next || f.deadline < next) {
+                next = f.deadline;
+            }
+        }
+        armTimer(next);
+    }
+
+private:
+    struct Fifo {
+        Fifo() : capacity(0), watermark(1), latencyNs(0), deadline(0), events() { }
+
+        size_t capacity;
+        size_t watermark;
+        int64_t latencyNs;
+        /// When the oldest held event must be released.
+        int64_t deadline;
+        std::vector<sensors_event_t> events;
+    };
+
+    template <class Emit>
+    void release(Fifo &f, Emit emit) {
+        for (const auto &e : f.events) {
+            emit(e);
+        }
+        f.events.clear();
+        updateActive();
+    }
+
+    /// @return the CLOCK_BOOTTIME time, which the timerfd runs on.
+    static int64_t now();
+
+    /// Arms the timer for an absolute deadline, or disarms it for 0.
+    void armTimer(int64_t deadline);
+
+    /// Makes the FIFO due on the next timer expiry, if it holds events.
+    void expireLocked(Fifo &f);
+
+    void updateActive();
+
+    mutable std::mutex lock;
+    std::map<int, Fifo> fifos;
+    int timerFd;
+    /// The deadline the timer is armed for, 0 if disarmed.
+    int64_t nextDeadline;
+    /// Number of FIFOs batching or holding events, read without the lock.
+    std::atomic<int> active;
+};
+
+#endif // SOFTWARE_BATCHER_H
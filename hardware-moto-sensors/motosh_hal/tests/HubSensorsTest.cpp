@@ -0,0 +1,369 @@
+/*
+ * Copyright (C) 2017 Motorola Mobility LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replays a sensor hub trace through HubSensors, without the hub. The trace
+// is written from the session below, read back with SensorTraceReader and
+// fed to HubSensors through a pipe, the way `sensortrace replay` feeds the
+// replay FIFO. What HubSensors asks of the hub goes to the replay stub of
+// hubIoctl().
+//
+// The other tests write records straight to the pipe, to check how each
+// record type decodes and where the events which do not fit a read go.
+
+#include <gtest/gtest.h>
+
+#include <endian.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include <hardware/mot_sensorhub_motosh.h>
+
+#include "HubSensors.h"
+#include "SensorTrace.h"
+
+#define PERIOD_NS       (10000000LL)
+#define POLL_EVENTS     (16)
+
+namespace {
+
+typedef struct motosh_android_sensor_data Record;
+
+/** @return a record of type with the big endian words of values. */
+Record makeRecord(uint8_t type, int64_t timestamp, std::initializer_list<int16_t> values) {
+    Record r;
+
+    memset(&r, 0, sizeof(r));
+    r.type = type;
+    r.timestamp = timestamp;
+    uint8_t *p = r.data;
+    for (int16_t v : values) {
+        uint16_t word = htobe16((uint16_t)v);
+        memcpy(p, &word, sizeof(word));
+        p += sizeof(word);
+    }
+    return r;
+}
+
+Record makeFlush(int32_t handle) {
+    Record r;
+
+    memset(&r, 0, sizeof(r));
+    r.type = DT_FLUSH;
+    uint32_t word = htobe32((uint32_t)handle);
+    memcpy(r.data + FLUSH_FLUSH, &word, sizeof(word));
+    return r;
+}
+
+/** One read() of the session: accel, then gyro and a flush of the accel. */
+const std::vector<std::vector<Record>> SESSION = {
+    {
+        makeRecord(DT_ACCEL, 1 * PERIOD_NS, { 1024, -1024, 2048 }),
+        makeRecord(DT_ACCEL, 2 * PERIOD_NS, { 512, 0, -2048 }),
+    },
+    {
+        makeRecord(DT_GYRO, 3 * PERIOD_NS, { 100, 200, -300 }),
+        makeFlush(ID_A),
+    },
+    {
+        makeRecord(DT_ACCEL, 4 * PERIOD_NS, { 0, 0, 2048 }),
+    },
+};
+
+/** A HubSensors reading its records from fd, which records what it asks of
+ * the hub. */
+class TestHubSensors : public HubSensors {
+public:
+    explicit TestHubSensors(int fd) : HubSensors(fd) {}
+
+    int hubIoctl(unsigned long request, void *arg) override {
+        requests.push_back(request);
+        return HubSensors::hubIoctl(request, arg);
+    }
+
+    /// Requests made after construction, in order
+    std::vector<unsigned long> requests;
+};
+
+class HubSensorsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        const char *dir = getenv("TMPDIR");
+        tracePath = std::string(dir ? dir : "/data/local/tmp") + "/hub_trace_XXXXXX";
+        int fd = mkstemp(&tracePath[0]);
+        ASSERT_GE(fd, 0);
+        close(fd);
+
+        int fds[2];
+        ASSERT_EQ(0, pipe2(fds, O_NONBLOCK | O_CLOEXEC));
+        replayFd = fds[1];
+        hub.reset(new TestHubSensors(fds[0]));
+    }
+
+    void TearDown() override {
+        hub.reset();
+        if (replayFd >= 0) {
+            close(replayFd);
+        }
+        unlink(tracePath.c_str());
+    }
+
+    /** Writes a trace of session, one chunk per read(). */
+    void writeTrace(const std::vector<std::vector<Record>> &session) {
+        struct sensor_trace_header header;
+        FILE *fp = fopen(tracePath.c_str(), "we");
+        ASSERT_TRUE(fp != NULL);
+
+        memset(&header, 0, sizeof(header));
+        header.magic = SENSOR_TRACE_MAGIC;
+        header.version = SENSOR_TRACE_VERSION;
+        header.recordSize = sizeof(Record);
+        header.typeOffset = offsetof(Record, type);
+        strncpy(header.hub, "motosh", sizeof(header.hub) - 1);
+        ASSERT_EQ(1u, fwrite(&header, sizeof(header), 1, fp));
+
+        for (const auto &records : session) {
+            struct sensor_trace_chunk chunk;
+            memset(&chunk, 0, sizeof(chunk));
+            chunk.timestamp = records.empty() ? 0 : records.back().timestamp;
+            chunk.length = records.size() * sizeof(Record);
+            ASSERT_EQ(1u, fwrite(&chunk, sizeof(chunk), 1, fp));
+            ASSERT_EQ(records.size(), fwrite(records.data(), sizeof(Record), records.size(), fp));
+        }
+        fclose(fp);
+    }
+
+    /** Feeds the trace to the pipe HubSensors reads, as the replay tool does.
+     * @return the number of chunks fed. */
+    size_t replayTrace() {
+        std::unique_ptr<SensorTraceReader> reader = SensorTraceReader::open(tracePath.c_str());
+        struct sensor_trace_chunk chunk;
+        std::vector<uint8_t> data;
+        size_t chunks = 0;
+
+        EXPECT_TRUE(reader != nullptr);
+        if (!reader) {
+            return 0;
+        }
+        EXPECT_EQ(sizeof(Record), reader->getHeader().recordSize);
+        EXPECT_STREQ("motosh", reader->getHeader().hub);
+        while (reader->next(chunk, data)) {
+            EXPECT_EQ((ssize_t)data.size(), write(replayFd, data.data(), data.size()));
+            chunks++;
+        }
+        return chunks;
+    }
+
+    /** Calls readEvents() with room for count events until it returns none.
+     * @return the events read. */
+    std::vector<sensors_event_t> readAll(int count = POLL_EVENTS) {
+        std::vector<sensors_event_t> events;
+        std::vector<sensors_event_t> buf(count);
+        int n;
+
+        while ((n = hub->readEvents(buf.data(), count)) > 0) {
+            EXPECT_LE(n, count);
+            events.insert(events.end(), buf.begin(), buf.begin() + n);
+        }
+        EXPECT_EQ(0, n);
+        return events;
+    }
+
+    /** Writes records to the pipe as a single read() of the hub. */
+    void feed(const std::vector<Record> &records) {
+        ssize_t len = records.size() * sizeof(Record);
+        ASSERT_EQ(len, write(replayFd, records.data(), len));
+    }
+
+    /** @return the number of records not read by HubSensors yet. */
+    int queuedRecords() {
+        int bytes = 0;
+        EXPECT_EQ(0, ioctl(replayFd, FIONREAD, &bytes));
+        return bytes / sizeof(Record);
+    }
+
+    std::string tracePath;
+    int replayFd = -1;
+    std::unique_ptr<TestHubSensors> hub;
+};
+
+void expectAccel(const sensors_event_t &ev, int64_t timestamp, int16_t x, int16_t y, int16_t z) {
+    EXPECT_EQ(SENSORS_HANDLE_BASE + ID_A, ev.sensor);
+    EXPECT_EQ(SENSOR_TYPE_ACCELEROMETER, ev.type);
+    EXPECT_EQ(timestamp, ev.timestamp);
+    EXPECT_FLOAT_EQ(x * CONVERT_A_X, ev.acceleration.x);
+    EXPECT_FLOAT_EQ(y * CONVERT_A_Y, ev.acceleration.y);
+    EXPECT_FLOAT_EQ(z * CONVERT_A_Z, ev.acceleration.z);
+}
+
+TEST_F(HubSensorsTest, ReplaysTraceWithoutHub) {
+    ASSERT_EQ(0, hub->setEnable(ID_A, 1));
+    ASSERT_EQ(0, hub->setEnable(ID_G, 1));
+    writeTrace(SESSION);
+    ASSERT_EQ(SESSION.size(), replayTrace());
+
+    std::vector<sensors_event_t> events = readAll();
+    ASSERT_EQ(5u, events.size());
+    expectAccel(events[0], 1 * PERIOD_NS, 1024, -1024, 2048);
+    expectAccel(events[1], 2 * PERIOD_NS, 512, 0, -2048);
+    EXPECT_EQ(SENSORS_HANDLE_BASE + ID_G, events[2].sensor);
+    EXPECT_EQ(SENSOR_TYPE_GYROSCOPE, events[2].type);
+    EXPECT_FLOAT_EQ(-300 * CONVERT_G_Y, events[2].gyro.z);
+    // The flush complete stays behind the samples recorded before it
+    EXPECT_EQ(SENSOR_TYPE_META_DATA, events[3].type);
+    EXPECT_EQ(META_DATA_FLUSH_COMPLETE, events[3].meta_data.what);
+    EXPECT_EQ(ID_A, events[3].meta_data.sensor);
+    expectAccel(events[4], 4 * PERIOD_NS, 0, 0, 2048);
+    EXPECT_FALSE(hub->hasPendingEvents());
+}
+
+TEST_F(HubSensorsTest, ReplaysEachRead) {
+    writeTrace(SESSION);
+    std::unique_ptr<SensorTraceReader> reader = SensorTraceReader::open(tracePath.c_str());
+    ASSERT_TRUE(reader != nullptr);
+
+    struct sensor_trace_chunk chunk;
+    std::vector<uint8_t> data;
+    size_t expected[] = { 2, 2, 1 };
+    for (size_t i = 0; i < SESSION.size(); i++) {
+        ASSERT_TRUE(reader->next(chunk, data));
+        ASSERT_EQ((ssize_t)data.size(), write(replayFd, data.data(), data.size()));
+        EXPECT_EQ(expected[i], readAll().size()) << "read " << i;
+    }
+    EXPECT_FALSE(reader->next(chunk, data));
+}
+
+TEST_F(HubSensorsTest, ConfiguresNoHub) {
+    hub->requests.clear();
+
+    EXPECT_EQ(0, hub->setEnable(ID_A, 1));
+    EXPECT_EQ(0, hub->batch(ID_A, 0, PERIOD_NS, 0));
+    EXPECT_EQ(0, hub->flush(ID_A));
+    EXPECT_EQ(0, hub->setEnable(ID_A, 0));
+
+    std::vector<unsigned long> expected = {
+        MOTOSH_IOCTL_SET_SENSORS,
+        MOTOSH_IOCTL_SET_ACC_DELAY,
+        MOTOSH_IOCTL_SET_FLUSH,
+        MOTOSH_IOCTL_SET_SENSORS,
+    };
+    EXPECT_EQ(expected, hub->requests);
+
+    // Reading from the hub fails rather than returning what isn't there
+    uint8_t cal[MOTOSH_ACCEL_CAL_SIZE];
+    EXPECT_EQ(-ENODEV, hub->hubIoctl(MOTOSH_IOCTL_GET_ACCEL_CAL, cal));
+}
+
+TEST_F(HubSensorsTest, DecodesEachType) {
+    const struct {
+        uint8_t type;
+        int32_t sensor;
+        int32_t sensorType;
+    } expected[] = {
+        { DT_ACCEL, ID_A, SENSOR_TYPE_ACCELEROMETER },
+        { DT_GYRO, ID_G, SENSOR_TYPE_GYROSCOPE },
+        { DT_UNCALIB_GYRO, ID_UNCALIB_GYRO, SENSOR_TYPE_GYROSCOPE_UNCALIBRATED },
+        { DT_ALS, ID_L, SENSOR_TYPE_LIGHT },
+        { DT_DISP_ROTATE, ID_DR, SENSOR_TYPE_DISPLAY_ROTATE },
+        { DT_PROX, ID_P, SENSOR_TYPE_PROXIMITY },
+        { DT_FLAT_UP, ID_FU, SENSOR_TYPE_FLAT_UP },
+        { DT_FLAT_DOWN, ID_FD, SENSOR_TYPE_FLAT_DOWN },
+        { DT_STOWED, ID_S, SENSOR_TYPE_STOWED },
+        { DT_CAMERA_ACT, ID_CA, SENSOR_TYPE_CAMERA_ACTIVATE },
+        { DT_FLUSH, 0, SENSOR_TYPE_META_DATA },
+    };
+    std::vector<Record> records;
+    for (const auto &e : expected) {
+        records.push_back(e.type == DT_FLUSH ? makeFlush(ID_A) :
+                makeRecord(e.type, PERIOD_NS, { 1, 2, 3 }));
+    }
+    feed(records);
+
+    std::vector<sensors_event_t> events = readAll();
+    ASSERT_EQ(records.size(), events.size());
+    for (size_t i = 0; i < events.size(); i++) {
+        EXPECT_EQ(SENSORS_HANDLE_BASE + expected[i].sensor, events[i].sensor) << "type " << (int)expected[i].type;
+        EXPECT_EQ(expected[i].sensorType, events[i].type) << "type " << (int)expected[i].type;
+    }
+}
+
+TEST_F(HubSensorsTest, SkipsUnknownTypes) {
+    feed({
+        makeRecord(0, 1 * PERIOD_NS, { 1, 2, 3 }),
+        makeRecord(DT_ACCEL, 2 * PERIOD_NS, { 1024, 0, 0 }),
+        makeRecord(255, 3 * PERIOD_NS, { 1, 2, 3 }),
+        makeRecord(DT_ACCEL, 4 * PERIOD_NS, { 0, 1024, 0 }),
+    });
+
+    std::vector<sensors_event_t> events = readAll();
+    ASSERT_EQ(2u, events.size());
+    expectAccel(events[0], 2 * PERIOD_NS, 1024, 0, 0);
+    expectAccel(events[1], 4 * PERIOD_NS, 0, 1024, 0);
+}
+
+TEST_F(HubSensorsTest, ReadsNoMoreRecordsThanFreeSlots) {
+    feed({
+        makeRecord(DT_ACCEL, 1 * PERIOD_NS, { 1, 0, 0 }),
+        makeRecord(DT_ACCEL, 2 * PERIOD_NS, { 2, 0, 0 }),
+        makeRecord(DT_ACCEL, 3 * PERIOD_NS, { 3, 0, 0 }),
+    });
+
+    sensors_event_t buf[2];
+    ASSERT_EQ(2, hub->readEvents(buf, 2));
+    expectAccel(buf[1], 2 * PERIOD_NS, 2, 0, 0);
+    EXPECT_FALSE(hub->hasPendingEvents());
+    EXPECT_EQ(1, queuedRecords());
+
+    std::vector<sensors_event_t> events = readAll();
+    ASSERT_EQ(1u, events.size());
+    expectAccel(events[0], 3 * PERIOD_NS, 3, 0, 0);
+}
+
+TEST_F(HubSensorsTest, SpillsEventsWhichDoNotFit) {
+    // A glance decodes to both glance gestures when both are enabled
+    ASSERT_EQ(0, hub->setEnable(ID_MOTO_GLANCE_GESTURE, 1));
+    ASSERT_EQ(0, hub->setEnable(ID_GLANCE_GESTURE, 1));
+    feed({
+        makeRecord(DT_GLANCE, 1 * PERIOD_NS, { 7 }),
+        makeRecord(DT_ACCEL, 2 * PERIOD_NS, { 1024, 0, 0 }),
+    });
+
+    sensors_event_t ev;
+    ASSERT_EQ(1, hub->readEvents(&ev, 1));
+    EXPECT_EQ(ID_MOTO_GLANCE_GESTURE, ev.sensor);
+    EXPECT_FLOAT_EQ(7, ev.data[0]);
+    EXPECT_TRUE(hub->hasPendingEvents());
+    EXPECT_EQ(1, queuedRecords());
+
+    // The spilled event comes out before the next record
+    std::vector<sensors_event_t> events = readAll();
+    ASSERT_EQ(2u, events.size());
+    EXPECT_EQ(ID_GLANCE_GESTURE, events[0].sensor);
+    EXPECT_EQ(SENSOR_TYPE_GLANCE_GESTURE, events[0].type);
+    EXPECT_EQ(1 * PERIOD_NS, events[0].timestamp);
+    expectAccel(events[1], 2 * PERIOD_NS, 1024, 0, 0);
+    EXPECT_FALSE(hub->hasPendingEvents());
+}
+
+} // namespace
@@ -0,0 +1,44 @@
+LOCAL_PATH := $(call my-dir)
+
+ifeq ($(BOARD_USES_MOT_SENSOR_HUB), true)
+
+################################################################################
+## sensortrace #################################################################
+# Replays the sensor hub traces recorded by the HAL (vendor.sensors.trace)
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE := sensortrace
+LOCAL_VENDOR_MODULE := true
+LOCAL_CFLAGS += -Wall -Wextra
+LOCAL_CXXFLAGS += -Weffc++
+
+LOCAL_SRC_FILES := \
+    sensortrace.cpp \
+    ../SensorTrace.cpp
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+LOCAL_HEADER_LIBRARIES := libhardware_headers
+LOCAL_SHARED_LIBRARIES := libcutils liblog
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+## sensortrace (host) ##########################################################
+# The same tool, to inspect traces pulled off a device
+include $(CLEAR_VARS)
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE := sensortrace
+LOCAL_CFLAGS += -Wall -Wextra
+LOCAL_CXXFLAGS += -Weffc++
+
+LOCAL_SRC_FILES := \
+    sensortrace.cpp \
+    ../SensorTrace.cpp
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+LOCAL_HEADER_LIBRARIES := libhardware_headers
+LOCAL_SHARED_LIBRARIES := libcutils liblog
+
+include $(BUILD_HOST_EXECUTABLE)
+
+endif # BOARD_USES_MOT_SENSOR_HUB
@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2017 Motorola Mobility
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * sensortrace - inspects and replays the sensor hub traces recorded by the
+ * HAL (see SensorTrace.h).
+ *
+ * Replay writes the recorded reads to the FIFO the HAL reads from when
+ * vendor.sensors.replay is set, at the recorded pace or as fast as the HAL
+ * drains them. The FIFO only holds a few pages, so a write blocks while the
+ * HAL is behind: how late each write completes is the HAL's read latency.
+ * The replay ends once the HAL has decoded every record, and reports what
+ * the HAL counted in its replay stats: the events of each sensor and the
+ * time it took to decode each one.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "SensorTrace.h"
+
+using namespace std;
+
+static void usage() {
+    printf("sensortrace - sensor hub trace replay\n");
+    printf("USAGE:  sensortrace <command> <command-options>\n");
+    printf("  command:\n");
+    printf("    info TRACE - print the records of a trace by type\n");
+    printf("    replay [-f] [-n LOOPS] [-p PID] TRACE FIFO - feed a trace to the HAL\n");
+    printf("      options:\n");
+    printf("        -f as fast as the HAL reads, rather than at the recorded pace\n");
+    printf("        -n replay the trace LOOPS times\n");
+    printf("        -p report the CPU time PID (the sensors HAL) used per event\n");
+}
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleepUntil(int64_t deadline) {
+    struct timespec ts;
+    ts.tv_sec = deadline / 1000000000LL;
+    ts.tv_nsec = deadline % 1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+/** @return the user + system CPU time of a process in ns, or -1. */
+static int64_t processCpuNs(int pid) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+
+    FILE *fp = fopen(path, "re");
+    if (!fp) {
+        return -1;
+    }
+    char buf[1024];
+    size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[len] = '\0';
+
+    // utime and stime are the 14th and 15th fields. The 2nd one, the
+    // command name, may contain spaces, so start after its ')'.
+    unsigned long long utime, stime;
+    char *p = strrchr(buf, ')');
+    if (!p || sscanf(p + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+                &utime, &stime) != 2) {
+        return -1;
+    }
+    return (int64_t)(utime + stime) * 1000000000LL / sysconf(_SC_CLK_TCK);
+}
+
+/** Counts the records of each type in a chunk, the trace's sensor mix. */
+static void countTypes(const struct sensor_trace_header &header,
+        const vector<uint8_t> &data, map<int, uint64_t> &types) {
+    for (size_t off = 0; off + header.recordSize <= data.size(); off += header.recordSize) {
+        types[data[off + header.typeOffset]]++;
+    }
+}
+
+static void printTypes(const map<int, uint64_t> &types) {
+    printf("  type  records\n");
+    for (const auto &t : types) {
+        printf("  %4d  %" PRIu64 "\n", t.first, t.second);
+    }
+}
+
+static int info(const char *path) {
+    unique_ptr<SensorTraceReader> reader = SensorTraceReader::open(path);
+    if (!reader) {
+        fprintf(stderr, "%s isn't a sensor trace\n", path);
+        return 1;
+    }
+    const struct sensor_trace_header &header = reader->getHeader();
+
+    struct sensor_trace_chunk chunk;
+    vector<uint8_t> data;
+    map<int, uint64_t> types;
+    uint64_t reads = 0, records = 0;
+    int64_t first = 0, last = 0;
+
+    while (reader->next(chunk, data)) {
+        if (!reads++) {
+            first = chunk.timestamp;
+        }
+        last = chunk.timestamp;
+        records += data.size() / header.recordSize;
+        countTypes(header, data, types);
+    }
+
+    double seconds = (last - first) / 1e9;
+    printf("%s: %s hub, %u bytes per record\n", path, header.hub, header.recordSize);
+    printf("  %" PRIu64 " reads, %" PRIu64 " records over %.3f s (%.1f records/s)\n",
+           reads, records, seconds, seconds > 0 ? records / seconds : 0.0);
+    printTypes(types);
+    return 0;
+}
+
+static int writeAll(int fd, const uint8_t *buf, size_t len) {
+    while (len) {
+        ssize_t ret = write(fd, buf, len);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        buf += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+static int64_t percentile(vector<int64_t> &v, int pct) {
+    if (v.empty()) {
+        return 0;
+    }
+    size_t i = min(v.size() - 1, v.size() * pct / 100);
+    nth_element(v.begin(), v.begin() + i, v.end());
+    return v[i];
+}
+
+/** @return the upper bound of the bucket of a latency histogram the pct
+ * percentile falls in. */
+static uint64_t histogramPercentile(const uint64_t *hist, uint64_t total, int pct) {
+    uint64_t rank = max<uint64_t>(1, (total * pct + 99) / 100);
+    uint64_t seen = 0;
+
+    for (size_t b = 0; b < SENSOR_REPLAY_BUCKETS; b++) {
+        seen += hist[b];
+        if (seen >= rank) {
+            return sensorReplayBucketFloor(b + 1) - 1;
+        }
+    }
+    return 0;
+}
+
+/** Waits for the HAL to have decoded records more records than in base,
+ * into stats.
+ * @return false if it didn't within a few seconds. */
+static bool waitForHal(const SensorReplayStats &replayStats,
+        const struct sensor_replay_stats &base, uint64_t records,
+        struct sensor_replay_stats &stats) {
+    int64_t deadline = nowNs() + 5000000000LL;
+
+    while (replayStats.snapshot(stats) && stats.records - base.records < records) {
+        if (nowNs() > deadline) {
+            return false;
+        }
+        sleepUntil(nowNs() + 100000LL);
+    }
+    return stats.records - base.records >= records;
+}
+
+/** Prints what the HAL decoded between two snapshots, over elapsed ns. */
+static void printHalStats(const struct sensor_replay_stats &base,
+        const struct sensor_replay_stats &stats, int64_t elapsed) {
+    uint64_t events = stats.events - base.events;
+    double seconds = elapsed / 1e9;
+
+    printf("  handle  type  events  events/s\n");
+    for (size_t h = 0; h <= SENSOR_REPLAY_MAX_HANDLE; h++) {
+        uint64_t n = stats.sensorEvents[h] - base.sensorEvents[h];
+        if (n) {
+            printf("  %s%4zu  %4d  %6" PRIu64 "  %8.1f\n", h == SENSOR_REPLAY_MAX_HANDLE ? ">=" : "  ",
+                   h, stats.sensorType[h], n, seconds > 0 ? n / seconds : 0.0);
+        }
+    }
+    printf("  %" PRIu64 " events in %.3f s: %.1f events/s\n", events, seconds,
+           seconds > 0 ? events / seconds : 0.0);
+
+    uint64_t hist[SENSOR_REPLAY_BUCKETS];
+    for (size_t b = 0; b < SENSOR_REPLAY_BUCKETS; b++) {
+        hist[b] = stats.latency[b] - base.latency[b];
+    }
+    if (events) {
+        printf("  HAL decode ns/event (25%% buckets): p50 <%" PRIu64 " p90 <%" PRIu64
+               " p99 <%" PRIu64 " max <%" PRIu64 "\n",
+               histogramPercentile(hist, events, 50), histogramPercentile(hist, events, 90),
+               histogramPercentile(hist, events, 99), histogramPercentile(hist, events, 100));
+    }
+}
+
+static int replay(const char *tracePath, const char *fifoPath, bool fast, int loops, int pid) {
+    unique_ptr<SensorTraceReader> reader = SensorTraceReader::open(tracePath);
+    if (!reader) {
+        fprintf(stderr, "%s isn't a sensor trace\n", tracePath);
+        return 1;
+    }
+    const struct sensor_trace_header &header = reader->getHeader();
+
+    // Created by the HAL along with the FIFO
+    unique_ptr<SensorReplayStats> replayStats = SensorReplayStats::open(fifoPath);
+    if (!replayStats) {
+        fprintf(stderr, "Couldn't open the HAL stats of %s (is %s set?)\n", fifoPath,
+                SENSOR_REPLAY_PROPERTY);
+        return 1;
+    }
+    struct sensor_replay_stats base, stats;
+    if (!replayStats->snapshot(base)) {
+        fprintf(stderr, "The HAL stats of %s are inconsistent\n", fifoPath);
+        return 1;
+    }
+
+    // The HAL keeps the FIFO open, so this doesn't wait for a reader
+    int fd = open(fifoPath, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Couldn't open %s: %s (is %s set?)\n", fifoPath, strerror(errno),
+                SENSOR_REPLAY_PROPERTY);
+        return 1;
+    }
+
+    struct sensor_trace_chunk chunk;
+    vector<uint8_t> data;
+    //! How late each write completed, relative to its schedule
+    vector<int64_t> latency;
+    uint64_t records = 0;
+
+    int64_t cpuStart = pid > 0 ? processCpuNs(pid) : -1;
+    int64_t start = nowNs();
+
+    for (int loop = 0; loop < loops; loop++) {
+        reader->rewind();
+        int64_t traceStart = -1;
+        int64_t loopStart = nowNs();
+
+        while (reader->next(chunk, data)) {
+            if (traceStart < 0) {
+                traceStart = chunk.timestamp;
+            }
+            int64_t due = nowNs();
+            if (!fast) {
+                due = loopStart + (chunk.timestamp - traceStart);
+                sleepUntil(due);
+            }
+
+            int err = writeAll(fd, data.data(), data.size());
+            if (err) {
+                fprintf(stderr, "Writing %s failed: %s\n", fifoPath, strerror(-err));
+                close(fd);
+                return 1;
+            }
+            latency.push_back(nowNs() - due);
+            records += data.size() / header.recordSize;
+        }
+    }
+
+    // The last writes only reached the FIFO, the HAL may still be decoding
+    bool drained = waitForHal(*replayStats, base, records, stats);
+    int64_t elapsed = nowNs() - start;
+    int64_t cpuEnd = pid > 0 ? processCpuNs(pid) : -1;
+    close(fd);
+
+    printf("%s: %s hub, %d loop(s), %s\n", tracePath, header.hub, loops,
+           fast ? "max speed" : "real time");
+    if (!drained) {
+        fprintf(stderr, "The HAL decoded %" PRIu64 " of %" PRIu64 " records\n",
+                stats.records - base.records, records);
+    }
+    printHalStats(base, stats, elapsed);
+    printf("  write latency us: p50 %" PRId64 " p90 %" PRId64 " p99 %" PRId64 " max %" PRId64 "\n",
+           percentile(latency, 50) / 1000, percentile(latency, 90) / 1000,
+           percentile(latency, 99) / 1000, percentile(latency, 100) / 1000);
+    uint64_t events = stats.events - base.events;
+    if (cpuStart >= 0 && cpuEnd >= 0 && events) {
+        printf("  pid %d cpu: %" PRId64 " ns/event\n", pid, (cpuEnd - cpuStart) / (int64_t)events);
+    }
+    return drained ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    if (!strcmp(argv[1], "info") && argc == 3) {
+        return info(argv[2]);
+    }
+
+    if (!strcmp(argv[1], "replay")) {
+        bool fast = false;
+        int loops = 1;
+        int pid = 0;
+        int opt;
+
+        optind = 2;
+        while ((opt = getopt(argc, argv, "fn:p:")) != -1) {
+            switch (opt) {
+                case 'f':
+                    fast = true;
+                    break;
+                case 'n':
+                    loops = max(1, atoi(optarg));
+                    break;
+                case 'p':
+                    pid = atoi(optarg);
+                    break;
+                default:
+                    usage();
+                    return 1;
+            }
+        }
+        if (argc - optind != 2) {
+            usage();
+            return 1;
+        }
+        return replay(argv[optind], argv[optind + 1], fast, loops, pid);
+    }
+
+    usage();
+    return 1;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Copyright (C) 2016 Motorola Mobility LLC
+ */
+
+#include "FusionEngine.h"
+
+const size_t FusionEngine::FUSION_BATCH_CHUNK;
+
+FusionEngine::FusionEngine()
+:
+#ifdef _ENABLE_MAGNETOMETER
+  mGeomagRVReady(false),
+#endif
+  mLastGyroTimestamp(0),
+  mChunkGyro(),
+  mChunkSteps()
+{
+}
+
+FusionEngine::~FusionEngine()
+{
+}
+
+size_t FusionEngine::processFusion(FusionData* samples, size_t count, uint32_t outputs)
+{
+    size_t ready = 0;
+
+    while (count > 0) {
+        size_t n = count < FUSION_BATCH_CHUNK ? count : FUSION_BATCH_CHUNK;
+
+        processChunk(samples, n, outputs, ready);
+        samples += n;
+        count -= n;
+    }
+
+    return ready;
+}
+
+void FusionEngine::processChunk(FusionData* samples, size_t count, uint32_t outputs,
+        size_t& ready)
+{
+    bool useGyro = outputs & (FUSION_GAME_RV | FUSION_LA_GRAVITY | FUSION_ROTATION_VECT);
+
+    if (useGyro) {
+        for (size_t i = 0; i < count; i++)
+            mChunkGyro[i] = samples[i].gyro;
+        GyroIntegration::computeSteps(mChunkSteps, mChunkGyro, count, mLastGyroTimestamp);
+        mLastGyroTimestamp = mChunkGyro[count - 1].timestamp;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        FusionData& fusionData = samples[i];
+        bool ok = true;
+
+#ifdef _ENABLE_MAGNETOMETER
+        if (outputs & (FUSION_GEOMAG_RV | FUSION_ROTATION_VECT))
+            ok = updateGeoMagRV(fusionData) && ok;
+#endif
+        if (outputs & (FUSION_GAME_RV | FUSION_LA_GRAVITY))
+            ok = mGameRV.processFusion(fusionData, mChunkSteps[i]) && ok;
+        if (outputs & FUSION_LA_GRAVITY)
+            ok = updateLinearAccelGravity(fusionData) && ok;
+#ifdef _ENABLE_MAGNETOMETER
+        if (outputs & FUSION_ROTATION_VECT) {
+            mRotationVect.processFusion(fusionData, !mGeomagRVReady, mChunkSteps[i]);
+            ok = mGeomagRVReady && ok;
+        }
+#endif
+        if (ok)
+            ready++;
+    }
+}
+
+void FusionEngine::reset(uint32_t outputs)
+{
+    if (outputs & FUSION_GAME_RV)
+        mGameRV.reset();
+    if (outputs & FUSION_LA_GRAVITY)
+        mLAGravity.reset();
+#ifdef _ENABLE_MAGNETOMETER
+    if (outputs & FUSION_GEOMAG_RV) {
+        mGeomagRV.reset();
+        mGeomagRVReady = false;
+    }
+    if (outputs & FUSION_ROTATION_VECT)
+        mRotationVect.reset();
+#endif
+}
+
+void FusionEngine::reset(uint32_t outputs, FusionData& fusionData)
+{
+    if (outputs & FUSION_GAME_RV)
+        mGameRV.processFusion(fusionData, true);
+    if (outputs & FUSION_LA_GRAVITY)
+        mLAGravity.processFusion(fusionData, true);
+#ifdef _ENABLE_MAGNETOMETER
+    if (outputs & FUSION_GEOMAG_RV)
+        mGeomagRV.processFusion(fusionData, true);
+    if (outputs & FUSION_ROTATION_VECT)
+        mRotationVect.processFusion(fusionData, true);
+#endif
+}
+
+bool FusionEngine::updateGameRV(FusionData& fusionData)
+{
+    return mGameRV.processFusion(fusionData, false);
+}
+
+bool FusionEngine::updateLinearAccelGravity(FusionData& fusionData)
+{
+    return mLAGravity.processFusion(fusionData, false);
+}
+
+#ifdef _ENABLE_MAGNETOMETER
+bool FusionEngine::updateGeoMagRV(FusionData& fusionData)
+{
+    mGeomagRVReady = mGeomagRV.processFusion(fusionData, false);
+    return mGeomagRVReady;
+}
+
+bool FusionEngine::updateRotationVector(FusionData& fusionData)
+{
+    mRotationVect.processFusion(fusionData, !mGeomagRVReady);
+    return mGeomagRVReady;
+}
+#endif
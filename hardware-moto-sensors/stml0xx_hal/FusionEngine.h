@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Copyright (C) 2016 Motorola Mobility LLC
+ */
+
+#ifndef FUSION_ENGINE_H
+#define FUSION_ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FusionSensorBase.h"
+#include "GameRotationVector.h"
+#include "GyroIntegration.h"
+#include "LinearAccelGravity.h"
+
+#ifdef _ENABLE_MAGNETOMETER
+#include "GeoMagRotationVector.h"
+#include "RotationVector.h"
+#endif
+
+/*!
+ * \brief One sensor fusion pipeline
+ *
+ * Owns the state of every fusion algorithm, so any number of pipelines can
+ * run side by side and each can be reset on its own. The HAL drives it one
+ * stage at a time as accel and gyro samples arrive. Offline users (trace
+ * replay, host tools) can push a whole batch through processFusion().
+ *
+ * Not thread safe. Each instance must be used by one thread at a time.
+ */
+class FusionEngine {
+public:
+    //! \brief Outputs requested from processFusion()
+    enum {
+        FUSION_GAME_RV          = 1 << 0,
+        FUSION_LA_GRAVITY       = 1 << 1,
+        FUSION_GEOMAG_RV        = 1 << 2,
+        FUSION_ROTATION_VECT    = 1 << 3,
+    };
+
+    FusionEngine();
+    ~FusionEngine();
+
+    /*!
+     * \brief Run the fusion stages selected by \c outputs over a batch
+     *
+     * Each sample holds the latest accel, gyro and mag readings at that
+     * point of the stream. The fused outputs are written back into the same
+     * sample. Samples are processed in order and the filter state carries
+     * over from one to the next. The gyro integration steps are computed
+     * FUSION_BATCH_CHUNK samples at a time with the vector kernels, and
+     * shared by the game RV and the 9-axis RV.
+     *
+     * \param[inout] samples batch of fusion inputs/outputs
+     * \param[in] count number of samples in \c samples
+     * \param[in] outputs mask of FUSION_* outputs to compute
+     * \returns number of samples for which every requested output was ready
+     */
+    size_t processFusion(FusionData* samples, size_t count, uint32_t outputs);
+
+    //! \brief Reset the fusion stages selected by \c outputs
+    void reset(uint32_t outputs);
+
+    /*!
+     * \brief Reset the selected stages and re-seed them from \c fusionData
+     *
+     * Same as the per-algorithm processFusion(fusionData, true) the HAL has
+     * always used when fusion sensors are disabled. The game RV and the
+     * 9-axis RV restart from the last sample, so the first sample after they
+     * are enabled again is filtered and integrated against it. The geomag RV
+     * is only reset, and the geomag-ready flag is left until the next accel
+     * sample updates it.
+     */
+    void reset(uint32_t outputs, FusionData& fusionData);
+
+    //! \brief Update fusionData.gameRotation from accel and gyro
+    bool updateGameRV(FusionData& fusionData);
+
+    //! \brief Update fusionData.gravity and linearAccel from the game RV
+    bool updateLinearAccelGravity(FusionData& fusionData);
+
+#ifdef _ENABLE_MAGNETOMETER
+    //! \brief Update fusionData.geoMagRotation from accel and mag
+    bool updateGeoMagRV(FusionData& fusionData);
+
+    /*!
+     * \brief Update fusionData.rotationVector from the geomag RV and gyro
+     *
+     * The 9-axis integration is held in reset until the geomag RV is ready.
+     */
+    bool updateRotationVector(FusionData& fusionData);
+#endif
+
+private:
+    static const size_t FUSION_BATCH_CHUNK = 64;
+
+    void processChunk(FusionData* samples, size_t count, uint32_t outputs, size_t& ready);
+
+    GameRotationVector mGameRV;
+    LinearAccelGravity mLAGravity;
+#ifdef _ENABLE_MAGNETOMETER
+    GeoMagRotationVector mGeomagRV;
+    bool mGeomagRVReady;
+    RotationVector mRotationVect;
+#endif
+
+    //! gyro timestamp the next batch step is measured from
+    int64_t mLastGyroTimestamp;
+    CartData mChunkGyro[FUSION_BATCH_CHUNK];
+    struct GyroIntegrationStep mChunkSteps[FUSION_BATCH_CHUNK];
+};
+
+#endif // FUSION_ENGINE_H
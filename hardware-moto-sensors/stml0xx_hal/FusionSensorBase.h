@@ -113,6 +113,14 @@ typedef struct {
  */
 #define NINE_AXIS_FILTER_SELECT_THRESH (0.5f)
 
+/*!
+ * \brief Gyro integration step when the gyro timestamp has not advanced
+ *
+ * This is the fastest gyro rate the sensor hub reports (GYRO_MIN_DELAY_US).
+ * It is repeated here so the fusion code does not depend on the HAL headers.
+ */
+#define GYRO_INTEGRATION_DEFAULT_DT_US (5000)
+
 
 class FusionSensorBase {
 public:
@@ -128,6 +136,11 @@ public:
      */
     virtual bool processFusion(FusionData& fusionData, bool reset) = 0;
 
+    /*!
+     * \brief Re-initialize the fusion algorithm without processing a sample
+     */
+    virtual void reset() {};
+
 protected:
 };
 
@@ -23,13 +23,10 @@
 #include <string.h>
 #include <log/log.h>
 #include "GameRotationVector.h"
-#include "GyroIntegration.h"
 #include "Quaternion.h"
-#include "SensorList.h"
-
-GameRotationVector GameRotationVector::self;
 
 GameRotationVector::GameRotationVector()
+: mState()
 {
 }
 
@@ -37,9 +34,10 @@ GameRotationVector::~GameRotationVector()
 {
 }
 
-GameRotationVector *GameRotationVector::getInstance()
+void GameRotationVector::reset()
 {
-    return &self;
+    mState.gis.initialized = 0;
+    mState.initialized = 0;
 }
 
 int GameRotationVector::permSort(size_t* p, float* a, size_t const len)
@@ -87,23 +85,32 @@ int GameRotationVector::permSort(size_t* p, float* a, size_t const len)
 }
 
 bool GameRotationVector::processFusion(FusionData& fusionData, bool reset)
+{
+    if (reset)
+        this->reset();
+
+    return update(fusionData, NULL);
+}
+
+bool GameRotationVector::processFusion(FusionData& fusionData,
+        const struct GyroIntegrationStep& step)
+{
+    return update(fusionData, &step);
+}
+
+bool GameRotationVector::update(FusionData& fusionData, const struct GyroIntegrationStep* step)
 {
     /************************Internal state variables*************************/
-    static struct GyroIntegrationState gis;
-    static int initialized;
-    static float nRaw[3];
-    static float h[3];
+    struct GyroIntegrationState& gis = mState.gis;
+    int& initialized = mState.initialized;
+    float (&nRaw)[3] = mState.nRaw;
+    float (&h)[3] = mState.h;
     /*************************************************************************/
 
     float n[3];
     float m[3];
     size_t nPerm[3];
 
-    if (reset) {
-        gis.initialized = 0;
-        initialized = 0;
-    }
-
     n[0] = fusionData.accel.x;
     n[1] = fusionData.accel.y;
     n[2] = fusionData.accel.z;
@@ -191,7 +198,10 @@ bool GameRotationVector::processFusion(FusionData& fusionData, bool reset)
     fusionData.gameRotation.d = 0.5f * r;
     fusionData.gameRotation.accuracy = 0;
 
-    GyroIntegration::integrate( &gis, fusionData.gameRotation, fusionData.gameRotation, fusionData );
+    if (step)
+        GyroIntegration::integrate( &gis, fusionData.gameRotation, fusionData.gameRotation, *step );
+    else
+        GyroIntegration::integrate( &gis, fusionData.gameRotation, fusionData.gameRotation, fusionData );
 
     // Notice here that quatGame[3] >= 0 by construction, implying the rotation
     // angle encoded by the quaternion is in [-pi/2, pi/2).
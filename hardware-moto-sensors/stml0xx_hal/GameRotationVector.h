@@ -21,16 +21,16 @@
 #ifndef GAME_ROTATION_VECTOR_H
 #define GAME_ROTATION_VECTOR_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include "FusionSensorBase.h"
+#include "GyroIntegration.h"
 
 class GameRotationVector : public FusionSensorBase {
 public:
     GameRotationVector();
     virtual ~GameRotationVector();
 
-    static GameRotationVector* getInstance();
-
     /*!
      * \brief Process accel and gyro samples to compute game rotation vector
      * \param[out] fusionData Stores computed data into fusionData.gameRotation as follows:
@@ -44,8 +44,26 @@ public:
      */
     bool processFusion(FusionData& fusionData, bool reset);
 
+    /*!
+     * \brief Same as processFusion() with a precomputed gyro step
+     * \see GyroIntegration::computeSteps()
+     */
+    bool processFusion(FusionData& fusionData, const struct GyroIntegrationStep& step);
+
+    void reset();
+
 private:
-    static GameRotationVector self;
+    bool update(FusionData& fusionData, const struct GyroIntegrationStep* step);
+
+    //! \brief Filter state, cleared on reset
+    struct State {
+        struct GyroIntegrationState gis;
+        int initialized;
+        float nRaw[3];  //!< low-passed accel
+        float h[3];     //!< "east" vector
+    };
+
+    State mState;
 
     /*!
      * \brief Sort by absolute value in descending order with permutation
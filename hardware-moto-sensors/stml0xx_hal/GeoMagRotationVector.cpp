@@ -24,35 +24,30 @@
 #include <log/log.h>
 #include "GeoMagRotationVector.h"
 #include "Quaternion.h"
-#include "SensorList.h"
-
-GeoMagRotationVector GeoMagRotationVector::self;
 
 GeoMagRotationVector::GeoMagRotationVector()
+: mState()
 {
+    mState.mag_cnt = MAG_COUNTS;
 }
 
 GeoMagRotationVector::~GeoMagRotationVector()
 {
 }
 
-GeoMagRotationVector *GeoMagRotationVector::getInstance()
+void GeoMagRotationVector::reset()
 {
-    return &self;
+    mState.initialized = false;
+    mState.mag_cnt = MAG_COUNTS;
 }
 
 bool GeoMagRotationVector::processFusion(FusionData& fusionData, bool reset)
 {
-    /* this guarantees that at least n-1 mag samples have been
-       processed before reporting that the 6-axis is initialized
-    */
-    const uint8_t MAG_COUNTS = 10;
-
     /************************Internal state variables*************************/
-    static bool initialized = false;
-    static uint8_t mag_cnt = MAG_COUNTS;
-    static float nRaw[3];
-    static float mRaw[3];
+    bool& initialized = mState.initialized;
+    uint8_t& mag_cnt = mState.mag_cnt;
+    float (&nRaw)[3] = mState.nRaw;
+    float (&mRaw)[3] = mState.mRaw;
     /*************************************************************************/
 
     float n[3];
@@ -63,8 +58,7 @@ bool GeoMagRotationVector::processFusion(FusionData& fusionData, bool reset)
     float r;
 
     if (reset) {
-        initialized = false;
-        mag_cnt = MAG_COUNTS;
+        this->reset();
         return initialized;
     }
 
@@ -29,12 +29,25 @@ public:
     GeoMagRotationVector();
     virtual ~GeoMagRotationVector();
 
-    static GeoMagRotationVector* getInstance();
-
     bool processFusion(FusionData& fusionData, bool reset);
 
+    void reset();
+
 private:
-    static GeoMagRotationVector self;
+    /* this guarantees that at least n-1 mag samples have been
+       processed before reporting that the 6-axis is initialized
+    */
+    static const uint8_t MAG_COUNTS = 10;
+
+    //! \brief Filter state, cleared on reset
+    struct State {
+        bool initialized;
+        uint8_t mag_cnt;
+        float nRaw[3];  //!< low-passed accel
+        float mRaw[3];  //!< low-passed mag
+    };
+
+    State mState;
 };
 
 #endif // GEOMAG_ROTATION_VECTOR_H
@@ -25,21 +25,20 @@
 #include "FusionSensorBase.h"
 #include "GyroIntegration.h"
 #include "Quaternion.h"
-#include "SensorList.h"
+#include "QuaternionSimd.h"
 
-void GyroIntegration::integrate(
-    struct GyroIntegrationState* gis,
-    QuatData& rvOut,
-    const QuatData& rvIn,
-    FusionData& fusionData
-)
+/*
+ * \brief Step for one gyro sample
+ *
+ * \param[in] dt integration interval (s)
+ */
+static void computeStep1(struct GyroIntegrationStep* step, float dt)
 {
-    // Time (s) from the last call to this function.
-    float dt;
+    QuatData& q = step->quatGyroDelta;
     // Last gyro sample (rad/s)
-    float gyroX;
-    float gyroY;
-    float gyroZ;
+    float gyroX = step->gyro.x;
+    float gyroY = step->gyro.y;
+    float gyroZ = step->gyro.z;
     // Magnitude of gyro vector above.
     float gyroMag;
     // \theta/2, where \theta is the rotation angle implied by the gyro
@@ -48,32 +47,7 @@ void GyroIntegration::integrate(
     // Trig
     float sinHalfTheta;
     float cosHalfTheta;
-    // Incremental rotation quaternion implied by (gyroX,gyroY,gyroZ).
-    QuatData quatGyroDelta;
-    float nine_axis_filter;
-
-    // If it becomes necessary to reset the RV, provide a call
-    // to set gis->initialized=0 and done.
-    if ( !gis->initialized ) {
-        gis->quatGyro.a = rvIn.a;
-        gis->quatGyro.b = rvIn.b;
-        gis->quatGyro.c = rvIn.c;
-        gis->quatGyro.d = rvIn.d;
-        gis->quatGyro.timestamp = rvIn.timestamp;
-        gis->initialized = 1;
-    }
 
-    // 1) Forward-integrate the gyro
-    if (fusionData.gyro.timestamp != gis->quatGyro.timestamp) {
-        dt = (float)(fusionData.gyro.timestamp - gis->quatGyro.timestamp) / 1000000000.f;
-        gis->quatGyro.timestamp = fusionData.gyro.timestamp;
-    } else {
-        dt = (float)GYRO_MIN_DELAY_US / 1000000.f;
-    }
-
-    gyroX = fusionData.gyro.x;
-    gyroY = fusionData.gyro.y;
-    gyroZ = fusionData.gyro.z;
     // Normalize the gyro vector if we can do so with single precision.
     gyroMag = gyroX*gyroX + gyroY*gyroY + gyroZ*gyroZ;
     // NOTE: the tolerance should be at least approximately machineEps^2,
@@ -91,27 +65,181 @@ void GyroIntegration::integrate(
     }
 
     // Construct incremental gyro rotation quaternion
-    sinHalfTheta = sinf(halfTheta);
-    cosHalfTheta = cosf(halfTheta);
-    quatGyroDelta.a = sinHalfTheta * gyroX;
-    quatGyroDelta.b = sinHalfTheta * gyroY;
-    quatGyroDelta.c = sinHalfTheta * gyroZ;
-    quatGyroDelta.d = cosHalfTheta;
-    Quaternion::renormalize(quatGyroDelta);
+    if (fabsf(halfTheta) <= QV_SMALL_ANGLE_MAX) {
+        qv_sincos_small1(halfTheta, &sinHalfTheta, &cosHalfTheta);
+    } else {
+        sinHalfTheta = sinf(halfTheta);
+        cosHalfTheta = cosf(halfTheta);
+    }
+    q.a = sinHalfTheta * gyroX;
+    q.b = sinHalfTheta * gyroY;
+    q.c = sinHalfTheta * gyroZ;
+    q.d = cosHalfTheta;
+    Quaternion::renormalize(q);
+    step->gyroMag = gyroMag;
+}
+
+/*
+ * \brief Steps for 4 gyro samples, one per vector lane
+ *
+ * Same math as computeStep1().
+ *
+ * \param[in] dt integration interval (s) of each sample
+ */
+static void computeSteps4(struct GyroIntegrationStep* steps, const float* dt)
+{
+    float mag2[4], mag[4], halfTheta[4], norm2[4];
+    float qa[4], qb[4], qc[4], qd[4];
+    int i;
+
+    qvec4 vx = qv_set(steps[0].gyro.x, steps[1].gyro.x, steps[2].gyro.x, steps[3].gyro.x);
+    qvec4 vy = qv_set(steps[0].gyro.y, steps[1].gyro.y, steps[2].gyro.y, steps[3].gyro.y);
+    qvec4 vz = qv_set(steps[0].gyro.z, steps[1].gyro.z, steps[2].gyro.z, steps[3].gyro.z);
+    qvec4 vmag2 = qv_madd(qv_madd(qv_mul(vx, vx), vy, vy), vz, vz);
+    // Clamp so that samples too small to normalize do not produce NaNs.
+    // They are redone by computeStep1() below.
+    qvec4 vmag = qv_sqrt(qv_max(vmag2, qv_dup((float)1e-5)));
+    qvec4 vdt = qv_set(dt[0], dt[1], dt[2], dt[3]);
+    qvec4 vhalfTheta = qv_mul(qv_mul(vdt, vmag), qv_dup(0.5f));
+    qvec4 vsin, vcos;
+    qv_sincos_small(vhalfTheta, &vsin, &vcos);
+    // sin(theta/2) / |gyro|, applied to the raw gyro axis
+    qvec4 vscale = qv_div(vsin, vmag);
+    qvec4 va = qv_mul(vscale, vx);
+    qvec4 vb = qv_mul(vscale, vy);
+    qvec4 vc = qv_mul(vscale, vz);
+    qvec4 vnorm2 = qv_madd(qv_madd(qv_madd(qv_mul(va, va), vb, vb), vc, vc), vcos, vcos);
+
+    qv_store(mag2, vmag2);
+    qv_store(mag, vmag);
+    qv_store(halfTheta, vhalfTheta);
+    qv_store(norm2, vnorm2);
+    qv_store(qa, va);
+    qv_store(qb, vb);
+    qv_store(qc, vc);
+    qv_store(qd, vcos);
+
+    for (i = 0; i < 4; i++) {
+        QuatData& q = steps[i].quatGyroDelta;
+
+        if (!(mag2[i] > (float)1e-5) || fabsf(halfTheta[i]) > QV_SMALL_ANGLE_MAX) {
+            // No rotation, or a long gap between samples that is outside
+            // the range of the series.
+            computeStep1(&steps[i], dt[i]);
+            continue;
+        }
+        q.a = qa[i];
+        q.b = qb[i];
+        q.c = qc[i];
+        q.d = qd[i];
+        // Unit by construction; only renormalize() what drifted (cf. MAG_TOL)
+        if (fabsf(norm2[i] - 1.f) > 0.0001f)
+            Quaternion::renormalize(q);
+        steps[i].gyroMag = mag[i];
+    }
+}
+
+void GyroIntegration::computeSteps(
+    struct GyroIntegrationStep* steps,
+    const CartData* gyro,
+    size_t count,
+    int64_t prevTimestamp
+)
+{
+    float dt[4];
+    size_t i, j;
+
+    for (i = 0; i < count; i += 4) {
+        size_t n = count - i < 4 ? count - i : 4;
+
+        for (j = 0; j < n; j++) {
+            struct GyroIntegrationStep& step = steps[i + j];
+            const CartData& g = gyro[i + j];
+
+            step.gyro = g;
+            step.prevTimestamp = prevTimestamp;
+            step.quatGyroDelta.accuracy = 0.f;
+            step.quatGyroDelta.timestamp = g.timestamp;
+            if (g.timestamp != prevTimestamp)
+                dt[j] = (float)(g.timestamp - prevTimestamp) / 1000000000.f;
+            else
+                dt[j] = (float)GYRO_INTEGRATION_DEFAULT_DT_US / 1000000.f;
+            prevTimestamp = g.timestamp;
+        }
+
+        if (n == 4) {
+            computeSteps4(&steps[i], dt);
+        } else {
+            for (j = 0; j < n; j++)
+                computeStep1(&steps[i + j], dt[j]);
+        }
+    }
+}
+
+static void initState(struct GyroIntegrationState* gis, const QuatData& rvIn)
+{
+    // If it becomes necessary to reset the RV, provide a call
+    // to set gis->initialized=0 and done.
+    if ( !gis->initialized ) {
+        gis->quatGyro.a = rvIn.a;
+        gis->quatGyro.b = rvIn.b;
+        gis->quatGyro.c = rvIn.c;
+        gis->quatGyro.d = rvIn.d;
+        gis->quatGyro.timestamp = rvIn.timestamp;
+        gis->initialized = 1;
+    }
+}
+
+void GyroIntegration::integrate(
+    struct GyroIntegrationState* gis,
+    QuatData& rvOut,
+    const QuatData& rvIn,
+    FusionData& fusionData
+)
+{
+    struct GyroIntegrationStep step;
+
+    initState(gis, rvIn);
+
+    computeSteps(&step, &fusionData.gyro, 1, gis->quatGyro.timestamp);
+    integrate(gis, rvOut, rvIn, step);
+}
+
+void GyroIntegration::integrate(
+    struct GyroIntegrationState* gis,
+    QuatData& rvOut,
+    const QuatData& rvIn,
+    const struct GyroIntegrationStep& step
+)
+{
+    struct GyroIntegrationStep fresh;
+    const struct GyroIntegrationStep* s = &step;
+    float nine_axis_filter;
+
+    initState(gis, rvIn);
+
+    // The step must be measured from where this integrator left off
+    if (s->prevTimestamp != gis->quatGyro.timestamp) {
+        computeSteps(&fresh, &step.gyro, 1, gis->quatGyro.timestamp);
+        s = &fresh;
+    }
+
+    // 1) Forward-integrate the gyro
+    gis->quatGyro.timestamp = s->quatGyroDelta.timestamp;
 
     // Multiply to apply incremental rotation (integration). The order is
     // first to rotate by quatGyro, then apply incremental rotation
     // quatGyroDelta. So, we update quatGyro with the argument
     // quatGyroDelta on the right, and quatGyro on the left.
     //   newQuatGyro = quatGyro * quatGyroDelta
-    if (Quaternion::mul(gis->quatGyro, gis->quatGyro, quatGyroDelta)) {
+    if (Quaternion::mul(gis->quatGyro, gis->quatGyro, s->quatGyroDelta)) {
         ALOGD("gyroIntegration: quatMul bad");
         gis->initialized = 0;
         return;
     }
 
     // Select an alpha depending on how fast we are rotating
-    if (gyroMag < NINE_AXIS_FILTER_SELECT_THRESH)
+    if (s->gyroMag < NINE_AXIS_FILTER_SELECT_THRESH)
         nine_axis_filter = NINE_AXIS_FILTER_ALPHA_SLOW;
     else
         nine_axis_filter = NINE_AXIS_FILTER_ALPHA_FAST;
@@ -21,6 +21,7 @@
 #ifndef GYRO_INTEGRATION_H
 #define GYRO_INTEGRATION_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "FusionSensorBase.h"
@@ -36,8 +37,61 @@ struct GyroIntegrationState
     QuatData quatGyro;
 };
 
+/*
+ * \brief Incremental rotation implied by one gyro sample
+ *
+ * Depends only on the gyro stream, so a batch of steps can be computed up
+ * front and applied to any number of integrators.
+ *
+ * \see \c GyroIntegration::computeSteps()
+ */
+struct GyroIntegrationStep
+{
+    //! the gyro sample
+    CartData gyro;
+    //! incremental rotation, with the timestamp of the gyro sample
+    QuatData quatGyroDelta;
+    //! gyro magnitude (rad/s) used to pick the 9-axis filter alpha, or its
+    //! square when too small to normalize
+    float gyroMag;
+    //! timestamp the integration interval was measured from
+    int64_t prevTimestamp;
+};
+
 class GyroIntegration {
 public:
+    /*
+     * \brief Compute integration steps for a batch of gyro samples
+     *
+     * Sample i is integrated from the timestamp of sample i-1, and sample 0
+     * from \c prevTimestamp. Four samples are processed at a time with the
+     * vector kernels in QuaternionSimd.h.
+     *
+     * \param[out] steps array of \c count steps
+     * \param[in] gyro array of \c count gyro samples
+     * \param[in] count number of samples
+     * \param[in] prevTimestamp timestamp before the first sample
+     */
+    static void computeSteps(
+        struct GyroIntegrationStep* steps,
+        const CartData* gyro,
+        size_t count,
+        int64_t prevTimestamp
+    );
+
+    /*
+     * \brief Same as \c integrate() with a precomputed step
+     *
+     * If \c step was measured from a different timestamp than the one in
+     * \c gis (e.g. after a reset), it is recomputed.
+     */
+    static void integrate(
+        struct GyroIntegrationState* gis,
+        QuatData& rvOut,
+        const QuatData& rvIn,
+        const struct GyroIntegrationStep& step
+    );
+
     /*
      * \brief Use gyro to integrate a rotation vector forward
      *
@@ -18,7 +18,9 @@
  * Copyright (C) 2011-2016 Motorola Mobility LLC
  */
 
+#include <algorithm>
 #include <assert.h>
+#include <inttypes.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <math.h>
@@ -50,12 +52,24 @@
 HubSensors HubSensors::self;
 
 HubSensors::HubSensors()
-: SensorBase(SENSORHUB_DEVICE_NAME, NULL, SENSORHUB_AS_DATA_NAME),
+: HubSensors(sensorTraceOpenReplay())
+{
+}
+
+HubSensors::HubSensors(int replayFd)
+: SensorBase(replayFd < 0 ? SENSORHUB_DEVICE_NAME : NULL, NULL,
+        replayFd < 0 ? SENSORHUB_AS_DATA_NAME : NULL),
     mEnabled(0),
     mWakeEnabled(0),
     mPendingMask(0),
     mEnabledHandles(0),
-    mPendingBug2go(0)
+    mPendingBug2go(0),
+    mSentBug2goSec(0),
+    mTrace(SensorTraceRecorder::create("stml0xx", sizeof(struct stml0xx_android_sensor_data),
+            offsetof(struct stml0xx_android_sensor_data, type))),
+    mReplayStats(),
+    mReplaying(replayFd >= 0),
+    nextPendingEvent(0)
 {
     // read the actual value of all sensors if they're enabled already
     struct input_absinfo absinfo;
@@ -67,12 +81,21 @@ HubSensors::HubSensors()
 
     static_assert(MAX_SENSOR_ID < (sizeof(mEnabledHandles) * CHAR_BIT),
         "enabled handlers bit mask can NOT hold all the handles");
+    static_assert(GYRO_INTEGRATION_DEFAULT_DT_US == GYRO_MIN_DELAY_US,
+        "gyro integration step must match the fastest gyro rate");
 
     memset(mErrorCnt, 0, sizeof(mErrorCnt));
 #ifdef _ENABLE_GYROSCOPE
     memset(mGyroCal, 0, sizeof(mGyroCal));
 #endif
     memset(mAccelCal, 0, sizeof(mAccelCal));
+    memset(&mReadStats, 0, sizeof(mReadStats));
+    initDecoders();
+
+    if (mReplaying) {
+        data_fd = replayFd;
+        mReplayStats = SensorReplayStats::create();
+    }
 
     open_device();
 
@@ -117,20 +140,11 @@ HubSensors::HubSensors()
             ALOGE("Gyro Cal file read failed");
             memset(mGyroCal, 0, sizeof(mGyroCal));
         } else {
-            err = ioctl(dev_fd, STML0XX_IOCTL_SET_GYRO_CAL, mGyroCal);
+            err = hubIoctl(STML0XX_IOCTL_SET_GYRO_CAL, mGyroCal);
             if (err < 0)
                 ALOGE("Can't send Gyro Cal data");
         }
     }
-
-    mGameRV = GameRotationVector::getInstance();
-    mLAGravity = LinearAccelGravity::getInstance();
-#endif
-
-#ifdef _ENABLE_MAGNETOMETER
-    mGeomagRV = GeoMagRotationVector::getInstance();
-    mGeomagRVReady = 0;
-    mRotationVect = RotationVector::getInstance();
 #endif
 
     if ((fp = fopen(ACCEL_CAL_FILE, "r")) != NULL) {
@@ -140,17 +154,17 @@ HubSensors::HubSensors()
             ALOGE("Accel Cal file read failed");
             memset(mAccelCal, 0, sizeof(mAccelCal));
         } else {
-            err = ioctl(dev_fd, STML0XX_IOCTL_SET_ACCEL_CAL, mAccelCal);
+            err = hubIoctl(STML0XX_IOCTL_SET_ACCEL_CAL, mAccelCal);
             if (err < 0)
                 ALOGE("Can't send Accel Cal data");
         }
     }
 
-    if (!ioctl(dev_fd, STML0XX_IOCTL_GET_SENSORS, &flags16))  {
+    if (!hubIoctl(STML0XX_IOCTL_GET_SENSORS, &flags16))  {
         mEnabled = flags16;
     }
 
-    if (!ioctl(dev_fd, STML0XX_IOCTL_GET_WAKESENSORS, &flags24))  {
+    if (!hubIoctl(STML0XX_IOCTL_GET_WAKESENSORS, &flags24))  {
         mWakeEnabled = flags24;
     }
 }
@@ -164,6 +178,23 @@ HubSensors *HubSensors::getInstance()
     return &self;
 }
 
+int HubSensors::hubIoctl(unsigned long request, void *arg)
+{
+    if (!mReplaying)
+        return ioctl(dev_fd, request, arg);
+
+    switch (request) {
+        case STML0XX_IOCTL_GET_SENSORS:
+        case STML0XX_IOCTL_GET_WAKESENSORS:
+        case STML0XX_IOCTL_GET_GYRO_CAL:
+        case STML0XX_IOCTL_GET_ACCEL_CAL:
+            // Nothing to read back, and no calibration to save
+            return -ENODEV;
+        default:
+            return 0;
+    }
+}
+
 bool HubSensors::isHandleEnabled(uint64_t handle)
 {
     return (mEnabledHandles & ((decltype(mEnabledHandles))1 << handle)) != 0;
@@ -305,7 +336,7 @@ int HubSensors::setEnable(int32_t handle, int en)
 #endif
 
         if (new_enabled != mEnabled) {
-            err = ioctl(dev_fd, STML0XX_IOCTL_SET_SENSORS, &new_enabled);
+            err = hubIoctl(STML0XX_IOCTL_SET_SENSORS, &new_enabled);
             ALOGE_IF(err, "Could not change sensor state (%s)", strerror(-err));
             // Never return this error to the caller. This would result in a
             // failure to registerListener(), but regardless of failure, we
@@ -319,9 +350,9 @@ int HubSensors::setEnable(int32_t handle, int en)
         // the 9-axis RV to reset until mag samples have been received.
         // If only the 9-axis RV has been disabled, reset it directly
         if (!mFusionSensors[GEOMAG_RV].enabled) {
-            mGeomagRV->processFusion(mFusionData, true);
+            mFusion.reset(FusionEngine::FUSION_GEOMAG_RV, mFusionData);
         } else if (!mFusionSensors[ROTATION_VECT].enabled) {
-            mRotationVect->processFusion(mFusionData, true);
+            mFusion.reset(FusionEngine::FUSION_ROTATION_VECT, mFusionData);
         }
 #endif
 #ifdef _ENABLE_GYROSCOPE
@@ -329,7 +360,7 @@ int HubSensors::setEnable(int32_t handle, int en)
         if (!mFusionSensors[GAME_RV].enabled &&
             !mFusionSensors[LINEAR_ACCEL].enabled &&
             !mFusionSensors[GRAVITY].enabled) {
-            mGameRV->processFusion(mFusionData, true);
+            mFusion.reset(FusionEngine::FUSION_GAME_RV, mFusionData);
         }
 #endif
     }
@@ -428,7 +459,7 @@ int HubSensors::setEnable(int32_t handle, int en)
     }
 
     if (found && (new_enabled != mWakeEnabled)) {
-        err = ioctl(dev_fd, STML0XX_IOCTL_SET_WAKESENSORS, &new_enabled);
+        err = hubIoctl(STML0XX_IOCTL_SET_WAKESENSORS, &new_enabled);
         ALOGE_IF(err, "Could not change wake sensor state (%s)", strerror(-err));
         // Never return this error to the caller. This would result in a
         // failure to registerListener(), but regardless of failure, we
@@ -491,11 +522,11 @@ int HubSensors::setDelay(int32_t handle, int64_t ns)
 #endif
 #ifdef _ENABLE_ACCEL_SECONDARY
         case ID_A2:
-            err = ioctl(dev_fd, STML0XX_IOCTL_SET_ACC2_DELAY, &delay);
+            err = hubIoctl(STML0XX_IOCTL_SET_ACC2_DELAY, &delay);
             break;
 #endif
         case ID_L:
-            err = ioctl(dev_fd, STML0XX_IOCTL_SET_ALS_DELAY, &delay);
+            err = hubIoctl(STML0XX_IOCTL_SET_ALS_DELAY, &delay);
             break;
         case ID_DR:
         case ID_P:
@@ -537,7 +568,7 @@ int HubSensors::setDelay(int32_t handle, int64_t ns)
             else if (delay > 3600) // 1 hour
                 delay = 3600;
 
-            err = ioctl(dev_fd, STML0XX_IOCTL_SET_STEP_COUNTER_DELAY, &delay);
+            err = hubIoctl(STML0XX_IOCTL_SET_STEP_COUNTER_DELAY, &delay);
             break;
         case ID_STEP_DETECTOR:
             err = 0;
@@ -591,477 +622,714 @@ void HubSensors::logAlsEvent(int32_t lux, int64_t ts_ns) {
 
 int HubSensors::readEvents(sensors_event_t* d, int dLen)
 {
-    struct stml0xx_android_sensor_data buff;
     int ret;
     char timeBuf[32];
     struct tm* ptm = NULL;
     struct timeval timeutc;
-    static long int sent_bug2go_sec = 0;
     sensors_event_t* data = d;
-    FILE *fp;
-    int size;
-
-    // Ensure there are at least 4 slots free in the buffer
-    // The following sensors populate multiple events per read:
-    // DT_GYRO - upto 4 events
-    // DT_GLANCE - upto 2 events
-    sensors_event_t const* const dataEnd = d + dLen - 3;
+    sensors_event_t const* const dataEnd = d + dLen;
 
     if (dLen < 1) {
         ALOGE("HubSensors::readEvents - bad length %d", dLen);
         return 0;
     }
 
-    while (data < dataEnd && ((ret = read(data_fd, &buff, sizeof(struct stml0xx_android_sensor_data))) != 0)) {
-        /* Sensorhub reset occurred, upload a bug2go if its been at least 10mins since previous bug2go*/
-        /* remove this if-clause when corruption issue resolved */
-        switch (buff.type) {
-            case DT_FLUSH:
-                data->version = META_DATA_VERSION;
-                data->sensor = 0;
-                data->type = SENSOR_TYPE_META_DATA;
-                data->reserved0 = 0;
-                data->timestamp = 0;
-                data->meta_data.what = META_DATA_FLUSH_COMPLETE;
-                data->meta_data.sensor = STM32TOH(buff.data + FLUSH);
-                data++;
-                break;
-            case DT_ACCEL:
-                mFusionData.accel.x = STM16TOH(buff.data+ACCEL_X) * CONVERT_A_X;
-                mFusionData.accel.y = STM16TOH(buff.data+ACCEL_Y) * CONVERT_A_Y;
-                mFusionData.accel.z = STM16TOH(buff.data+ACCEL_Z) * CONVERT_A_Z;
-                mFusionData.accel.timestamp = buff.timestamp;
-                if (mFusionSensors[ACCEL].enabled) {
-                    data->version = SENSORS_EVENT_T_SIZE;
-                    data->sensor = SENSORS_HANDLE_BASE + ID_A;
-                    data->type = SENSOR_TYPE_ACCELEROMETER;
-                    data->acceleration.x = mFusionData.accel.x;
-                    data->acceleration.y = mFusionData.accel.y;
-                    data->acceleration.z = mFusionData.accel.z;
-                    data->acceleration.status = SENSOR_STATUS_ACCURACY_HIGH;
-                    data->timestamp = mFusionData.accel.timestamp;
-                    data++;
+    while (data < dataEnd && nextPendingEvent < pendingEvents.size()) {
+        *data++ = pendingEvents[nextPendingEvent++];
+        if (nextPendingEvent == pendingEvents.size()) {
+            pendingEvents.clear();
+            nextPendingEvent = 0;
+        }
+    }
+
+    while (data < dataEnd) {
+        // Read as many records as there are free slots, most records decode
+        // to a single event.
+        size_t count = std::min<size_t>(HUB_READ_BATCH, dataEnd - data);
+
+        ret = read(data_fd, mReadBuf, count * sizeof(mReadBuf[0]));
+        mReadStats.reads++;
+        if (ret < 0) {
+            // EAGAIN: a replay FIFO (sensorTraceOpenReplay()) that was drained
+            ALOGE_IF(errno != EAGAIN, "Error reading data_fd (%s)", strerror(errno));
+            break;
+        } else if (ret == 0) {
+            break;
+        }
+
+        if (mTrace) {
+            mTrace->write(mReadBuf, ret);
+        }
+
+        size_t records = ret / sizeof(mReadBuf[0]);
+        if (ret % sizeof(mReadBuf[0])) {
+            ALOGE("Dropping partial record of %zu bytes", ret % sizeof(mReadBuf[0]));
+        }
+
+        int64_t decodeStart = getTimestamp();
+        if (mReplayStats) {
+            mReplayStats->beginRead();
+        }
+        for (size_t i = 0; i < records; i++) {
+            const struct stml0xx_android_sensor_data& buff = mReadBuf[i];
+            Decoder decode = mDecoders[buff.type];
+            int64_t recordStart = mReplayStats ? getTimestamp() : 0;
+
+            if (decode == NULL) {
+                continue;
+            } else if (dataEnd - data >= HUB_MAX_EVENTS_PER_RECORD) {
+                sensors_event_t* first = data;
+                data = (this->*decode)(buff, data, dataEnd);
+                if (mReplayStats) {
+                    mReplayStats->addEvents(first, data, getTimestamp() - recordStart);
                 }
-#ifdef _ENABLE_MAGNETOMETER
-                if (mFusionSensors[GEOMAG_RV].enabled || mFusionSensors[ROTATION_VECT].enabled) {
-                    mGeomagRVReady = mGeomagRV->processFusion(mFusionData, false);
-                    if (mFusionSensors[GEOMAG_RV].enabled) {
-                        data->version = SENSORS_EVENT_T_SIZE;
-                        data->sensor = SENSORS_HANDLE_BASE + ID_GEOMAG_RV;
-                        data->type = SENSOR_TYPE_GEOMAGNETIC_ROTATION_VECTOR;
-                        data->data[0] = mFusionData.geoMagRotation.a;
-                        data->data[1] = mFusionData.geoMagRotation.b;
-                        data->data[2] = mFusionData.geoMagRotation.c;
-                        data->data[3] = mFusionData.geoMagRotation.d;
-                        data->data[4] = mFusionData.geoMagRotation.accuracy;
-                        data->timestamp = mFusionData.geoMagRotation.timestamp;
-                        data++;
+            } else {
+                // Not enough room for every event the record may decode to,
+                // the ones which do not fit go to pendingEvents.
+                sensors_event_t overflow[HUB_MAX_EVENTS_PER_RECORD];
+                sensors_event_t* overflowEnd =
+                    (this->*decode)(buff, overflow, overflow + HUB_MAX_EVENTS_PER_RECORD);
+                if (mReplayStats) {
+                    mReplayStats->addEvents(overflow, overflowEnd, getTimestamp() - recordStart);
+                }
+                for (sensors_event_t* e = overflow; e < overflowEnd; e++) {
+                    if (data < dataEnd) {
+                        *data++ = *e;
+                    } else {
+                        pendingEvents.push_back(*e);
                     }
                 }
-#endif
-                break;
+            }
+        }
+        if (mReplayStats) {
+            mReplayStats->endRead(records);
+        }
+        mReadStats.records += records;
+        mReadStats.decodeNs += getTimestamp() - decodeStart;
+        if (records > mReadStats.maxBatch) {
+            mReadStats.maxBatch = records;
+        }
+        if (mReadStats.reads % HUB_READ_STATS_PERIOD == 0) {
+            logReadStats();
+        }
+    }
+    if (mPendingBug2go == 1) {
+        time(&timeutc.tv_sec);
+        if (timeutc.tv_sec - mSentBug2goSec > 24*60*60) {
+            // put timestamp in dropbox file
+            ptm = localtime(&(timeutc.tv_sec));
+            if (ptm != NULL) {
+                strftime(timeBuf, sizeof(timeBuf), "%m-%d %H:%M:%S", ptm);
+                capture_dump(timeBuf, DT_RESET, SENSORHUB_DUMPFILE,
+                    DROPBOX_FLAG_TEXT | DROPBOX_FLAG_GZIP);
+            }
+            mSentBug2goSec = timeutc.tv_sec;
+            mPendingBug2go = 0;
+        }
+    }
+
+    return data - d;
+}
+
+void HubSensors::logReadStats()
+{
+    ALOGD("reads %" PRIu64 " records %" PRIu64 " (max %" PRIu64 " per read) decode %" PRIu64 " ns/record",
+          mReadStats.reads, mReadStats.records, mReadStats.maxBatch,
+          mReadStats.records ? mReadStats.decodeNs / mReadStats.records : 0);
+}
+
+void HubSensors::initDecoders()
+{
+    static const struct {
+        int type;
+        Decoder decode;
+    } decoders[] = {
+        { DT_FLUSH, &HubSensors::decodeFlush },
+        { DT_ACCEL, &HubSensors::decodeAccel },
 #ifdef _ENABLE_ACCEL_SECONDARY
-            case DT_ACCEL2:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor = SENSORS_HANDLE_BASE + ID_A2;
-                data->type = SENSOR_TYPE_ACCELEROMETER;
-                data->acceleration.x = STM16TOH(buff.data+ACCEL_X) * CONVERT_A_X;
-                data->acceleration.y = STM16TOH(buff.data+ACCEL_Y) * CONVERT_A_Y;
-                data->acceleration.z = STM16TOH(buff.data+ACCEL_Z) * CONVERT_A_Z;
-                data->acceleration.status = SENSOR_STATUS_ACCURACY_HIGH;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
+        { DT_ACCEL2, &HubSensors::decodeAccel2 },
 #endif
 #ifdef _ENABLE_GYROSCOPE
-            case DT_GYRO:
-                mFusionData.gyro.x = STM16TOH(buff.data + GYRO_X) * CONVERT_G_P;
-                mFusionData.gyro.y = STM16TOH(buff.data + GYRO_Y) * CONVERT_G_R;
-                mFusionData.gyro.z = STM16TOH(buff.data + GYRO_Z) * CONVERT_G_Y;
-                mFusionData.gyro.timestamp = buff.timestamp;
-                if (mFusionSensors[GYRO].enabled) {
-                    data->version = SENSORS_EVENT_T_SIZE;
-                    data->sensor = SENSORS_HANDLE_BASE + ID_G;
-                    data->type = SENSOR_TYPE_GYROSCOPE;
-                    data->gyro.x = mFusionData.gyro.x;
-                    data->gyro.y = mFusionData.gyro.y;
-                    data->gyro.z = mFusionData.gyro.z;
-                    data->gyro.status = SENSOR_STATUS_ACCURACY_HIGH;
-                    data->timestamp = mFusionData.gyro.timestamp;
-                    data++;
-                }
-                if (mFusionSensors[GAME_RV].enabled || mFusionSensors[LINEAR_ACCEL].enabled
-                        || mFusionSensors[GRAVITY].enabled) {
-                    mGameRV->processFusion(mFusionData, false);
-                    if (mFusionSensors[GAME_RV].enabled) {
-                        data->version = SENSORS_EVENT_T_SIZE;
-                        data->sensor = SENSORS_HANDLE_BASE + ID_GAME_RV;
-                        data->type = SENSOR_TYPE_GAME_ROTATION_VECTOR;
-                        data->data[0] = mFusionData.gameRotation.a;
-                        data->data[1] = mFusionData.gameRotation.b;
-                        data->data[2] = mFusionData.gameRotation.c;
-                        data->data[3] = mFusionData.gameRotation.d;
-                        data->data[4] = mFusionData.gameRotation.accuracy;
-                        data->timestamp = mFusionData.gameRotation.timestamp;
-                        data++;
-                    }
-                    if (mFusionSensors[LINEAR_ACCEL].enabled || mFusionSensors[GRAVITY].enabled) {
-                        mLAGravity->processFusion(mFusionData, false);
-
-                        if (mFusionSensors[LINEAR_ACCEL].enabled) {
-                            data->version = SENSORS_EVENT_T_SIZE;
-                            data->sensor = SENSORS_HANDLE_BASE + ID_LA;
-                            data->type = SENSOR_TYPE_LINEAR_ACCELERATION;
-                            data->acceleration.x = mFusionData.linearAccel.x;
-                            data->acceleration.y = mFusionData.linearAccel.y;
-                            data->acceleration.z = mFusionData.linearAccel.z;
-                            data->acceleration.status = SENSOR_STATUS_ACCURACY_HIGH;
-                            data->timestamp = mFusionData.linearAccel.timestamp;
-                            data++;
-                        }
-                        if (mFusionSensors[GRAVITY].enabled) {
-                            data->version = SENSORS_EVENT_T_SIZE;
-                            data->sensor = SENSORS_HANDLE_BASE + ID_GRAVITY;
-                            data->type = SENSOR_TYPE_GRAVITY;
-                            data->acceleration.x = mFusionData.gravity.x;
-                            data->acceleration.y = mFusionData.gravity.y;
-                            data->acceleration.z = mFusionData.gravity.z;
-                            data->acceleration.status = SENSOR_STATUS_ACCURACY_HIGH;
-                            data->timestamp = mFusionData.gravity.timestamp;
-                            data++;
-                        }
-                    }
-                }
-#ifdef _ENABLE_MAGNETOMETER
-                if (mFusionSensors[ROTATION_VECT].enabled) {
-                    mRotationVect->processFusion(mFusionData, !mGeomagRVReady);
-
-                    data->version = SENSORS_EVENT_T_SIZE;
-                    data->sensor = SENSORS_HANDLE_BASE + ID_RV;
-                    data->type = SENSOR_TYPE_ROTATION_VECTOR;
-                    data->data[0] = mFusionData.rotationVector.a;
-                    data->data[1] = mFusionData.rotationVector.b;
-                    data->data[2] = mFusionData.rotationVector.c;
-                    data->data[3] = mFusionData.rotationVector.d;
-                    data->data[4] = mFusionData.rotationVector.accuracy;
-                    data->timestamp = mFusionData.rotationVector.timestamp;
-                    data++;
-                }
+        { DT_GYRO, &HubSensors::decodeGyro },
+        { DT_UNCALIB_GYRO, &HubSensors::decodeUncalibGyro },
 #endif
-                break;
-            case DT_UNCALIB_GYRO:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_UNCALIB_GYRO;
-                data->type = SENSOR_TYPE_GYROSCOPE_UNCALIBRATED;
-                data->uncalibrated_gyro.x_uncalib = STM16TOH(buff.data + UNCALIB_GYRO_X) * CONVERT_G_P;
-                data->uncalibrated_gyro.y_uncalib = STM16TOH(buff.data + UNCALIB_GYRO_Y) * CONVERT_G_R;
-                data->uncalibrated_gyro.z_uncalib = STM16TOH(buff.data + UNCALIB_GYRO_Z) * CONVERT_G_Y;
-                data->uncalibrated_gyro.x_bias = STM16TOH(buff.data + UNCALIB_GYRO_X_BIAS) * CONVERT_BIAS_G_P;
-                data->uncalibrated_gyro.y_bias = STM16TOH(buff.data + UNCALIB_GYRO_Y_BIAS) * CONVERT_BIAS_G_R;
-                data->uncalibrated_gyro.z_bias = STM16TOH(buff.data + UNCALIB_GYRO_Z_BIAS) * CONVERT_BIAS_G_Y;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-#endif
-            case DT_ALS:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor = SENSORS_HANDLE_BASE + ID_L;
-                data->type = SENSOR_TYPE_LIGHT;
-                data->light = (uint16_t)STM16TOH(buff.data + LIGHT_LIGHT);
-                data->timestamp = buff.timestamp;
-                logAlsEvent(data->light, data->timestamp);
-                data++;
-                break;
-            case DT_DISP_ROTATE:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor = SENSORS_HANDLE_BASE + ID_DR;
-                data->type = SENSOR_TYPE_DISPLAY_ROTATE;
-                if (buff.data[ROTATE_ROTATE] == DISP_FLAT)
-                    data->data[0] = DISP_UNKNOWN;
-                else
-                    data->data[0] = buff.data[ROTATE_ROTATE];
-
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_PROX:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor = SENSORS_HANDLE_BASE + ID_P;
-                data->type = SENSOR_TYPE_PROXIMITY;
-                if (buff.data[PROXIMITY_PROXIMITY] == 0) {
-                    data->distance = PROX_UNCOVERED;
-                    ALOGE("Proximity uncovered");
-                } else if (buff.data[PROXIMITY_PROXIMITY] == 1) {
-                    data->distance = PROX_COVERED;
-                    ALOGE("Proximity covered 1");
-                } else {
-                    data->distance = PROX_SATURATED;
-                    ALOGE("Proximity covered 2");
-                }
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_FLAT_UP:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor = SENSORS_HANDLE_BASE + ID_FU;
-                data->type = SENSOR_TYPE_FLAT_UP;
-                if (buff.data[FLAT_FLAT] == 0x01)
-                    data->data[0] = FLAT_DETECTED;
-                else
-                    data->data[0] = FLAT_NOTDETECTED;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_FLAT_DOWN:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor = SENSORS_HANDLE_BASE + ID_FD;
-                data->type = SENSOR_TYPE_FLAT_DOWN;
-                if (buff.data[FLAT_FLAT] == 0x02)
-                    data->data[0] = FLAT_DETECTED;
-                else
-                    data->data[0] = FLAT_NOTDETECTED;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_STOWED:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor = SENSORS_HANDLE_BASE + ID_S;
-                data->type = SENSOR_TYPE_STOWED;
-                data->data[0] = buff.data[STOWED_STOWED];
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_CAMERA_ACT:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor = SENSORS_HANDLE_BASE + ID_CA;
-                data->type = SENSOR_TYPE_CAMERA_ACTIVATE;
-                data->data[0] = STML0XX_CAMERA_DATA;
-                data->data[1] = STM16TOH(buff.data + CAMERA_CAMERA);
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
+        { DT_ALS, &HubSensors::decodeAls },
+        { DT_DISP_ROTATE, &HubSensors::decodeDispRotate },
+        { DT_PROX, &HubSensors::decodeProx },
+        { DT_FLAT_UP, &HubSensors::decodeFlatUp },
+        { DT_FLAT_DOWN, &HubSensors::decodeFlatDown },
+        { DT_STOWED, &HubSensors::decodeStowed },
+        { DT_CAMERA_ACT, &HubSensors::decodeCameraAct },
 #ifdef _ENABLE_GYROSCOPE
-            case DT_GYRO_CAL:
-                ret = ioctl(dev_fd, STML0XX_IOCTL_GET_GYRO_CAL, mGyroCal);
-                if (ret < 0) {
-                    ALOGE("Can't read Gyro Cal data");
-                } else {
-                    if ((fp = fopen(GYRO_CAL_FILE, "w")) == NULL) {
-                        ALOGE("Can't open Gyro Cal file");
-                    } else {
-                        size = fwrite(mGyroCal, 1, STML0XX_GYRO_CAL_SIZE, fp);
-                        fclose(fp);
-                        if (size != STML0XX_GYRO_CAL_SIZE)
-                            ALOGE("Error writing Gyro Cal file");
-                    }
-                }
-                break;
+        { DT_GYRO_CAL, &HubSensors::decodeGyroCal },
 #endif
-            case DT_ACCEL_CAL:
-                ret = ioctl(dev_fd, STML0XX_IOCTL_GET_ACCEL_CAL, mAccelCal);
-                if (ret < 0) {
-                    ALOGE("Can't read Accel Cal data");
-                } else {
-                    if ((fp = fopen(ACCEL_CAL_FILE, "w")) == NULL) {
-                        ALOGE("Can't open Accel Cal file");
-                    } else {
-                        size = fwrite(mAccelCal, 1, STML0XX_ACCEL_CAL_SIZE, fp);
-                        fclose(fp);
-                        if (size != STML0XX_ACCEL_CAL_SIZE)
-                            ALOGE("Error writing Accel Cal file");
-                    }
-                }
-                break;
-            case DT_RESET:
-                time(&timeutc.tv_sec);
-                if (buff.data[0] <= RESET_REASON_MAX_CODE)
-                    mErrorCnt[buff.data[0]]++;
-                if ((sent_bug2go_sec == 0) ||
-                    (timeutc.tv_sec - sent_bug2go_sec > 24*60*60)) {
-                    // put timestamp in dropbox file
-                    ptm = localtime(&(timeutc.tv_sec));
-                    if (ptm != NULL) {
-                        strftime(timeBuf, sizeof(timeBuf), "%m-%d %H:%M:%S", ptm);
-                        capture_dump(timeBuf, buff.type, SENSORHUB_DUMPFILE,
-                            DROPBOX_FLAG_TEXT | DROPBOX_FLAG_GZIP);
-                    }
-                    sent_bug2go_sec = timeutc.tv_sec;
-                } else {
-                    mPendingBug2go = 1;
-                }
-                break;
+        { DT_ACCEL_CAL, &HubSensors::decodeAccelCal },
+        { DT_RESET, &HubSensors::decodeReset },
 #ifdef _ENABLE_LIFT
-            case DT_LIFT:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor = SENSORS_HANDLE_BASE + ID_LF;
-                data->type = SENSOR_TYPE_LIFT_GESTURE;
-                data->data[0] = STM32TOH(buff.data + LIFT_DISTANCE);
-                data->data[1] = STM32TOH(buff.data + LIFT_ROTATION);
-                data->data[2] = STM32TOH(buff.data + LIFT_GRAV_DIFF);
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
+        { DT_LIFT, &HubSensors::decodeLift },
 #endif
 #ifdef _ENABLE_CHOPCHOP
-            case DT_CHOPCHOP:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor = SENSORS_HANDLE_BASE + ID_CC;
-                data->type = SENSOR_TYPE_CHOPCHOP_GESTURE;
-                data->data[0] = STM16TOH(buff.data + CHOPCHOP_CHOPCHOP);
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
+        { DT_CHOPCHOP, &HubSensors::decodeChopchop },
 #endif
 #ifdef _ENABLE_PEDO
-            case DT_STEP_COUNTER:
-            {
-                static uint32_t last_stepcount;
-                static uint32_t step_offset;
-                uint32_t stepcount;
+        { DT_STEP_COUNTER, &HubSensors::decodeStepCounter },
+        { DT_STEP_DETECTOR, &HubSensors::decodeStepDetector },
+#endif
+        { DT_GLANCE, &HubSensors::decodeGlance },
+#ifdef _ENABLE_MAGNETOMETER
+        { DT_MAG, &HubSensors::decodeMag },
+        { DT_UNCALIB_MAG, &HubSensors::decodeUncalibMag },
+        { DT_ORIENT, &HubSensors::decodeOrient },
+#endif
+        { DT_MOTION_DETECT, &HubSensors::decodeMotionDetect },
+        { DT_STATIONARY_DETECT, &HubSensors::decodeStationaryDetect },
+    };
+
+    memset(mDecoders, 0, sizeof(mDecoders));
+    for (const auto& entry : decoders) {
+        if (entry.type < 0 || entry.type >= HUB_DECODER_TABLE_SIZE) {
+            ALOGE("Sensor type %d out of decoder table", entry.type);
+            continue;
+        }
+        mDecoders[entry.type] = entry.decode;
+    }
+}
 
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_STEP_COUNTER;
-                data->type = SENSOR_TYPE_STEP_COUNTER;
-                /* data from sensors sent as 4 bytes. Thats plenty of steps */
-                stepcount = (buff.data[0] << 24 |
-                             buff.data[1] << 16 |
-                             buff.data[2] << 8  |
-                             buff.data[3]);
-                if(stepcount + step_offset < last_stepcount)
-                {
-                    /* hub reset, determine offset and apply, so users
-                       only see contiguous steps */
-                    step_offset = last_stepcount;
-                    ALOGD("Saving %d footsteps", step_offset);
-                }
-                last_stepcount = stepcount + step_offset;
+sensors_event_t* HubSensors::decodeFlush(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = META_DATA_VERSION;
+    data->sensor = 0;
+    data->type = SENSOR_TYPE_META_DATA;
+    data->reserved0 = 0;
+    data->timestamp = 0;
+    data->meta_data.what = META_DATA_FLUSH_COMPLETE;
+    data->meta_data.sensor = STM32TOH(buff.data + FLUSH);
+    data++;
+    return data;
+}
 
-                data->u64.step_counter = (uint64_t)(last_stepcount);
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            }
-            case DT_STEP_DETECTOR:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_STEP_DETECTOR;
-                data->type = SENSOR_TYPE_STEP_DETECTOR;
-                data->data[0] = (uint16_t)buff.data[0];
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
+sensors_event_t* HubSensors::decodeAccel(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    mFusionData.accel.x = STM16TOH(buff.data+ACCEL_X) * CONVERT_A_X;
+    mFusionData.accel.y = STM16TOH(buff.data+ACCEL_Y) * CONVERT_A_Y;
+    mFusionData.accel.z = STM16TOH(buff.data+ACCEL_Z) * CONVERT_A_Z;
+    mFusionData.accel.timestamp = buff.timestamp;
+    if (mFusionSensors[ACCEL].enabled) {
+        data->version = SENSORS_EVENT_T_SIZE;
+        data->sensor = SENSORS_HANDLE_BASE + ID_A;
+        data->type = SENSOR_TYPE_ACCELEROMETER;
+        data->acceleration.x = mFusionData.accel.x;
+        data->acceleration.y = mFusionData.accel.y;
+        data->acceleration.z = mFusionData.accel.z;
+        data->acceleration.status = SENSOR_STATUS_ACCURACY_HIGH;
+        data->timestamp = mFusionData.accel.timestamp;
+        data++;
+    }
+#ifdef _ENABLE_MAGNETOMETER
+    if (mFusionSensors[GEOMAG_RV].enabled || mFusionSensors[ROTATION_VECT].enabled) {
+        mFusion.updateGeoMagRV(mFusionData);
+        if (mFusionSensors[GEOMAG_RV].enabled) {
+            data->version = SENSORS_EVENT_T_SIZE;
+            data->sensor = SENSORS_HANDLE_BASE + ID_GEOMAG_RV;
+            data->type = SENSOR_TYPE_GEOMAGNETIC_ROTATION_VECTOR;
+            data->data[0] = mFusionData.geoMagRotation.a;
+            data->data[1] = mFusionData.geoMagRotation.b;
+            data->data[2] = mFusionData.geoMagRotation.c;
+            data->data[3] = mFusionData.geoMagRotation.d;
+            data->data[4] = mFusionData.geoMagRotation.accuracy;
+            data->timestamp = mFusionData.geoMagRotation.timestamp;
+            data++;
+        }
+    }
 #endif
-            case DT_GLANCE:
-                if (isHandleEnabled(ID_MOTO_GLANCE_GESTURE)) {
-                    data->version = SENSORS_EVENT_T_SIZE;
-                    data->sensor = ID_MOTO_GLANCE_GESTURE;
-                    data->type = SENSOR_TYPE_MOTO_GLANCE_GESTURE;
-                    data->data[0] = STM16TOH(buff.data); /* Gesture that triggered glance */
-                    data->data[1] = 0;
-                    data->data[2] = 0;
-                    data->timestamp = buff.timestamp;
-                    data++;
-                }
+    return data;
+}
 
-                if (isHandleEnabled(ID_GLANCE_GESTURE)) {
-                    data->version = SENSORS_EVENT_T_SIZE;
-                    data->sensor = ID_GLANCE_GESTURE;
-                    data->type = SENSOR_TYPE_GLANCE_GESTURE;
-                    data->data[0] = 1.0;                   /* set to 1 for Android compatibility */
-                    data->data[1] = STM16TOH(buff.data);   /* Currently blocked by Android FW */
-                    data->data[2] = 0;
-                    data->timestamp = buff.timestamp;
-                    data++;
-                }
-#ifdef _ENABLE_MAGNETOMETER
-            case DT_MAG:
-                mFusionData.mag.x = STM16TOH(buff.data + MAGNETIC_X) * CONVERT_M_X;
-                mFusionData.mag.y = STM16TOH(buff.data + MAGNETIC_Y) * CONVERT_M_Y;
-                mFusionData.mag.z = STM16TOH(buff.data + MAGNETIC_Z) * CONVERT_M_Z;
-                mFusionData.mag.timestamp = buff.timestamp;
-                if (mFusionSensors[MAG].enabled) {
-                    data->version = SENSORS_EVENT_T_SIZE;
-                    data->sensor = SENSORS_HANDLE_BASE + ID_M;
-                    data->type = SENSOR_TYPE_MAGNETIC_FIELD;
-                    data->magnetic.x = mFusionData.mag.x;
-                    data->magnetic.y = mFusionData.mag.y;
-                    data->magnetic.z = mFusionData.mag.z;
-                    data->magnetic.status = buff.status;
-                    data->timestamp = mFusionData.mag.timestamp;
-                    data++;
-                }
-                break;
-            case DT_UNCALIB_MAG:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_UM;
-                data->type = SENSOR_TYPE_MAGNETIC_FIELD_UNCALIBRATED;
-                data->uncalibrated_magnetic.x_uncalib = STM16TOH(buff.data + UNCALIB_MAGNETIC_X) * CONVERT_M_X;
-                data->uncalibrated_magnetic.y_uncalib = STM16TOH(buff.data + UNCALIB_MAGNETIC_Y) * CONVERT_M_Y;
-                data->uncalibrated_magnetic.z_uncalib = STM16TOH(buff.data + UNCALIB_MAGNETIC_Z) * CONVERT_M_Z;
-                data->uncalibrated_magnetic.x_bias = STM16TOH(buff.data + UNCALIB_MAGNETIC_X_BIAS) * CONVERT_BIAS_M_X;
-                data->uncalibrated_magnetic.y_bias = STM16TOH(buff.data + UNCALIB_MAGNETIC_Y_BIAS) * CONVERT_BIAS_M_Y;
-                data->uncalibrated_magnetic.z_bias = STM16TOH(buff.data + UNCALIB_MAGNETIC_Z_BIAS) * CONVERT_BIAS_M_Z;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
-            case DT_ORIENT:
-                data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_OR;
-                data->type = SENSOR_TYPE_ORIENTATION;
-                data->orientation.azimuth = STM16TOH(buff.data + ORIENTATION_AZIMUTH) * CONVERT_O_Y;
-                data->orientation.pitch = STM16TOH(buff.data + ORIENTATION_PITCH) * CONVERT_O_P;
-                data->orientation.roll = STM16TOH(buff.data + ORIENTATION_ROLL) * CONVERT_O_R;
-                data->orientation.status = buff.status;
-                data->timestamp = buff.timestamp;
-                data++;
-                break;
+#ifdef _ENABLE_ACCEL_SECONDARY
+sensors_event_t* HubSensors::decodeAccel2(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor = SENSORS_HANDLE_BASE + ID_A2;
+    data->type = SENSOR_TYPE_ACCELEROMETER;
+    data->acceleration.x = STM16TOH(buff.data+ACCEL_X) * CONVERT_A_X;
+    data->acceleration.y = STM16TOH(buff.data+ACCEL_Y) * CONVERT_A_Y;
+    data->acceleration.z = STM16TOH(buff.data+ACCEL_Z) * CONVERT_A_Z;
+    data->acceleration.status = SENSOR_STATUS_ACCURACY_HIGH;
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
 #endif
-            case DT_MOTION_DETECT:
+
+#ifdef _ENABLE_GYROSCOPE
+sensors_event_t* HubSensors::decodeGyro(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    mFusionData.gyro.x = STM16TOH(buff.data + GYRO_X) * CONVERT_G_P;
+    mFusionData.gyro.y = STM16TOH(buff.data + GYRO_Y) * CONVERT_G_R;
+    mFusionData.gyro.z = STM16TOH(buff.data + GYRO_Z) * CONVERT_G_Y;
+    mFusionData.gyro.timestamp = buff.timestamp;
+    if (mFusionSensors[GYRO].enabled) {
+        data->version = SENSORS_EVENT_T_SIZE;
+        data->sensor = SENSORS_HANDLE_BASE + ID_G;
+        data->type = SENSOR_TYPE_GYROSCOPE;
+        data->gyro.x = mFusionData.gyro.x;
+        data->gyro.y = mFusionData.gyro.y;
+        data->gyro.z = mFusionData.gyro.z;
+        data->gyro.status = SENSOR_STATUS_ACCURACY_HIGH;
+        data->timestamp = mFusionData.gyro.timestamp;
+        data++;
+    }
+    if (mFusionSensors[GAME_RV].enabled || mFusionSensors[LINEAR_ACCEL].enabled
+            || mFusionSensors[GRAVITY].enabled) {
+        mFusion.updateGameRV(mFusionData);
+        if (mFusionSensors[GAME_RV].enabled) {
+            data->version = SENSORS_EVENT_T_SIZE;
+            data->sensor = SENSORS_HANDLE_BASE + ID_GAME_RV;
+            data->type = SENSOR_TYPE_GAME_ROTATION_VECTOR;
+            data->data[0] = mFusionData.gameRotation.a;
+            data->data[1] = mFusionData.gameRotation.b;
+            data->data[2] = mFusionData.gameRotation.c;
+            data->data[3] = mFusionData.gameRotation.d;
+            data->data[4] = mFusionData.gameRotation.accuracy;
+            data->timestamp = mFusionData.gameRotation.timestamp;
+            data++;
+        }
+        if (mFusionSensors[LINEAR_ACCEL].enabled || mFusionSensors[GRAVITY].enabled) {
+            mFusion.updateLinearAccelGravity(mFusionData);
+
+            if (mFusionSensors[LINEAR_ACCEL].enabled) {
                 data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_MOTION_DETECT;
-                data->type = SENSOR_TYPE_MOTION_DETECT;
-                data->data[0] = 1.0;
-                data->timestamp = buff.timestamp;
+                data->sensor = SENSORS_HANDLE_BASE + ID_LA;
+                data->type = SENSOR_TYPE_LINEAR_ACCELERATION;
+                data->acceleration.x = mFusionData.linearAccel.x;
+                data->acceleration.y = mFusionData.linearAccel.y;
+                data->acceleration.z = mFusionData.linearAccel.z;
+                data->acceleration.status = SENSOR_STATUS_ACCURACY_HIGH;
+                data->timestamp = mFusionData.linearAccel.timestamp;
                 data++;
-                /* Disable, because this is a one shot sensor */
-                setEnable(ID_MOTION_DETECT, 0);
-                break;
-            case DT_STATIONARY_DETECT:
+            }
+            if (mFusionSensors[GRAVITY].enabled) {
                 data->version = SENSORS_EVENT_T_SIZE;
-                data->sensor =  SENSORS_HANDLE_BASE + ID_STATIONARY_DETECT;
-                data->type = SENSOR_TYPE_STATIONARY_DETECT;
-                data->data[0] = 1.0;
-                data->timestamp = buff.timestamp;
+                data->sensor = SENSORS_HANDLE_BASE + ID_GRAVITY;
+                data->type = SENSOR_TYPE_GRAVITY;
+                data->acceleration.x = mFusionData.gravity.x;
+                data->acceleration.y = mFusionData.gravity.y;
+                data->acceleration.z = mFusionData.gravity.z;
+                data->acceleration.status = SENSOR_STATUS_ACCURACY_HIGH;
+                data->timestamp = mFusionData.gravity.timestamp;
                 data++;
-                /* Disable, because this is a one shot sensor */
-                setEnable(ID_STATIONARY_DETECT, 0);
-                break;
-            default:
-                break;
+            }
         }
     }
-    if (mPendingBug2go == 1) {
-        time(&timeutc.tv_sec);
-        if (timeutc.tv_sec - sent_bug2go_sec > 24*60*60) {
-            // put timestamp in dropbox file
-            ptm = localtime(&(timeutc.tv_sec));
-            if (ptm != NULL) {
-                strftime(timeBuf, sizeof(timeBuf), "%m-%d %H:%M:%S", ptm);
-                capture_dump(timeBuf, buff.type, SENSORHUB_DUMPFILE,
-                    DROPBOX_FLAG_TEXT | DROPBOX_FLAG_GZIP);
-            }
-            sent_bug2go_sec = timeutc.tv_sec;
-            mPendingBug2go = 0;
+#ifdef _ENABLE_MAGNETOMETER
+    if (mFusionSensors[ROTATION_VECT].enabled) {
+        mFusion.updateRotationVector(mFusionData);
+
+        data->version = SENSORS_EVENT_T_SIZE;
+        data->sensor = SENSORS_HANDLE_BASE + ID_RV;
+        data->type = SENSOR_TYPE_ROTATION_VECTOR;
+        data->data[0] = mFusionData.rotationVector.a;
+        data->data[1] = mFusionData.rotationVector.b;
+        data->data[2] = mFusionData.rotationVector.c;
+        data->data[3] = mFusionData.rotationVector.d;
+        data->data[4] = mFusionData.rotationVector.accuracy;
+        data->timestamp = mFusionData.rotationVector.timestamp;
+        data++;
+    }
+#endif
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeUncalibGyro(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_UNCALIB_GYRO;
+    data->type = SENSOR_TYPE_GYROSCOPE_UNCALIBRATED;
+    data->uncalibrated_gyro.x_uncalib = STM16TOH(buff.data + UNCALIB_GYRO_X) * CONVERT_G_P;
+    data->uncalibrated_gyro.y_uncalib = STM16TOH(buff.data + UNCALIB_GYRO_Y) * CONVERT_G_R;
+    data->uncalibrated_gyro.z_uncalib = STM16TOH(buff.data + UNCALIB_GYRO_Z) * CONVERT_G_Y;
+    data->uncalibrated_gyro.x_bias = STM16TOH(buff.data + UNCALIB_GYRO_X_BIAS) * CONVERT_BIAS_G_P;
+    data->uncalibrated_gyro.y_bias = STM16TOH(buff.data + UNCALIB_GYRO_Y_BIAS) * CONVERT_BIAS_G_R;
+    data->uncalibrated_gyro.z_bias = STM16TOH(buff.data + UNCALIB_GYRO_Z_BIAS) * CONVERT_BIAS_G_Y;
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+#endif
+
+sensors_event_t* HubSensors::decodeAls(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor = SENSORS_HANDLE_BASE + ID_L;
+    data->type = SENSOR_TYPE_LIGHT;
+    data->light = (uint16_t)STM16TOH(buff.data + LIGHT_LIGHT);
+    data->timestamp = buff.timestamp;
+    logAlsEvent(data->light, data->timestamp);
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeDispRotate(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor = SENSORS_HANDLE_BASE + ID_DR;
+    data->type = SENSOR_TYPE_DISPLAY_ROTATE;
+    if (buff.data[ROTATE_ROTATE] == DISP_FLAT)
+        data->data[0] = DISP_UNKNOWN;
+    else
+        data->data[0] = buff.data[ROTATE_ROTATE];
+
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeProx(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor = SENSORS_HANDLE_BASE + ID_P;
+    data->type = SENSOR_TYPE_PROXIMITY;
+    if (buff.data[PROXIMITY_PROXIMITY] == 0) {
+        data->distance = PROX_UNCOVERED;
+        ALOGE("Proximity uncovered");
+    } else if (buff.data[PROXIMITY_PROXIMITY] == 1) {
+        data->distance = PROX_COVERED;
+        ALOGE("Proximity covered 1");
+    } else {
+        data->distance = PROX_SATURATED;
+        ALOGE("Proximity covered 2");
+    }
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeFlatUp(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor = SENSORS_HANDLE_BASE + ID_FU;
+    data->type = SENSOR_TYPE_FLAT_UP;
+    if (buff.data[FLAT_FLAT] == 0x01)
+        data->data[0] = FLAT_DETECTED;
+    else
+        data->data[0] = FLAT_NOTDETECTED;
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeFlatDown(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor = SENSORS_HANDLE_BASE + ID_FD;
+    data->type = SENSOR_TYPE_FLAT_DOWN;
+    if (buff.data[FLAT_FLAT] == 0x02)
+        data->data[0] = FLAT_DETECTED;
+    else
+        data->data[0] = FLAT_NOTDETECTED;
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeStowed(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor = SENSORS_HANDLE_BASE + ID_S;
+    data->type = SENSOR_TYPE_STOWED;
+    data->data[0] = buff.data[STOWED_STOWED];
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeCameraAct(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor = SENSORS_HANDLE_BASE + ID_CA;
+    data->type = SENSOR_TYPE_CAMERA_ACTIVATE;
+    data->data[0] = STML0XX_CAMERA_DATA;
+    data->data[1] = STM16TOH(buff.data + CAMERA_CAMERA);
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+#ifdef _ENABLE_GYROSCOPE
+sensors_event_t* HubSensors::decodeGyroCal(const struct stml0xx_android_sensor_data& /* buff */,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    int ret;
+    FILE *fp;
+    int size;
+
+    ret = hubIoctl(STML0XX_IOCTL_GET_GYRO_CAL, mGyroCal);
+    if (ret < 0) {
+        ALOGE("Can't read Gyro Cal data");
+    } else {
+        if ((fp = fopen(GYRO_CAL_FILE, "w")) == NULL) {
+            ALOGE("Can't open Gyro Cal file");
+        } else {
+            size = fwrite(mGyroCal, 1, STML0XX_GYRO_CAL_SIZE, fp);
+            fclose(fp);
+            if (size != STML0XX_GYRO_CAL_SIZE)
+                ALOGE("Error writing Gyro Cal file");
+        }
+    }
+    return data;
+}
+#endif
+
+sensors_event_t* HubSensors::decodeAccelCal(const struct stml0xx_android_sensor_data& /* buff */,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    int ret;
+    FILE *fp;
+    int size;
+
+    ret = hubIoctl(STML0XX_IOCTL_GET_ACCEL_CAL, mAccelCal);
+    if (ret < 0) {
+        ALOGE("Can't read Accel Cal data");
+    } else {
+        if ((fp = fopen(ACCEL_CAL_FILE, "w")) == NULL) {
+            ALOGE("Can't open Accel Cal file");
+        } else {
+            size = fwrite(mAccelCal, 1, STML0XX_ACCEL_CAL_SIZE, fp);
+            fclose(fp);
+            if (size != STML0XX_ACCEL_CAL_SIZE)
+                ALOGE("Error writing Accel Cal file");
         }
     }
+    return data;
+}
 
-    return data - d;
+sensors_event_t* HubSensors::decodeReset(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    char timeBuf[32];
+    struct tm* ptm = NULL;
+    struct timeval timeutc;
+
+    time(&timeutc.tv_sec);
+    if (buff.data[0] <= RESET_REASON_MAX_CODE)
+        mErrorCnt[buff.data[0]]++;
+    if ((mSentBug2goSec == 0) ||
+        (timeutc.tv_sec - mSentBug2goSec > 24*60*60)) {
+        // put timestamp in dropbox file
+        ptm = localtime(&(timeutc.tv_sec));
+        if (ptm != NULL) {
+            strftime(timeBuf, sizeof(timeBuf), "%m-%d %H:%M:%S", ptm);
+            capture_dump(timeBuf, buff.type, SENSORHUB_DUMPFILE,
+                DROPBOX_FLAG_TEXT | DROPBOX_FLAG_GZIP);
+        }
+        mSentBug2goSec = timeutc.tv_sec;
+    } else {
+        mPendingBug2go = 1;
+    }
+    return data;
+}
+
+#ifdef _ENABLE_LIFT
+sensors_event_t* HubSensors::decodeLift(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor = SENSORS_HANDLE_BASE + ID_LF;
+    data->type = SENSOR_TYPE_LIFT_GESTURE;
+    data->data[0] = STM32TOH(buff.data + LIFT_DISTANCE);
+    data->data[1] = STM32TOH(buff.data + LIFT_ROTATION);
+    data->data[2] = STM32TOH(buff.data + LIFT_GRAV_DIFF);
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+#endif
+
+#ifdef _ENABLE_CHOPCHOP
+sensors_event_t* HubSensors::decodeChopchop(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor = SENSORS_HANDLE_BASE + ID_CC;
+    data->type = SENSOR_TYPE_CHOPCHOP_GESTURE;
+    data->data[0] = STM16TOH(buff.data + CHOPCHOP_CHOPCHOP);
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+#endif
+
+#ifdef _ENABLE_PEDO
+sensors_event_t* HubSensors::decodeStepCounter(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    static uint32_t last_stepcount;
+    static uint32_t step_offset;
+    uint32_t stepcount;
+
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_STEP_COUNTER;
+    data->type = SENSOR_TYPE_STEP_COUNTER;
+    /* data from sensors sent as 4 bytes. Thats plenty of steps */
+    stepcount = (buff.data[0] << 24 |
+                 buff.data[1] << 16 |
+                 buff.data[2] << 8  |
+                 buff.data[3]);
+    if(stepcount + step_offset < last_stepcount)
+    {
+        /* hub reset, determine offset and apply, so users
+           only see contiguous steps */
+        step_offset = last_stepcount;
+        ALOGD("Saving %d footsteps", step_offset);
+    }
+    last_stepcount = stepcount + step_offset;
+
+    data->u64.step_counter = (uint64_t)(last_stepcount);
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeStepDetector(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_STEP_DETECTOR;
+    data->type = SENSOR_TYPE_STEP_DETECTOR;
+    data->data[0] = (uint16_t)buff.data[0];
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+#endif
+
+sensors_event_t* HubSensors::decodeGlance(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    if (isHandleEnabled(ID_MOTO_GLANCE_GESTURE)) {
+        data->version = SENSORS_EVENT_T_SIZE;
+        data->sensor = ID_MOTO_GLANCE_GESTURE;
+        data->type = SENSOR_TYPE_MOTO_GLANCE_GESTURE;
+        data->data[0] = STM16TOH(buff.data); /* Gesture that triggered glance */
+        data->data[1] = 0;
+        data->data[2] = 0;
+        data->timestamp = buff.timestamp;
+        data++;
+    }
+
+    if (isHandleEnabled(ID_GLANCE_GESTURE)) {
+        data->version = SENSORS_EVENT_T_SIZE;
+        data->sensor = ID_GLANCE_GESTURE;
+        data->type = SENSOR_TYPE_GLANCE_GESTURE;
+        data->data[0] = 1.0;                   /* set to 1 for Android compatibility */
+        data->data[1] = STM16TOH(buff.data);   /* Currently blocked by Android FW */
+        data->data[2] = 0;
+        data->timestamp = buff.timestamp;
+        data++;
+    }
+    return data;
+}
+
+#ifdef _ENABLE_MAGNETOMETER
+sensors_event_t* HubSensors::decodeMag(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    mFusionData.mag.x = STM16TOH(buff.data + MAGNETIC_X) * CONVERT_M_X;
+    mFusionData.mag.y = STM16TOH(buff.data + MAGNETIC_Y) * CONVERT_M_Y;
+    mFusionData.mag.z = STM16TOH(buff.data + MAGNETIC_Z) * CONVERT_M_Z;
+    mFusionData.mag.timestamp = buff.timestamp;
+    if (mFusionSensors[MAG].enabled) {
+        data->version = SENSORS_EVENT_T_SIZE;
+        data->sensor = SENSORS_HANDLE_BASE + ID_M;
+        data->type = SENSOR_TYPE_MAGNETIC_FIELD;
+        data->magnetic.x = mFusionData.mag.x;
+        data->magnetic.y = mFusionData.mag.y;
+        data->magnetic.z = mFusionData.mag.z;
+        data->magnetic.status = buff.status;
+        data->timestamp = mFusionData.mag.timestamp;
+        data++;
+    }
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeUncalibMag(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_UM;
+    data->type = SENSOR_TYPE_MAGNETIC_FIELD_UNCALIBRATED;
+    data->uncalibrated_magnetic.x_uncalib = STM16TOH(buff.data + UNCALIB_MAGNETIC_X) * CONVERT_M_X;
+    data->uncalibrated_magnetic.y_uncalib = STM16TOH(buff.data + UNCALIB_MAGNETIC_Y) * CONVERT_M_Y;
+    data->uncalibrated_magnetic.z_uncalib = STM16TOH(buff.data + UNCALIB_MAGNETIC_Z) * CONVERT_M_Z;
+    data->uncalibrated_magnetic.x_bias = STM16TOH(buff.data + UNCALIB_MAGNETIC_X_BIAS) * CONVERT_BIAS_M_X;
+    data->uncalibrated_magnetic.y_bias = STM16TOH(buff.data + UNCALIB_MAGNETIC_Y_BIAS) * CONVERT_BIAS_M_Y;
+    data->uncalibrated_magnetic.z_bias = STM16TOH(buff.data + UNCALIB_MAGNETIC_Z_BIAS) * CONVERT_BIAS_M_Z;
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeOrient(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_OR;
+    data->type = SENSOR_TYPE_ORIENTATION;
+    data->orientation.azimuth = STM16TOH(buff.data + ORIENTATION_AZIMUTH) * CONVERT_O_Y;
+    data->orientation.pitch = STM16TOH(buff.data + ORIENTATION_PITCH) * CONVERT_O_P;
+    data->orientation.roll = STM16TOH(buff.data + ORIENTATION_ROLL) * CONVERT_O_R;
+    data->orientation.status = buff.status;
+    data->timestamp = buff.timestamp;
+    data++;
+    return data;
+}
+#endif
+
+sensors_event_t* HubSensors::decodeMotionDetect(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_MOTION_DETECT;
+    data->type = SENSOR_TYPE_MOTION_DETECT;
+    data->data[0] = 1.0;
+    data->timestamp = buff.timestamp;
+    data++;
+    /* Disable, because this is a one shot sensor */
+    setEnable(ID_MOTION_DETECT, 0);
+    return data;
+}
+
+sensors_event_t* HubSensors::decodeStationaryDetect(const struct stml0xx_android_sensor_data& buff,
+        sensors_event_t* data, sensors_event_t const* /* dataEnd */)
+{
+    data->version = SENSORS_EVENT_T_SIZE;
+    data->sensor =  SENSORS_HANDLE_BASE + ID_STATIONARY_DETECT;
+    data->type = SENSOR_TYPE_STATIONARY_DETECT;
+    data->data[0] = 1.0;
+    data->timestamp = buff.timestamp;
+    data++;
+    /* Disable, because this is a one shot sensor */
+    setEnable(ID_STATIONARY_DETECT, 0);
+    return data;
 }
 
 int HubSensors::flush(int32_t handle)
 {
     int ret = 0;
     if (handle > MIN_SENSOR_ID && handle < MAX_SENSOR_ID) {
-        ret = ioctl(dev_fd,  STML0XX_IOCTL_SET_FLUSH, &handle);
+        ret = hubIoctl(STML0XX_IOCTL_SET_FLUSH, &handle);
     }
     return ret;
 }
@@ -1131,7 +1399,7 @@ int HubSensors::updateGyroRate()
 
     if (delay != prev_delay) {
         // Update gyro rate
-        err = ioctl(dev_fd, STML0XX_IOCTL_SET_GYRO_DELAY, &delay);
+        err = hubIoctl(STML0XX_IOCTL_SET_GYRO_DELAY, &delay);
         ALOGI("HubSensors::updateGyroRate %d", delay);
         prev_delay = delay;
     }
@@ -1171,7 +1439,7 @@ int HubSensors::updateMagRate()
 
     if (delay != prev_delay) {
         // Update mag rate
-        err = ioctl(dev_fd, STML0XX_IOCTL_SET_MAG_DELAY, &delay);
+        err = hubIoctl(STML0XX_IOCTL_SET_MAG_DELAY, &delay);
         ALOGI("HubSensors::updateMagRate %d", delay);
         prev_delay = delay;
     }
@@ -1210,7 +1478,7 @@ int HubSensors::updateAccelRate()
 
     if (delay != prev_delay) {
         // Update accel rate
-        err = ioctl(dev_fd, STML0XX_IOCTL_SET_ACC_DELAY, &delay);
+        err = hubIoctl(STML0XX_IOCTL_SET_ACC_DELAY, &delay);
         ALOGI("HubSensors::updateAccelRate %d", delay);
         prev_delay = delay;
     }
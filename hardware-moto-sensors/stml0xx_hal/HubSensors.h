@@ -28,20 +28,16 @@
 #include <sys/types.h>
 #include <zlib.h>
 #include <time.h>
+#include <memory>
+#include <vector>
 
 #include <linux/stml0xx.h>
 
-#include "FusionSensorBase.h"
-#include "GameRotationVector.h"
-#include "LinearAccelGravity.h"
+#include "FusionEngine.h"
 #include "SensorBase.h"
 #include "SensorList.h"
 #include "Sensors.h"
-
-#ifdef _ENABLE_MAGNETOMETER
-#include "GeoMagRotationVector.h"
-#include "RotationVector.h"
-#endif
+#include "SensorTrace.h"
 
 /*****************************************************************************/
 
@@ -99,6 +95,14 @@
 #define STM16TOH(p) (int16_t) be16toh(*((uint16_t *) (p)))
 #define STM32TOH(p) (int32_t) be32toh(*((uint32_t *) (p)))
 
+/* Records asked for per read(). The stml0xx driver returns a single record per
+ * read() whatever the length, so a batch only saves read() calls on a replay
+ * FIFO until the driver copies out every queued record (a kernel change). */
+#define HUB_READ_BATCH            32
+#define HUB_MAX_EVENTS_PER_RECORD 5     /* Most events decoded from a record (DT_GYRO) */
+#define HUB_DECODER_TABLE_SIZE    256   /* Record types are one byte */
+#define HUB_READ_STATS_PERIOD     10000 /* read() calls between two stats logs */
+
 struct input_event;
 
 class HubSensors : public SensorBase {
@@ -110,10 +114,26 @@ public:
     virtual int setEnable(int32_t handle, int enabled) override;
     virtual int setDelay(int32_t handle, int64_t ns) override;
     virtual int readEvents(sensors_event_t* data, int count) override;
+    virtual bool hasPendingEvents() const override {
+        return !pendingEvents.empty();
+    }
     virtual int flush(int32_t handle) override;
 
     static HubSensors* getInstance();
 
+protected:
+    /** Reads the hub's records from replayFd rather than from the hub if it
+     * is not negative, like the default constructor does with a replay FIFO
+     * (SENSOR_REPLAY_PROPERTY). The hub's nodes are not opened then, so that
+     * a trace replays where there is no hub. */
+    explicit HubSensors(int replayFd);
+
+    /** Issues an ioctl on the hub's control node. While replaying, the
+     * requests which configure the hub succeed without effect, and those
+     * which read from it fail with -ENODEV.
+     * @return 0 on success, or a negative value on error. */
+    virtual int hubIoctl(unsigned long request, void *arg);
+
 private:
     enum fusion_enum
     {
@@ -152,19 +172,13 @@ private:
     uint32_t mFlushEnabled;
     uint64_t mEnabledHandles;
     uint32_t mPendingBug2go;
+    long int mSentBug2goSec;
     FusionData mFusionData;
+    FusionEngine mFusion;
 
 #ifdef _ENABLE_GYROSCOPE
     //! \brief gyroscope calibration table
     uint8_t mGyroCal[STML0XX_GYRO_CAL_SIZE];
-    GameRotationVector *mGameRV;
-    LinearAccelGravity *mLAGravity;
-#endif
-
-#ifdef _ENABLE_MAGNETOMETER
-    GeoMagRotationVector *mGeomagRV;
-    uint8_t mGeomagRVReady;
-    RotationVector *mRotationVect;
 #endif
 
     uint8_t mAccelCal[STML0XX_ACCEL_CAL_SIZE];
@@ -175,6 +189,110 @@ private:
     void logAlsEvent(int32_t lux, int64_t ts_ns);
     bool isRotationVectorRunning(void);
 
+    /**
+     * Records read from the sensor hub are decoded by the decoder of their
+     * type. A decoder writes the events of a record from data on, at most
+     * HUB_MAX_EVENTS_PER_RECORD, and returns the end of what it wrote.
+     */
+    typedef sensors_event_t* (HubSensors::*Decoder)(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    static_assert(sizeof(stml0xx_android_sensor_data::type) == 1,
+        "record types must index the decoder table");
+
+    struct ReadStats {
+        uint64_t reads;     //!< read() calls on data_fd
+        uint64_t records;   //!< records decoded
+        uint64_t maxBatch;  //!< most records returned by one read()
+        uint64_t decodeNs;  //!< time spent decoding records
+    };
+
+    //! \brief Decoder of each record type, NULL for unknown types
+    Decoder mDecoders[HUB_DECODER_TABLE_SIZE];
+    //! \brief Records of the last read() on data_fd
+    struct stml0xx_android_sensor_data mReadBuf[HUB_READ_BATCH];
+    ReadStats mReadStats;
+    //! \brief Set when recording reads to a trace (SENSOR_TRACE_PROPERTY)
+    std::unique_ptr<SensorTraceRecorder> mTrace;
+    //! \brief Set when reading from a replay FIFO (SENSOR_REPLAY_PROPERTY)
+    std::unique_ptr<SensorReplayStats> mReplayStats;
+    //! \brief Set when reading from a replay fd rather than from the hub
+    bool mReplaying;
+
+    /**
+     * Events of the last records read which did not fit in the poll buffer,
+     * reported on the next call.
+     */
+    std::vector<sensors_event_t> pendingEvents;
+    /// The index of the next event in the pendingEvents list that needs to be reported.
+    size_t nextPendingEvent;
+
+    void initDecoders();
+    void logReadStats();
+    sensors_event_t* decodeFlush(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeAccel(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#ifdef _ENABLE_ACCEL_SECONDARY
+    sensors_event_t* decodeAccel2(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#endif
+#ifdef _ENABLE_GYROSCOPE
+    sensors_event_t* decodeGyro(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeUncalibGyro(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#endif
+    sensors_event_t* decodeAls(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeDispRotate(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeProx(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeFlatUp(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeFlatDown(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeStowed(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeCameraAct(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#ifdef _ENABLE_GYROSCOPE
+    sensors_event_t* decodeGyroCal(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#endif
+    sensors_event_t* decodeAccelCal(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeReset(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#ifdef _ENABLE_LIFT
+    sensors_event_t* decodeLift(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#endif
+#ifdef _ENABLE_CHOPCHOP
+    sensors_event_t* decodeChopchop(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#endif
+#ifdef _ENABLE_PEDO
+    sensors_event_t* decodeStepCounter(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeStepDetector(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#endif
+    sensors_event_t* decodeGlance(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#ifdef _ENABLE_MAGNETOMETER
+    sensors_event_t* decodeMag(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeUncalibMag(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeOrient(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+#endif
+    sensors_event_t* decodeMotionDetect(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+    sensors_event_t* decodeStationaryDetect(const struct stml0xx_android_sensor_data& buff,
+            sensors_event_t* data, sensors_event_t const* dataEnd);
+
 #ifdef _ENABLE_GYROSCOPE
     /*!
      * \brief Helper to update gyro rate
@@ -23,11 +23,9 @@
 #include <string.h>
 #include <log/log.h>
 #include <android-base/macros.h>
+#include <hardware/sensors.h>
 #include "LinearAccelGravity.h"
 #include "Quaternion.h"
-#include "SensorList.h"
-
-LinearAccelGravity LinearAccelGravity::self;
 
 LinearAccelGravity::LinearAccelGravity()
 : gameRVData(), gameRVts(0)
@@ -38,11 +36,6 @@ LinearAccelGravity::~LinearAccelGravity()
 {
 }
 
-LinearAccelGravity *LinearAccelGravity::getInstance()
-{
-    return &self;
-}
-
 bool LinearAccelGravity::processFusion(FusionData& fusionData, bool reset)
 {
     UNUSED(reset);
@@ -29,12 +29,9 @@ public:
     LinearAccelGravity();
     virtual ~LinearAccelGravity();
 
-    static LinearAccelGravity* getInstance();
-
     bool processFusion(FusionData& fusionData, bool reset);
 
 private:
-    static LinearAccelGravity self;
     float gameRVData[4];
     int64_t gameRVts;
 };
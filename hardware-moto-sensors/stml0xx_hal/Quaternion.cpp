@@ -20,7 +20,67 @@
 
 #include <math.h>
 #include <float.h>
+#include <stddef.h>
 #include "Quaternion.h"
+#include "QuaternionSimd.h"
+
+static_assert(offsetof(QuatData, b) == 1 * sizeof(float) &&
+              offsetof(QuatData, c) == 2 * sizeof(float) &&
+              offsetof(QuatData, d) == 3 * sizeof(float),
+              "QuatData components must be loadable as one vector");
+
+#define MAG_TOL (0.0001f)
+
+static inline qvec4 loadQuat(const QuatData& q)
+{
+    return qv_load(&q.a);
+}
+
+static inline void storeQuat(QuatData& q, qvec4 v)
+{
+    qv_store(&q.a, v);
+}
+
+/*!
+ * \brief q1*q2 on vectors
+ *
+ * Each output component sums its terms in the same order as the scalar
+ * formula, so the result matches it bit for bit.
+ */
+static inline qvec4 mulVec(qvec4 q1, qvec4 q2)
+{
+    const qvec4 signA = qv_set(1.f, -1.f, 1.f, -1.f);
+    const qvec4 signB = qv_set(1.f, 1.f, -1.f, -1.f);
+    const qvec4 signC = qv_set(-1.f, 1.f, 1.f, -1.f);
+    qvec4 halves = qv_swap_halves(q2);                  // c2 d2 a2 b2
+    qvec4 out = qv_mul(qv_lane(q1, 3), q2);
+    out = qv_madd(out, qv_lane(q1, 0), qv_mul(qv_swap_pairs(halves), signA));
+    out = qv_madd(out, qv_lane(q1, 1), qv_mul(halves, signB));
+    out = qv_madd(out, qv_lane(q1, 2), qv_mul(qv_swap_pairs(q2), signC));
+    return out;
+}
+
+//! \brief renormalize() on a vector
+static inline int renormalizeVec(qvec4& q)
+{
+    // Square magnitude
+    float mag = qv_dot(q, q);
+
+    if (mag < MAG_TOL) {
+        // This is bad. Quaternion is not renormalizable.
+        q = qv_set(0.f, 0.f, 0.f, 1.f);
+        return 1;
+    } else if (mag > 1.f + MAG_TOL || mag < 1.f - MAG_TOL) {
+        // Not only do we want to normalize, but we want to keep
+        // q[3] >= 0 so that the encoded angle is in [-pi/2, pi/2)
+        float d[4];
+        qv_store(d, q);
+        mag = copysignf( sqrtf(mag), d[3] );
+        q = qv_div(q, qv_dup(mag));
+    }
+
+    return 0;
+}
 
 void Quaternion::cross3(float* out, float* u, float* v)
 {
@@ -64,19 +124,10 @@ void Quaternion::inv(QuatData& out, const QuatData& q)
  */
 int Quaternion::mul(QuatData& q, const QuatData& q1, const QuatData& q2)
 {
-    QuatData out;
-    int ret;
+    qvec4 out = mulVec(loadQuat(q1), loadQuat(q2));
+    int ret = renormalizeVec(out);
 
-    out.a = q1.d * q2.a + q1.a * q2.d + q1.b * q2.c - q1.c * q2.b;
-    out.b = q1.d * q2.b - q1.a * q2.c + q1.b * q2.d + q1.c * q2.a;
-    out.c = q1.d * q2.c + q1.a * q2.b - q1.b * q2.a + q1.c * q2.d;
-    out.d = q1.d * q2.d - q1.a * q2.a - q1.b * q2.b - q1.c * q2.c;
-    ret = renormalize(out);
-
-    q.a = out.a;
-    q.b = out.b;
-    q.c = out.c;
-    q.d = out.d;
+    storeQuat(q, out);
 
     return ret;
 }
@@ -91,29 +142,12 @@ int Quaternion::mul(QuatData& q, const QuatData& q1, const QuatData& q2)
  */
 int Quaternion::renormalize(QuatData& q)
 {
-    // Square magnitude
-    float mag = q.a * q.a + q.b * q.b + q.c * q.c + q.d * q.d;
+    qvec4 v = loadQuat(q);
+    int ret = renormalizeVec(v);
 
-#define MAG_TOL (0.0001f)
-    if (mag < MAG_TOL) {
-        // This is bad. Quaternion is not renormalizable.
-        q.a = 0.f;
-        q.b = 0.f;
-        q.c = 0.f;
-        q.d = 1.f;
-        return 1;
-    } else if (mag > 1.f + MAG_TOL || mag < 1.f - MAG_TOL) {
-        // Not only do we want to normalize, but we want to keep
-        // q[3] >= 0 so that the encoded angle is in [-pi/2, pi/2)
-        mag = copysignf( sqrtf(mag), q.d );
-        q.a /= mag;
-        q.b /= mag;
-        q.c /= mag;
-        q.d /= mag;
-    }
-#undef MAG_TOL
+    storeQuat(q, v);
 
-   return 0;
+    return ret;
 }
 
 /*!
@@ -125,26 +159,15 @@ int Quaternion::renormalize(QuatData& q)
  */
 void Quaternion::mul_noRenormalize(QuatData& q, const QuatData& q1, const QuatData& q2)
 {
-    QuatData out;
-
-    out.a = q1.d * q2.a + q1.a * q2.d + q1.b * q2.c - q1.c * q2.b;
-    out.b = q1.d * q2.b - q1.a * q2.c + q1.b * q2.d + q1.c * q2.a;
-    out.c = q1.d * q2.c + q1.a * q2.b - q1.b * q2.a + q1.c * q2.d;
-    out.d = q1.d * q2.d - q1.a * q2.a - q1.b * q2.b - q1.c * q2.c;
-
-    q.a = out.a;
-    q.b = out.b;
-    q.c = out.c;
-    q.d = out.d;
+    storeQuat(q, mulVec(loadQuat(q1), loadQuat(q2)));
 }
 
 //! \brief Squared distance between two quaternions
 float Quaternion::dist(const QuatData& q1, const QuatData& q2)
 {
-    return (q1.a - q2.a) * (q1.a - q2.a)
-         + (q1.b - q2.b) * (q1.b - q2.b)
-         + (q1.c - q2.c) * (q1.c - q2.c)
-         + (q1.d - q2.d) * (q1.d - q2.d);
+    qvec4 diff = qv_sub(loadQuat(q1), loadQuat(q2));
+
+    return qv_dot(diff, diff);
 }
 
 /*!
@@ -168,25 +191,22 @@ float Quaternion::dist(const QuatData& q1, const QuatData& q2)
  */
 int Quaternion::linInterp(QuatData& out, const QuatData& q1, const QuatData& q2, const float alpha)
 {
-    QuatData minusQ2;
+    qvec4 v1 = loadQuat(q1);
+    qvec4 v2 = loadQuat(q2);
     float oneMinusAlpha = 1.f-alpha;
+    int ret;
 
     // There are always 2 ways to get from q1 to q2, just like there are always
     // 2 paths between any two places on Earth (the short arc, and the long arc).
-    // We will test to see which way is shorter by constructing -q2.
-    minusQ2.a = -q2.a;
-    minusQ2.b = -q2.b;
-    minusQ2.c = -q2.c;
-    minusQ2.d = -q2.d;
-
-    // Looks like the opposite way will be shorter...
-    if ( dist(q1, minusQ2) < dist(q1, q2) )
+    // ||q1 + q2||^2 < ||q1 - q2||^2 exactly when <q1,q2> < 0, in which case
+    // the opposite way (through -q2) will be shorter.
+    if ( qv_dot(v1, v2) < 0.f )
             oneMinusAlpha = -oneMinusAlpha;
 
-    out.a = alpha * q1.a + oneMinusAlpha * q2.a;
-    out.b = alpha * q1.b + oneMinusAlpha * q2.b;
-    out.c = alpha * q1.c + oneMinusAlpha * q2.c;
-    out.d = alpha * q1.d + oneMinusAlpha * q2.d;
+    v1 = qv_madd(qv_mul(qv_dup(alpha), v1), qv_dup(oneMinusAlpha), v2);
+    ret = renormalizeVec(v1);
 
-    return renormalize(out);
+    storeQuat(out, v1);
+
+    return ret;
 }
@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Copyright (C) 2015 Motorola Mobility LLC
+ */
+
+#ifndef QUATERNION_SIMD_H
+#define QUATERNION_SIMD_H
+
+/*!
+ * \file
+ * \brief 4-lane float vector helpers for the fusion kernels
+ *
+ * A \c qvec4 holds either one quaternion (a, b, c, d) or one component of
+ * four samples. NEON is used on AArch64, SSE2 on x86. Every other target,
+ * including 32-bit ARM (its NEON has no vector sqrt or divide), uses a plain
+ * array. All three give the same results up to float rounding.
+ */
+
+#include <math.h>
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define QUAT_SIMD_NEON
+#include <arm_neon.h>
+typedef float32x4_t qvec4;
+#elif defined(__SSE2__)
+#define QUAT_SIMD_SSE
+#include <xmmintrin.h>
+typedef __m128 qvec4;
+#else
+#define QUAT_SIMD_GENERIC
+typedef struct { float v[4]; } qvec4;
+#endif
+
+#ifdef QUAT_SIMD_GENERIC
+#define QV_MAP1(expr) \
+    qvec4 r; \
+    for (int i = 0; i < 4; i++) \
+        r.v[i] = (expr); \
+    return r
+#endif
+
+static inline qvec4 qv_load(const float* p)
+{
+#if defined(QUAT_SIMD_NEON)
+    return vld1q_f32(p);
+#elif defined(QUAT_SIMD_SSE)
+    return _mm_loadu_ps(p);
+#else
+    QV_MAP1(p[i]);
+#endif
+}
+
+static inline void qv_store(float* p, qvec4 a)
+{
+#if defined(QUAT_SIMD_NEON)
+    vst1q_f32(p, a);
+#elif defined(QUAT_SIMD_SSE)
+    _mm_storeu_ps(p, a);
+#else
+    for (int i = 0; i < 4; i++)
+        p[i] = a.v[i];
+#endif
+}
+
+//! \brief [x, y, z, w]
+static inline qvec4 qv_set(float x, float y, float z, float w)
+{
+#if defined(QUAT_SIMD_NEON)
+    qvec4 r = vdupq_n_f32(x);
+    r = vsetq_lane_f32(y, r, 1);
+    r = vsetq_lane_f32(z, r, 2);
+    return vsetq_lane_f32(w, r, 3);
+#elif defined(QUAT_SIMD_SSE)
+    return _mm_setr_ps(x, y, z, w);
+#else
+    qvec4 r = { { x, y, z, w } };
+    return r;
+#endif
+}
+
+static inline qvec4 qv_dup(float x)
+{
+#if defined(QUAT_SIMD_NEON)
+    return vdupq_n_f32(x);
+#elif defined(QUAT_SIMD_SSE)
+    return _mm_set1_ps(x);
+#else
+    QV_MAP1(x);
+#endif
+}
+
+static inline qvec4 qv_add(qvec4 a, qvec4 b)
+{
+#if defined(QUAT_SIMD_NEON)
+    return vaddq_f32(a, b);
+#elif defined(QUAT_SIMD_SSE)
+    return _mm_add_ps(a, b);
+#else
+    QV_MAP1(a.v[i] + b.v[i]);
+#endif
+}
+
+static inline qvec4 qv_sub(qvec4 a, qvec4 b)
+{
+#if defined(QUAT_SIMD_NEON)
+    return vsubq_f32(a, b);
+#elif defined(QUAT_SIMD_SSE)
+    return _mm_sub_ps(a, b);
+#else
+    QV_MAP1(a.v[i] - b.v[i]);
+#endif
+}
+
+static inline qvec4 qv_mul(qvec4 a, qvec4 b)
+{
+#if defined(QUAT_SIMD_NEON)
+    return vmulq_f32(a, b);
+#elif defined(QUAT_SIMD_SSE)
+    return _mm_mul_ps(a, b);
+#else
+    QV_MAP1(a.v[i] * b.v[i]);
+#endif
+}
+
+static inline qvec4 qv_div(qvec4 a, qvec4 b)
+{
+#if defined(QUAT_SIMD_NEON)
+    return vdivq_f32(a, b);
+#elif defined(QUAT_SIMD_SSE)
+    return _mm_div_ps(a, b);
+#else
+    QV_MAP1(a.v[i] / b.v[i]);
+#endif
+}
+
+static inline qvec4 qv_max(qvec4 a, qvec4 b)
+{
+#if defined(QUAT_SIMD_NEON)
+    return vmaxq_f32(a, b);
+#elif defined(QUAT_SIMD_SSE)
+    return _mm_max_ps(a, b);
+#else
+    QV_MAP1(a.v[i] > b.v[i] ? a.v[i] : b.v[i]);
+#endif
+}
+
+static inline qvec4 qv_sqrt(qvec4 a)
+{
+#if defined(QUAT_SIMD_NEON)
+    return vsqrtq_f32(a);
+#elif defined(QUAT_SIMD_SSE)
+    return _mm_sqrt_ps(a);
+#else
+    QV_MAP1(sqrtf(a.v[i]));
+#endif
+}
+
+//! \brief a + b*c
+static inline qvec4 qv_madd(qvec4 a, qvec4 b, qvec4 c)
+{
+    return qv_add(a, qv_mul(b, c));
+}
+
+//! \brief Broadcast lane \c n (a constant 0..3) to all lanes
+#if defined(QUAT_SIMD_NEON)
+#define qv_lane(a, n) vdupq_laneq_f32((a), (n))
+#elif defined(QUAT_SIMD_SSE)
+#define qv_lane(a, n) _mm_shuffle_ps((a), (a), _MM_SHUFFLE((n), (n), (n), (n)))
+#else
+#define qv_lane(a, n) qv_dup((a).v[(n)])
+#endif
+
+//! \brief [x, y, z, w] -> [y, x, w, z]
+static inline qvec4 qv_swap_pairs(qvec4 a)
+{
+#if defined(QUAT_SIMD_NEON)
+    return vrev64q_f32(a);
+#elif defined(QUAT_SIMD_SSE)
+    return _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1));
+#else
+    return qv_set(a.v[1], a.v[0], a.v[3], a.v[2]);
+#endif
+}
+
+//! \brief [x, y, z, w] -> [z, w, x, y]
+static inline qvec4 qv_swap_halves(qvec4 a)
+{
+#if defined(QUAT_SIMD_NEON)
+    return vextq_f32(a, a, 2);
+#elif defined(QUAT_SIMD_SSE)
+    return _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 3, 2));
+#else
+    return qv_set(a.v[2], a.v[3], a.v[0], a.v[1]);
+#endif
+}
+
+//! \brief x + y + z + w
+static inline float qv_hsum(qvec4 a)
+{
+#if defined(QUAT_SIMD_NEON)
+    return vaddvq_f32(a);
+#elif defined(QUAT_SIMD_SSE)
+    qvec4 s = _mm_add_ps(a, _mm_movehl_ps(a, a));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(s);
+#else
+    return (a.v[0] + a.v[1]) + (a.v[2] + a.v[3]);
+#endif
+}
+
+//! \brief Dot product of two 4-vectors
+static inline float qv_dot(qvec4 a, qvec4 b)
+{
+    return qv_hsum(qv_mul(a, b));
+}
+
+/*!
+ * \brief Largest angle (rad) handled by qv_sincos_small()
+ *
+ * At this bound the truncation error of both series is below 6e-9, well
+ * under half an ulp of the results. Larger angles must use sinf()/cosf().
+ */
+#define QV_SMALL_ANGLE_MAX (0.5f)
+
+/*!
+ * \brief sin(x) and cos(x) for |x| <= QV_SMALL_ANGLE_MAX
+ *
+ * Taylor series to x^7 for sin and x^8 for cos, evaluated with Horner's
+ * rule. A gyro step is far below the limit (2000 dps over 5 ms is 0.09 rad
+ * of half angle), so this replaces sinf()/cosf() in the integration loop.
+ */
+static inline void qv_sincos_small(qvec4 x, qvec4* s, qvec4* c)
+{
+    qvec4 x2 = qv_mul(x, x);
+    qvec4 ps = qv_madd(qv_dup(1.f / 120.f), x2, qv_dup(-1.f / 5040.f));
+    ps = qv_madd(qv_dup(-1.f / 6.f), x2, ps);
+    ps = qv_madd(qv_dup(1.f), x2, ps);
+    *s = qv_mul(x, ps);
+    qvec4 pc = qv_madd(qv_dup(-1.f / 720.f), x2, qv_dup(1.f / 40320.f));
+    pc = qv_madd(qv_dup(1.f / 24.f), x2, pc);
+    pc = qv_madd(qv_dup(-1.f / 2.f), x2, pc);
+    *c = qv_madd(qv_dup(1.f), x2, pc);
+}
+
+//! \brief Scalar qv_sincos_small(), for samples that do not fill a vector
+static inline void qv_sincos_small1(float x, float* s, float* c)
+{
+    float x2 = x * x;
+    *s = x * (1.f + x2 * (-1.f / 6.f + x2 * (1.f / 120.f + x2 * (-1.f / 5040.f))));
+    *c = 1.f + x2 * (-1.f / 2.f + x2 * (1.f / 24.f + x2 * (-1.f / 720.f + x2 * (1.f / 40320.f))));
+}
+
+#ifdef QUAT_SIMD_GENERIC
+#undef QV_MAP1
+#endif
+
+#endif // QUATERNION_SIMD_H
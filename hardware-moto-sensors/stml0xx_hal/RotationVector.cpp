@@ -22,14 +22,11 @@
 #include <math.h>
 #include <string.h>
 #include <log/log.h>
-#include "GyroIntegration.h"
 #include "Quaternion.h"
 #include "RotationVector.h"
-#include "SensorList.h"
-
-RotationVector RotationVector::self;
 
 RotationVector::RotationVector()
+: mGis()
 {
 }
 
@@ -37,21 +34,32 @@ RotationVector::~RotationVector()
 {
 }
 
-RotationVector *RotationVector::getInstance()
+void RotationVector::reset()
 {
-    return &self;
+    mGis.initialized = 0;
 }
 
 bool RotationVector::processFusion(FusionData& fusionData, bool reset)
 {
-    static struct GyroIntegrationState gis;
+    if (reset)
+        this->reset();
+
+    // Integrate forward the 6-axis
+    GyroIntegration::integrate(&mGis, fusionData.rotationVector, fusionData.geoMagRotation, fusionData);
+    fusionData.rotationVector.accuracy = 0;
+    fusionData.rotationVector.timestamp = fusionData.gyro.timestamp;
 
-    if (reset) {
-        gis.initialized = 0;
-	}
+    return true;
+}
+
+bool RotationVector::processFusion(FusionData& fusionData, bool reset,
+        const struct GyroIntegrationStep& step)
+{
+    if (reset)
+        this->reset();
 
     // Integrate forward the 6-axis
-    GyroIntegration::integrate(&gis, fusionData.rotationVector, fusionData.geoMagRotation, fusionData);
+    GyroIntegration::integrate(&mGis, fusionData.rotationVector, fusionData.geoMagRotation, step);
     fusionData.rotationVector.accuracy = 0;
     fusionData.rotationVector.timestamp = fusionData.gyro.timestamp;
 
@@ -23,18 +23,26 @@
 
 #include <stdint.h>
 #include "FusionSensorBase.h"
+#include "GyroIntegration.h"
 
 class RotationVector : public FusionSensorBase {
 public:
     RotationVector();
     virtual ~RotationVector();
 
-    static RotationVector* getInstance();
-
     bool processFusion(FusionData& fusionData, bool reset);
 
+    /*!
+     * \brief Same as processFusion() with a precomputed gyro step
+     * \see GyroIntegration::computeSteps()
+     */
+    bool processFusion(FusionData& fusionData, bool reset,
+            const struct GyroIntegrationStep& step);
+
+    void reset();
+
 private:
-    static RotationVector self;
+    struct GyroIntegrationState mGis;
 };
 
 #endif // ROTATION_VECTOR_H
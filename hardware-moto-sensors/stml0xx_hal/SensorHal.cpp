@@ -35,7 +35,7 @@
 static int poll__close(struct hw_device_t *dev)
 {
 	(void)dev;
-        return 0;
+	return SensorsPollContext::getInstance()->close();
 }
 
 static int poll__activate(struct sensors_poll_device_t *dev,
@@ -91,6 +91,27 @@ static int poll__flush(sensors_poll_device_1_t *dev,
 	return ctx->flush(handle);
 }
 
+/* Data injection requires operation mode 1, which isn't supported. */
+static int poll__inject_sensor_data(sensors_poll_device_1_t *dev,
+		const sensors_event_t *data) {
+	(void)dev;
+	(void)data;
+	return -EPERM;
+}
+
+static int poll__register_direct_channel(sensors_poll_device_1_t *dev,
+		const struct sensors_direct_mem_t* mem, int channel_handle) {
+	SensorsPollContext *ctx = (SensorsPollContext *)dev;
+	return ctx->registerDirectChannel(mem, channel_handle);
+}
+
+static int poll__config_direct_report(sensors_poll_device_1_t *dev,
+		int sensor_handle, int channel_handle,
+		const struct sensors_direct_cfg_t *config) {
+	SensorsPollContext *ctx = (SensorsPollContext *)dev;
+	return ctx->configDirectReport(sensor_handle, channel_handle, config);
+}
+
 /** Open a new instance of a sensor device using name */
 static int open_sensors(const struct hw_module_t* module, const char* id,
 			struct hw_device_t** device)
@@ -103,7 +124,7 @@ static int open_sensors(const struct hw_module_t* module, const char* id,
 		memset(&dev->device, 0, sizeof(sensors_poll_device_1_t));
 
 		dev->device.common.tag      = HARDWARE_DEVICE_TAG;
-		dev->device.common.version  = SENSORS_DEVICE_API_VERSION_1_3;
+		dev->device.common.version  = SENSORS_DEVICE_API_VERSION_1_4;
 		dev->device.common.module   = const_cast<hw_module_t*>(module);
 		dev->device.common.close    = poll__close;
 		dev->device.activate        = poll__activate;
@@ -111,6 +132,9 @@ static int open_sensors(const struct hw_module_t* module, const char* id,
 		dev->device.poll            = poll__poll;
 		dev->device.batch           = poll__batch;
 		dev->device.flush           = poll__flush;
+		dev->device.inject_sensor_data      = poll__inject_sensor_data;
+		dev->device.register_direct_channel = poll__register_direct_channel;
+		dev->device.config_direct_report    = poll__config_direct_report;
 
 		*device = &dev->device.common;
 		status = 0;
@@ -64,9 +64,7 @@ SensorsPollContext::SensorsPollContext()
     char *ecomp_prop = {"ro.vendor.hw.ecompass"};
     mSensors[sensor_hub] = HubSensors::getInstance();
     if (mSensors[sensor_hub]) {
-        mPollFds[sensor_hub].fd = mSensors[sensor_hub]->getFd();
-        mPollFds[sensor_hub].events = POLLIN;
-        mPollFds[sensor_hub].revents = 0;
+        mEventLoop.addDriver(mSensors[sensor_hub], mSensors[sensor_hub]->getFd());
     } else {
         ALOGE("out of memory: new failed for HubSensors");
     }
@@ -75,9 +73,7 @@ SensorsPollContext::SensorsPollContext()
     mSensors[rearprox] =new RearProxSensor(0);
     ALOGE("rearprox sensor_1 created");
     if (mSensors[rearprox]) {
-        mPollFds[rearprox].fd = mSensors[rearprox]->getFd();
-        mPollFds[rearprox].events = POLLIN;
-        mPollFds[rearprox].revents = 0;
+        mEventLoop.addDriver(mSensors[rearprox], mSensors[rearprox]->getFd());
     } else {
         ALOGE("out of memory: new failed for rearprox sensor_1");
     }
@@ -86,9 +82,7 @@ SensorsPollContext::SensorsPollContext()
     mSensors[rearprox_2] =new RearProxSensor(1);
     ALOGE("rearprox sensor_2 created");
     if (mSensors[rearprox_2]) {
-        mPollFds[rearprox_2].fd = mSensors[rearprox_2]->getFd();
-        mPollFds[rearprox_2].events = POLLIN;
-        mPollFds[rearprox_2].revents = 0;
+        mEventLoop.addDriver(mSensors[rearprox_2], mSensors[rearprox_2]->getFd());
     } else {
         ALOGE("out of memory: new failed for rearprox sensor_2");
     }
@@ -118,15 +112,18 @@ SensorsPollContext::SensorsPollContext()
         sSensorList.push_back(capSensorType);
         mSensors[capsense] = CapSense::getInstance();
         if (mSensors[capsense]) {
-            mPollFds[capsense].fd = mSensors[capsense]->getFd();
-            mPollFds[capsense].events = POLLIN;
-            mPollFds[capsense].revents = 0;
+            mEventLoop.addDriver(mSensors[capsense], mSensors[capsense]->getFd());
         } else {
             ALOGE("out of memory: new failed for capsense sensor");
         }
     }
 #endif
 
+    // The IMU and fusion sensors can also be reported through direct channels
+    for (auto& sensor : sSensorList) {
+        DirectReport::advertise(sensor);
+    }
+
     // Add all supported sensors to the mIdToSensor map
     for( unsigned int i = 0; i < sSensorList.size(); ++i ) {
         mIdToSensor.insert(std::make_pair(sSensorList[i].handle, &(sSensorList.at(i))));
@@ -215,7 +212,10 @@ int SensorsPollContext::activate(int handle, int enabled)
         return -EINVAL;
     }
 
-    err = mSensors[drv]->setEnable(handle, enabled);
+    // A sensor streaming to a direct channel stays enabled
+    mDirectReport.setPollEnabled(handle, enabled);
+    int64_t ns = 0, timeout = 0;
+    err = mSensors[drv]->setEnable(handle, mDirectReport.getRate(handle, ns, timeout));
 
     return err;
 }
@@ -233,6 +233,10 @@ int SensorsPollContext::setDelay(int handle, int64_t ns)
         return -EINVAL;
     }
 
+    // A direct report may need a faster rate than the poll path
+    int64_t timeout = 0;
+    mDirectReport.setPollRate(handle, ns, 0);
+    mDirectReport.getRate(handle, ns, timeout);
     err = mSensors[drv]->setDelay(handle, ns);
 
     return err;
@@ -240,11 +244,6 @@ int SensorsPollContext::setDelay(int handle, int64_t ns)
 
 int SensorsPollContext::pollEvents(sensors_event_t* data, int count)
 {
-    int nbEvents = 0;
-    int n = 0;
-    int ret;
-    int err;
-
     if (!data) {
         ALOGE("poll failed, data buffer is null");
         return -EINVAL;
@@ -255,44 +254,18 @@ int SensorsPollContext::pollEvents(sensors_event_t* data, int count)
         return -EINVAL;
     }
 
-    while (true) {
-        ret = poll(mPollFds, numSensorDrivers, nbEvents ? 0 : -1);
-        err = errno;
-        // Success
-        if (ret >= 0)
-            break;
-        // EINTR is OK
-        if (err == EINTR) {
-            ALOGE("poll() restart (%s)", strerror(err));
-            continue;
-        } else {
-            ALOGE("poll() failed (%s)", strerror(err));
-            return 0;
-        }
-    }
-
-
-    for (int i=0 ; count && i<numSensorDrivers ; i++) {
-        //add a null detect here
-        //this make daynamic sSensorList compatible with immutable array mSensors and mPollFds
-        //if a sensor isn't added in mSensors, then shouldn't pollfd
-        if (!mSensors[i])
-            continue;
-        SensorBase* const sensor(mSensors[i]);
-        if ((mPollFds[i].revents & POLLIN) || (sensor->hasPendingEvents())) {
-            int nb = sensor->readEvents(data, count);
-            if (nb < 0) {
-                ALOGE("readEvents failed %d possibly dropped events", nb);
-                return nbEvents;
-            }
-            count -= nb;
-            nbEvents += nb;
-            data += nb;
-            mPollFds[i].revents = 0;
-        }
+    int ret = mEventLoop.poll(data, count);
+    if (ret > 0) {
+        ret = mDirectReport.dispatch(data, ret);
     }
+    // poll__poll() calls us again on 0
+    return ret >= 0 ? ret : 0;
+}
 
-    return nbEvents;
+int SensorsPollContext::close()
+{
+    mEventLoop.dumpStats();
+    return 0;
 }
 
 int SensorsPollContext::batch(int handle, int flags, int64_t ns, int64_t timeout)
@@ -319,3 +292,61 @@ int SensorsPollContext::flush(int handle)
     // implemented by rearprox driver ideally
     return mSensors[sensor_hub]->flush(handle);
 }
+
+int SensorsPollContext::registerDirectChannel(const struct sensors_direct_mem_t* mem, int channel)
+{
+    if (mem)
+        return mDirectReport.registerChannel(mem);
+
+    for (int handle : mDirectReport.unregisterChannel(channel))
+        updateDirectReport(handle);
+    return 0;
+}
+
+int SensorsPollContext::configDirectReport(int handle, int channel,
+        const struct sensors_direct_cfg_t *config)
+{
+    if (!config)
+        return -EINVAL;
+
+    if (handle == -1) {
+        if (config->rate_level != SENSOR_DIRECT_RATE_STOP)
+            return -EINVAL;
+        for (int h : mDirectReport.stopChannel(channel))
+            updateDirectReport(h);
+        return 0;
+    }
+
+    if (!mIdToSensor.count(handle) ||
+            config->rate_level > DirectReport::getMaxRateLevel(*mIdToSensor[handle])) {
+        ALOGE("Sensorhub hal configDirectReport: %d - %d (bad handle or rate)",
+                handle, config->rate_level);
+        return -EINVAL;
+    }
+
+    int token = mDirectReport.configure(handle, channel, config->rate_level);
+    if (token < 0)
+        return token;
+
+    int err = updateDirectReport(handle);
+    return err < 0 ? err : token;
+}
+
+/* Applies the combined poll and direct report rate to a sensor's driver. */
+int SensorsPollContext::updateDirectReport(int handle)
+{
+    int drv = handleToDriver(handle);
+    int64_t ns = 0, timeout = 0;
+    int err;
+
+    if (drv < 0 || !mSensors[drv])
+        return -EINVAL;
+
+    bool enabled = mDirectReport.getRate(handle, ns, timeout);
+    if (enabled) {
+        err = mSensors[drv]->setDelay(handle, ns);
+        if (err < 0)
+            return err;
+    }
+    return mSensors[drv]->setEnable(handle, enabled);
+}
@@ -40,6 +40,8 @@
 
 #include "Sensors.h"
 #include "SensorBase.h"
+#include "SensorsEventLoop.h"
+#include "DirectChannel.h"
 
 
 class SensorsPollContext {
@@ -54,6 +56,9 @@ public:
     int pollEvents(sensors_event_t* data, int count);
     int batch(int handle, int flags, int64_t ns, int64_t timeout);
     int flush(int handle);
+    int close();
+    int registerDirectChannel(const struct sensors_direct_mem_t* mem, int channel);
+    int configDirectReport(int handle, int channel, const struct sensors_direct_cfg_t *config);
 
 private:
     enum {
@@ -72,13 +77,15 @@ private:
     };
 
     static SensorsPollContext self;
-    struct pollfd mPollFds[numSensorDrivers];
+    SensorsEventLoop<SensorBase> mEventLoop;
+    DirectReport mDirectReport;
     SensorBase* mSensors[numSensorDrivers];
 
         //! \brief Map from sensor id (handle) to sensor_t entry
         std::map<int32_t, const sensor_t*> mIdToSensor;
 
     int handleToDriver(int handle);
+    int updateDirectReport(int handle);
 };
 
 #endif /* SENSORS_POLL_CONTEXT_H */
@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) 2017 Motorola Mobility LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Error bound and speedup of the fusion fast path (QuaternionSimd.h and the
+// batched gyro steps) against the scalar sinf/cosf code it replaced. The
+// scalar code is kept here as the reference. Exits with 1 if an error bound
+// is exceeded.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "GyroIntegration.h"
+#include "Quaternion.h"
+#include "QuaternionSimd.h"
+
+#define SAMPLE_PERIOD_NS    (5000000LL)
+#define SAMPLE_COUNT        (20000)
+// a gap this long every GAP_EVERY samples takes the sinf/cosf path
+#define GAP_EVERY           (1000)
+#define GAP_NS              (400000000LL)
+#define RUNS                (9)
+
+// Bounds checked against. The series alone is good to 6e-9, the rest is
+// float rounding that differs from libm.
+#define SINCOS_MAX_ERROR    (1e-6)
+#define STEP_MAX_ERROR      (1e-6f)
+#define INTEGRATE_MAX_ERROR (2e-5f)
+
+namespace {
+
+/*
+ * The scalar code before the fast path, as GyroIntegration::integrate() and
+ * Quaternion::mul()/renormalize()/linInterp() used to be.
+ */
+namespace scalar {
+
+int renormalize(QuatData& q)
+{
+    float mag = q.a * q.a + q.b * q.b + q.c * q.c + q.d * q.d;
+
+    if (mag < 0.0001f) {
+        q.a = 0.f;
+        q.b = 0.f;
+        q.c = 0.f;
+        q.d = 1.f;
+        return 1;
+    } else if (mag > 1.f + 0.0001f || mag < 1.f - 0.0001f) {
+        mag = copysignf(sqrtf(mag), q.d);
+        q.a /= mag;
+        q.b /= mag;
+        q.c /= mag;
+        q.d /= mag;
+    }
+    return 0;
+}
+
+int mul(QuatData& q, const QuatData& q1, const QuatData& q2)
+{
+    QuatData out;
+    int ret;
+
+    out.a = q1.d * q2.a + q1.a * q2.d + q1.b * q2.c - q1.c * q2.b;
+    out.b = q1.d * q2.b - q1.a * q2.c + q1.b * q2.d + q1.c * q2.a;
+    out.c = q1.d * q2.c + q1.a * q2.b - q1.b * q2.a + q1.c * q2.d;
+    out.d = q1.d * q2.d - q1.a * q2.a - q1.b * q2.b - q1.c * q2.c;
+    ret = renormalize(out);
+
+    q.a = out.a;
+    q.b = out.b;
+    q.c = out.c;
+    q.d = out.d;
+    return ret;
+}
+
+float dist(const QuatData& q1, const QuatData& q2)
+{
+    return (q1.a - q2.a) * (q1.a - q2.a)
+         + (q1.b - q2.b) * (q1.b - q2.b)
+         + (q1.c - q2.c) * (q1.c - q2.c)
+         + (q1.d - q2.d) * (q1.d - q2.d);
+}
+
+int linInterp(QuatData& out, const QuatData& q1, const QuatData& q2, const float alpha)
+{
+    QuatData minusQ2;
+    float oneMinusAlpha = 1.f - alpha;
+
+    minusQ2.a = -q2.a;
+    minusQ2.b = -q2.b;
+    minusQ2.c = -q2.c;
+    minusQ2.d = -q2.d;
+    if (dist(q1, minusQ2) < dist(q1, q2))
+        oneMinusAlpha = -oneMinusAlpha;
+
+    out.a = alpha * q1.a + oneMinusAlpha * q2.a;
+    out.b = alpha * q1.b + oneMinusAlpha * q2.b;
+    out.c = alpha * q1.c + oneMinusAlpha * q2.c;
+    out.d = alpha * q1.d + oneMinusAlpha * q2.d;
+    return renormalize(out);
+}
+
+void step(QuatData& q, float& gyroMag, const CartData& gyro, int64_t prevTimestamp)
+{
+    float dt;
+    float gyroX = gyro.x;
+    float gyroY = gyro.y;
+    float gyroZ = gyro.z;
+    float halfTheta;
+
+    if (gyro.timestamp != prevTimestamp)
+        dt = (float)(gyro.timestamp - prevTimestamp) / 1000000000.f;
+    else
+        dt = (float)GYRO_INTEGRATION_DEFAULT_DT_US / 1000000.f;
+
+    gyroMag = gyroX*gyroX + gyroY*gyroY + gyroZ*gyroZ;
+    if (gyroMag > (float)1e-5) {
+        gyroMag = sqrtf(gyroMag);
+        gyroX /= gyroMag;
+        gyroY /= gyroMag;
+        gyroZ /= gyroMag;
+        halfTheta = dt * gyroMag / 2.f;
+    } else {
+        halfTheta = 0.f;
+    }
+
+    float sinHalfTheta = sinf(halfTheta);
+    float cosHalfTheta = cosf(halfTheta);
+    q.a = sinHalfTheta * gyroX;
+    q.b = sinHalfTheta * gyroY;
+    q.c = sinHalfTheta * gyroZ;
+    q.d = cosHalfTheta;
+    q.timestamp = gyro.timestamp;
+    renormalize(q);
+}
+
+void integrate(struct GyroIntegrationState* gis, QuatData& rvOut, const QuatData& rvIn,
+        const CartData& gyro)
+{
+    QuatData quatGyroDelta;
+    float gyroMag;
+
+    if (!gis->initialized) {
+        gis->quatGyro = rvIn;
+        gis->initialized = 1;
+    }
+
+    step(quatGyroDelta, gyroMag, gyro, gis->quatGyro.timestamp);
+    gis->quatGyro.timestamp = gyro.timestamp;
+    if (mul(gis->quatGyro, gis->quatGyro, quatGyroDelta)) {
+        gis->initialized = 0;
+        return;
+    }
+    linInterp(gis->quatGyro, rvIn, gis->quatGyro,
+            gyroMag < NINE_AXIS_FILTER_SELECT_THRESH ?
+            NINE_AXIS_FILTER_ALPHA_SLOW : NINE_AXIS_FILTER_ALPHA_FAST);
+    rvOut = gis->quatGyro;
+}
+
+} // namespace scalar
+
+// Tumbling at up to ~4 rad/s, with an occasional long gap between samples
+void makeStream(std::vector<CartData>& gyro, std::vector<QuatData>& rvIn)
+{
+    int64_t ts = 1000000000LL;
+
+    gyro.resize(SAMPLE_COUNT);
+    rvIn.resize(SAMPLE_COUNT);
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        float t = i * (SAMPLE_PERIOD_NS / 1e9f);
+
+        ts += (i % GAP_EVERY == GAP_EVERY - 1) ? GAP_NS : SAMPLE_PERIOD_NS;
+        gyro[i].x = 2.5f * sinf(1.1f * t);
+        gyro[i].y = 3.0f * cosf(0.5f * t);
+        gyro[i].z = (i % 97 == 0) ? 0.f : 0.1f + 0.05f * sinf(2.0f * t);
+        if (i % 97 == 0) {
+            // too small to normalize
+            gyro[i].x = 0.f;
+            gyro[i].y = 0.f;
+        }
+        gyro[i].timestamp = ts;
+
+        // a unit 6-axis RV for the 9-axis filter to pull towards
+        float h = 0.3f * sinf(0.2f * t);
+        rvIn[i].a = sinf(h) * 0.6f;
+        rvIn[i].b = sinf(h) * 0.8f;
+        rvIn[i].c = 0.f;
+        rvIn[i].d = cosf(h);
+        rvIn[i].accuracy = 0.f;
+        rvIn[i].timestamp = ts;
+    }
+}
+
+float quatError(const QuatData& a, const QuatData& b)
+{
+    float e = fabsf(a.a - b.a);
+    e = fmaxf(e, fabsf(a.b - b.b));
+    e = fmaxf(e, fabsf(a.c - b.c));
+    return fmaxf(e, fabsf(a.d - b.d));
+}
+
+// Best of RUNS, in ns per sample
+template <typename F>
+double timePerSample(F f)
+{
+    double best = 0;
+
+    for (int r = 0; r < RUNS; r++) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double, std::nano> d = std::chrono::steady_clock::now() - start;
+        if (r == 0 || d.count() < best)
+            best = d.count();
+    }
+    return best / SAMPLE_COUNT;
+}
+
+volatile float sink;
+
+} // namespace
+
+int main()
+{
+    std::vector<CartData> gyro;
+    std::vector<QuatData> rvIn;
+    std::vector<struct GyroIntegrationStep> steps(SAMPLE_COUNT);
+    std::vector<QuatData> scalarSteps(SAMPLE_COUNT);
+    std::vector<QuatData> out(SAMPLE_COUNT);
+    std::vector<QuatData> scalarOut(SAMPLE_COUNT);
+    double sincosError = 0;
+    float stepError = 0;
+    float integrateError = 0;
+    float batchError = 0;
+    int failed = 0;
+
+    makeStream(gyro, rvIn);
+
+    // 1) sin/cos series over its whole range, scalar and vector
+    for (int i = -100000; i <= 100000; i += 4) {
+        float x[4], s[4], c[4];
+        qvec4 vs, vc;
+
+        for (int j = 0; j < 4; j++)
+            x[j] = QV_SMALL_ANGLE_MAX * (i + j) / 100000.f;
+        qv_sincos_small(qv_load(x), &vs, &vc);
+        qv_store(s, vs);
+        qv_store(c, vc);
+        for (int j = 0; j < 4; j++) {
+            float s1, c1;
+
+            qv_sincos_small1(x[j], &s1, &c1);
+            sincosError = fmax(sincosError, fabs(s[j] - sin((double)x[j])));
+            sincosError = fmax(sincosError, fabs(c[j] - cos((double)x[j])));
+            sincosError = fmax(sincosError, fabs(s1 - sin((double)x[j])));
+            sincosError = fmax(sincosError, fabs(c1 - cos((double)x[j])));
+        }
+    }
+
+    // 2) one gyro step
+    GyroIntegration::computeSteps(steps.data(), gyro.data(), SAMPLE_COUNT, 0);
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        float mag;
+
+        scalar::step(scalarSteps[i], mag, gyro[i], i ? gyro[i - 1].timestamp : 0);
+        stepError = fmaxf(stepError, quatError(scalarSteps[i], steps[i].quatGyroDelta));
+    }
+
+    // 3) the whole 9-axis integration, one sample at a time and batched
+    {
+        struct GyroIntegrationState gis, batchGis, scalarGis;
+        FusionData fd;
+
+        memset(&gis, 0, sizeof(gis));
+        memset(&batchGis, 0, sizeof(batchGis));
+        memset(&scalarGis, 0, sizeof(scalarGis));
+        memset(&fd, 0, sizeof(fd));
+        for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+            QuatData batchOut;
+
+            fd.gyro = gyro[i];
+            GyroIntegration::integrate(&gis, out[i], rvIn[i], fd);
+            GyroIntegration::integrate(&batchGis, batchOut, rvIn[i], steps[i]);
+            scalar::integrate(&scalarGis, scalarOut[i], rvIn[i], gyro[i]);
+            integrateError = fmaxf(integrateError, quatError(scalarOut[i], out[i]));
+            batchError = fmaxf(batchError, quatError(scalarOut[i], batchOut));
+        }
+    }
+
+    printf("fusion fast path, %d samples, best of %d runs\n\n", SAMPLE_COUNT, RUNS);
+    printf("%-24s %12s %12s\n", "max abs error", "measured", "bound");
+    printf("%-24s %12.3g %12.3g\n", "sin/cos series", sincosError, SINCOS_MAX_ERROR);
+    printf("%-24s %12.3g %12.3g\n", "gyro step", stepError, STEP_MAX_ERROR);
+    printf("%-24s %12.3g %12.3g\n", "9-axis integration", integrateError, INTEGRATE_MAX_ERROR);
+    printf("%-24s %12.3g %12.3g\n", "batched integration", batchError, INTEGRATE_MAX_ERROR);
+    if (sincosError > SINCOS_MAX_ERROR || stepError > STEP_MAX_ERROR ||
+            integrateError > INTEGRATE_MAX_ERROR || batchError > INTEGRATE_MAX_ERROR)
+        failed = 1;
+
+    double scalarStepNs = timePerSample([&] {
+        float mag;
+        for (size_t i = 0; i < SAMPLE_COUNT; i++)
+            scalar::step(scalarSteps[i], mag, gyro[i], i ? gyro[i - 1].timestamp : 0);
+        sink = scalarSteps[SAMPLE_COUNT - 1].a;
+    });
+    double stepNs = timePerSample([&] {
+        GyroIntegration::computeSteps(steps.data(), gyro.data(), SAMPLE_COUNT, 0);
+        sink = steps[SAMPLE_COUNT - 1].quatGyroDelta.a;
+    });
+
+    double scalarMulNs = timePerSample([&] {
+        QuatData q = rvIn[0];
+        for (size_t i = 0; i < SAMPLE_COUNT; i++)
+            scalar::mul(q, q, scalarSteps[i]);
+        sink = q.a;
+    });
+    double mulNs = timePerSample([&] {
+        QuatData q = rvIn[0];
+        for (size_t i = 0; i < SAMPLE_COUNT; i++)
+            Quaternion::mul(q, q, scalarSteps[i]);
+        sink = q.a;
+    });
+
+    double scalarIntegrateNs = timePerSample([&] {
+        struct GyroIntegrationState gis;
+        memset(&gis, 0, sizeof(gis));
+        for (size_t i = 0; i < SAMPLE_COUNT; i++)
+            scalar::integrate(&gis, scalarOut[i], rvIn[i], gyro[i]);
+        sink = scalarOut[SAMPLE_COUNT - 1].a;
+    });
+    double integrateNs = timePerSample([&] {
+        struct GyroIntegrationState gis;
+        FusionData fd;
+        memset(&gis, 0, sizeof(gis));
+        memset(&fd, 0, sizeof(fd));
+        for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+            fd.gyro = gyro[i];
+            GyroIntegration::integrate(&gis, out[i], rvIn[i], fd);
+        }
+        sink = out[SAMPLE_COUNT - 1].a;
+    });
+    double batchNs = timePerSample([&] {
+        struct GyroIntegrationState gis;
+        memset(&gis, 0, sizeof(gis));
+        GyroIntegration::computeSteps(steps.data(), gyro.data(), SAMPLE_COUNT, 0);
+        for (size_t i = 0; i < SAMPLE_COUNT; i++)
+            GyroIntegration::integrate(&gis, out[i], rvIn[i], steps[i]);
+        sink = out[SAMPLE_COUNT - 1].a;
+    });
+
+    printf("\n%-24s %12s %12s %9s\n", "ns/sample", "scalar", "fast path", "speedup");
+    printf("%-24s %12.1f %12.1f %8.2fx\n", "gyro step", scalarStepNs, stepNs,
+            scalarStepNs / stepNs);
+    printf("%-24s %12.1f %12.1f %8.2fx\n", "quaternion mul", scalarMulNs, mulNs,
+            scalarMulNs / mulNs);
+    printf("%-24s %12.1f %12.1f %8.2fx\n", "9-axis integration", scalarIntegrateNs,
+            integrateNs, scalarIntegrateNs / integrateNs);
+    printf("%-24s %12.1f %12.1f %8.2fx\n", "batched integration", scalarIntegrateNs,
+            batchNs, scalarIntegrateNs / batchNs);
+
+    if (failed)
+        printf("\nFAILED: error bound exceeded\n");
+    return failed;
+}
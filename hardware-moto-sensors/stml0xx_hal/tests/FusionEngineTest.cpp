@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2017 Motorola Mobility LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks FusionEngine against the fusion singletons it replaced. A synthetic
+// accel/gyro/mag stream is pushed through the engine the way HubSensors does
+// it, including a disable/enable of the fusion sensors, and the fused outputs
+// are compared with the values the old GameRotationVector, LinearAccelGravity,
+// GeoMagRotationVector and RotationVector singletons produced for the same
+// stream. The batch processFusion() is checked against the per-stage calls.
+
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "FusionEngine.h"
+
+#define SAMPLE_PERIOD_NS    (5000000LL)
+#define SAMPLE_COUNT        (1200)
+// one mag sample for this many accel/gyro samples
+#define MAG_DECIMATION      (4)
+// all fusion sensors are disabled for [DISABLE_AT, ENABLE_AT)
+#define DISABLE_AT          (600)
+#define ENABLE_AT           (700)
+// only the 9-axis RV is disabled and enabled again here
+#define RV_RESET_AT         (900)
+
+// The quaternion fast path (QuaternionSimd.h) does not round the same way as
+// the libm trig the singletons used.
+#define TOLERANCE           (2e-4f)
+
+namespace {
+
+struct Expected {
+    size_t index;
+    float gameRotation[4];
+    float geoMagRotation[4];
+    float rotationVector[4];
+    float gravity[3];
+    float linearAccel[3];
+};
+
+// Recorded from the processFusion() singletons of the HAL before
+// FusionEngine, driven by runHalSequence() below.
+const Expected EXPECTED[] = {
+    { 0,
+      { 5.8122341e-02f, -2.2061843e-02f, -3.8338441e-01f, 9.2149419e-01f },
+      { 4.8941974e-02f, 3.8284373e-02f, 6.1493772e-01f, 7.8612369e-01f },
+      { 4.8331797e-02f, 3.9064355e-02f, 6.1508459e-01f, 7.8600812e-01f },
+      { -3.8311392e-02f, 1.2163692e+00f, 9.7308474e+00f },
+      { 3.8311392e-02f, -1.6369104e-02f, -1.3084698e-01f } },
+    { 1,
+      { 5.8885977e-02f, -2.0234475e-02f, -3.8303581e-01f, 9.2163259e-01f },
+      { 4.9097311e-02f, 3.8073219e-02f, 6.1506253e-01f, 7.8602672e-01f },
+      { 4.8488088e-02f, 3.8853902e-02f, 6.1520994e-01f, 7.8591090e-01f },
+      { -7.6623000e-02f, 1.2164514e+00f, 9.7306099e+00f },
+      { 8.1872992e-02f, -1.6453743e-02f, -1.2930965e-01f } },
+    { 10,
+      { 6.5859899e-02f, -3.8381966e-03f, -3.7977490e-01f, 9.2272401e-01f },
+      { 5.0731193e-02f, 3.5816979e-02f, 6.1072898e-01f, 7.8940076e-01f },
+      { 5.0136179e-02f, 3.6607850e-02f, 6.1088252e-01f, 7.8928363e-01f },
+      { -4.2110386e-01f, 1.2204987e+00f, 9.7212877e+00f },
+      { 4.7359315e-01f, -2.0738602e-02f, -1.0829639e-01f } },
+    { 100,
+      { 1.4444560e-01f, 1.5258534e-01f, -3.3656725e-01f, 9.1792184e-01f },
+      { 5.9228510e-02f, 2.2298140e-02f, 5.8298522e-01f, 8.1001419e-01f },
+      { -6.8779704e-03f, 1.3055129e-01f, 6.1378288e-01f, 7.7857500e-01f },
+      { -3.7005630e+00f, 1.5932699e+00f, 8.9407892e+00f },
+      { 4.2149096e+00f, -4.1718996e-01f, 7.8024864e-01f } },
+    { 400,
+      { 3.9014265e-01f, 4.7513416e-01f, -1.9833800e-01f, 7.6334679e-01f },
+      { 7.3791683e-02f, -3.9267574e-02f, 4.6312502e-01f, 8.8234240e-01f },
+      { -1.6769013e-01f, 5.2113783e-01f, 5.8062673e-01f, 6.0263419e-01f },
+      { -8.6312695e+00f, 3.9928164e+00f, 2.3935339e+00f },
+      { 1.0109444e+01f, -3.1567683e+00f, 7.3095665e+00f } },
+    { 599,
+      { 2.9449412e-01f, 3.1538764e-01f, -2.9772601e-01f, 8.5156506e-01f },
+      { 5.4324444e-02f, -5.6256007e-02f, 3.7201002e-01f, 9.2492849e-01f },
+      { -9.7268417e-02f, 3.7454733e-01f, 5.4391354e-01f, 7.4458784e-01f },
+      { -6.9872708e+00f, 3.0769701e+00f, 6.1547284e+00f },
+      { 8.2847271e+00f, -2.6399047e+00f, 3.3086658e+00f } },
+    { 650,
+      { -4.7433963e-03f, -7.1456745e-02f, -3.7961134e-01f, 9.2237008e-01f },
+      { 5.4324444e-02f, -5.6256007e-02f, 3.7201002e-01f, 9.2492849e-01f },
+      { -9.7268417e-02f, 3.7454733e-01f, 5.4391354e-01f, 7.4458784e-01f },
+      { -6.9872708e+00f, 3.0769701e+00f, 6.1547284e+00f },
+      { 8.2847271e+00f, -2.6399047e+00f, 3.3086658e+00f } },
+    { 700,
+      { -5.0940193e-02f, -9.1836616e-02f, -3.5028863e-01f, 9.3072999e-01f },
+      { 2.4235493e-02f, -4.5786619e-02f, 2.7287653e-01f, 9.6065325e-01f },
+      { 2.4120616e-02f, -4.6005599e-02f, 2.7302381e-01f, 9.6060377e-01f },
+      { 2.0264456e+00f, -2.9895389e-01f, 9.5903358e+00f },
+      { -1.0697986e+00f, 5.0291449e-01f, -1.8770409e-01f } },
+    { 701,
+      { -5.1256653e-02f, -9.1978423e-02f, -3.5000414e-01f, 9.3080103e-01f },
+      { 2.4050020e-02f, -4.5620993e-02f, 2.7272421e-01f, 9.6070904e-01f },
+      { 2.3934782e-02f, -4.5842577e-02f, 2.7287191e-01f, 9.6065938e-01f },
+      { 2.0310681e+00f, -3.0434373e-01f, 9.5891886e+00f },
+      { -1.0784703e+00f, 5.0593889e-01f, -1.8676281e-01f } },
+    { 750,
+      { -6.9922306e-02f, -1.0187516e-01f, -3.3518431e-01f, 9.3400472e-01f },
+      { 1.5537494e-02f, -3.8892951e-02f, 2.4175711e-01f, 9.6943253e-01f },
+      { 1.2947951e-02f, -4.6668623e-02f, 2.4847037e-01f, 9.6742672e-01f },
+      { 2.3259609e+00f, -6.1117804e-01f, 9.5071945e+00f },
+      { -1.5850804e+00f, 6.9606268e-01f, -1.0455608e-01f } },
+    { 899,
+      { -1.5766224e-01f, -1.7896642e-01f, -2.8400689e-01f, 9.2863983e-01f },
+      { -4.8090126e-03f, -1.5901972e-02f, 1.5151729e-01f, 9.8831499e-01f },
+      { -2.0192211e-02f, -1.8134797e-01f, 2.7886704e-01f, 9.4280505e-01f },
+      { 4.1382060e+00f, -1.8748658e+00f, 8.6908293e+00f },
+      { -4.1455669e+00f, 1.6045611e+00f, 8.2404041e-01f } },
+    { 900,
+      { -1.5852413e-01f, -1.7994739e-01f, -2.8361553e-01f, 9.2842317e-01f },
+      { -4.9750204e-03f, -1.5665954e-02f, 1.5059583e-01f, 9.8845875e-01f },
+      { -5.2516861e-03f, -1.7870830e-02f, 1.5196197e-01f, 9.8821080e-01f },
+      { 4.1588936e+00f, -1.8858080e+00f, 8.6785774e+00f },
+      { -4.1715040e+00f, 1.6131654e+00f, 8.3747005e-01f } },
+    { 901,
+      { -1.5938601e-01f, -1.8093199e-01f, -2.8322393e-01f, 9.2820370e-01f },
+      { -5.1414650e-03f, -1.5429224e-02f, 1.4968215e-01f, 9.8860037e-01f },
+      { -5.5451170e-03f, -1.9188358e-02f, 1.5225659e-01f, 9.8813909e-01f },
+      { 4.1796155e+00f, -1.8967302e+00f, 8.6662340e+00f },
+      { -4.1974764e+00f, 1.6217510e+00f, 8.5099506e-01f } },
+    { 1000,
+      { -2.4109001e-01f, -2.9504269e-01f, -2.4248454e-01f, 8.9215714e-01f },
+      { -1.9440632e-02f, 1.0383872e-02f, 5.0312817e-02f, 9.9849027e-01f },
+      { -2.5713092e-02f, -1.6561581e-01f, 1.7443110e-01f, 9.7030026e-01f },
+      { 6.3098249e+00f, -2.8156600e+00f, 6.9590631e+00f },
+      { -6.8360000e+00f, 2.3162837e+00f, 2.6839614e+00f } },
+    { 1199,
+      { -3.4027156e-01f, -5.7925242e-01f, -1.1613017e-01f, 7.3151523e-01f },
+      { -2.9776400e-02f, 6.1220422e-02f, -1.6029845e-01f, 9.8471814e-01f },
+      { 1.1885989e-02f, -5.0237131e-01f, 2.0203850e-01f, 8.4063143e-01f },
+      { 9.0865545e+00f, -3.5629501e+00f, 9.5409405e-01f },
+      { -1.0391336e+01f, 2.6797006e+00f, 8.8455410e+00f } },
+};
+
+const uint32_t ALL_OUTPUTS = FusionEngine::FUSION_GAME_RV |
+        FusionEngine::FUSION_LA_GRAVITY | FusionEngine::FUSION_GEOMAG_RV |
+        FusionEngine::FUSION_ROTATION_VECT;
+
+// Slow tumbling motion, with gravity mostly along z
+void makeSample(size_t i, FusionData& d)
+{
+    float t = i * (SAMPLE_PERIOD_NS / 1e9f);
+    int64_t ts = 1000000000LL + i * SAMPLE_PERIOD_NS;
+
+    d.accel.x = 1.5f * sinf(0.7f * t);
+    d.accel.y = 1.2f * cosf(0.4f * t);
+    d.accel.z = 9.6f + 0.2f * sinf(1.3f * t);
+    d.accel.timestamp = ts;
+
+    d.gyro.x = 0.2f * sinf(1.1f * t);
+    d.gyro.y = 0.8f * cosf(0.5f * t);
+    d.gyro.z = 0.1f + 0.05f * sinf(2.0f * t);
+    d.gyro.timestamp = ts + SAMPLE_PERIOD_NS / 2;
+
+    if (i % MAG_DECIMATION == 0) {
+        d.mag.x = 20.f * cosf(0.3f * t);
+        d.mag.y = 25.f * sinf(0.3f * t);
+        d.mag.z = -40.f;
+        d.mag.timestamp = ts;
+    }
+}
+
+// Same calls, in the same order, as HubSensors::setEnable(), decodeAccel()
+// and decodeGyro() with all four fusion sensors enabled
+void runHalSequence(FusionEngine& engine, std::vector<FusionData>& out)
+{
+    FusionData d;
+
+    memset(&d, 0, sizeof(d));
+    out.resize(SAMPLE_COUNT);
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        if (i == DISABLE_AT) {
+            engine.reset(FusionEngine::FUSION_GEOMAG_RV, d);
+            engine.reset(FusionEngine::FUSION_GAME_RV, d);
+        }
+        if (i >= DISABLE_AT && i < ENABLE_AT) {
+            out[i] = d;
+            continue;
+        }
+        if (i == RV_RESET_AT)
+            engine.reset(FusionEngine::FUSION_ROTATION_VECT, d);
+
+        makeSample(i, d);
+        engine.updateGeoMagRV(d);
+        engine.updateGameRV(d);
+        engine.updateLinearAccelGravity(d);
+        engine.updateRotationVector(d);
+        out[i] = d;
+    }
+}
+
+void expectQuat(const float* expected, const QuatData& q, size_t index, const char* name)
+{
+    EXPECT_NEAR(expected[0], q.a, TOLERANCE) << name << " a at " << index;
+    EXPECT_NEAR(expected[1], q.b, TOLERANCE) << name << " b at " << index;
+    EXPECT_NEAR(expected[2], q.c, TOLERANCE) << name << " c at " << index;
+    EXPECT_NEAR(expected[3], q.d, TOLERANCE) << name << " d at " << index;
+}
+
+void expectCart(const float* expected, const CartData& v, size_t index, const char* name)
+{
+    // m/s^2, so scale the tolerance to gravity
+    EXPECT_NEAR(expected[0], v.x, TOLERANCE * 10) << name << " x at " << index;
+    EXPECT_NEAR(expected[1], v.y, TOLERANCE * 10) << name << " y at " << index;
+    EXPECT_NEAR(expected[2], v.z, TOLERANCE * 10) << name << " z at " << index;
+}
+
+void expectSameQuat(const QuatData& a, const QuatData& b, size_t index, const char* name)
+{
+    float e[4] = { a.a, a.b, a.c, a.d };
+    expectQuat(e, b, index, name);
+}
+
+} // namespace
+
+TEST(FusionEngineTest, HalSequenceMatchesLegacyFusion)
+{
+    FusionEngine engine;
+    std::vector<FusionData> out;
+
+    runHalSequence(engine, out);
+
+    for (const Expected& e : EXPECTED) {
+        const FusionData& d = out[e.index];
+
+        expectQuat(e.gameRotation, d.gameRotation, e.index, "gameRotation");
+        expectQuat(e.geoMagRotation, d.geoMagRotation, e.index, "geoMagRotation");
+        expectQuat(e.rotationVector, d.rotationVector, e.index, "rotationVector");
+        expectCart(e.gravity, d.gravity, e.index, "gravity");
+        expectCart(e.linearAccel, d.linearAccel, e.index, "linearAccel");
+    }
+}
+
+TEST(FusionEngineTest, BatchMatchesPerStage)
+{
+    FusionEngine perStage;
+    FusionEngine batch;
+    std::vector<FusionData> samples(SAMPLE_COUNT);
+    std::vector<FusionData> expected(SAMPLE_COUNT);
+    FusionData d;
+    size_t ready = 0;
+
+    memset(&d, 0, sizeof(d));
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        makeSample(i, d);
+        samples[i] = d;
+
+        bool ok = perStage.updateGeoMagRV(d);
+        ok = perStage.updateGameRV(d) && ok;
+        ok = perStage.updateLinearAccelGravity(d) && ok;
+        ok = perStage.updateRotationVector(d) && ok;
+        expected[i] = d;
+        if (ok)
+            ready++;
+    }
+
+    EXPECT_EQ(ready, batch.processFusion(samples.data(), samples.size(), ALL_OUTPUTS));
+
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        expectSameQuat(expected[i].gameRotation, samples[i].gameRotation, i, "gameRotation");
+        expectSameQuat(expected[i].geoMagRotation, samples[i].geoMagRotation, i,
+                "geoMagRotation");
+        expectSameQuat(expected[i].rotationVector, samples[i].rotationVector, i,
+                "rotationVector");
+    }
+}
+
+TEST(FusionEngineTest, ResetStartsOver)
+{
+    FusionEngine fresh;
+    FusionEngine used;
+    FusionData a;
+    FusionData b;
+
+    memset(&a, 0, sizeof(a));
+    for (size_t i = 0; i < 100; i++) {
+        makeSample(i, a);
+        used.updateGeoMagRV(a);
+        used.updateGameRV(a);
+        used.updateRotationVector(a);
+    }
+    used.reset(ALL_OUTPUTS);
+
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+    for (size_t i = 200; i < 300; i++) {
+        makeSample(i, a);
+        makeSample(i, b);
+        EXPECT_EQ(fresh.updateGeoMagRV(a), used.updateGeoMagRV(b));
+        fresh.updateGameRV(a);
+        used.updateGameRV(b);
+        fresh.updateRotationVector(a);
+        used.updateRotationVector(b);
+        expectSameQuat(a.gameRotation, b.gameRotation, i, "gameRotation");
+        expectSameQuat(a.rotationVector, b.rotationVector, i, "rotationVector");
+    }
+}
@@ -0,0 +1,85 @@
+# Copyright (C) 2017 Motorola Mobility LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Host tests for the code shared by the sensor HALs.
+
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := sensors_event_loop_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS += -DLOG_TAG=\"SensorsTest\"
+LOCAL_CFLAGS += -Wall -Wextra
+LOCAL_SRC_FILES := SensorsEventLoopTest.cpp
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+LOCAL_HEADER_LIBRARIES := libhardware_headers liblog_headers
+LOCAL_SHARED_LIBRARIES := liblog
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := sensors_direct_channel_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS += -DLOG_TAG=\"SensorsTest\"
+LOCAL_CFLAGS += -Wall -Wextra
+LOCAL_SRC_FILES := \
+    DirectChannelTest.cpp \
+    ../DirectChannel.cpp
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+LOCAL_HEADER_LIBRARIES := libhardware_headers liblog_headers
+LOCAL_SHARED_LIBRARIES := liblog libcutils
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := sensors_software_batcher_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS += -DLOG_TAG=\"SensorsTest\"
+LOCAL_CFLAGS += -Wall -Wextra
+LOCAL_SRC_FILES := \
+    SoftwareBatcherTest.cpp \
+    ../motosh_hal/SoftwareBatcher.cpp
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/.. \
+    $(LOCAL_PATH)/../motosh_hal
+LOCAL_HEADER_LIBRARIES := libhardware_headers liblog_headers
+LOCAL_SHARED_LIBRARIES := liblog
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := sensors_iio_sensor_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS += -DLOG_TAG=\"SensorsTest\"
+LOCAL_CFLAGS += -Wall -Wextra
+LOCAL_CFLAGS += -include $(LOCAL_PATH)/HostIioTypes.h
+LOCAL_SRC_FILES := \
+    IioSensorTest.cpp \
+    FakeIio.cpp \
+    ../iio_hal/IioSensor.cpp \
+    ../motosh_hal/SensorBase.cpp \
+    ../DirectChannel.cpp
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/.. \
+    $(LOCAL_PATH)/../motosh_hal \
+    $(LOCAL_PATH)/../iio_hal \
+    $(LOCAL_PATH)/../libiio/include
+LOCAL_HEADER_LIBRARIES := libhardware_headers liblog_headers libbase_headers libcutils_headers
+LOCAL_SHARED_LIBRARIES := liblog libcutils
+
+include $(BUILD_HOST_NATIVE_TEST)
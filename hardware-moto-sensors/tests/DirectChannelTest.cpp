@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2017 Motorola Mobility LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Reads the direct channel ring the way a framework client does, from its
+// own mapping of the shared memory, and checks what DirectReport wrote: the
+// reserved0 counters (order and overwritten events), the report tokens, and
+// the decimation to each report's rate.
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <vector>
+
+#include <cutils/native_handle.h>
+
+#include "DirectChannel.h"
+
+#define HANDLE_ACCEL    (1)
+#define HANDLE_GYRO     (2)
+
+namespace {
+
+/** Shared memory for one channel, and a client reading it. A temporary file
+ * stands in for the ashmem region on the host. */
+class RingClient {
+public:
+    explicit RingClient(size_t slots) :
+        file(tmpfile()), handle(native_handle_create(1, 0)), mem(), ring(nullptr),
+        slots(slots), next(0), lastCounter(0), lost(0) {
+        size_t size = slots * sizeof(sensors_event_t);
+
+        EXPECT_NE(nullptr, file);
+        handle->data[0] = fileno(file);
+        EXPECT_EQ(0, ftruncate(handle->data[0], size));
+
+        mem.type = SENSOR_DIRECT_MEM_TYPE_ASHMEM;
+        mem.format = SENSOR_DIRECT_FMT_SENSORS_EVENT;
+        mem.size = size;
+        mem.handle = handle;
+
+        void *base = mmap(nullptr, size, PROT_READ, MAP_SHARED, handle->data[0], 0);
+        EXPECT_NE(MAP_FAILED, base);
+        ring = static_cast<const volatile sensors_event_t *>(base);
+    }
+
+    ~RingClient() {
+        munmap(const_cast<sensors_event_t *>(ring), mem.size);
+        native_handle_delete(handle);
+        fclose(file);
+    }
+
+    const struct sensors_direct_mem_t *getMem() const { return &mem; }
+
+    /** Reads every event written since the last call. When the writer has
+     * lapped the client, it skips to the oldest event left and counts the
+     * overwritten ones as lost. */
+    void read(std::vector<sensors_event_t> &out) {
+        for (;;) {
+            const volatile sensors_event_t &slot = ring[next];
+            uint32_t counter = static_cast<uint32_t>(slot.reserved0);
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (counter == 0 || counter <= lastCounter) {
+                // Unwritten, or not rewritten since the last lap
+                return;
+            }
+            if (counter != lastCounter + 1) {
+                resync();
+                continue;
+            }
+
+            sensors_event_t ev;
+            memcpy(&ev, const_cast<const sensors_event_t *>(&slot), sizeof(ev));
+            out.push_back(ev);
+            lastCounter = counter;
+            next = (next + 1) % slots;
+        }
+    }
+
+    uint64_t getLost() const { return lost; }
+
+private:
+    FILE *file;
+    native_handle_t *handle;
+    struct sensors_direct_mem_t mem;
+    const volatile sensors_event_t *ring;
+    size_t slots;
+    size_t next;
+    uint32_t lastCounter;
+    uint64_t lost;
+
+    /** Jumps to the oldest event still in the ring, as a client that fell
+     * behind does. */
+    void resync() {
+        uint32_t oldest = 0;
+        size_t at = 0;
+
+        for (size_t i = 0; i < slots; ++i) {
+            uint32_t c = static_cast<uint32_t>(ring[i].reserved0);
+            if (c > lastCounter && (!oldest || c < oldest)) {
+                oldest = c;
+                at = i;
+            }
+        }
+        if (oldest) {
+            lost += oldest - lastCounter - 1;
+            lastCounter = oldest - 1;
+            next = at;
+        }
+    }
+};
+
+sensors_event_t makeEvent(int handle, int64_t timestamp, float x) {
+    sensors_event_t ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.version = sizeof(ev);
+    ev.sensor = handle;
+    ev.type = handle == HANDLE_ACCEL ? SENSOR_TYPE_ACCELEROMETER : SENSOR_TYPE_GYROSCOPE;
+    ev.timestamp = timestamp;
+    ev.data[0] = x;
+    return ev;
+}
+
+/** Pushes events of handle at periodNs through dispatch(), in poll() sized
+ * batches, like the HAL does.
+ * @return the number of events dispatch() left for poll(). */
+int runDriver(DirectReport &report, int handle, int64_t periodNs, int nb, int64_t start = 0) {
+    const int BATCH = 16;
+    int kept = 0;
+
+    for (int i = 0; i < nb; i += BATCH) {
+        sensors_event_t batch[BATCH];
+        int n = std::min(BATCH, nb - i);
+
+        for (int j = 0; j < n; ++j) {
+            batch[j] = makeEvent(handle, start + (i + j + 1) * periodNs, i + j);
+        }
+        kept += report.dispatch(batch, n);
+    }
+    return kept;
+}
+
+/** After the first one, events are one report period apart, give or take
+ * one driver period. */
+void expectSpacing(const std::vector<sensors_event_t> &events, int64_t periodNs) {
+    for (size_t i = 2; i < events.size(); ++i) {
+        int64_t spacing = events[i].timestamp - events[i - 1].timestamp;
+        EXPECT_GE(spacing, periodNs * 3 / 4) << "event " << i;
+        EXPECT_LE(spacing, periodNs * 5 / 4) << "event " << i;
+    }
+}
+
+} // namespace
+
+TEST(DirectChannelTest, CountersAreOrderedWithoutLoss) {
+    DirectReport report;
+    RingClient client(256);
+    std::vector<sensors_event_t> events;
+
+    int channel = report.registerChannel(client.getMem());
+    ASSERT_GT(channel, 0);
+    int token = report.configure(HANDLE_ACCEL, channel, SENSOR_DIRECT_RATE_FAST);
+    ASSERT_GT(token, 0);
+
+    for (int round = 0; round < 10; ++round) {
+        runDriver(report, HANDLE_ACCEL, 5000000LL, 100, round * 100 * 5000000LL);
+        client.read(events);
+    }
+
+    ASSERT_EQ(1000u, events.size());
+    EXPECT_EQ(0u, client.getLost());
+    for (size_t i = 0; i < events.size(); ++i) {
+        EXPECT_EQ(i + 1, static_cast<uint32_t>(events[i].reserved0));
+        EXPECT_EQ(token, events[i].sensor);
+        EXPECT_EQ(SENSOR_TYPE_ACCELEROMETER, events[i].type);
+        EXPECT_EQ(static_cast<float>(i % 100), events[i].data[0]);
+        if (i) {
+            EXPECT_GT(events[i].timestamp, events[i - 1].timestamp);
+        }
+    }
+}
+
+TEST(DirectChannelTest, OverwrittenEventsShowAsCounterGap) {
+    DirectReport report;
+    RingClient client(16);
+    std::vector<sensors_event_t> events;
+
+    int channel = report.registerChannel(client.getMem());
+    ASSERT_GT(channel, 0);
+    ASSERT_GT(report.configure(HANDLE_ACCEL, channel, SENSOR_DIRECT_RATE_FAST), 0);
+
+    runDriver(report, HANDLE_ACCEL, 5000000LL, 10);
+    client.read(events);
+    ASSERT_EQ(10u, events.size());
+
+    // 40 more without reading: 24 of them are overwritten
+    runDriver(report, HANDLE_ACCEL, 5000000LL, 40, 10 * 5000000LL);
+    client.read(events);
+
+    EXPECT_EQ(24u, client.getLost());
+    ASSERT_EQ(26u, events.size());
+    EXPECT_EQ(35u, static_cast<uint32_t>(events[10].reserved0));
+    EXPECT_EQ(50u, static_cast<uint32_t>(events.back().reserved0));
+}
+
+TEST(DirectChannelTest, DecimatesToEachReportRate) {
+    DirectReport report;
+    RingClient normal(256), fast(512);
+    std::vector<sensors_event_t> normalEvents, fastEvents;
+
+    int normalChannel = report.registerChannel(normal.getMem());
+    int fastChannel = report.registerChannel(fast.getMem());
+    ASSERT_GT(normalChannel, 0);
+    ASSERT_GT(fastChannel, 0);
+    ASSERT_GT(report.configure(HANDLE_GYRO, normalChannel, SENSOR_DIRECT_RATE_NORMAL), 0);
+    ASSERT_GT(report.configure(HANDLE_GYRO, fastChannel, SENSOR_DIRECT_RATE_FAST), 0);
+
+    // The driver runs at the fastest report: 800Hz for one second
+    int64_t periodNs;
+    int64_t latencyNs;
+    ASSERT_TRUE(report.getRate(HANDLE_GYRO, periodNs, latencyNs));
+    EXPECT_EQ(DirectReport::rateLevelToPeriodNs(SENSOR_DIRECT_RATE_FAST), periodNs);
+    EXPECT_EQ(0, latencyNs);
+
+    runDriver(report, HANDLE_GYRO, 1250000LL, 800);
+    normal.read(normalEvents);
+    fast.read(fastEvents);
+
+    // 50Hz and 200Hz on average, give or take the first event
+    EXPECT_NEAR(50, static_cast<int>(normalEvents.size()), 1);
+    EXPECT_NEAR(200, static_cast<int>(fastEvents.size()), 1);
+    expectSpacing(normalEvents, DirectReport::rateLevelToPeriodNs(SENSOR_DIRECT_RATE_NORMAL));
+    expectSpacing(fastEvents, DirectReport::rateLevelToPeriodNs(SENSOR_DIRECT_RATE_FAST));
+}
+
+TEST(DirectChannelTest, KeepsEveryEventAtTheReportRate) {
+    DirectReport report;
+    RingClient client(512);
+    std::vector<sensors_event_t> events;
+
+    int channel = report.registerChannel(client.getMem());
+    ASSERT_GT(channel, 0);
+    ASSERT_GT(report.configure(HANDLE_ACCEL, channel, SENSOR_DIRECT_RATE_FAST), 0);
+
+    // 200Hz with +/-10% timestamp jitter
+    for (int i = 1; i <= 400; ++i) {
+        int64_t jitter = (i % 3 - 1) * 500000LL;
+        sensors_event_t ev = makeEvent(HANDLE_ACCEL, i * 5000000LL + jitter, i);
+        report.dispatch(&ev, 1);
+    }
+    client.read(events);
+
+    EXPECT_EQ(400u, events.size());
+}
+
+TEST(DirectChannelTest, PollPathOnlyGetsActivatedSensors) {
+    DirectReport report;
+    RingClient client(256);
+
+    int channel = report.registerChannel(client.getMem());
+    ASSERT_GT(channel, 0);
+    ASSERT_GT(report.configure(HANDLE_ACCEL, channel, SENSOR_DIRECT_RATE_FAST), 0);
+
+    // Direct only: nothing is left for poll()
+    EXPECT_EQ(0, runDriver(report, HANDLE_ACCEL, 5000000LL, 32));
+
+    // Also activated through poll(): every event is kept
+    report.setPollEnabled(HANDLE_ACCEL, true);
+    EXPECT_EQ(32, runDriver(report, HANDLE_ACCEL, 5000000LL, 32, 32 * 5000000LL));
+
+    // Not directly reported at all: untouched
+    EXPECT_EQ(32, runDriver(report, HANDLE_GYRO, 5000000LL, 32));
+
+    // Stopping the channel hands the sensor back to the poll path only
+    std::vector<int> stopped = report.unregisterChannel(channel);
+    ASSERT_EQ(1u, stopped.size());
+    EXPECT_EQ(HANDLE_ACCEL, stopped[0]);
+}
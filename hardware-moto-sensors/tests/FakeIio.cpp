@@ -0,0 +1,582 @@
+/*
+ * Copyright (C) 2017 Motorola Mobility LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+
+#include <linux/iio/events.h>
+#include <linux/iio/types.h>
+
+#include "FakeIio.h"
+
+struct iio_channel {
+    struct iio_device *dev;
+    FakeIioDevice::Channel info;
+    bool enabled;
+};
+
+struct iio_device {
+    FakeIioDevice *fake;
+    std::vector<struct iio_channel> channels;
+};
+
+struct iio_buffer {
+    struct iio_device *dev;
+    bool blocking;
+    /// Where the last refill left the samples
+    uint8_t *start;
+    /// libiio's own buffer, on the read() path
+    std::vector<uint8_t> data;
+    /// The mmap()ed blocks, on the block path
+    std::vector<void *> maps;
+    size_t blockSize;
+    int lastDequeued;
+};
+
+namespace {
+
+/** Lays out the enabled scan elements like libiio: each one aligned to its
+ * own storage size, in channel order.
+ * @return the offset of chn in a sample, or the sample size if chn is null. */
+size_t layout(const struct iio_device *dev, const struct iio_channel *chn) {
+    size_t size = 0;
+
+    for (const struct iio_channel &c : dev->channels) {
+        if (!c.enabled || c.info.index < 0) {
+            continue;
+        }
+        size_t len = c.info.format.length / 8;
+        if (size % len) {
+            size += len - size % len;
+        }
+        if (&c == chn) {
+            return size;
+        }
+        size += len;
+    }
+    return size;
+}
+
+} // namespace
+
+FakeIioDevice::FakeIioDevice(const std::vector<Channel> &channels, bool blocks) :
+    kernelBuffers(4), dev(new iio_device()), attrs(), hasBlocks(blocks), enabled(false),
+    fifo(), watermark(1), bytesRead(0), pollFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+    eventFds{-1, -1}, memFd(-1), blocks(), enqueued() {
+
+    dev->fake = this;
+    for (const Channel &c : channels) {
+        dev->channels.push_back({ dev.get(), c, false });
+    }
+    if (pipe2(eventFds, O_NONBLOCK | O_CLOEXEC)) {
+        eventFds[0] = eventFds[1] = -1;
+    }
+}
+
+FakeIioDevice::~FakeIioDevice() {
+    freeBlocks();
+    close(pollFd);
+    close(eventFds[0]);
+    close(eventFds[1]);
+}
+
+struct iio_device *FakeIioDevice::getDevice() {
+    return dev.get();
+}
+
+void FakeIioDevice::setAttr(const std::string &attr, const std::string &value) {
+    attrs[attr] = value;
+}
+
+std::string FakeIioDevice::getAttr(const std::string &attr) const {
+    auto it = attrs.find(attr);
+    return it == attrs.end() ? "" : it->second;
+}
+
+bool FakeIioDevice::readAttr(const std::string &attr, std::string &value) const {
+    auto it = attrs.find(attr);
+    if (it == attrs.end()) {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+int FakeIioDevice::writeAttr(const std::string &attr, const std::string &value) {
+    attrs[attr] = value;
+
+    if (attr == "flush") {
+        // The Greybus flush complete: a falling BUFFER_EMPTY event on the
+        // proprietary channel 0
+        struct iio_event_data event;
+        memset(&event, 0, sizeof(event));
+        event.id = (static_cast<uint64_t>(IIO_EV_TYPE_BUFFER_EMPTY) << 56) |
+            (static_cast<uint64_t>(IIO_EV_DIR_FALLING) << 48) |
+            (static_cast<uint64_t>(IIO_PROPRIETARY) << 32);
+        if (write(eventFds[1], &event, sizeof(event)) != sizeof(event)) {
+            return -errno;
+        }
+    }
+    return 0;
+}
+
+void FakeIioDevice::push(const void *samples, size_t nb) {
+    const uint8_t *src = static_cast<const uint8_t *>(samples);
+
+    if (!enabled) {
+        return;
+    }
+    fifo.insert(fifo.end(), src, src + nb * getSampleSize());
+    updatePoll();
+}
+
+size_t FakeIioDevice::getSampleSize() const {
+    return layout(dev.get(), nullptr);
+}
+
+size_t FakeIioDevice::getQueued() const {
+    size_t sampleSize = getSampleSize();
+    return sampleSize ? fifo.size() / sampleSize : 0;
+}
+
+bool FakeIioDevice::isReadable() const {
+    struct pollfd pfd = { pollFd, POLLIN, 0 };
+    return ::poll(&pfd, 1, 0) == 1;
+}
+
+void FakeIioDevice::setEnabled(bool enabled) {
+    this->enabled = enabled;
+    fifo.clear();
+    updatePoll();
+}
+
+size_t FakeIioDevice::take(uint8_t *dst, size_t len) {
+    size_t sampleSize = getSampleSize();
+    size_t n = sampleSize ? std::min(len, fifo.size()) / sampleSize * sampleSize : 0;
+
+    std::copy(fifo.begin(), fifo.begin() + n, dst);
+    fifo.erase(fifo.begin(), fifo.begin() + n);
+    updatePoll();
+    return n;
+}
+
+size_t FakeIioDevice::read(uint8_t *dst, size_t len) {
+    size_t n = take(dst, len);
+    bytesRead += n;
+    return n;
+}
+
+void FakeIioDevice::updatePoll() {
+    uint64_t val;
+
+    // The eventfd is readable while its count is non-zero: clear it, then
+    // set it again if the watermark is reached.
+    while (::read(pollFd, &val, sizeof(val)) > 0) {}
+    if (enabled && static_cast<long long>(getQueued()) >= std::max(1LL, watermark)) {
+        val = 1;
+        (void)::write(pollFd, &val, sizeof(val));
+    }
+}
+
+int FakeIioDevice::writeBufferAttr(const char *attr, long long val) {
+    if (strcmp(attr, "watermark")) {
+        return -ENOENT;
+    }
+    if (val < 1) {
+        return -EINVAL;
+    }
+    watermark = val;
+    updatePoll();
+    return 0;
+}
+
+void FakeIioDevice::freeBlocks() {
+    blocks.clear();
+    enqueued.clear();
+    if (memFd >= 0) {
+        close(memFd);
+        memFd = -1;
+    }
+}
+
+int FakeIioDevice::ioctl(unsigned long request, void *arg) {
+    struct iio_block *block = static_cast<struct iio_block *>(arg);
+
+    if (request == IIO_GET_EVENT_FD_IOCTL) {
+        int fd = fcntl(eventFds[0], F_DUPFD_CLOEXEC, 0);
+        if (fd < 0) {
+            return -errno;
+        }
+        *static_cast<int *>(arg) = fd;
+        return 0;
+    }
+
+    if (!hasBlocks) {
+        // A driver without the block interface
+        return -ENOTTY;
+    }
+
+    switch (request) {
+    case IIO_BLOCK_ALLOC_IOCTL: {
+        struct iio_block_alloc_req *req = static_cast<struct iio_block_alloc_req *>(arg);
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t stride = (req->size + page - 1) / page * page;
+
+        if (!req->size || !req->count || memFd >= 0) {
+            return -EINVAL;
+        }
+        memFd = memfd_create("fake-iio-blocks", MFD_CLOEXEC);
+        if (memFd < 0 || ftruncate(memFd, stride * req->count)) {
+            return -errno;
+        }
+        for (uint32_t id = 0; id < req->count; ++id) {
+            struct iio_block b;
+            memset(&b, 0, sizeof(b));
+            b.id = id;
+            b.size = req->size;
+            b.offset = id * stride;
+            blocks.push_back(b);
+        }
+        return 0;
+    }
+    case IIO_BLOCK_FREE_IOCTL:
+        freeBlocks();
+        return 0;
+    case IIO_BLOCK_QUERY_IOCTL:
+        if (block->id >= blocks.size()) {
+            return -EINVAL;
+        }
+        *block = blocks[block->id];
+        return 0;
+    case IIO_BLOCK_ENQUEUE_IOCTL:
+        if (block->id >= blocks.size()) {
+            return -EINVAL;
+        }
+        blocks[block->id].bytes_used = 0;
+        enqueued.push_back(block->id);
+        return 0;
+    case IIO_BLOCK_DEQUEUE_IOCTL: {
+        if (enqueued.empty() || fifo.empty()) {
+            return -EAGAIN;
+        }
+        struct iio_block &b = blocks[enqueued.front()];
+        std::vector<uint8_t> dma(b.size);
+        size_t n = take(dma.data(), dma.size());
+
+        // The "DMA" writes into the block, not into anything userspace reads
+        if (pwrite(memFd, dma.data(), n, b.offset) != static_cast<ssize_t>(n)) {
+            return -errno;
+        }
+        enqueued.pop_front();
+        b.bytes_used = n;
+        *block = b;
+        return 0;
+    }
+    default:
+        return -ENOTTY;
+    }
+}
+
+// The libiio calls made by IioSensor, as libiio's local backend makes them.
+
+struct iio_context *iio_create_local_context(void) {
+    errno = ENOSYS;
+    return nullptr;
+}
+
+void iio_context_destroy(struct iio_context *) {
+}
+
+int iio_context_set_timeout(struct iio_context *, unsigned int) {
+    return 0;
+}
+
+const char *iio_device_get_id(const struct iio_device *) {
+    return "iio:device0";
+}
+
+const char *iio_device_get_name(const struct iio_device *) {
+    return "fake";
+}
+
+bool iio_device_is_trigger(const struct iio_device *) {
+    return false;
+}
+
+unsigned int iio_device_get_channels_count(const struct iio_device *dev) {
+    return dev->channels.size();
+}
+
+struct iio_channel *iio_device_get_channel(const struct iio_device *dev, unsigned int index) {
+    if (index >= dev->channels.size()) {
+        return nullptr;
+    }
+    return const_cast<struct iio_channel *>(&dev->channels[index]);
+}
+
+const char *iio_device_find_attr(const struct iio_device *dev, const char *name) {
+    std::string value;
+    return dev->fake->readAttr(name, value) ? name : nullptr;
+}
+
+ssize_t iio_device_attr_read(const struct iio_device *dev, const char *attr,
+        char *dst, size_t len) {
+    std::string value;
+
+    if (!dev->fake->readAttr(attr, value)) {
+        return -ENOENT;
+    }
+    if (!len) {
+        return -EINVAL;
+    }
+    size_t n = std::min(value.size(), len - 1);
+    memcpy(dst, value.data(), n);
+    dst[n] = '\0';
+    return n + 1;
+}
+
+int iio_device_attr_read_longlong(const struct iio_device *dev, const char *attr,
+        long long *val) {
+    std::string value;
+
+    if (!dev->fake->readAttr(attr, value)) {
+        return -ENOENT;
+    }
+    *val = strtoll(value.c_str(), nullptr, 0);
+    return 0;
+}
+
+int iio_device_attr_read_double(const struct iio_device *dev, const char *attr,
+        double *val) {
+    std::string value;
+
+    if (!dev->fake->readAttr(attr, value)) {
+        return -ENOENT;
+    }
+    *val = strtod(value.c_str(), nullptr);
+    return 0;
+}
+
+int iio_device_attr_write_longlong(const struct iio_device *dev, const char *attr,
+        long long val) {
+    return dev->fake->writeAttr(attr, std::to_string(val));
+}
+
+int iio_device_attr_write_double(const struct iio_device *dev, const char *attr,
+        double val) {
+    return dev->fake->writeAttr(attr, std::to_string(val));
+}
+
+int iio_device_set_kernel_buffers_count(const struct iio_device *dev,
+        unsigned int nb_buffers) {
+    if (!nb_buffers) {
+        return -EINVAL;
+    }
+    dev->fake->kernelBuffers = nb_buffers;
+    return 0;
+}
+
+ssize_t iio_device_get_sample_size(const struct iio_device *dev) {
+    size_t size = layout(dev, nullptr);
+    return size ? static_cast<ssize_t>(size) : -EINVAL;
+}
+
+const char *iio_channel_get_id(const struct iio_channel *chn) {
+    return chn->info.id;
+}
+
+const char *iio_channel_get_name(const struct iio_channel *) {
+    return nullptr;
+}
+
+long iio_channel_get_index(const struct iio_channel *chn) {
+    return chn->info.index;
+}
+
+bool iio_channel_is_output(const struct iio_channel *) {
+    return false;
+}
+
+bool iio_channel_is_scan_element(const struct iio_channel *chn) {
+    return chn->info.index >= 0;
+}
+
+bool iio_channel_is_enabled(const struct iio_channel *chn) {
+    return chn->enabled;
+}
+
+void iio_channel_enable(struct iio_channel *chn) {
+    chn->enabled = true;
+}
+
+void iio_channel_disable(struct iio_channel *chn) {
+    chn->enabled = false;
+}
+
+const struct iio_data_format *iio_channel_get_data_format(const struct iio_channel *chn) {
+    return &chn->info.format;
+}
+
+void iio_channel_convert(const struct iio_channel *chn, void *dst, const void *src) {
+    const struct iio_data_format &fmt = chn->info.format;
+    unsigned len = fmt.length / 8;
+    uint8_t *d = static_cast<uint8_t *>(dst);
+    const uint8_t *s = static_cast<const uint8_t *>(src);
+    uint64_t word = 0;
+
+    // libiio converts len bytes in place: byte swap, shift, then sign extend
+    // or mask to the valid bits. The bytes of dst past len are left alone.
+    for (unsigned i = 0; i < len; ++i) {
+        unsigned byte = fmt.is_be ? len - 1 - i : i;
+        word |= static_cast<uint64_t>(s[byte]) << (8 * i);
+    }
+    word = fmt.shift < 64 ? word >> fmt.shift : 0;
+    if (!fmt.is_fully_defined && fmt.bits < 64) {
+        uint64_t mask = (1ULL << fmt.bits) - 1;
+        word &= mask;
+        if (fmt.is_signed && (word >> (fmt.bits - 1)) & 1) {
+            word |= ~mask;
+        }
+    }
+#if __BYTE_ORDER == __BIG_ENDIAN
+    for (unsigned i = 0; i < len; ++i) {
+        d[len - 1 - i] = word >> (8 * i);
+    }
+#else
+    for (unsigned i = 0; i < len; ++i) {
+        d[i] = word >> (8 * i);
+    }
+#endif
+}
+
+struct iio_buffer *iio_device_create_buffer(const struct iio_device *dev,
+        size_t samples_count, bool) {
+    FakeIioDevice *fake = dev->fake;
+    size_t sampleSize = layout(dev, nullptr);
+    std::unique_ptr<struct iio_buffer> buf(new iio_buffer());
+
+    if (!sampleSize || !samples_count) {
+        errno = EINVAL;
+        return nullptr;
+    }
+    buf->dev = const_cast<struct iio_device *>(dev);
+    buf->blocking = true;
+    buf->blockSize = samples_count * sampleSize;
+    buf->lastDequeued = -1;
+
+    // Ask for blocks first, and fall back to read() if the driver has no
+    // block interface
+    struct iio_block_alloc_req req;
+    memset(&req, 0, sizeof(req));
+    req.size = buf->blockSize;
+    req.count = fake->kernelBuffers;
+    if (fake->ioctl(IIO_BLOCK_ALLOC_IOCTL, &req) == 0) {
+        for (uint32_t id = 0; id < req.count; ++id) {
+            struct iio_block block;
+            memset(&block, 0, sizeof(block));
+            block.id = id;
+            void *map = MAP_FAILED;
+            if (fake->ioctl(IIO_BLOCK_QUERY_IOCTL, &block) == 0) {
+                map = mmap(nullptr, block.size, PROT_READ, MAP_SHARED,
+                        fake->getMemFd(), block.offset);
+            }
+            if (map == MAP_FAILED || fake->ioctl(IIO_BLOCK_ENQUEUE_IOCTL, &block)) {
+                if (map != MAP_FAILED) {
+                    munmap(map, block.size);
+                }
+                iio_buffer_destroy(buf.release());
+                errno = EIO;
+                return nullptr;
+            }
+            buf->maps.push_back(map);
+        }
+        buf->start = static_cast<uint8_t *>(buf->maps.front());
+    } else {
+        buf->data.resize(buf->blockSize);
+        buf->start = buf->data.data();
+    }
+
+    fake->setEnabled(true);
+    return buf.release();
+}
+
+void iio_buffer_destroy(struct iio_buffer *buf) {
+    FakeIioDevice *fake = buf->dev->fake;
+
+    for (void *map : buf->maps) {
+        munmap(map, buf->blockSize);
+    }
+    if (!buf->maps.empty()) {
+        fake->ioctl(IIO_BLOCK_FREE_IOCTL, nullptr);
+    }
+    fake->setEnabled(false);
+    delete buf;
+}
+
+int iio_buffer_get_poll_fd(struct iio_buffer *buf) {
+    return buf->dev->fake->getPollFd();
+}
+
+int iio_buffer_set_blocking_mode(struct iio_buffer *buf, bool blocking) {
+    buf->blocking = blocking;
+    return 0;
+}
+
+ssize_t iio_buffer_refill(struct iio_buffer *buf) {
+    FakeIioDevice *fake = buf->dev->fake;
+
+    // The fake never waits: a blocking refill on an empty buffer times out
+    int empty = buf->blocking ? -ETIMEDOUT : -EAGAIN;
+
+    if (buf->maps.empty()) {
+        size_t n = fake->read(buf->data.data(), buf->data.size());
+        return n ? static_cast<ssize_t>(n) : empty;
+    }
+
+    // Hand the block read last time back to the kernel, and take the next
+    struct iio_block block;
+    memset(&block, 0, sizeof(block));
+    if (buf->lastDequeued >= 0) {
+        block.id = buf->lastDequeued;
+        buf->lastDequeued = -1;
+        int ret = fake->ioctl(IIO_BLOCK_ENQUEUE_IOCTL, &block);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    int ret = fake->ioctl(IIO_BLOCK_DEQUEUE_IOCTL, &block);
+    if (ret < 0) {
+        return ret == -EAGAIN ? empty : ret;
+    }
+    buf->lastDequeued = block.id;
+    buf->start = static_cast<uint8_t *>(buf->maps[block.id]);
+    return block.bytes_used;
+}
+
+void *iio_buffer_start(const struct iio_buffer *buf) {
+    return buf->start;
+}
+
+void *iio_buffer_first(const struct iio_buffer *buf, const struct iio_channel *chn) {
+    return buf->start + layout(buf->dev, chn);
+}
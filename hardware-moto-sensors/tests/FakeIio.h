@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2017 Motorola Mobility LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FAKE_IIO
+#define FAKE_IIO
+
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "IioBlock.h"
+#include "iio.h"
+
+/**
+ * An IIO device for host tests. FakeIio.cpp implements the libiio calls
+ * IioSensor makes the way libiio's local backend does, on top of this class,
+ * which plays the kernel driver and its buffer:
+ *
+ * - push() queues samples in the kernel buffer. The poll fd is readable once
+ *   watermark samples are queued.
+ * - With blocks, the buffer is a memfd. libiio allocates blocks in it with
+ *   the block interface ioctls, mmap()s them and enqueues them, and a refill
+ *   dequeues the next block: the samples are copied into the block by the
+ *   "DMA", and decoded in place from the mapping. Without blocks, the block
+ *   ioctls fail and a refill read()s the samples into libiio's own buffer.
+ * - Writing the flush attribute queues a flush complete on the event fd,
+ *   behind the samples already in the buffer.
+ *
+ * The HAL reaches the buffer attributes and ioctls through
+ * IioSensor::writeBufferAttr() and bufferIoctl(), which a test subclass
+ * forwards to the device's.
+ */
+class FakeIioDevice {
+public:
+    struct Channel {
+        const char *id;
+        long index;
+        struct iio_data_format format;
+    };
+
+    FakeIioDevice(const std::vector<Channel> &channels, bool blocks);
+    ~FakeIioDevice();
+
+    struct iio_device *getDevice();
+
+    /** Sets a device attribute, as read by iio_device_attr_read*(). */
+    void setAttr(const std::string &attr, const std::string &value);
+    /** @return the last value written to a device attribute, or "". */
+    std::string getAttr(const std::string &attr) const;
+
+    /** Queues nb samples of getSampleSize() bytes each, as the driver does. */
+    void push(const void *samples, size_t nb = 1);
+
+    /** @return the size of a sample with every scan element enabled. */
+    size_t getSampleSize() const;
+    /** @return the number of samples queued in the kernel buffer. */
+    size_t getQueued() const;
+    /** @return true if poll() on the buffer fd would return POLLIN. */
+    bool isReadable() const;
+    long long getWatermark() const { return watermark; }
+    /** @return the number of bytes read() out of the buffer. Stays 0 when
+     * libiio uses the blocks. */
+    size_t getBytesRead() const { return bytesRead; }
+    /** @return the number of blocks libiio mmap()ed. */
+    size_t getBlockCount() const { return blocks.size(); }
+
+    /** @{ The kernel side of IioSensor::writeBufferAttr() and bufferIoctl().
+     * Both return 0 or a negative errno code. */
+    int writeBufferAttr(const char *attr, long long val);
+    int ioctl(unsigned long request, void *arg);
+    /** @} */
+
+    /** @{ Used by the libiio calls in FakeIio.cpp. */
+    int writeAttr(const std::string &attr, const std::string &value);
+    bool readAttr(const std::string &attr, std::string &value) const;
+    int getPollFd() const { return pollFd; }
+    int getMemFd() const { return memFd; }
+    /** Starts or stops the kernel buffer. Starting it drops stale samples. */
+    void setEnabled(bool enabled);
+    /** read()s up to len bytes of whole samples out of the kernel buffer. */
+    size_t read(uint8_t *dst, size_t len);
+    /// Blocks to allocate, from iio_device_set_kernel_buffers_count()
+    unsigned kernelBuffers;
+    /** @} */
+
+private:
+    std::unique_ptr<struct iio_device> dev;
+    std::map<std::string, std::string> attrs;
+    bool hasBlocks;
+    bool enabled;
+    /// Samples queued in the kernel buffer
+    std::deque<uint8_t> fifo;
+    long long watermark;
+    size_t bytesRead;
+    /// Readable while the kernel buffer holds watermark samples
+    int pollFd;
+    int eventFds[2];
+    int memFd;
+    std::vector<struct iio_block> blocks;
+    /// Blocks owned by the kernel, in the order they are filled
+    std::deque<uint32_t> enqueued;
+
+    /** Moves up to len bytes of whole samples out of the kernel buffer. */
+    size_t take(uint8_t *dst, size_t len);
+    void updatePoll();
+    void freeBlocks();
+};
+
+#endif // FAKE_IIO
@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2017 Motorola Mobility LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The Motorola extensions to the IIO uapi enums, which the host's
+// <linux/iio/types.h> doesn't have. Included ahead of every source of the
+// host IIO tests.
+
+#ifndef HOST_IIO_TYPES
+#define HOST_IIO_TYPES
+
+#include <linux/iio/types.h>
+
+#define IIO_EV_TYPE_BUFFER_EMPTY ((enum iio_event_type)0x7f)
+#define IIO_PROPRIETARY ((enum iio_chan_type)0x7f)
+
+#endif // HOST_IIO_TYPES
@@ -0,0 +1,509 @@
+/*
+ * Copyright (C) 2017 Motorola Mobility LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs IioSensor on a fake IIO device, with and without the block (mmap)
+// interface, and checks what poll() would get: the samples in order, the
+// watermark the kernel is given, and flush completes behind the samples
+// queued before them. Then checks the decode plan against hand computed
+// values for the storage formats drivers use.
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <vector>
+
+#include "FakeIio.h"
+#include "IioSensor.h"
+
+#define HANDLE          (7)
+
+#define PERIOD_NS       (10000000LL)
+
+namespace {
+
+/** An accelerometer sample: le:s32/32>>0 x, y and z, and a le:s64/64>>0
+ * timestamp aligned to 8 bytes. */
+struct Sample {
+    int32_t x, y, z;
+    int32_t pad;
+    int64_t timestamp;
+};
+
+std::vector<FakeIioDevice::Channel> accelChannels() {
+    const struct iio_data_format s32 = { 32, 32, 0, true, true, false, false, 0 };
+    const struct iio_data_format s64 = { 64, 64, 0, true, true, false, false, 0 };
+
+    return {
+        { "accel_x", 0, s32 },
+        { "accel_y", 1, s32 },
+        { "accel_z", 2, s32 },
+        { "timestamp", 3, s64 },
+    };
+}
+
+/** Reaches the fake device where the HAL goes around libiio, and exposes the
+ * decode plan. */
+class TestIioSensor : public IioSensor {
+public:
+    explicit TestIioSensor(FakeIioDevice &fake) :
+        IioSensor(nullptr, fake.getDevice(), HANDLE), fake(fake) {}
+
+    using IioSensor::ChannelDecode;
+    using IioSensor::decodeRaw;
+
+    /** @return the plan of the data channel with the given index. */
+    const ChannelDecode *getPlan(int index) const {
+        for (const ChannelDecode &cd : data_decode) {
+            if (cd.index == index) {
+                return &cd;
+            }
+        }
+        return nullptr;
+    }
+
+    const ChannelDecode *getTimestampPlan() const {
+        return has_timestamp ? &timestamp_decode : nullptr;
+    }
+
+    bool isUniform() const {
+        return decode_sample != &TestIioSensor::decodeSample;
+    }
+
+protected:
+    int writeBufferAttr(const char *attr, long long val) override {
+        return fake.writeBufferAttr(attr, val);
+    }
+
+    int bufferIoctl(unsigned long request, void *arg) override {
+        return fake.ioctl(request, arg);
+    }
+
+private:
+    FakeIioDevice &fake;
+};
+
+/** Runs each test on a device with blocks, then on one without. */
+class IioSensorTest : public ::testing::TestWithParam<bool> {
+protected:
+    IioSensorTest() : fake(accelChannels(), GetParam()), sensor(nullptr), next(0) {
+        fake.setAttr("in_scale", "1");
+        fake.setAttr("in_offset", "0");
+        fake.setAttr("greybus_type", "1");
+        fake.setAttr("greybus_name_len", "4");
+        fake.setAttr("greybus_name", "Fake");
+    }
+
+    void SetUp() override {
+        sensor.reset(new TestIioSensor(fake));
+        sensor->setBufferTuning(4, 3);
+    }
+
+    void TearDown() override {
+        sensor.reset();
+    }
+
+    /** Has the driver queue nb samples, numbered from the last one. */
+    void push(int nb) {
+        ASSERT_EQ(sizeof(Sample), fake.getSampleSize());
+        for (int i = 0; i < nb; ++i) {
+            Sample s;
+            memset(&s, 0, sizeof(s));
+            ++next;
+            s.x = next;
+            s.y = -next;
+            s.z = 1000 + next;
+            s.timestamp = next * PERIOD_NS;
+            fake.push(&s);
+        }
+    }
+
+    /** Checks that events are samples first to first + nb - 1. */
+    void expectSamples(const sensors_event_t *events, int nb, int first) {
+        for (int i = 0; i < nb; ++i) {
+            int n = first + i;
+            EXPECT_EQ(HANDLE, events[i].sensor) << "sample " << n;
+            EXPECT_EQ(SENSOR_TYPE_ACCELEROMETER, events[i].type) << "sample " << n;
+            EXPECT_EQ(n * PERIOD_NS, events[i].timestamp) << "sample " << n;
+            EXPECT_EQ(static_cast<float>(n), events[i].data[0]) << "sample " << n;
+            EXPECT_EQ(static_cast<float>(-n), events[i].data[1]) << "sample " << n;
+            EXPECT_EQ(static_cast<float>(1000 + n), events[i].data[2]) << "sample " << n;
+        }
+    }
+
+    void expectFlushComplete(const sensors_event_t &event) {
+        EXPECT_EQ(SENSOR_TYPE_META_DATA, event.type);
+        EXPECT_EQ(META_DATA_FLUSH_COMPLETE, event.meta_data.what);
+        EXPECT_EQ(HANDLE, event.meta_data.sensor);
+    }
+
+    FakeIioDevice fake;
+    std::unique_ptr<TestIioSensor> sensor;
+    int next;
+};
+
+} // namespace
+
+TEST_P(IioSensorTest, EnableReportsZeroCopy) {
+    ASSERT_EQ(0, sensor->setEnable(HANDLE, 1));
+    EXPECT_EQ(GetParam(), sensor->isZeroCopy());
+    EXPECT_EQ(GetParam() ? 3u : 0u, fake.getBlockCount());
+    EXPECT_GE(sensor->getEventFd(), 0);
+
+    push(2);
+    sensors_event_t events[8];
+    ASSERT_EQ(2, sensor->readEvents(events, 8, sensor->getFd()));
+    expectSamples(events, 2, 1);
+
+    // Decoded in place from the mapped block, or read() into libiio's buffer
+    EXPECT_EQ(GetParam() ? 0u : 2 * sizeof(Sample), fake.getBytesRead());
+
+    ASSERT_EQ(0, sensor->setEnable(HANDLE, 0));
+    EXPECT_FALSE(sensor->isZeroCopy());
+    EXPECT_EQ(0u, fake.getBlockCount());
+    EXPECT_EQ(-1, sensor->getEventFd());
+}
+
+TEST_P(IioSensorTest, RefillCyclesThroughBlocks) {
+    ASSERT_EQ(0, sensor->setEnable(HANDLE, 1));
+
+    // 10 samples go through blocks of 4, and only 3 blocks: each one has to
+    // be handed back to the kernel after it's read.
+    push(10);
+    std::vector<sensors_event_t> events;
+    for (int reads = 0; reads < 20; ++reads) {
+        sensors_event_t batch[3];
+        int n = sensor->readEvents(batch, 3, sensor->getFd());
+        if (n == 0 && !sensor->hasPendingEvents()) {
+            break;
+        }
+        events.insert(events.end(), batch, batch + n);
+    }
+    ASSERT_EQ(10u, events.size());
+    expectSamples(events.data(), 10, 1);
+    EXPECT_EQ(0u, fake.getQueued());
+
+    // And once more after the blocks have all been used
+    push(9);
+    events.clear();
+    for (int reads = 0; reads < 20; ++reads) {
+        sensors_event_t batch[16];
+        int n = sensor->readEvents(batch, 16, sensor->getFd());
+        if (n == 0) {
+            break;
+        }
+        events.insert(events.end(), batch, batch + n);
+    }
+    ASSERT_EQ(9u, events.size());
+    expectSamples(events.data(), 9, 11);
+}
+
+TEST_P(IioSensorTest, WatermarkFollowsBatch) {
+    // Set before the buffer exists, written when it's created
+    ASSERT_EQ(0, sensor->batch(HANDLE, 0, PERIOD_NS, 3 * PERIOD_NS));
+    ASSERT_EQ(0, sensor->setEnable(HANDLE, 1));
+    EXPECT_EQ(3, fake.getWatermark());
+
+    push(2);
+    EXPECT_FALSE(fake.isReadable());
+    push(1);
+    EXPECT_TRUE(fake.isReadable());
+
+    // Clamped to one block
+    ASSERT_EQ(0, sensor->batch(HANDLE, 0, PERIOD_NS, 1000000000LL));
+    EXPECT_EQ(4, fake.getWatermark());
+    EXPECT_FALSE(fake.isReadable());
+
+    // No latency: every sample wakes up poll()
+    ASSERT_EQ(0, sensor->batch(HANDLE, 0, PERIOD_NS, 0));
+    EXPECT_EQ(1, fake.getWatermark());
+    EXPECT_TRUE(fake.isReadable());
+}
+
+TEST_P(IioSensorTest, FlushCompleteFollowsQueuedSamples) {
+    ASSERT_EQ(0, sensor->setEnable(HANDLE, 1));
+    ASSERT_EQ(0, sensor->batch(HANDLE, 0, PERIOD_NS, 4 * PERIOD_NS));
+
+    // Below the watermark: the kernel holds these back
+    push(3);
+    EXPECT_FALSE(fake.isReadable());
+
+    ASSERT_EQ(0, sensor->flush(HANDLE));
+    EXPECT_EQ(1, fake.getWatermark());
+    EXPECT_TRUE(fake.isReadable());
+
+    // Even when poll() sees the event fd first, the samples come first
+    sensors_event_t events[8];
+    ASSERT_EQ(4, sensor->readEvents(events, 8, sensor->getEventFd()));
+    expectSamples(events, 3, 1);
+    expectFlushComplete(events[3]);
+    EXPECT_FALSE(sensor->hasPendingEvents());
+
+    // The batched watermark is back once the flush is reported
+    EXPECT_EQ(4, fake.getWatermark());
+}
+
+TEST_P(IioSensorTest, FlushCompleteWaitsForRoom) {
+    ASSERT_EQ(0, sensor->setEnable(HANDLE, 1));
+    ASSERT_EQ(0, sensor->batch(HANDLE, 0, PERIOD_NS, 4 * PERIOD_NS));
+    push(3);
+    ASSERT_EQ(0, sensor->flush(HANDLE));
+    ASSERT_EQ(0, sensor->flush(HANDLE));
+
+    // Only room for two samples: the first flush complete waits for the third
+    sensors_event_t events[8];
+    ASSERT_EQ(2, sensor->readEvents(events, 2, sensor->getEventFd()));
+    expectSamples(events, 2, 1);
+    EXPECT_TRUE(sensor->hasPendingEvents());
+    EXPECT_EQ(1, fake.getWatermark());
+
+    // poll() comes back for it through hasPendingEvents(), on the data fd
+    ASSERT_EQ(2, sensor->readEvents(events, 2, sensor->getFd()));
+    expectSamples(events, 1, 3);
+    expectFlushComplete(events[1]);
+    EXPECT_FALSE(sensor->hasPendingEvents());
+    EXPECT_EQ(1, fake.getWatermark());
+
+    // The second flush complete is still on the event fd
+    ASSERT_EQ(1, sensor->readEvents(events, 2, sensor->getEventFd()));
+    expectFlushComplete(events[0]);
+    EXPECT_FALSE(sensor->hasPendingEvents());
+    EXPECT_EQ(4, fake.getWatermark());
+}
+
+TEST_P(IioSensorTest, TuningIsClamped) {
+    sensor->setBufferTuning(100000, 100000);
+    EXPECT_EQ(256u, sensor->getBufferTuning().block_len);
+    EXPECT_EQ(32u, sensor->getBufferTuning().block_count);
+
+    sensor->setBufferTuning(0, 0);
+    EXPECT_EQ(1u, sensor->getBufferTuning().block_len);
+    EXPECT_EQ(1u, sensor->getBufferTuning().block_count);
+}
+
+INSTANTIATE_TEST_CASE_P(BlocksAndRead, IioSensorTest, ::testing::Bool());
+
+namespace {
+
+struct iio_data_format format(const char *spec) {
+    // "le:s12/16>>4", as in the scan_elements type files
+    struct iio_data_format fmt;
+    char endian[3], sign;
+
+    memset(&fmt, 0, sizeof(fmt));
+    EXPECT_EQ(5, sscanf(spec, "%2s:%c%u/%u>>%u", endian, &sign, &fmt.bits,
+            &fmt.length, &fmt.shift)) << spec;
+    fmt.is_be = !strcmp(endian, "be");
+    fmt.is_signed = sign == 's' || sign == 'S';
+    fmt.is_fully_defined = sign == 'S' || sign == 'U' || fmt.bits == fmt.length;
+    return fmt;
+}
+
+/** A sensor on a fake device with the given channels, enabled. The sample
+ * is built by writing each channel's bytes at its planned offset. */
+class IioDecodeTest : public ::testing::Test {
+protected:
+    IioDecodeTest() : fake(nullptr), sensor(nullptr), sample() {}
+
+    void enable(const std::vector<FakeIioDevice::Channel> &channels) {
+        fake.reset(new FakeIioDevice(channels, true));
+        fake->setAttr("in_scale", "0.5");
+        fake->setAttr("in_offset", "1");
+        fake->setAttr("greybus_type", "1");
+        sensor.reset(new TestIioSensor(*fake));
+        ASSERT_EQ(0, sensor->setEnable(HANDLE, 1));
+        sample.assign(fake->getSampleSize(), 0);
+    }
+
+    void TearDown() override {
+        sensor.reset();
+        fake.reset();
+    }
+
+    /** Writes the storage bytes of channel index, in memory order. */
+    void set(int index, std::vector<uint8_t> bytes) {
+        const TestIioSensor::ChannelDecode *cd = sensor->getPlan(index);
+        const TestIioSensor::ChannelDecode *ts = sensor->getTimestampPlan();
+        if (!cd && ts && ts->index == index) {
+            cd = ts;
+        }
+        ASSERT_NE(nullptr, cd) << "channel " << index;
+        ASSERT_LE(cd->offset + bytes.size(), sample.size());
+        std::copy(bytes.begin(), bytes.end(), sample.begin() + cd->offset);
+    }
+
+    int64_t decode(int index) {
+        const TestIioSensor::ChannelDecode *cd = sensor->getPlan(index);
+        EXPECT_NE(nullptr, cd) << "channel " << index;
+        return cd ? TestIioSensor::decodeRaw(*cd, sample.data()) : 0;
+    }
+
+    /** Runs the sample through poll(), scale and offset included. */
+    sensors_event_t read() {
+        sensors_event_t event;
+        memset(&event, 0, sizeof(event));
+        fake->push(sample.data());
+        EXPECT_EQ(1, sensor->readEvents(&event, 1, sensor->getFd()));
+        return event;
+    }
+
+    std::unique_ptr<FakeIioDevice> fake;
+    std::unique_ptr<TestIioSensor> sensor;
+    std::vector<uint8_t> sample;
+};
+
+} // namespace
+
+TEST_F(IioDecodeTest, MixedFormats) {
+    enable({
+        { "in_a", 0, format("le:s16/16>>0") },
+        { "in_b", 1, format("be:s16/16>>0") },
+        { "in_c", 2, format("le:u16/16>>0") },
+        { "in_d", 3, format("be:u16/16>>0") },
+        { "in_e", 4, format("le:s32/32>>0") },
+        { "in_f", 5, format("be:u32/32>>0") },
+        { "in_g", 6, format("le:s12/16>>4") },
+        { "in_h", 7, format("be:u10/16>>2") },
+        { "in_i", 8, format("le:s20/32>>8") },
+        { "timestamp", 9, format("le:s64/64>>0") },
+    });
+    EXPECT_FALSE(sensor->isUniform());
+
+    set(0, { 0xfe, 0xff });
+    set(1, { 0xff, 0xfe });
+    set(2, { 0xfe, 0xff });
+    set(3, { 0xff, 0xfe });
+    set(4, { 0x00, 0x00, 0x00, 0x80 });
+    set(5, { 0x80, 0x00, 0x00, 0x01 });
+    // -3 in 12 bits, over 4 bits of garbage
+    set(6, { 0xdf, 0xff });
+    // 1000 in 10 bits, with garbage on both sides
+    set(7, { 0xff, 0xa3 });
+    // -70000 in 20 bits, shifted by 8, with garbage in the low and high bits
+    set(8, { 0x5a, 0x90, 0xee, 0xfe });
+    set(9, { 0xef, 0xcd, 0xab, 0x89, 0x67, 0x45, 0x23, 0x01 });
+
+    EXPECT_EQ(-2, decode(0));
+    EXPECT_EQ(-2, decode(1));
+    EXPECT_EQ(65534, decode(2));
+    EXPECT_EQ(65534, decode(3));
+    EXPECT_EQ(INT32_MIN, decode(4));
+    EXPECT_EQ(0x80000001LL, decode(5));
+    EXPECT_EQ(-3, decode(6));
+    EXPECT_EQ(1000, decode(7));
+    EXPECT_EQ(-70000, decode(8));
+    ASSERT_NE(nullptr, sensor->getTimestampPlan());
+    EXPECT_EQ(0x0123456789abcdefLL, TestIioSensor::decodeRaw(*sensor->getTimestampPlan(),
+            sample.data()));
+
+    sensors_event_t event = read();
+    EXPECT_EQ(0x0123456789abcdefLL, event.timestamp);
+    EXPECT_FLOAT_EQ(-0.5f, event.data[0]);
+    EXPECT_FLOAT_EQ(32767.5f, event.data[2]);
+    EXPECT_FLOAT_EQ(-1.0f, event.data[6]);
+    EXPECT_FLOAT_EQ(500.5f, event.data[7]);
+    EXPECT_FLOAT_EQ(-34999.5f, event.data[8]);
+}
+
+TEST_F(IioDecodeTest, StorageLibiioConverts) {
+    // 3 byte words have no loader: libiio converts them, and the HAL sign
+    // extends past the 3 bytes libiio writes
+    enable({
+        { "in_a", 0, format("le:s24/24>>0") },
+        { "in_b", 1, format("be:s24/24>>0") },
+        { "in_c", 2, format("be:u24/24>>0") },
+        { "in_d", 3, format("le:s20/24>>4") },
+        { "timestamp", 4, format("le:s64/64>>0") },
+    });
+    for (int index = 0; index < 4; ++index) {
+        ASSERT_NE(nullptr, sensor->getPlan(index));
+        EXPECT_EQ(nullptr, sensor->getPlan(index)->load) << "channel " << index;
+    }
+
+    set(0, { 0x90, 0xee, 0xfe });
+    set(1, { 0xfe, 0xee, 0x90 });
+    set(2, { 0xab, 0xcd, 0xef });
+    // -5 in 20 bits, over 4 bits of garbage
+    set(3, { 0xbf, 0xff, 0xff });
+
+    EXPECT_EQ(-70000, decode(0));
+    EXPECT_EQ(-70000, decode(1));
+    EXPECT_EQ(0xabcdef, decode(2));
+    EXPECT_EQ(-5, decode(3));
+
+    sensors_event_t event = read();
+    EXPECT_FLOAT_EQ(-34999.5f, event.data[0]);
+    EXPECT_FLOAT_EQ(5629688.0f, event.data[2]);
+    EXPECT_FLOAT_EQ(-2.0f, event.data[3]);
+}
+
+TEST_F(IioDecodeTest, UniformSigned16) {
+    enable({
+        { "in_x", 0, format("le:s16/16>>0") },
+        { "in_y", 1, format("le:s16/16>>0") },
+        { "in_z", 2, format("le:s16/16>>0") },
+        { "timestamp", 3, format("le:s64/64>>0") },
+    });
+    EXPECT_TRUE(sensor->isUniform());
+
+    set(0, { 0x00, 0x80 });
+    set(1, { 0xff, 0x7f });
+    set(2, { 0xff, 0xff });
+    set(3, { 0x40, 0x42, 0x0f, 0x00, 0x00, 0x00, 0x00, 0x00 });
+
+    sensors_event_t event = read();
+    EXPECT_EQ(1000000, event.timestamp);
+    EXPECT_FLOAT_EQ(-16383.5f, event.data[0]);
+    EXPECT_FLOAT_EQ(16384.0f, event.data[1]);
+    EXPECT_FLOAT_EQ(0.0f, event.data[2]);
+}
+
+TEST_F(IioDecodeTest, UniformUnsigned32) {
+    enable({
+        { "in_x", 0, format("le:u32/32>>0") },
+        { "in_y", 1, format("le:u32/32>>0") },
+        { "timestamp", 2, format("le:s64/64>>0") },
+    });
+    EXPECT_TRUE(sensor->isUniform());
+
+    set(0, { 0xff, 0xff, 0xff, 0xff });
+    set(1, { 0x01, 0x00, 0x00, 0x00 });
+
+    sensors_event_t event = read();
+    EXPECT_FLOAT_EQ(2147483648.0f, event.data[0]);
+    EXPECT_FLOAT_EQ(1.0f, event.data[1]);
+}
+
+TEST_F(IioDecodeTest, NotUniformWhenShiftedOrSwapped) {
+    // Same storage size, but one channel needs a shift and another a swap:
+    // these go through decodeRaw()
+    enable({
+        { "in_x", 0, format("le:s32/32>>0") },
+        { "in_y", 1, format("le:s24/32>>8") },
+        { "in_z", 2, format("be:s32/32>>0") },
+    });
+    EXPECT_FALSE(sensor->isUniform());
+    EXPECT_EQ(nullptr, sensor->getTimestampPlan());
+
+    set(0, { 0xfe, 0xff, 0xff, 0xff });
+    set(1, { 0x00, 0xfe, 0xff, 0xff });
+    set(2, { 0xff, 0xff, 0xff, 0xfe });
+
+    sensors_event_t event = read();
+    EXPECT_FLOAT_EQ(-0.5f, event.data[0]);
+    EXPECT_FLOAT_EQ(-0.5f, event.data[1]);
+    EXPECT_FLOAT_EQ(-0.5f, event.data[2]);
+}
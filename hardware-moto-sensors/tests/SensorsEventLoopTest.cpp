@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2017 Motorola Mobility LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "SensorsEventLoop.h"
+
+namespace {
+
+/** A driver whose fd is a pipe. Every byte written to the pipe is one event,
+ * and pending events are served without the pipe. */
+class FakeDriver {
+public:
+    explicit FakeDriver(int handle) : handle(handle), pending(0), reads(0) {
+        fds[0] = fds[1] = -1;
+        if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+            ADD_FAILURE() << "pipe2: " << strerror(errno);
+        }
+    }
+
+    ~FakeDriver() {
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    int getFd() const { return fds[0]; }
+
+    void push(int nb) {
+        for (int i = 0; i < nb; ++i) {
+            char c = 0;
+            ASSERT_EQ(1, write(fds[1], &c, 1));
+        }
+    }
+
+    bool hasPendingEvents() const { return pending > 0; }
+
+    int readEvents(sensors_event_t *data, int count) {
+        int nb = 0;
+
+        reads++;
+        for (; nb < count && pending > 0; ++nb, --pending) {
+            fill(data[nb]);
+        }
+        for (char c; nb < count && read(fds[0], &c, 1) == 1; ++nb) {
+            fill(data[nb]);
+        }
+        return nb;
+    }
+
+    const int handle;
+    int pending;
+    int reads;
+
+private:
+    int fds[2];
+
+    void fill(sensors_event_t &e) {
+        memset(&e, 0, sizeof(e));
+        e.sensor = handle;
+    }
+};
+
+int countFor(const sensors_event_t *data, int nb, int handle) {
+    int n = 0;
+    for (int i = 0; i < nb; ++i) {
+        if (data[i].sensor == handle) {
+            n++;
+        }
+    }
+    return n;
+}
+
+} // namespace
+
+TEST(SensorsEventLoopTest, RejectsEmptyBuffer) {
+    SensorsEventLoop<FakeDriver> loop;
+    sensors_event_t data[1];
+
+    EXPECT_EQ(-EINVAL, loop.poll(data, 0));
+    EXPECT_EQ(-EINVAL, loop.poll(nullptr, 1));
+}
+
+TEST(SensorsEventLoopTest, PendingEventsSkipBlocking) {
+    SensorsEventLoop<FakeDriver> loop;
+    FakeDriver pendingOnly(1);
+    sensors_event_t data[8];
+
+    ASSERT_EQ(0, loop.addDriver(&pendingOnly, -1));
+    pendingOnly.pending = 3;
+
+    EXPECT_EQ(3, loop.poll(data, 8));
+    EXPECT_EQ(3, countFor(data, 3, 1));
+}
+
+TEST(SensorsEventLoopTest, ReadyDriversShareTheBuffer) {
+    SensorsEventLoop<FakeDriver> loop;
+    FakeDriver a(1), b(2);
+    sensors_event_t data[8];
+
+    ASSERT_EQ(0, loop.addDriver(&a, a.getFd()));
+    ASSERT_EQ(0, loop.addDriver(&b, b.getFd()));
+    a.push(20);
+    b.push(20);
+
+    int nb = loop.poll(data, 8);
+    EXPECT_EQ(8, nb);
+    EXPECT_EQ(4, countFor(data, nb, 1));
+    EXPECT_EQ(4, countFor(data, nb, 2));
+}
+
+TEST(SensorsEventLoopTest, BlocksUntilAnFdIsReadable) {
+    SensorsEventLoop<FakeDriver> loop;
+    FakeDriver a(1);
+    sensors_event_t data[4];
+    std::atomic<int> result(-1);
+
+    ASSERT_EQ(0, loop.addDriver(&a, a.getFd()));
+    std::thread poller([&] { result = loop.poll(data, 4); });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(-1, result);
+    a.push(1);
+    poller.join();
+    EXPECT_EQ(1, result);
+}
+
+// A driver without an fd used to leave epoll with nothing to wait on, and
+// poll() returned 0 events in a tight loop.
+TEST(SensorsEventLoopTest, NoFdDoesNotSpin) {
+    auto loop = new SensorsEventLoop<FakeDriver>();
+    auto pendingOnly = new FakeDriver(1);
+    static sensors_event_t data[4];
+    auto returned = std::make_shared<std::atomic<bool>>(false);
+
+    ASSERT_EQ(0, loop->addDriver(pendingOnly, -1));
+    std::thread([loop, returned] {
+        loop->poll(data, 4);
+        *returned = true;
+    }).detach();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_FALSE(*returned);
+    EXPECT_EQ(0, pendingOnly->reads);
+    // The poller never returns, so the loop and driver are leaked on purpose.
+}
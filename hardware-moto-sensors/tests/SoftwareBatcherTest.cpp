@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2017 Motorola Mobility LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Pushes events through SoftwareBatcher the way the motosh HAL does, and
+// checks the order they come out in: per sensor FIFO order, held events
+// ahead of their flush complete, and release on the watermark or deadline.
+
+#include <gtest/gtest.h>
+
+#include <poll.h>
+#include <string.h>
+
+#include <vector>
+
+#include "SoftwareBatcher.h"
+
+#define HANDLE_ACCEL    (1)
+#define HANDLE_GYRO     (2)
+#define HANDLE_LIGHT    (3)
+
+#define PERIOD_NS       (10000000LL)
+
+namespace {
+
+sensors_event_t makeEvent(int handle, int64_t timestamp) {
+    sensors_event_t ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.version = sizeof(ev);
+    ev.sensor = handle;
+    ev.type = handle == HANDLE_ACCEL ? SENSOR_TYPE_ACCELEROMETER : SENSOR_TYPE_GYROSCOPE;
+    ev.timestamp = timestamp;
+    return ev;
+}
+
+sensors_event_t makeFlushComplete(int handle) {
+    sensors_event_t ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.version = META_DATA_VERSION;
+    ev.type = SENSOR_TYPE_META_DATA;
+    ev.meta_data.what = META_DATA_FLUSH_COMPLETE;
+    ev.meta_data.sensor = handle;
+    return ev;
+}
+
+/** Collects what the batcher emits. */
+class Sink {
+public:
+    void operator()(const sensors_event_t &ev) {
+        events.push_back(ev);
+    }
+
+    std::vector<sensors_event_t> events;
+};
+
+class SoftwareBatcherTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_GE(batcher.getFd(), 0);
+        batcher.setCapacity(HANDLE_ACCEL, 100);
+        batcher.setCapacity(HANDLE_GYRO, 100);
+    }
+
+    void push(const sensors_event_t &ev) {
+        batcher.push(ev, [this](const sensors_event_t &e) { sink(e); });
+    }
+
+    void pushSamples(int handle, int nb, int64_t start = 0) {
+        for (int i = 1; i <= nb; ++i) {
+            push(makeEvent(handle, start + i * PERIOD_NS));
+        }
+    }
+
+    /** Waits for the timerfd like the HAL's poll loop, then releases what's
+     * due. @return false if the timer didn't fire within timeoutMs. */
+    bool waitAndRelease(int timeoutMs) {
+        struct pollfd pfd = { batcher.getFd(), POLLIN, 0 };
+
+        if (::poll(&pfd, 1, timeoutMs) != 1) {
+            return false;
+        }
+        batcher.releaseExpired([this](const sensors_event_t &e) { sink(e); });
+        return true;
+    }
+
+    /** The timestamps emitted for handle must follow each other by one
+     * period, from the first sample on. */
+    void expectInOrder(int handle, size_t nb) {
+        size_t n = 0;
+        for (const auto &ev : sink.events) {
+            if (ev.type != SENSOR_TYPE_META_DATA && ev.sensor == handle) {
+                EXPECT_EQ(static_cast<int64_t>(++n) * PERIOD_NS, ev.timestamp)
+                    << "handle " << handle;
+            }
+        }
+        EXPECT_EQ(nb, n) << "handle " << handle;
+    }
+
+    SoftwareBatcher batcher;
+    Sink sink;
+};
+
+} // namespace
+
+TEST_F(SoftwareBatcherTest, UnbatchedSensorsPassThrough) {
+    EXPECT_EQ(0u, batcher.getCapacity(HANDLE_LIGHT));
+    EXPECT_EQ(100u, batcher.getCapacity(HANDLE_ACCEL));
+
+    // No FIFO, and a FIFO without latency, both emit right away
+    pushSamples(HANDLE_LIGHT, 3);
+    batcher.configure(HANDLE_ACCEL, PERIOD_NS, 0);
+    pushSamples(HANDLE_ACCEL, 3);
+
+    EXPECT_EQ(6u, sink.events.size());
+    EXPECT_FALSE(batcher.isBatching());
+}
+
+TEST_F(SoftwareBatcherTest, WatermarkReleasesInFifoOrder) {
+    // 1s of latency at 100Hz: the 100 events capacity
+    batcher.configure(HANDLE_ACCEL, PERIOD_NS, 1000000000LL);
+    EXPECT_TRUE(batcher.isBatching());
+
+    pushSamples(HANDLE_ACCEL, 99);
+    EXPECT_TRUE(sink.events.empty());
+
+    pushSamples(HANDLE_ACCEL, 1, 99 * PERIOD_NS);
+    expectInOrder(HANDLE_ACCEL, 100);
+}
+
+TEST_F(SoftwareBatcherTest, InterleavedSensorsKeepTheirOrder) {
+    // Watermarks of 20 and 30 events
+    batcher.configure(HANDLE_ACCEL, PERIOD_NS, 20 * PERIOD_NS);
+    batcher.configure(HANDLE_GYRO, PERIOD_NS, 30 * PERIOD_NS);
+
+    for (int i = 1; i <= 60; ++i) {
+        push(makeEvent(HANDLE_ACCEL, i * PERIOD_NS));
+        push(makeEvent(HANDLE_GYRO, i * PERIOD_NS));
+    }
+
+    ASSERT_EQ(120u, sink.events.size());
+    expectInOrder(HANDLE_ACCEL, 60);
+    expectInOrder(HANDLE_GYRO, 60);
+}
+
+TEST_F(SoftwareBatcherTest, FlushCompleteFollowsHeldEvents) {
+    batcher.configure(HANDLE_ACCEL, PERIOD_NS, 1000000000LL);
+    batcher.configure(HANDLE_GYRO, PERIOD_NS, 1000000000LL);
+    pushSamples(HANDLE_ACCEL, 10);
+    pushSamples(HANDLE_GYRO, 5);
+
+    push(makeFlushComplete(HANDLE_ACCEL));
+
+    // Only the flushed sensor's events, then its flush complete
+    ASSERT_EQ(11u, sink.events.size());
+    expectInOrder(HANDLE_ACCEL, 10);
+    EXPECT_EQ(SENSOR_TYPE_META_DATA, sink.events.back().type);
+    EXPECT_EQ(HANDLE_ACCEL, sink.events.back().meta_data.sensor);
+
+    // The other sensor is still held, and keeps batching after a flush
+    push(makeFlushComplete(HANDLE_GYRO));
+    pushSamples(HANDLE_ACCEL, 1, 10 * PERIOD_NS);
+    ASSERT_EQ(17u, sink.events.size());
+    expectInOrder(HANDLE_GYRO, 5);
+    EXPECT_EQ(SENSOR_TYPE_META_DATA, sink.events.back().type);
+    EXPECT_EQ(HANDLE_GYRO, sink.events.back().meta_data.sensor);
+}
+
+TEST_F(SoftwareBatcherTest, DeadlineReleasesOnTimer) {
+    // 50ms of latency, with a watermark the test never reaches
+    batcher.configure(HANDLE_ACCEL, 1000000LL, 50000000LL);
+    pushSamples(HANDLE_ACCEL, 3);
+    EXPECT_TRUE(sink.events.empty());
+
+    ASSERT_TRUE(waitAndRelease(1000));
+    expectInOrder(HANDLE_ACCEL, 3);
+    EXPECT_TRUE(batcher.isBatching());
+}
+
+TEST_F(SoftwareBatcherTest, LoweredWatermarkReleasesHeldEvents) {
+    batcher.configure(HANDLE_ACCEL, PERIOD_NS, 1000000000LL);
+    pushSamples(HANDLE_ACCEL, 30);
+
+    // The held events are over the new watermark of 10, and shouldn't wait
+    // out the old 1s deadline
+    batcher.configure(HANDLE_ACCEL, PERIOD_NS, 10 * PERIOD_NS);
+    ASSERT_TRUE(waitAndRelease(100));
+    expectInOrder(HANDLE_ACCEL, 30);
+}
+
+TEST_F(SoftwareBatcherTest, ZeroLatencyReleasesHeldEvents) {
+    batcher.configure(HANDLE_ACCEL, PERIOD_NS, 1000000000LL);
+    pushSamples(HANDLE_ACCEL, 5);
+
+    batcher.configure(HANDLE_ACCEL, PERIOD_NS, 0);
+    ASSERT_TRUE(waitAndRelease(100));
+    expectInOrder(HANDLE_ACCEL, 5);
+    EXPECT_FALSE(batcher.isBatching());
+}
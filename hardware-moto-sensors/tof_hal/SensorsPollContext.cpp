@@ -45,7 +45,7 @@
 
 using namespace std;
 
-SensorsPollContext::SensorsPollContext() {
+SensorsPollContext::SensorsPollContext() : eventLoop() {
     S_LOGD("+ pid=%d tid=%d", getpid(), gettid());
 
 //#ifdef _ENABLE_REARPROX
@@ -58,24 +58,12 @@ SensorsPollContext::SensorsPollContext() {
             continue;
         }
         int fd = driver->getFd();
-        //S_LOGD("Adding fd=%d for driver=0x%08x @ %d", fd, driver.get(), pollFds.size());
-        if (fd >= 0) {
-            fd2driver[fd] = driver;
-            pollFds.push_back({
-                    .fd = fd,
-                    .events = POLLIN,
-                    .revents = 0
-            });
-        }
+        eventLoop.addDriver(driver.get(), fd);
     }
 }
 
 int SensorsPollContext::poll(sensors_event_t* data, int count)
 {
-    int nbEvents = 0;
-    int ret;
-    int err;
-
     //S_LOGD("count=%d pid=%d tid=%d", count, getpid(), gettid());
 
     if (!data) {
@@ -88,50 +76,14 @@ int SensorsPollContext::poll(sensors_event_t* data, int count)
         return -EINVAL;
     }
 
-    auto eventReader = [&](shared_ptr<SensorBase> d, int fd) {
-        int nb = d->readEvents(data, count, fd);
-        if (nb > 0) {
-            count -= nb;
-            nbEvents += nb;
-            data += nb;
-        }
-        return nb;
-    };
-
-    // See if we have any pending events before blocking on poll()
-    for (const auto& d : drivers) {
-        if (d->hasPendingEvents()) {
-            if (eventReader(d, -1) <= 0) {
-                S_LOGE("Failed to read pending events");
-            }
-        }
-    }
-
-    if (nbEvents) return nbEvents;
-
-    ret = TEMP_FAILURE_RETRY(::poll(&pollFds.front(), pollFds.size(), -1));
-    err = errno;
-
-    // Success
-    if (ret > 0) {
-        for (const auto& p : pollFds) {
-            if (p.revents & POLLIN) {
-                int nb = eventReader(fd2driver[p.fd], p.fd);
-                // Need to relay any errors upward.
-                if (nb < 0) {
-                    //if eventread error in one fd, print log
-                    //then return event read from other fds
-                    S_LOGE("reading events failed fd=%d nb=%d", p.fd, nb);
-                }
-            }
-        }
-    } else if (ret == 0) {
-        S_LOGD("poll() timed out");
-    } else {
-        S_LOGE("poll() failed with %d (%s)", err, strerror(err));
-    }
+    int ret = eventLoop.poll(data, count);
+    // SensorsModuleT::poll() calls us again on 0
+    return ret >= 0 ? ret : 0;
+}
 
-    return nbEvents >= 0 ? nbEvents : 0;
+int SensorsPollContext::close() {
+    eventLoop.dumpStats();
+    return 0;
 }
 
 int SensorsPollContext::getSensorsList(struct sensor_t const** list) {
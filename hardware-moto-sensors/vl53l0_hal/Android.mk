@@ -31,7 +31,8 @@ LOCAL_SRC_FILES := \
     RearProxSensor.cpp \
     SensorsPollContext.cpp \
     SensorBase.cpp \
-    ../InputEventReader.cpp
+    ../InputEventReader.cpp \
+    ../DirectChannel.cpp
 
 LOCAL_C_INCLUDES += \
     $(LOCAL_PATH)/.. \